@@ -0,0 +1,288 @@
+/*
+ *  Patch layout, integers are little endian or LEB128 varints:
+ *
+ *  header   "BDP1", u32 source size, u32 target size, u32 flags (0),
+ *           source image SHA-256, target image SHA-256
+ *  body     controls: varint diff length, varint extra length, varint seek
+ *           (zigzag), then the diff runs and the extra bytes
+ *  diff     run headers: varint (length << 1 | 1) for zero runs, nothing
+ *           follows; varint (length << 1) for literal runs, length bytes
+ *           follow and are added to the source bytes
+ */
+
+#include "delta-patch.h"
+
+#include <string.h>
+
+enum {
+    PATCH_STATE_CONTROL = 0,
+    PATCH_STATE_RUN_HEADER,
+    PATCH_STATE_ZERO_RUN,
+    PATCH_STATE_LITERAL_RUN,
+    PATCH_STATE_EXTRA
+};
+
+#define CONTROL_VALUES_COUNT 3
+
+#define VARINT_MAX_SHIFT 28
+
+static uint32_t delta_patch_read_u32(const uint8_t *data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t) data[3] << 24);
+}
+
+bool delta_patch_parse_header(const uint8_t *data, size_t length, delta_patch_header_t *header) {
+
+    if (length < DELTA_PATCH_HEADER_SIZE || memcmp(data, DELTA_PATCH_MAGIC, 4) != 0) {
+        return false;
+    }
+
+    // no flags are defined yet
+    if (delta_patch_read_u32(data + 12) != 0) {
+        return false;
+    }
+
+    header->source_size = delta_patch_read_u32(data + 4);
+    header->target_size = delta_patch_read_u32(data + 8);
+    memcpy(header->source_hash, data + 16, DELTA_PATCH_HASH_SIZE);
+    memcpy(header->target_hash, data + 16 + DELTA_PATCH_HASH_SIZE, DELTA_PATCH_HASH_SIZE);
+
+    return true;
+}
+
+void delta_patch_init(delta_patch_t *patch, const delta_patch_header_t *header,
+        delta_patch_read_f read_source, delta_patch_write_f write_target, void *context) {
+
+    memset(patch, 0, offsetof(delta_patch_t, source_block));
+    patch->header = *header;
+    patch->read_source = read_source;
+    patch->write_target = write_target;
+    patch->context = context;
+    patch->state = PATCH_STATE_CONTROL;
+}
+
+static esp_err_t delta_patch_flush_window(delta_patch_t *patch) {
+
+    if (patch->window_length == 0) {
+        return ESP_OK;
+    }
+
+    esp_err_t err = patch->write_target(patch->context, patch->window, patch->window_length);
+    patch->window_length = 0;
+    return err;
+}
+
+/**
+ * Make the source block hold the current source position,
+ * return the bytes available from it or 0 if out of the source image
+ */
+static uint32_t delta_patch_load_source(delta_patch_t *patch, const uint8_t **source) {
+
+    if (patch->source_position < 0 || patch->source_position >= patch->header.source_size) {
+        return 0;
+    }
+
+    uint32_t position = patch->source_position;
+
+    if (position < patch->source_block_offset || position >= patch->source_block_offset + patch->source_block_length) {
+        uint32_t length = patch->header.source_size - position;
+        length = length < DELTA_PATCH_SOURCE_BLOCK_SIZE ? length : DELTA_PATCH_SOURCE_BLOCK_SIZE;
+        if (patch->read_source(patch->context, position, patch->source_block, length) != ESP_OK) {
+            patch->source_block_length = 0;
+            return 0;
+        }
+        patch->source_block_offset = position;
+        patch->source_block_length = length;
+    }
+
+    uint32_t index = position - patch->source_block_offset;
+    *source = patch->source_block + index;
+    return patch->source_block_length - index;
+}
+
+/**
+ * Accumulate a varint byte, true once the value is complete
+ */
+static bool delta_patch_read_varint(delta_patch_t *patch, uint8_t byte, esp_err_t *err) {
+
+    if (patch->varint_shift > VARINT_MAX_SHIFT) {
+        *err = ESP_ERR_INVALID_ARG;
+        return false;
+    }
+
+    patch->varint_value |= (uint32_t) (byte & 0x7F) << patch->varint_shift;
+    patch->varint_shift += 7;
+
+    return (byte & 0x80) == 0;
+}
+
+static void delta_patch_end_control(delta_patch_t *patch) {
+
+    patch->source_position += patch->seek;
+    patch->state = PATCH_STATE_CONTROL;
+}
+
+static esp_err_t delta_patch_start_control(delta_patch_t *patch) {
+
+    uint64_t produced = (uint64_t) patch->target_written + patch->diff_remaining + patch->extra_remaining;
+    if (produced > patch->header.target_size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    patch->target_written = produced;
+
+    if (patch->diff_remaining > 0) {
+        patch->state = PATCH_STATE_RUN_HEADER;
+    } else if (patch->extra_remaining > 0) {
+        patch->state = PATCH_STATE_EXTRA;
+    } else {
+        delta_patch_end_control(patch);
+    }
+
+    return ESP_OK;
+}
+
+static void delta_patch_end_diff(delta_patch_t *patch) {
+
+    if (patch->diff_remaining > 0) {
+        patch->state = PATCH_STATE_RUN_HEADER;
+    } else if (patch->extra_remaining > 0) {
+        patch->state = PATCH_STATE_EXTRA;
+    } else {
+        delta_patch_end_control(patch);
+    }
+}
+
+static esp_err_t delta_patch_on_varint(delta_patch_t *patch) {
+
+    uint32_t value = patch->varint_value;
+    patch->varint_value = 0;
+    patch->varint_shift = 0;
+
+    if (patch->state == PATCH_STATE_RUN_HEADER) {
+        patch->run_remaining = value >> 1;
+        if (patch->run_remaining == 0 || patch->run_remaining > patch->diff_remaining) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        patch->diff_remaining -= patch->run_remaining;
+        patch->state = value & 1 ? PATCH_STATE_ZERO_RUN : PATCH_STATE_LITERAL_RUN;
+        return ESP_OK;
+    }
+
+    switch (patch->control_index++) {
+        case 0:
+            patch->diff_remaining = value;
+            return ESP_OK;
+        case 1:
+            patch->extra_remaining = value;
+            return ESP_OK;
+        default:
+            patch->control_index = 0;
+            // zigzag encoded
+            patch->seek = (int32_t) (value >> 1) ^ -(int32_t) (value & 1);
+            return delta_patch_start_control(patch);
+    }
+}
+
+/**
+ * Copy a zero run from the source, no patch bytes are consumed
+ */
+static esp_err_t delta_patch_copy_source(delta_patch_t *patch) {
+
+    while (patch->run_remaining > 0) {
+
+        const uint8_t *source;
+        uint32_t available = delta_patch_load_source(patch, &source);
+        if (available == 0) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        uint32_t length = DELTA_PATCH_WINDOW_SIZE - patch->window_length;
+        length = length < available ? length : available;
+        length = length < patch->run_remaining ? length : patch->run_remaining;
+
+        memcpy(patch->window + patch->window_length, source, length);
+        patch->window_length += length;
+        patch->source_position += length;
+        patch->run_remaining -= length;
+
+        if (patch->window_length == DELTA_PATCH_WINDOW_SIZE) {
+            esp_err_t err = delta_patch_flush_window(patch);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+    }
+
+    delta_patch_end_diff(patch);
+    return ESP_OK;
+}
+
+static esp_err_t delta_patch_put_byte(delta_patch_t *patch, uint8_t byte) {
+
+    patch->window[patch->window_length++] = byte;
+
+    return patch->window_length == DELTA_PATCH_WINDOW_SIZE ? delta_patch_flush_window(patch) : ESP_OK;
+}
+
+esp_err_t delta_patch_feed(delta_patch_t *patch, const uint8_t *data, size_t length) {
+
+    esp_err_t err = ESP_OK;
+    size_t index = 0;
+
+    while (err == ESP_OK && (index < length || patch->state == PATCH_STATE_ZERO_RUN)) {
+
+        if (patch->state == PATCH_STATE_ZERO_RUN) {
+            err = delta_patch_copy_source(patch);
+            continue;
+        }
+
+        if (patch->state == PATCH_STATE_CONTROL && patch->control_index == 0 &&
+            patch->target_written == patch->header.target_size) {
+            // trailing bytes after the whole target
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        uint8_t byte = data[index++];
+
+        switch (patch->state) {
+            case PATCH_STATE_CONTROL:
+            case PATCH_STATE_RUN_HEADER:
+                if (delta_patch_read_varint(patch, byte, &err)) {
+                    err = delta_patch_on_varint(patch);
+                }
+                break;
+            case PATCH_STATE_LITERAL_RUN: {
+                const uint8_t *source;
+                if (delta_patch_load_source(patch, &source) == 0) {
+                    return ESP_ERR_INVALID_SIZE;
+                }
+                patch->source_position++;
+                err = delta_patch_put_byte(patch, *source + byte);
+                if (--patch->run_remaining == 0) {
+                    delta_patch_end_diff(patch);
+                }
+                break;
+            }
+            case PATCH_STATE_EXTRA:
+                err = delta_patch_put_byte(patch, byte);
+                if (--patch->extra_remaining == 0) {
+                    delta_patch_end_control(patch);
+                }
+                break;
+        }
+    }
+
+    return err;
+}
+
+esp_err_t delta_patch_finish(delta_patch_t *patch) {
+
+    bool is_complete = patch->state == PATCH_STATE_CONTROL && patch->control_index == 0 &&
+        patch->varint_shift == 0 && patch->target_written == patch->header.target_size;
+
+    if (!is_complete) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    return delta_patch_flush_window(patch);
+}
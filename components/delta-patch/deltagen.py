@@ -0,0 +1,267 @@
+#!/usr/bin/env python
+#
+# Generate and verify delta patches of app images, applied on the device by
+# delta-patch.c while streaming the download. See delta-patch.c for the layout.
+#
+# usage: deltagen.py diff <source.bin> <target.bin> <patch>
+#        deltagen.py apply <source.bin> <patch> <target.bin>
+#        deltagen.py verify <source.bin> <target.bin> <patch>
+
+import hashlib
+import struct
+import sys
+import time
+
+PATCH_MAGIC = b'BDP1'
+HEADER_FORMAT = '<4sIII32s32s'
+HASH_SIZE = 32
+
+# ESP image header: magic, segments, spi mode, spi size, entry point, then the extended header
+IMAGE_MAGIC = 0xE9
+IMAGE_HASH_APPENDED_OFFSET = 23
+
+# bytes indexed to find matches and minimum zero run worth a run header
+MATCH_KEY_LENGTH = 8
+MIN_ZERO_RUN = 4
+
+# a match is extended while it scores better within this distance
+EXTENSION_LOOKAHEAD = 64
+
+
+def image_hash(image, name):
+    if len(image) < HASH_SIZE + IMAGE_HASH_APPENDED_OFFSET or image[0] != IMAGE_MAGIC:
+        sys.exit('%s is not an app image' % name)
+    if image[IMAGE_HASH_APPENDED_OFFSET] != 1:
+        sys.exit('%s has no appended SHA-256' % name)
+
+    # the device identifies the running image by its appended hash
+    digest = image[-HASH_SIZE:]
+    if hashlib.sha256(image[:-HASH_SIZE]).digest() != digest:
+        sys.exit('%s appended SHA-256 does not match' % name)
+    return digest
+
+
+def write_varint(out, value):
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return
+
+
+def read_varint(patch, index):
+    value = 0
+    shift = 0
+    while True:
+        byte = patch[index]
+        index += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, index
+
+
+def zigzag(value):
+    return (value << 1) ^ (value >> 63)
+
+
+def unzigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def extend_forward(source, target, s, t, limit):
+    # bsdiff style approximate extension, keep the length with the best matches - mismatches score
+    score = best_score = best_length = 0
+    i = 0
+    while i < limit and s + i < len(source) and t + i < len(target):
+        score += 1 if source[s + i] == target[t + i] else -1
+        i += 1
+        if score > best_score:
+            best_score = score
+            best_length = i
+        elif i - best_length > EXTENSION_LOOKAHEAD:
+            break
+    return best_length
+
+
+def extend_backward(source, target, s, t, limit):
+    score = best_score = best_length = 0
+    i = 1
+    while i <= limit and s - i >= 0:
+        score += 1 if source[s - i] == target[t - i] else -1
+        if score > best_score:
+            best_score = score
+            best_length = i
+        elif i - best_length > EXTENSION_LOOKAHEAD:
+            break
+        i += 1
+    return best_length
+
+
+def find_matches(source, target):
+    index = {}
+    for s in range(len(source) - MATCH_KEY_LENGTH, -1, -1):
+        index[source[s:s + MATCH_KEY_LENGTH]] = s
+
+    matches = []
+    last_end = 0
+    offset = 0
+    t = 0
+
+    while t <= len(target) - MATCH_KEY_LENGTH:
+        key = target[t:t + MATCH_KEY_LENGTH]
+
+        # the offset of the previous match is tried first, code moved as a block keeps it
+        s = t + offset
+        if not (0 <= s <= len(source) - MATCH_KEY_LENGTH and source[s:s + MATCH_KEY_LENGTH] == key):
+            s = index.get(key)
+        if s is None:
+            t += 1
+            continue
+
+        back = extend_backward(source, target, s, t, t - last_end)
+        length = extend_forward(source, target, s, t, len(target) - t)
+        matches.append((s - back, t - back, back + length))
+
+        offset = s - t
+        t += length
+        last_end = t
+
+    return matches
+
+
+def encode_diff(out, source, target, s, t, length):
+    diff = bytes((target[t + i] - source[s + i]) & 0xFF for i in range(length))
+
+    i = 0
+    literal_start = 0
+    while i < length:
+        if diff[i] != 0:
+            i += 1
+            continue
+        zero_end = i
+        while zero_end < length and diff[zero_end] == 0:
+            zero_end += 1
+        if zero_end - i >= MIN_ZERO_RUN:
+            if i > literal_start:
+                write_varint(out, (i - literal_start) << 1)
+                out += diff[literal_start:i]
+            write_varint(out, (zero_end - i) << 1 | 1)
+            literal_start = zero_end
+        i = zero_end
+
+    if length > literal_start:
+        write_varint(out, (length - literal_start) << 1)
+        out += diff[literal_start:length]
+
+
+def diff_images(source, target):
+    header = struct.pack(HEADER_FORMAT, PATCH_MAGIC, len(source), len(target), 0,
+                         image_hash(source, 'source'), image_hash(target, 'target'))
+
+    body = bytearray()
+    matches = find_matches(source, target)
+    target_position = 0
+
+    # a leading control without diff carries the bytes before the first match
+    if not matches or matches[0][0] > 0 or matches[0][1] > 0:
+        first_source = matches[0][0] if matches else 0
+        extra_end = matches[0][1] if matches else len(target)
+        write_varint(body, 0)
+        write_varint(body, extra_end)
+        write_varint(body, zigzag(first_source))
+        body += target[:extra_end]
+        target_position = extra_end
+
+    for i, (s, t, length) in enumerate(matches):
+        extra_end = matches[i + 1][1] if i + 1 < len(matches) else len(target)
+        next_source = matches[i + 1][0] if i + 1 < len(matches) else s + length
+        write_varint(body, length)
+        write_varint(body, extra_end - t - length)
+        write_varint(body, zigzag(next_source - s - length))
+        encode_diff(body, source, target, s, t, length)
+        body += target[t + length:extra_end]
+        target_position = extra_end
+
+    assert target_position == len(target)
+    return header + bytes(body)
+
+
+def apply_patch(source, patch):
+    magic, source_size, target_size, flags, source_hash, target_hash = \
+        struct.unpack_from(HEADER_FORMAT, patch)
+    if magic != PATCH_MAGIC or flags != 0:
+        sys.exit('not a delta patch')
+    if source_size != len(source) or source_hash != image_hash(source, 'source'):
+        sys.exit('patch does not apply to this source image')
+
+    target = bytearray()
+    index = struct.calcsize(HEADER_FORMAT)
+    source_position = 0
+
+    while index < len(patch):
+        diff_length, index = read_varint(patch, index)
+        extra_length, index = read_varint(patch, index)
+        seek, index = read_varint(patch, index)
+
+        while diff_length > 0:
+            run, index = read_varint(patch, index)
+            run_length = run >> 1
+            if run & 1:
+                target += source[source_position:source_position + run_length]
+            else:
+                target += bytes((source[source_position + i] + patch[index + i]) & 0xFF for i in range(run_length))
+                index += run_length
+            source_position += run_length
+            diff_length -= run_length
+
+        target += patch[index:index + extra_length]
+        index += extra_length
+        source_position += unzigzag(seek)
+
+    if len(target) != target_size or image_hash(bytes(target), 'target') != target_hash:
+        sys.exit('patched image does not match the target')
+    return bytes(target)
+
+
+def read_file(path):
+    with open(path, 'rb') as f:
+        return f.read()
+
+
+def write_file(path, data):
+    with open(path, 'wb') as f:
+        f.write(data)
+
+
+def main():
+    if len(sys.argv) != 5 or sys.argv[1] not in ('diff', 'apply', 'verify'):
+        sys.exit('usage: deltagen.py diff|verify <source.bin> <target.bin> <patch>\n'
+                 '       deltagen.py apply <source.bin> <patch> <target.bin>')
+
+    command = sys.argv[1]
+    source = read_file(sys.argv[2])
+
+    if command == 'apply':
+        write_file(sys.argv[4], apply_patch(source, read_file(sys.argv[3])))
+        return
+
+    target = read_file(sys.argv[3])
+
+    if command == 'diff':
+        start = time.time()
+        patch = diff_images(source, target)
+        write_file(sys.argv[4], patch)
+        print('patch of %d bytes, %.1f%% of the target, generated in %.1f s' %
+              (len(patch), 100.0 * len(patch) / len(target), time.time() - start))
+    else:
+        if apply_patch(source, read_file(sys.argv[4])) != target:
+            sys.exit('patched image does not match the target')
+        print('patch verified')
+
+
+if __name__ == '__main__':
+    main()
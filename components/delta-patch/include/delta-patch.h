@@ -0,0 +1,90 @@
+#ifndef DELTA_PATCH_INCLUDE_DELTA_PATCH_H_
+#define DELTA_PATCH_INCLUDE_DELTA_PATCH_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define DELTA_PATCH_MAGIC "BDP1"
+
+#define DELTA_PATCH_HEADER_SIZE 80
+
+#define DELTA_PATCH_HASH_SIZE 32
+
+// target bytes collected before a write
+#define DELTA_PATCH_WINDOW_SIZE 4096
+
+// source bytes read at once
+#define DELTA_PATCH_SOURCE_BLOCK_SIZE 1024
+
+/**
+ * Patch header, sizes are in bytes and hashes are the SHA-256 appended
+ * to the source and target app images
+ */
+typedef struct {
+    uint32_t source_size;
+    uint32_t target_size;
+    uint8_t source_hash[DELTA_PATCH_HASH_SIZE];
+    uint8_t target_hash[DELTA_PATCH_HASH_SIZE];
+} delta_patch_header_t;
+
+/**
+ * Read length bytes of the source image at offset
+ */
+typedef esp_err_t(*delta_patch_read_f)(void *context, uint32_t offset, void *data, size_t length);
+
+/**
+ * Write the next length bytes of the target image
+ */
+typedef esp_err_t(*delta_patch_write_f)(void *context, const void *data, size_t length);
+
+/**
+ * Streaming decoder of bsdiff style patches generated by deltagen.py.
+ * The patch is a sequence of controls (diff length, extra length, seek):
+ * diff bytes are added to the source bytes at the current source position,
+ * extra bytes are copied as they are, then the source position is moved by
+ * seek. Diff bytes are run length encoded, long zero runs copy the source.
+ * Memory use is fixed, the patch is fed in chunks of any size.
+ */
+typedef struct {
+    delta_patch_header_t header;
+    delta_patch_read_f read_source;
+    delta_patch_write_f write_target;
+    void *context;
+    uint8_t state;
+    uint8_t control_index;
+    uint32_t varint_value;
+    uint8_t varint_shift;
+    uint32_t diff_remaining;
+    uint32_t extra_remaining;
+    uint32_t run_remaining;
+    int32_t seek;
+    int64_t source_position;
+    uint32_t target_written;
+    uint32_t source_block_offset;
+    uint32_t source_block_length;
+    uint32_t window_length;
+    uint8_t source_block[DELTA_PATCH_SOURCE_BLOCK_SIZE];
+    uint8_t window[DELTA_PATCH_WINDOW_SIZE];
+} delta_patch_t;
+
+/**
+ * Parse the first DELTA_PATCH_HEADER_SIZE bytes of a patch, false if it's not one
+ */
+bool delta_patch_parse_header(const uint8_t *data, size_t length, delta_patch_header_t *header);
+
+void delta_patch_init(delta_patch_t *patch, const delta_patch_header_t *header,
+    delta_patch_read_f read_source, delta_patch_write_f write_target, void *context);
+
+/**
+ * Decode the next chunk of the patch body, the header excluded
+ */
+esp_err_t delta_patch_feed(delta_patch_t *patch, const uint8_t *data, size_t length);
+
+/**
+ * Write the last window, fails if the patch ended before the whole target was produced
+ */
+esp_err_t delta_patch_finish(delta_patch_t *patch);
+
+#endif
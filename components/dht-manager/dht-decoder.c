@@ -0,0 +1,55 @@
+#include "dht-decoder.h"
+
+#include <stdbool.h>
+
+// phase C and D last ~80us, bounds are loose to tolerate capture overhead
+#define DHT_RESPONSE_MIN_DURATION 40
+#define DHT_RESPONSE_MAX_DURATION 120
+
+static bool dht_is_response_pulse(const dht_pulse_t *pulse, uint8_t level) {
+    return pulse->level == level &&
+        pulse->duration >= DHT_RESPONSE_MIN_DURATION &&
+        pulse->duration <= DHT_RESPONSE_MAX_DURATION;
+}
+
+dht_decode_result_t dht_decode_pulses(const dht_pulse_t *pulses, size_t count, uint8_t data[DHT_DATA_BYTES]) {
+
+    size_t i = 0;
+    while (i + 1 < count && !(dht_is_response_pulse(&pulses[i], 0) && dht_is_response_pulse(&pulses[i + 1], 1))) {
+        i++;
+    }
+
+    if (i + 1 >= count) {
+        return DHT_DECODE_NO_RESPONSE;
+    }
+
+    // skip phases C and D
+    i += 2;
+
+    if (count - i < DHT_DATA_BITS * 2) {
+        return DHT_DECODE_TRUNCATED;
+    }
+
+    for (int bit = 0; bit < DHT_DATA_BITS; bit++, i += 2) {
+
+        const dht_pulse_t *low = &pulses[i];
+        const dht_pulse_t *high = &pulses[i + 1];
+
+        if (low->level != 0 || high->level != 1) {
+            return DHT_DECODE_BAD_LEVEL;
+        }
+
+        uint8_t b = bit / 8;
+        uint8_t m = bit % 8;
+        if (!m)
+            data[b] = 0;
+
+        data[b] |= (high->duration > low->duration) << (7 - m);
+    }
+
+    if (data[4] != ((data[0] + data[1] + data[2] + data[3]) & 0xFF)) {
+        return DHT_DECODE_BAD_CHECKSUM;
+    }
+
+    return DHT_DECODE_OK;
+}
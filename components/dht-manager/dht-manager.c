@@ -29,89 +29,249 @@
 #include <freertos/FreeRTOS.h>
 #include "freertos/task.h"
 #include <esp_log.h>
+#include "esp_timer.h"
 
 #include "dht-manager.h"
+#include "dht-decoder.h"
+
+#ifdef CONFIG_DHT_RMT_BACKEND
+#include "driver/rmt.h"
+#include "freertos/ringbuf.h"
+#endif
 
 static const char *TAG = "DHTxx";
 
 // DHT timer precision in microseconds
 #define DHT_TIMER_INTERVAL 2
-#define DHT_DATA_BITS 40
-#define DHT_DATA_BYTES (DHT_DATA_BITS / 8)
-#define UPDATE_TASK_DELAY 30000
+#define DHT_MAX_PULSES 128
+
+#ifdef CONFIG_DHT_RMT_BACKEND
+#define DHT_RMT_CHANNEL RMT_CHANNEL_4
+// 1us resolution from the 80MHz APB clock
+#define DHT_RMT_CLOCK_DIVIDER 80
+// glitches shorter than 100 APB cycles (1.25us) are ignored
+#define DHT_RMT_FILTER_TICKS 100
+// frame ends when the line stays high longer than this, in microseconds
+#define DHT_RMT_IDLE_THRESHOLD 200
+#define DHT_RMT_RINGBUFFER_SIZE 1024
+#define DHT_RMT_RECEIVE_TIMEOUT 50
+#endif
 
 #define CHECK_ARG(VAL) do { if (!(VAL)) return ESP_ERR_INVALID_ARG; } while (0)
 
-#define CHECK_LOGE(x, msg, ...) do { \
+#define CHECK_ERROR(x) do { \
         esp_err_t __; \
         if ((__ = x) != ESP_OK) { \
-            PORT_EXIT_CRITICAL; \
-            ESP_LOGE(TAG, msg, ## __VA_ARGS__); \
             return __; \
         } \
     } while (0)
 
-static portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
-#define PORT_ENTER_CRITICAL portENTER_CRITICAL(&mux)
-#define PORT_EXIT_CRITICAL portEXIT_CRITICAL(&mux)
+// temperature and humidity are always copied together
+static portMUX_TYPE last_reading_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static dht_reading_t last_reading;
 
-static TaskHandle_t dht_task_handle = NULL;
-static float humidity = 0.;
-static float temperature = 0.;
+static bool has_last_reading = false;
+
+// owned by the dht task
+static dht_pulse_t pulses[DHT_MAX_PULSES];
 
 static esp_err_t dht_manager_read_data(dht_sensor_type_t sensor_type, gpio_num_t pin, int16_t *humidity, int16_t *temperature);
 
 static esp_err_t dht_manager_read_float_data(dht_sensor_type_t sensor_type, gpio_num_t pin, float *humidity, float *temperature);
 
+static inline int16_t dht_convert_data(dht_sensor_type_t sensor_type, uint8_t msb, uint8_t lsb);
+
+static inline uint32_t dht_start_pulse_duration(dht_sensor_type_t sensor_type) {
+    return sensor_type == DHT_TYPE_SI7021 ? 500 : 20000;
+}
+
+#ifdef CONFIG_DHT_RMT_BACKEND
+
+static RingbufHandle_t rmt_ringbuffer = NULL;
+
+static esp_err_t dht_rmt_init(gpio_num_t pin) {
+
+    if (rmt_ringbuffer != NULL) {
+        return ESP_OK;
+    }
+
+    rmt_config_t config = {
+        .rmt_mode = RMT_MODE_RX,
+        .channel = DHT_RMT_CHANNEL,
+        .gpio_num = pin,
+        .clk_div = DHT_RMT_CLOCK_DIVIDER,
+        .mem_block_num = 1,
+        .rx_config = {
+            .filter_en = true,
+            .filter_ticks_thresh = DHT_RMT_FILTER_TICKS,
+            .idle_threshold = DHT_RMT_IDLE_THRESHOLD
+        }
+    };
+
+    CHECK_ERROR(rmt_config(&config));
+    CHECK_ERROR(rmt_driver_install(DHT_RMT_CHANNEL, DHT_RMT_RINGBUFFER_SIZE, 0));
+    return rmt_get_ringbuf_handle(DHT_RMT_CHANNEL, &rmt_ringbuffer);
+}
+
+/**
+ * Send the start pulse and let the RMT peripheral time the sensor answer.
+ * No critical section is needed, the start pulse is a task delay.
+ */
+static esp_err_t dht_capture_pulses(dht_sensor_type_t sensor_type, gpio_num_t pin, size_t *count) {
+
+    CHECK_ERROR(dht_rmt_init(pin));
+
+    // input stays enabled so that RMT sees the line while it is driven
+    gpio_set_direction(pin, GPIO_MODE_INPUT_OUTPUT_OD);
+
+    // Phase 'A' pulling signal low to initiate read sequence
+    gpio_set_level(pin, 0);
+    uint32_t start_pulse_ms = dht_start_pulse_duration(sensor_type) / 1000;
+    if (start_pulse_ms > 0) {
+        vTaskDelay(start_pulse_ms / portTICK_PERIOD_MS + 1);
+    } else {
+        ets_delay_us(dht_start_pulse_duration(sensor_type));
+    }
+
+    rmt_rx_start(DHT_RMT_CHANNEL, true);
+    gpio_set_level(pin, 1);
+
+    size_t length = 0;
+    rmt_item32_t *items = xRingbufferReceive(rmt_ringbuffer, &length, DHT_RMT_RECEIVE_TIMEOUT / portTICK_PERIOD_MS);
+    rmt_rx_stop(DHT_RMT_CHANNEL);
+
+    if (items == NULL) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    *count = 0;
+    size_t items_count = length / sizeof(rmt_item32_t);
+    for (size_t i = 0; i < items_count && *count + 2 <= DHT_MAX_PULSES; i++) {
+
+        if (items[i].duration0 == 0) {
+            break;
+        }
+        pulses[(*count)++] = (dht_pulse_t) { .level = items[i].level0, .duration = items[i].duration0 };
+
+        // a zero duration marks the end of the frame
+        if (items[i].duration1 == 0) {
+            break;
+        }
+        pulses[(*count)++] = (dht_pulse_t) { .level = items[i].level1, .duration = items[i].duration1 };
+    }
+
+    vRingbufferReturnItem(rmt_ringbuffer, items);
+
+    return ESP_OK;
+}
+
+#else
+
+static portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+#define PORT_ENTER_CRITICAL portENTER_CRITICAL(&mux)
+#define PORT_EXIT_CRITICAL portEXIT_CRITICAL(&mux)
+
 static esp_err_t dht_await_pin_state(gpio_num_t pin, uint32_t timeout, int expected_pin_state, uint32_t *duration);
 
-static inline int16_t dht_convert_data(dht_sensor_type_t sensor_type, uint8_t msb, uint8_t lsb);
+static inline void dht_add_pulse(size_t *count, uint8_t level, uint32_t duration) {
+    pulses[(*count)++] = (dht_pulse_t) { .level = level, .duration = duration };
+}
 
 /**
- * Request data from DHT and read raw bit stream.
+ * Request data from DHT and time the raw bit stream.
  * The function call should be protected from task switching.
- * Return false if error occurred.
  */
-static inline esp_err_t dht_fetch_data(dht_sensor_type_t sensor_type, 
-                                       gpio_num_t pin, 
-                                       uint8_t data[DHT_DATA_BYTES])
+static inline esp_err_t dht_fetch_data(gpio_num_t pin, size_t *count)
 {
-    uint32_t low_duration;
-    uint32_t high_duration;
+    uint32_t duration;
 
-    // Phase 'A' pulling signal low to initiate read sequence
-    gpio_set_direction(pin, GPIO_MODE_OUTPUT_OD);
-    gpio_set_level(pin, 0);
-    ets_delay_us(sensor_type == DHT_TYPE_SI7021 ? 500 : 20000);
     gpio_set_level(pin, 1);
 
     // Step through Phase 'B', 40us
-    CHECK_LOGE(dht_await_pin_state(pin, 40, 0, NULL),
-            "Initialization error, problem in phase 'B'");
+    CHECK_ERROR(dht_await_pin_state(pin, 40, 0, NULL));
     // Step through Phase 'C', 88us
-    CHECK_LOGE(dht_await_pin_state(pin, 88, 1, NULL),
-            "Initialization error, problem in phase 'C'");
+    CHECK_ERROR(dht_await_pin_state(pin, 88, 1, &duration));
+    dht_add_pulse(count, 0, duration);
     // Step through Phase 'D', 88us
-    CHECK_LOGE(dht_await_pin_state(pin, 88, 0, NULL),
-            "Initialization error, problem in phase 'D'");
+    CHECK_ERROR(dht_await_pin_state(pin, 88, 0, &duration));
+    dht_add_pulse(count, 1, duration);
 
-    // Read in each of the 40 bits of data...
+    // Time each of the 40 bits of data, decoding happens later
     for (int i = 0; i < DHT_DATA_BITS; i++)
     {
-        CHECK_LOGE(dht_await_pin_state(pin, 65, 1, &low_duration),
-                "LOW bit timeout");
-        CHECK_LOGE(dht_await_pin_state(pin, 75, 0, &high_duration),
-                "HIGH bit timeout");
+        CHECK_ERROR(dht_await_pin_state(pin, 65, 1, &duration));
+        dht_add_pulse(count, 0, duration);
+        CHECK_ERROR(dht_await_pin_state(pin, 75, 0, &duration));
+        dht_add_pulse(count, 1, duration);
+    }
 
-        uint8_t b = i / 8;
-        uint8_t m = i % 8;
-        if (!m)
-            data[b] = 0;
+    return ESP_OK;
+}
+
+/**
+ * Polling capture, the critical section only covers the sensor answer (~5ms).
+ */
+static esp_err_t dht_capture_pulses(dht_sensor_type_t sensor_type, gpio_num_t pin, size_t *count) {
 
-        data[b] |= (high_duration > low_duration) << (7 - m);
+    *count = 0;
+
+    // Phase 'A' pulling signal low to initiate read sequence
+    gpio_set_direction(pin, GPIO_MODE_OUTPUT_OD);
+    gpio_set_level(pin, 0);
+    ets_delay_us(dht_start_pulse_duration(sensor_type));
+
+    PORT_ENTER_CRITICAL;
+    esp_err_t result = dht_fetch_data(pin, count);
+    PORT_EXIT_CRITICAL;
+
+    return result;
+}
+
+/**
+ * Wait specified time for pin to go to a specified state.
+ * If timeout is reached and pin doesn't go to a requested state
+ * false is returned.
+ * The elapsed time is returned in pointer 'duration' if it is not NULL.
+ */
+static esp_err_t dht_await_pin_state(gpio_num_t pin, uint32_t timeout,
+       int expected_pin_state, uint32_t *duration)
+{
+    /* XXX dht_await_pin_state() should save pin direction and restore
+     * the direction before return. however, the SDK does not provide
+     * gpio_get_direction().
+     */
+    gpio_set_direction(pin, GPIO_MODE_INPUT);
+    for (uint32_t i = 0; i < timeout; i += DHT_TIMER_INTERVAL)
+    {
+        // need to wait at least a single interval to prevent reading a jitter
+        ets_delay_us(DHT_TIMER_INTERVAL);
+        if (gpio_get_level(pin) == expected_pin_state)
+        {
+            if (duration)
+                *duration = i;
+            return ESP_OK;
+        }
     }
 
-    return ESP_OK;
+    return ESP_ERR_TIMEOUT;
+}
+
+#endif
+
+static esp_err_t dht_decode_result_to_error(dht_decode_result_t result) {
+
+    switch (result) {
+        case DHT_DECODE_OK:
+            return ESP_OK;
+        case DHT_DECODE_NO_RESPONSE:
+        case DHT_DECODE_TRUNCATED:
+            return ESP_ERR_TIMEOUT;
+        case DHT_DECODE_BAD_CHECKSUM:
+            return ESP_ERR_INVALID_CRC;
+        default:
+            return ESP_ERR_INVALID_RESPONSE;
+    }
 }
 
 /**
@@ -134,28 +294,27 @@ static esp_err_t dht_manager_read_data(dht_sensor_type_t sensor_type,
     CHECK_ARG(humidity && temperature);
 
     uint8_t data[DHT_DATA_BYTES] = { 0 };
+    size_t count = 0;
 
     gpio_set_direction(pin, GPIO_MODE_OUTPUT_OD);
     gpio_set_level(pin, 1);
 
-    PORT_ENTER_CRITICAL;
-    esp_err_t result = dht_fetch_data(sensor_type, pin, data);
-    if(result == ESP_OK){
-        PORT_EXIT_CRITICAL;
-    }
+    esp_err_t result = dht_capture_pulses(sensor_type, pin, &count);
 
-    /* restore GPIO direction because, after calling dht_fetch_data(), the
+    /* restore GPIO direction because, after calling dht_capture_pulses(), the
      * GPIO direction mode changes */
     gpio_set_direction(pin, GPIO_MODE_OUTPUT_OD);
     gpio_set_level(pin, 1);
 
-    if (result != ESP_OK)
+    if (result != ESP_OK) {
+        ESP_LOGE(TAG, "Unable to capture sensor data: %d", result);
         return result;
+    }
 
-    if (data[4] != ((data[0] + data[1] + data[2] + data[3]) & 0xFF))
-    {
-        ESP_LOGE(TAG, "Checksum failed, invalid data received from sensor");
-        return ESP_ERR_INVALID_CRC;
+    dht_decode_result_t decode_result = dht_decode_pulses(pulses, count, data);
+    if (decode_result != DHT_DECODE_OK) {
+        ESP_LOGE(TAG, "Invalid data received from sensor, decode error %d", decode_result);
+        return dht_decode_result_to_error(decode_result);
     }
 
     *humidity = dht_convert_data(sensor_type, data[0], data[1]);
@@ -183,7 +342,7 @@ static esp_err_t dht_manager_read_float_data(dht_sensor_type_t sensor_type,
     
     CHECK_ARG(humidity && temperature);
 
-    int16_t i_humidity, i_temp;
+    int16_t i_humidity = 0, i_temp = 0;
 
     esp_err_t res = dht_manager_read_data(sensor_type, pin, &i_humidity, &i_temp);
     if (res != ESP_OK)
@@ -195,35 +354,6 @@ static esp_err_t dht_manager_read_float_data(dht_sensor_type_t sensor_type,
     return ESP_OK;
 }
 
-/**
- * Wait specified time for pin to go to a specified state.
- * If timeout is reached and pin doesn't go to a requested state
- * false is returned.
- * The elapsed time is returned in pointer 'duration' if it is not NULL.
- */
-static esp_err_t dht_await_pin_state(gpio_num_t pin, uint32_t timeout,
-       int expected_pin_state, uint32_t *duration)
-{
-    /* XXX dht_await_pin_state() should save pin direction and restore
-     * the direction before return. however, the SDK does not provide
-     * gpio_get_direction().
-     */
-    gpio_set_direction(pin, GPIO_MODE_INPUT);
-    for (uint32_t i = 0; i < timeout; i += DHT_TIMER_INTERVAL)
-    {
-        // need to wait at least a single interval to prevent reading a jitter
-        ets_delay_us(DHT_TIMER_INTERVAL);
-        if (gpio_get_level(pin) == expected_pin_state)
-        {
-            if (duration)
-                *duration = i;
-            return ESP_OK;
-        }
-    }
-
-    return ESP_ERR_TIMEOUT;
-}
-
 /**
  * Pack two data bytes into single value and take into account sign bit.
  */
@@ -247,34 +377,33 @@ static inline int16_t dht_convert_data(dht_sensor_type_t sensor_type, uint8_t ms
     return data;
 }
 
-/**
- * Updates internal values
- */
-static void dht_task(void *args) {
+esp_err_t dht_manager_read(dht_reading_t *reading) {
 
-   while (true) {
-       dht_manager_read_float_data(DHT_TYPE_AM2301, CONFIG_DHT_GPIO, &humidity, &temperature);
-       vTaskDelay(UPDATE_TASK_DELAY / portTICK_RATE_MS);
-   }
-}
+    int64_t acquired_at = esp_timer_get_time();
 
-void dht_manager_start_update_task() {
-    
-    if (dht_task_handle) {
-        dht_manager_stop_update_task();
+    dht_reading_t current;
+    esp_err_t err = dht_manager_read_float_data(DHT_TYPE_AM2301, CONFIG_DHT_GPIO, &current.humidity, &current.temperature);
+    if (err != ESP_OK) {
+        return err;
     }
 
-    ESP_LOGI(TAG, "Starting dht task....");
-    xTaskCreate(&dht_task, "dht_task", 1024, NULL, 3, &dht_task_handle);
-}
+    current.acquired_at = acquired_at;
+    *reading = current;
 
-void dht_manager_stop_update_task() {
+    portENTER_CRITICAL(&last_reading_mux);
+    last_reading = current;
+    has_last_reading = true;
+    portEXIT_CRITICAL(&last_reading_mux);
 
-    ESP_LOGI(TAG, "Stopping dht task....");
-    vTaskDelete(dht_task_handle);
+    return ESP_OK;
 }
 
-void dht_manager_get_last_red_values(float *t, float *h) {
-    *t = temperature;
-    *h = humidity;
-}
\ No newline at end of file
+bool dht_manager_get_last_reading(dht_reading_t *reading) {
+
+    portENTER_CRITICAL(&last_reading_mux);
+    bool is_available = has_last_reading;
+    *reading = last_reading;
+    portEXIT_CRITICAL(&last_reading_mux);
+
+    return is_available;
+}
@@ -0,0 +1,34 @@
+#ifndef DHT_MANAGER_INCLUDE_DHT_DECODER_H_
+#define DHT_MANAGER_INCLUDE_DHT_DECODER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DHT_DATA_BITS 40
+#define DHT_DATA_BYTES (DHT_DATA_BITS / 8)
+
+/**
+ * A level held by the DHT data line and its duration in microseconds
+ */
+typedef struct {
+    uint8_t level;
+    uint16_t duration;
+} dht_pulse_t;
+
+typedef enum {
+    DHT_DECODE_OK = 0,
+    DHT_DECODE_NO_RESPONSE,
+    DHT_DECODE_TRUNCATED,
+    DHT_DECODE_BAD_LEVEL,
+    DHT_DECODE_BAD_CHECKSUM
+} dht_decode_result_t;
+
+/**
+ * Decode a captured DHT frame.
+ * Pulses preceding the sensor response (phases C and D) are skipped, then
+ * 40 low/high pairs are read: a bit is 1 when its high pulse lasts longer than its low pulse.
+ * Depends on no hardware, the decoder can be fed with recorded pulse traces.
+ */
+dht_decode_result_t dht_decode_pulses(const dht_pulse_t *pulses, size_t count, uint8_t data[DHT_DATA_BYTES]);
+
+#endif
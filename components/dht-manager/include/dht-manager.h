@@ -18,6 +18,8 @@
 #ifndef __DHT_H__
 #define __DHT_H__
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <driver/gpio.h>
 #include <esp_err.h>
 
@@ -35,20 +37,24 @@ typedef enum {
 } dht_sensor_type_t;
 
 /**
- * Start dht low priority task to update internal values.
- * You can get those internal values with #dht_get_last_red_values method
+ * Values of one sensor frame, acquired_at is the read time in microseconds from boot
  */
-void dht_manager_start_update_task();
+typedef struct {
+    float temperature;
+    float humidity;
+    int64_t acquired_at;
+} dht_reading_t;
 
 /**
- * Stop dht internal task.
+ * Read the sensor on CONFIG_DHT_GPIO, the last reading is updated on success.
+ * Reads are blocking and timed by the caller, e.g. the acquisition scheduler.
  */
-void dht_manager_stop_update_task();
+esp_err_t dht_manager_read(dht_reading_t *reading);
 
 /**
- * Get last red available values
+ * Copy of the last successful reading, false if the sensor was never read
  */
-void dht_manager_get_last_red_values(float *temperature, float *humidity);
+bool dht_manager_get_last_reading(dht_reading_t *reading);
 
 #ifdef __cplusplus
 }
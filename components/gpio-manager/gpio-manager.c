@@ -1,86 +1,270 @@
+/*
+ *  Pads are handled by a state machine each, driven by debounced press and
+ *  release changes and by a gesture timer:
+ *
+ *  IDLE            press -> PRESSED
+ *  PRESSED         release -> CLICK, or WAIT_SECOND with double clicks enabled
+ *                  long click threshold -> LONG_CLICK, LONG_PRESSED
+ *  WAIT_SECOND     press -> SECOND_PRESSED
+ *                  double click window -> CLICK, IDLE
+ *  SECOND_PRESSED  release -> DOUBLE_CLICK, IDLE
+ *                  long click threshold -> CLICK, LONG_CLICK, LONG_PRESSED
+ *  LONG_PRESSED    release -> IDLE
+ *                  hold repeat interval -> HOLD_REPEAT, if enabled
+ *
+ *  Interrupts on both edges restart a debounce timer, the pad level is read
+ *  once it expires. Timers only flag the pad and wake the gpio event task up,
+ *  which runs all state machines, so pads never block each other.
+ */
+
 #include "gpio-manager.h"
 
+#include <stdbool.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/queue.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "spsc-ring.h"
 
 #define ESP_INTR_FLAG_DEFAULT 0
 
-#define DEBOUNCE_TIME 500
+// times in microseconds, the esp_timer unit
+#define DEBOUNCE_TIME 30000
+
+#define LONG_CLICK_THRESHOLD 3000000
+
+#define DOUBLE_CLICK_WINDOW 300000
+
+#define HOLD_REPEAT_INTERVAL 500000
+
+// power of two, see spsc_ring_init
+#define GPIO_EVENTS_LENGTH 32
 
-#define LONG_CLICK_THRESHOLD 3000
+typedef enum {
+    PAD_STATE_IDLE = 0,
+    PAD_STATE_PRESSED,
+    PAD_STATE_WAIT_SECOND,
+    PAD_STATE_SECOND_PRESSED,
+    PAD_STATE_LONG_PRESSED
+} pad_state_t;
 
 static const char *TAG = "gpio-manager";
 
 typedef struct {
-    uint64_t last_interrupt_timestamp;
     pad_conf_t *config;
+    pad_state_t state;
+    bool is_pressed;
+    uint8_t pressed_level;
+    esp_timer_handle_t debounce_timer;
+    esp_timer_handle_t gesture_timer;
+    // 0 when the timer is not armed, a stopped timer may still have fired
+    int64_t debounce_deadline;
+    int64_t gesture_deadline;
 } pad_data_t;
 
 static pad_data_t pads_data[GPIO_NUM_MAX];
 
-static xQueueHandle gpio_event_queue = NULL;
+// interrupts of all pads are served on the same core, one producer at a time
+static spsc_ring_t gpio_events_ring;
 
-static uint64_t get_milliseconds_from_boot() {
-    return esp_timer_get_time() / 1000;
-}
+static uint8_t gpio_events_storage[GPIO_EVENTS_LENGTH];
+
+static TaskHandle_t gpio_event_task_handle = NULL;
+
+// pads with an expired timer, set by the esp_timer task
+static uint64_t expired_pads = 0;
+
+static portMUX_TYPE expired_pads_mux = portMUX_INITIALIZER_UNLOCKED;
 
 static void IRAM_ATTR gpio_isr_handler(void* arg) {
-    uint32_t gpio_num = (uint32_t) arg;
-    xQueueSendFromISR(gpio_event_queue, &gpio_num, NULL);
+    uint8_t gpio_num = (uint32_t) arg;
+    spsc_ring_push_from_isr(&gpio_events_ring, &gpio_num);
+}
+
+static void gpio_timer_callback(void* arg) {
+
+    pad_data_t *pad_data = (pad_data_t *) arg;
+
+    portENTER_CRITICAL(&expired_pads_mux);
+    expired_pads |= 1ULL << pad_data->config->gpio_number;
+    portEXIT_CRITICAL(&expired_pads_mux);
+
+    xTaskNotifyGive(gpio_event_task_handle);
+}
+
+static void gpio_arm_timer(esp_timer_handle_t timer, int64_t *deadline, uint64_t timeout) {
+
+    esp_timer_stop(timer);
+    *deadline = esp_timer_get_time() + timeout;
+    esp_timer_start_once(timer, timeout);
+}
+
+static void gpio_disarm_timer(esp_timer_handle_t timer, int64_t *deadline) {
+
+    esp_timer_stop(timer);
+    *deadline = 0;
+}
+
+static void gpio_send_event(pad_data_t *pad_data, pad_event_t event) {
+
+    ESP_LOGI(TAG, "gpio %d event %d", pad_data->config->gpio_number, event);
+
+    if (pad_data->config->callback != NULL) {
+        pad_data->config->callback(pad_data->config->gpio_number, event);
+    }
+}
+
+static void gpio_enter_long_pressed(pad_data_t *pad_data) {
+
+    pad_data->state = PAD_STATE_LONG_PRESSED;
+    gpio_send_event(pad_data, GPIO_LONG_CLICK);
+
+    if (pad_data->config->gestures & GPIO_GESTURE_HOLD_REPEAT) {
+        gpio_arm_timer(pad_data->gesture_timer, &pad_data->gesture_deadline, HOLD_REPEAT_INTERVAL);
+    }
+}
+
+static void gpio_on_press(pad_data_t *pad_data) {
+
+    if (pad_data->state == PAD_STATE_IDLE) {
+        pad_data->state = PAD_STATE_PRESSED;
+    } else if (pad_data->state == PAD_STATE_WAIT_SECOND) {
+        pad_data->state = PAD_STATE_SECOND_PRESSED;
+    } else {
+        return;
+    }
+
+    gpio_arm_timer(pad_data->gesture_timer, &pad_data->gesture_deadline, LONG_CLICK_THRESHOLD);
+}
+
+static void gpio_on_release(pad_data_t *pad_data) {
+
+    if (pad_data->state == PAD_STATE_PRESSED && (pad_data->config->gestures & GPIO_GESTURE_DOUBLE_CLICK)) {
+        pad_data->state = PAD_STATE_WAIT_SECOND;
+        gpio_arm_timer(pad_data->gesture_timer, &pad_data->gesture_deadline, DOUBLE_CLICK_WINDOW);
+        return;
+    }
+
+    pad_state_t state = pad_data->state;
+    pad_data->state = PAD_STATE_IDLE;
+    gpio_disarm_timer(pad_data->gesture_timer, &pad_data->gesture_deadline);
+
+    if (state == PAD_STATE_PRESSED) {
+        gpio_send_event(pad_data, GPIO_CLICK);
+    } else if (state == PAD_STATE_SECOND_PRESSED) {
+        gpio_send_event(pad_data, GPIO_DOUBLE_CLICK);
+    }
+}
+
+static void gpio_on_gesture_timeout(pad_data_t *pad_data) {
+
+    switch (pad_data->state) {
+        case PAD_STATE_PRESSED:
+            gpio_enter_long_pressed(pad_data);
+            break;
+        case PAD_STATE_SECOND_PRESSED:
+            // the first press was a click on its own
+            gpio_send_event(pad_data, GPIO_CLICK);
+            gpio_enter_long_pressed(pad_data);
+            break;
+        case PAD_STATE_WAIT_SECOND:
+            pad_data->state = PAD_STATE_IDLE;
+            gpio_send_event(pad_data, GPIO_CLICK);
+            break;
+        case PAD_STATE_LONG_PRESSED:
+            gpio_arm_timer(pad_data->gesture_timer, &pad_data->gesture_deadline, HOLD_REPEAT_INTERVAL);
+            gpio_send_event(pad_data, GPIO_HOLD_REPEAT);
+            break;
+        default:
+            break;
+    }
+}
+
+static void gpio_on_timers(pad_data_t *pad_data) {
+
+    int64_t now = esp_timer_get_time();
+
+    if (pad_data->debounce_deadline != 0 && now >= pad_data->debounce_deadline) {
+        pad_data->debounce_deadline = 0;
+
+        // bounces ended, the level is stable
+        bool is_pressed = gpio_get_level(pad_data->config->gpio_number) == pad_data->pressed_level;
+        if (is_pressed != pad_data->is_pressed) {
+            pad_data->is_pressed = is_pressed;
+            if (is_pressed) {
+                gpio_on_press(pad_data);
+            } else {
+                gpio_on_release(pad_data);
+            }
+        }
+    }
+
+    if (pad_data->gesture_deadline != 0 && now >= pad_data->gesture_deadline) {
+        pad_data->gesture_deadline = 0;
+        gpio_on_gesture_timeout(pad_data);
+    }
 }
 
 static void gpio_event_task(void* arg) {
-    
+
     uint8_t io_num;
-    int64_t now = 0;
-    
+
     while (true) {
 
-        if (xQueueReceive(gpio_event_queue, &io_num, portMAX_DELAY)) {
-            
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while (spsc_ring_pop(&gpio_events_ring, &io_num)) {
             pad_data_t *pad_data = &pads_data[io_num];
-            now = get_milliseconds_from_boot();
-
-            uint64_t elapsed_time = now - pad_data->last_interrupt_timestamp;
-            if (elapsed_time > DEBOUNCE_TIME) {
-                ESP_LOGI(TAG, "gpio %d interrupt", io_num);
-                uint8_t registered_io_level = pad_data->config->interrput_mode == GPIO_INTERRUPT_FALLING ? 0 : 1;
-                while (gpio_get_level(io_num) == registered_io_level) {
-                    vTaskDelay(200 / portTICK_RATE_MS);
-                }
-        
-                if (pad_data->config->callback != NULL) {
-                    uint64_t press_time = get_milliseconds_from_boot() - now;
-                    if (press_time >= LONG_CLICK_THRESHOLD) {
-                        pad_data->config->callback(io_num, GPIO_LONG_CLICK);
-                    } else {
-                        pad_data->config->callback(io_num, GPIO_CLICK);
-                    }   
-                }
-        
-                pads_data->last_interrupt_timestamp = get_milliseconds_from_boot();
+            gpio_arm_timer(pad_data->debounce_timer, &pad_data->debounce_deadline, DEBOUNCE_TIME);
+        }
+
+        portENTER_CRITICAL(&expired_pads_mux);
+        uint64_t expired = expired_pads;
+        expired_pads = 0;
+        portEXIT_CRITICAL(&expired_pads_mux);
+
+        for (int i = 0; expired != 0; i++, expired >>= 1) {
+            if (expired & 1) {
+                gpio_on_timers(&pads_data[i]);
             }
         }
     }
 }
 
 uint32_t gpio_manager_init() {
-    
-    gpio_event_queue = xQueueCreate(5, sizeof(uint32_t));
 
-    esp_err_t err = gpio_event_queue == NULL ? ESP_FAIL : ESP_OK;
+    // bursts of edges past the ring depth are bounces, the level is read after the last one popped
+    bool is_ring_ready = spsc_ring_init(&gpio_events_ring, gpio_events_storage, sizeof(uint8_t), GPIO_EVENTS_LENGTH, SPSC_RING_DROP_NEWEST);
+
+    esp_err_t err = is_ring_ready ? ESP_OK : ESP_FAIL;
     err += gpio_install_isr_service(ESP_INTR_FLAG_DEFAULT);
 
     if (err == ESP_OK) {
-        xTaskCreate(gpio_event_task, "gpio event task", 2048, NULL, 5, NULL);
+        xTaskCreate(gpio_event_task, "gpio event task", 2048, NULL, 5, &gpio_event_task_handle);
+        spsc_ring_set_consumer(&gpio_events_ring, gpio_event_task_handle);
     }
 
     return err;
 }
 
+static esp_err_t gpio_create_pad_timers(pad_data_t *pad_data) {
+
+    esp_timer_create_args_t timer_args = {
+        .callback = &gpio_timer_callback,
+        .arg = pad_data,
+        .name = "gpio-debounce"
+    };
+
+    esp_err_t err = esp_timer_create(&timer_args, &pad_data->debounce_timer);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    timer_args.name = "gpio-gesture";
+    return esp_timer_create(&timer_args, &pad_data->gesture_timer);
+}
+
 uint32_t gpio_manager_configure_pad(pad_conf_t *conf) {
 
     gpio_pad_select_gpio(conf->gpio_number);
@@ -94,24 +278,34 @@ uint32_t gpio_manager_configure_pad(pad_conf_t *conf) {
     }
     ret += gpio_set_pull_mode(conf->gpio_number, pull_mode);
 
-    gpio_int_type_t interrupt_mode = GPIO_INTR_DISABLE;
-    if (conf->interrput_mode != GPIO_INTERRUPT_NONE) {
-        interrupt_mode = conf->interrput_mode  == GPIO_INTERRUPT_FALLING ? GPIO_INTR_NEGEDGE : GPIO_INTR_POSEDGE;
+    if (conf->interrput_mode == GPIO_INTERRUPT_NONE) {
+        ret += gpio_set_intr_type(conf->gpio_number, GPIO_INTR_DISABLE);
+        return ret;
     }
-    ret += gpio_set_intr_type(conf->gpio_number, interrupt_mode);
 
-    if (interrupt_mode != GPIO_INTR_DISABLE) {
-        uint32_t pad_number = conf->gpio_number;
-        ret += gpio_isr_handler_add(conf->gpio_number, gpio_isr_handler, (void*) pad_number);
+    pad_data_t *pad_data = &pads_data[conf->gpio_number];
+    if (pad_data->config == NULL && ret == ESP_OK) {
+        ret = gpio_create_pad_timers(pad_data);
     }
 
-    if (ret == ESP_OK) {
-        pad_data_t pad_data = {
-            .last_interrupt_timestamp = 0,
-            .config = conf
-        };
-        pads_data[conf->gpio_number] = pad_data;
+    if (ret != ESP_OK) {
+        return ret;
     }
 
+    gpio_disarm_timer(pad_data->debounce_timer, &pad_data->debounce_deadline);
+    gpio_disarm_timer(pad_data->gesture_timer, &pad_data->gesture_deadline);
+
+    pad_data->config = conf;
+    pad_data->state = PAD_STATE_IDLE;
+    pad_data->pressed_level = conf->interrput_mode == GPIO_INTERRUPT_FALLING ? 0 : 1;
+    // a pad held while configured is ignored until released
+    pad_data->is_pressed = gpio_get_level(conf->gpio_number) == pad_data->pressed_level;
+
+    // the press edge alone can't tell bounces from releases
+    ret += gpio_set_intr_type(conf->gpio_number, GPIO_INTR_ANYEDGE);
+
+    uint32_t pad_number = conf->gpio_number;
+    ret += gpio_isr_handler_add(conf->gpio_number, gpio_isr_handler, (void*) pad_number);
+
     return ret;
-}
\ No newline at end of file
+}
@@ -2,12 +2,16 @@
 #define GPIO_MANAGER_INCLUDE_GPIO_MANAGER_H_
 
 #include <stdio.h>
+#include <stdint.h>
 
 typedef enum {
     GPIO_INPUT,
     GPIO_OUTPUT
 } pad_direction_t;
 
+/**
+ * Edge of a press: both edges raise an interrupt, the mode sets which level is pressed
+ */
 typedef enum {
     GPIO_INTERRUPT_NONE,
     GPIO_INTERRUPT_FALLING,
@@ -22,9 +26,22 @@ typedef enum {
 
 typedef enum {
     GPIO_CLICK,
-    GPIO_LONG_CLICK
+    // sent while the pad is still held, once the long click threshold is reached
+    GPIO_LONG_CLICK,
+    GPIO_DOUBLE_CLICK,
+    // sent periodically while the pad is held after a long click
+    GPIO_HOLD_REPEAT
 } pad_event_t;
 
+/**
+ * Gestures detected besides click and long click. With double clicks enabled
+ * a click is sent only once the double click window expired.
+ */
+typedef enum {
+    GPIO_GESTURE_DOUBLE_CLICK = 1 << 0,
+    GPIO_GESTURE_HOLD_REPEAT = 1 << 1
+} pad_gesture_t;
+
 typedef void (*gpio_callback_f)(uint8_t, pad_event_t);
 
 typedef struct {
@@ -32,11 +49,17 @@ typedef struct {
     pad_direction_t direction;
     pad_pull_mode_t pull_mode;
     pad_interrupt_t interrput_mode;
+    // pad_gesture_t flags
+    uint8_t gestures;
     gpio_callback_f callback;
 } pad_conf_t;
 
 uint32_t gpio_manager_init();
 
+/**
+ * Configure a pad, conf must stay valid afterwards. Callbacks of all pads run
+ * on the gpio event task, they shouldn't block.
+ */
 uint32_t gpio_manager_configure_pad(pad_conf_t *conf);
 
-#endif
\ No newline at end of file
+#endif
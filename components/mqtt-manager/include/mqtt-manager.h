@@ -2,16 +2,32 @@
 #define MQTT_MANAGER_INCLUDE_MQTT_MANAGER_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
+/**
+ * Zero terminated PEM data, referenced by the client and never released
+ */
 typedef struct {
-    char *ca_cert;
-    char *device_cert;
-    char *device_key;
+    const char *ca_cert;
+    const char *device_cert;
+    const char *device_key;
 } mqtt_certificates_t;
 
 typedef void(*load_certs_f)(mqtt_certificates_t*);
 
+/**
+ * Outcome of a QoS 1 publish, called from the MQTT task once the broker
+ * acknowledged the message, or with is_delivered false when it expired
+ */
+typedef void(*mqtt_delivery_callback_f)(void *context, bool is_delivered);
+
+/**
+ * Message received on a subscribed topic, called from the MQTT task.
+ * Topic and data are not zero terminated.
+ */
+typedef void(*mqtt_message_callback_f)(const char *topic, int topic_len, const char *data, int data_len);
+
 uint32_t mqtt_manager_init(load_certs_f f);
 
 uint32_t mqtt_manager_connect();
@@ -20,6 +36,31 @@ bool mqtt_manager_is_connected();
 
 bool mqtt_manager_publish(const char *topic, const char *data);
 
+/**
+ * Publish a binary payload, a zero data_len publishes data as a zero terminated string
+ */
+bool mqtt_manager_publish_data(const char *topic, const void *data, int data_len);
+
+/**
+ * Publish a QoS 1 message without waiting for the acknowledgement, up to
+ * CONFIG_MQTT_INFLIGHT_WINDOW messages can be in flight. Return false, and
+ * callback is not invoked, when not connected or when the window is full.
+ */
+bool mqtt_manager_publish_qos1(const char *topic, const void *data, int data_len,
+        mqtt_delivery_callback_f callback, void *context);
+
+/**
+ * Free slots of the in-flight window, expired messages are reported first
+ */
+int mqtt_manager_get_inflight_slots();
+
+/**
+ * Subscribe with QoS 1, messages are delivered to the message callback
+ */
+bool mqtt_manager_subscribe(const char *topic);
+
+void mqtt_manager_set_message_callback(mqtt_message_callback_f callback);
+
 uint32_t mqtt_manager_disconnect();
 
 #endif
\ No newline at end of file
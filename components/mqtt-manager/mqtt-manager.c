@@ -3,6 +3,23 @@
 
 #include "mqtt_client.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+// longer than the 30 s outbox expiration of esp-mqtt, which has no API to delete a
+// message from the outbox: a slot is released only once its message can't be resent
+#define INFLIGHT_MESSAGE_TIMEOUT 35000
+
+// acknowledgements received before the publishing task registered the message id
+#define EARLY_ACKS_COUNT 4
+
+typedef struct {
+    int msg_id;
+    int64_t deadline;
+    mqtt_delivery_callback_f callback;
+    void *context;
+} inflight_message_t;
 
 static const char *TAG = "mqtt-manager";
 
@@ -20,23 +37,21 @@ static bool is_connected = false;
 
 static bool is_started = false;
 
-static void mqtt_manager_send_event(int32_t event_id);
+static int64_t connection_start_time = 0;
 
-ESP_EVENT_DEFINE_BASE(MQTT_MANAGER_EVENTS);
+static mqtt_message_callback_f message_callback = NULL;
 
-static void mqtt_manager_free_certificate_buffers() {
-    
-    ESP_LOGI(TAG, "clear certificates buffers");
+static SemaphoreHandle_t inflight_mutex = NULL;
 
-    free(mqtt_certs.ca_cert);
-    mqtt_certs.ca_cert = NULL;
-    
-    free(mqtt_certs.device_cert);
-    mqtt_certs.device_cert = NULL;
-    
-    free(mqtt_certs.device_key);
-    mqtt_certs.device_key = NULL;
-}
+static inflight_message_t inflight_messages[CONFIG_MQTT_INFLIGHT_WINDOW];
+
+static int early_acks[EARLY_ACKS_COUNT];
+
+static uint8_t early_acks_index = 0;
+
+static void mqtt_manager_send_event(int32_t event_id);
+
+ESP_EVENT_DEFINE_BASE(MQTT_MANAGER_EVENTS);
 
 static void mqtt_manager_load_certificates() {
     load_certificates_function(&mqtt_certs);
@@ -47,10 +62,18 @@ static bool mqtt_manager_has_certificates_loaded() {
     return mqtt_certs.ca_cert != NULL && mqtt_certs.device_cert != NULL && mqtt_certs.device_key != NULL;
 }
 
+/**
+ * Certificates are mapped from flash once, the client keeps pointers to
+ * them and uses them again on every automatic reconnect.
+ */
 static bool mqtt_manager_configure_client() {
+
+    if (client != NULL) {
+        return true;
+    }
     
     if (!mqtt_manager_has_certificates_loaded()) {
-        ESP_LOGI(TAG, "load certificates from memory");
+        ESP_LOGI(TAG, "map certificates from flash");
         mqtt_manager_load_certificates();
     }
 
@@ -58,15 +81,76 @@ static bool mqtt_manager_configure_client() {
         .uri = CONFIG_BROKER_URL,
         .cert_pem = mqtt_certs.ca_cert,
         .client_cert_pem = mqtt_certs.device_cert,
-        .client_key_pem = mqtt_certs.device_key
+        .client_key_pem = mqtt_certs.device_key,
+#ifdef CONFIG_MQTT_PERSISTENT_SESSION
+        .disable_clean_session = true
+#endif
     };
 
-    if (client == NULL) {
-        client = esp_mqtt_client_init(&mqtt_cfg);
-        return client != NULL;
-    } 
+    client = esp_mqtt_client_init(&mqtt_cfg);
 
-    return esp_mqtt_set_config(client, &mqtt_cfg) == ESP_OK;
+    return client != NULL;
+}
+
+static int64_t get_milliseconds_from_boot() {
+    return esp_timer_get_time() / 1000;
+}
+
+/**
+ * Release the slot holding msg_id and return its callback, false if not in flight
+ */
+static bool mqtt_manager_release_inflight(int msg_id, inflight_message_t *released) {
+
+    bool is_found = false;
+
+    xSemaphoreTake(inflight_mutex, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_MQTT_INFLIGHT_WINDOW && !is_found; i++) {
+        if (inflight_messages[i].callback != NULL && inflight_messages[i].msg_id == msg_id) {
+            *released = inflight_messages[i];
+            inflight_messages[i].callback = NULL;
+            is_found = true;
+        }
+    }
+
+    if (!is_found) {
+        early_acks[early_acks_index] = msg_id;
+        early_acks_index = (early_acks_index + 1) % EARLY_ACKS_COUNT;
+    }
+    xSemaphoreGive(inflight_mutex);
+
+    return is_found;
+}
+
+static void mqtt_manager_on_published(int msg_id) {
+
+    inflight_message_t message = { 0 };
+    if (mqtt_manager_release_inflight(msg_id, &message)) {
+        message.callback(message.context, true);
+    }
+}
+
+/**
+ * Report messages not acknowledged in time as lost, callbacks run outside the lock
+ */
+static void mqtt_manager_expire_inflight() {
+
+    inflight_message_t expired[CONFIG_MQTT_INFLIGHT_WINDOW];
+    int expired_count = 0;
+    int64_t now = get_milliseconds_from_boot();
+
+    xSemaphoreTake(inflight_mutex, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_MQTT_INFLIGHT_WINDOW; i++) {
+        if (inflight_messages[i].callback != NULL && inflight_messages[i].deadline <= now) {
+            expired[expired_count++] = inflight_messages[i];
+            inflight_messages[i].callback = NULL;
+        }
+    }
+    xSemaphoreGive(inflight_mutex);
+
+    for (int i = 0; i < expired_count; i++) {
+        ESP_LOGW(TAG, "message %d not acknowledged", expired[i].msg_id);
+        expired[i].callback(expired[i].context, false);
+    }
 }
 
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data) {
@@ -76,11 +160,15 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
     
     switch (event->event_id) {
         case MQTT_EVENT_CONNECTED:
-            ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED");
+            ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED, tcp+tls+connack in %lld ms, session present %d",
+                (esp_timer_get_time() - connection_start_time) / 1000, event->session_present);
             is_connected = true;
-            mqtt_manager_free_certificate_buffers();
             mqtt_manager_send_event(MQTT_MANAGER_EVENT_CONNECTED);
             break;
+        case MQTT_EVENT_BEFORE_CONNECT:
+            // also raised by automatic reconnects
+            connection_start_time = esp_timer_get_time();
+            break;
         case MQTT_EVENT_DISCONNECTED:
             ESP_LOGI(TAG, "MQTT_EVENT_DISCONNECTED");
             is_connected = false;
@@ -93,12 +181,17 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
             ESP_LOGI(TAG, "MQTT_EVENT_UNSUBSCRIBED, msg_id=%d", event->msg_id);
             break;
         case MQTT_EVENT_PUBLISHED:
-            ESP_LOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+            ESP_LOGD(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+            mqtt_manager_on_published(event->msg_id);
             break;
         case MQTT_EVENT_DATA:
-            ESP_LOGI(TAG, "MQTT_EVENT_DATA");
-            printf("TOPIC=%.*s\r\n", event->topic_len, event->topic);
-            printf("DATA=%.*s\r\n", event->data_len, event->data);
+            ESP_LOGI(TAG, "MQTT_EVENT_DATA, topic=%.*s", event->topic_len, event->topic);
+            // messages larger than the client buffer come in chunks, they are not expected here
+            if (event->data_len != event->total_data_len) {
+                ESP_LOGW(TAG, "fragmented message of %d bytes ignored", event->total_data_len);
+            } else if (message_callback != NULL) {
+                message_callback(event->topic, event->topic_len, event->data, event->data_len);
+            }
             break;
         case MQTT_EVENT_ERROR:
             ESP_LOGI(TAG, "MQTT_EVENT_ERROR");
@@ -112,6 +205,8 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
 uint32_t mqtt_manager_init(load_certs_f f) {
 
     load_certificates_function = f;
+
+    inflight_mutex = xSemaphoreCreateMutex();
     
     mqtt_manager_configure_client();
 
@@ -120,7 +215,9 @@ uint32_t mqtt_manager_init(load_certs_f f) {
 
 uint32_t mqtt_manager_connect() {
 
-    mqtt_manager_configure_client();
+    if (!mqtt_manager_configure_client()) {
+        return ESP_FAIL;
+    }
 
     esp_err_t status = is_started ? esp_mqtt_client_reconnect(client) : esp_mqtt_client_start(client);
     is_started = true;
@@ -134,13 +231,119 @@ bool mqtt_manager_is_connected() {
 
 bool mqtt_manager_publish(const char *topic, const char *data) {
 
+    return mqtt_manager_publish_data(topic, data, 0);
+}
+
+bool mqtt_manager_publish_data(const char *topic, const void *data, int data_len) {
+
     if (!is_connected)
         return false;
 
-    int data_len = 0;
     int qos = 0;
     int retain = 0;
-    return esp_mqtt_client_publish(client, topic, data, data_len, qos, retain) > 0;
+    // message id is 0 for QoS 0 messages, -1 on failure
+    return esp_mqtt_client_publish(client, topic, data, data_len, qos, retain) >= 0;
+}
+
+static int mqtt_manager_reserve_inflight(mqtt_delivery_callback_f callback, void *context) {
+
+    int slot = -1;
+
+    xSemaphoreTake(inflight_mutex, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_MQTT_INFLIGHT_WINDOW && slot < 0; i++) {
+        if (inflight_messages[i].callback == NULL) {
+            inflight_messages[i] = (inflight_message_t) {
+                .msg_id = -1,
+                .deadline = get_milliseconds_from_boot() + INFLIGHT_MESSAGE_TIMEOUT,
+                .callback = callback,
+                .context = context
+            };
+            slot = i;
+        }
+    }
+    xSemaphoreGive(inflight_mutex);
+
+    return slot;
+}
+
+bool mqtt_manager_publish_qos1(const char *topic, const void *data, int data_len,
+        mqtt_delivery_callback_f callback, void *context) {
+
+    if (!is_connected || inflight_mutex == NULL) {
+        return false;
+    }
+
+    mqtt_manager_expire_inflight();
+
+    // the slot is reserved first, the acknowledgement may come before enqueue returns
+    int slot = mqtt_manager_reserve_inflight(callback, context);
+    if (slot < 0) {
+        return false;
+    }
+
+    // the message is stored in the outbox and sent again on reconnect until acknowledged
+    int msg_id = esp_mqtt_client_enqueue(client, topic, data, data_len, 1, 0, true);
+
+    bool is_acknowledged = false;
+
+    xSemaphoreTake(inflight_mutex, portMAX_DELAY);
+    if (msg_id < 0) {
+        inflight_messages[slot].callback = NULL;
+    } else {
+        for (int i = 0; i < EARLY_ACKS_COUNT && !is_acknowledged; i++) {
+            if (early_acks[i] == msg_id) {
+                early_acks[i] = 0;
+                is_acknowledged = true;
+            }
+        }
+
+        if (is_acknowledged) {
+            inflight_messages[slot].callback = NULL;
+        } else {
+            inflight_messages[slot].msg_id = msg_id;
+        }
+    }
+    xSemaphoreGive(inflight_mutex);
+
+    if (is_acknowledged) {
+        callback(context, true);
+    }
+
+    return msg_id >= 0;
+}
+
+int mqtt_manager_get_inflight_slots() {
+
+    if (inflight_mutex == NULL) {
+        return 0;
+    }
+
+    mqtt_manager_expire_inflight();
+
+    int free_slots = 0;
+
+    xSemaphoreTake(inflight_mutex, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_MQTT_INFLIGHT_WINDOW; i++) {
+        if (inflight_messages[i].callback == NULL) {
+            free_slots++;
+        }
+    }
+    xSemaphoreGive(inflight_mutex);
+
+    return free_slots;
+}
+
+bool mqtt_manager_subscribe(const char *topic) {
+
+    if (!is_connected) {
+        return false;
+    }
+
+    return esp_mqtt_client_subscribe(client, topic, 1) >= 0;
+}
+
+void mqtt_manager_set_message_callback(mqtt_message_callback_f callback) {
+    message_callback = callback;
 }
 
 uint32_t mqtt_manager_disconnect() {
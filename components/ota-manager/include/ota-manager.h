@@ -1,8 +1,34 @@
 #ifndef OTA_MANAGER_INCLUDE_OTA_MANAGER_H_
 #define OTA_MANAGER_INCLUDE_OTA_MANAGER_H_
 
+#include <stdbool.h>
+#include <stdint.h>
+
 int ota_manager_init();
 
-char* ota_manager_get_fw_version();
+/**
+ * Check for an update on the OTA task now, for devices not awake long enough
+ * for the periodic check. A downloaded update restarts the device, return
+ * false when the check didn't end within timeout_ms.
+ */
+bool ota_manager_check_now(uint32_t timeout_ms);
+
+const char* ota_manager_get_fw_version();
+
+/**
+ * True when the running image was just installed and waits to be confirmed,
+ * the bootloader rolls it back on the next reset otherwise
+ */
+bool ota_manager_is_pending_verify();
+
+/**
+ * Mark the running image valid, cancelling the rollback
+ */
+bool ota_manager_confirm_image();
+
+/**
+ * Mark the running image invalid and reboot into the previous one
+ */
+void ota_manager_rollback_image();
 
-#endif
\ No newline at end of file
+#endif
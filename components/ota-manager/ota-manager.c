@@ -1,24 +1,121 @@
 #include "ota-manager.h"
 
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
 #include "esp_ota_ops.h"
-#include "esp_https_ota.h"
+#include "esp_http_client.h"
+#include "esp_system.h"
+#include "esp_attr.h"
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "esp_rom_crc.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
+#include "cJSON.h"
+#include "delta-patch.h"
+#include "storage-manager.h"
 
-#define OTA_TIMER_PERIOD 60000000 // once an hour  3600000000
+#define OTA_CHECK_INTERVAL ((int64_t) CONFIG_FW_CHECK_INTERVAL * 1000000)
+
+// checks are spread over +-25% of the interval across the fleet
+#define OTA_CHECK_JITTER_PERCENT 25
+
+// an interrupted download is resumed sooner than the next check
+#define OTA_RESUME_DELAY 60000000
+
+#define OTA_BUFFER_SIZE 1024
+
+// full images are requested in ranges of this size, a multiple of the flash sector
+#define OTA_CHUNK_SIZE (64 * 1024)
+
+#define OTA_SECTOR_SIZE 4096
+
+#define OTA_HASH_HEX_LENGTH (DELTA_PATCH_HASH_SIZE * 2 + 1)
+
+#define OTA_ETAG_LENGTH 64
+
+#define OTA_VERSION_LENGTH 32
+
+#define OTA_URL_LENGTH 256
+
+#define OTA_CONTENT_RANGE_LENGTH 64
 
 static const char *TAG = "ota-manager";
 
 static EventGroupHandle_t ota_event_group;
 const int OTA_CHECK_BIT = BIT0;
+const int OTA_CHECK_DONE_BIT = BIT1;
+
+typedef struct {
+    const esp_partition_t *running_partition;
+    esp_ota_handle_t handle;
+} ota_update_t;
+
+/**
+ * Latest release as described by the manifest, the image hash is optional
+ */
+typedef struct {
+    char version[OTA_VERSION_LENGTH];
+    char url[OTA_URL_LENGTH];
+    bool has_image_hash;
+    uint8_t image_hash[DELTA_PATCH_HASH_SIZE];
+} ota_manifest_t;
+
+/**
+ * Download of a full image, persisted after every chunk. The CRC32 covers
+ * the bytes written so far and is checked against the flash before resuming.
+ */
+typedef struct {
+    char url[OTA_URL_LENGTH];
+    char version[OTA_VERSION_LENGTH];
+    char etag[OTA_ETAG_LENGTH];
+    uint32_t partition_address;
+    uint32_t image_size;
+    uint32_t written;
+    uint32_t crc;
+} ota_progress_t;
+
+static char *PROGRESS_KEY = "ota_progress";
+
+static esp_timer_handle_t check_timer;
+
+// owned by the OTA task, static to keep its stack small
+static uint8_t ota_buffer[OTA_BUFFER_SIZE];
+
+static uint8_t running_image_hash[DELTA_PATCH_HASH_SIZE];
+
+static char running_image_hash_hex[OTA_HASH_HEX_LENGTH] = {'\0'};
+
+// ETag of the last manifest handled, sent back with If-None-Match, kept through deep sleep
+static RTC_DATA_ATTR char manifest_etag[OTA_ETAG_LENGTH] = {'\0'};
+
+static char received_etag[OTA_ETAG_LENGTH];
+
+static char received_content_range[OTA_CONTENT_RANGE_LENGTH];
+
+static ota_progress_t progress;
+
+#ifdef CONFIG_FW_DELTA_UPDATES
+static delta_patch_t delta_patch;
+#endif
 
 static void ota_manager_timer_callback(void* arg) {
     xEventGroupSetBits(ota_event_group, OTA_CHECK_BIT);
 }
 
+/**
+ * Delay of the next check with a random jitter, devices restarted together drift apart
+ */
+static uint64_t ota_manager_get_check_delay() {
+
+    uint32_t jitter_range = 2 * OTA_CHECK_JITTER_PERCENT + 1;
+    uint32_t percent = 100 - OTA_CHECK_JITTER_PERCENT + esp_random() % jitter_range;
+
+    return OTA_CHECK_INTERVAL * percent / 100;
+}
+
 static esp_err_t ota_manager_http_event_handler(esp_http_client_event_t *evt) {
     
     switch (evt->event_id) {
@@ -33,6 +130,11 @@ static esp_err_t ota_manager_http_event_handler(esp_http_client_event_t *evt) {
             break;
         case HTTP_EVENT_ON_HEADER:
             ESP_LOGI(TAG, "HTTP_EVENT_ON_HEADER, key=%s, value=%s", evt->header_key, evt->header_value);
+            if (strcasecmp(evt->header_key, "ETag") == 0) {
+                strlcpy(received_etag, evt->header_value, OTA_ETAG_LENGTH);
+            } else if (strcasecmp(evt->header_key, "Content-Range") == 0) {
+                strlcpy(received_content_range, evt->header_value, OTA_CONTENT_RANGE_LENGTH);
+            }
             break;
         case HTTP_EVENT_ON_DATA:
             ESP_LOGI(TAG, "HTTP_EVENT_ON_DATA, len=%d", evt->data_len);
@@ -47,27 +149,559 @@ static esp_err_t ota_manager_http_event_handler(esp_http_client_event_t *evt) {
     return ESP_OK;
 }
 
-static void ota_task(void *args) {
+/**
+ * The running image is identified by its appended SHA-256, computed once
+ */
+static void ota_manager_load_running_image_hash(const esp_partition_t *running_partition) {
+
+    if (running_image_hash_hex[0] != '\0') {
+        return;
+    }
+
+    if (esp_partition_get_sha256(running_partition, running_image_hash) != ESP_OK) {
+        ESP_LOGE(TAG, "unable to hash the running image");
+        return;
+    }
+
+    for (int i = 0; i < DELTA_PATCH_HASH_SIZE; i++) {
+        sprintf(running_image_hash_hex + i * 2, "%02x", running_image_hash[i]);
+    }
+}
+
+/**
+ * Read until length bytes are received or the response ends, -1 on error
+ */
+static int ota_manager_read(esp_http_client_handle_t client, uint8_t *data, int length) {
+
+    int received = 0;
+
+    while (received < length) {
+        int count = esp_http_client_read(client, (char *) data + received, length - received);
+        if (count < 0) {
+            return -1;
+        }
+        if (count == 0) {
+            break;
+        }
+        received += count;
+    }
+
+    return received;
+}
+
+static esp_err_t ota_manager_write_target(void *context, const void *data, size_t length) {
+
+    ota_update_t *update = context;
+    return esp_ota_write(update->handle, data, length);
+}
+
+/**
+ * Stream a full image, first_length bytes of it are already in the buffer
+ */
+static esp_err_t ota_manager_apply_image(esp_http_client_handle_t client, ota_update_t *update, int first_length) {
+
+    esp_err_t err = ota_manager_write_target(update, ota_buffer, first_length);
+
+    int length = first_length;
+    while (err == ESP_OK && length > 0) {
+        length = ota_manager_read(client, ota_buffer, OTA_BUFFER_SIZE);
+        err = length < 0 ? ESP_FAIL : ota_manager_write_target(update, ota_buffer, length);
+    }
+
+    if (err == ESP_OK && !esp_http_client_is_complete_data_received(client)) {
+        ESP_LOGE(TAG, "image download interrupted");
+        err = ESP_ERR_INVALID_SIZE;
+    }
+
+    return err;
+}
+
+#ifdef CONFIG_FW_DELTA_UPDATES
+
+static esp_err_t ota_manager_read_source(void *context, uint32_t offset, void *data, size_t length) {
+
+    ota_update_t *update = context;
+    return esp_partition_read(update->running_partition, offset, data, length);
+}
+
+/**
+ * Rebuild the target image from the running one while the patch is downloaded,
+ * the patch body is decoded as it comes through the fixed size decoder window
+ */
+static esp_err_t ota_manager_apply_delta(esp_http_client_handle_t client, ota_update_t *update,
+        const delta_patch_header_t *header, int first_length) {
+
+    if (header->source_size > update->running_partition->size ||
+        memcmp(header->source_hash, running_image_hash, DELTA_PATCH_HASH_SIZE) != 0) {
+        ESP_LOGE(TAG, "delta patch does not apply to the running image");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    int64_t start_time = esp_timer_get_time();
+    uint32_t patch_length = first_length;
+
+    delta_patch_init(&delta_patch, header, ota_manager_read_source, ota_manager_write_target, update);
+    esp_err_t err = delta_patch_feed(&delta_patch, ota_buffer + DELTA_PATCH_HEADER_SIZE, first_length - DELTA_PATCH_HEADER_SIZE);
+
+    int length = first_length;
+    while (err == ESP_OK && length > 0) {
+        length = ota_manager_read(client, ota_buffer, OTA_BUFFER_SIZE);
+        err = length < 0 ? ESP_FAIL : delta_patch_feed(&delta_patch, ota_buffer, length);
+        patch_length += length > 0 ? length : 0;
+    }
+
+    if (err == ESP_OK) {
+        err = delta_patch_finish(&delta_patch);
+    }
+
+    if (err == ESP_OK) {
+        int64_t elapsed_ms = (esp_timer_get_time() - start_time) / 1000;
+        ESP_LOGI(TAG, "delta of %u bytes applied to a %u bytes image in %lld ms, %u bytes of decoder memory",
+            patch_length, header->target_size, elapsed_ms, sizeof(delta_patch) + OTA_BUFFER_SIZE);
+    } else {
+        ESP_LOGE(TAG, "delta patch failed: %s", esp_err_to_name(err));
+    }
+
+    return err;
+}
+
+#endif
+
+/**
+ * Write a whole response into the update partition through the OTA API, as a
+ * delta patch when the server has one for the running image or as a full
+ * image when it doesn't serve ranges. Not resumable.
+ */
+static esp_err_t ota_manager_stream_update(esp_http_client_handle_t client, const esp_partition_t *update_partition) {
+
+    ota_update_t update = {
+        .running_partition = esp_ota_get_running_partition()
+    };
+
+    int first_length = ota_manager_read(client, ota_buffer, OTA_BUFFER_SIZE);
+    if (first_length <= 0) {
+        return ESP_FAIL;
+    }
+
+    size_t image_size = OTA_SIZE_UNKNOWN;
+
+#ifdef CONFIG_FW_DELTA_UPDATES
+    delta_patch_header_t header;
+    bool is_delta = delta_patch_parse_header(ota_buffer, first_length, &header);
+    if (is_delta) {
+        // only the sectors of the target are erased
+        image_size = header.target_size;
+    }
+#endif
+
+    esp_err_t err = esp_ota_begin(update_partition, image_size, &update.handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+#ifdef CONFIG_FW_DELTA_UPDATES
+    err = is_delta ? ota_manager_apply_delta(client, &update, &header, first_length) :
+        ota_manager_apply_image(client, &update, first_length);
+#else
+    err = ota_manager_apply_image(client, &update, first_length);
+#endif
+
+    if (err != ESP_OK) {
+        esp_ota_abort(update.handle);
+        return err;
+    }
+
+    // the image is verified before it is accepted
+    return esp_ota_end(update.handle);
+}
+
+static void ota_manager_save_progress() {
+
+    if (!storage_manager_set_prefs_blob_value(PROGRESS_KEY, &progress, sizeof(progress))) {
+        ESP_LOGW(TAG, "unable to persist download progress");
+    }
+}
+
+static uint32_t ota_manager_get_written_crc(const esp_partition_t *partition, uint32_t length) {
+
+    uint32_t crc = 0;
+
+    for (uint32_t offset = 0; offset < length; offset += OTA_BUFFER_SIZE) {
+        uint32_t block_length = length - offset < OTA_BUFFER_SIZE ? length - offset : OTA_BUFFER_SIZE;
+        if (esp_partition_read(partition, offset, ota_buffer, block_length) != ESP_OK) {
+            return ~progress.crc;
+        }
+        crc = esp_rom_crc32_le(crc, ota_buffer, block_length);
+    }
+
+    return crc;
+}
+
+/**
+ * Resume the download of the release if an earlier attempt left intact data in the partition
+ */
+static void ota_manager_restore_progress(const ota_manifest_t *manifest, const esp_partition_t *partition) {
+
+    bool is_resumable = storage_manager_get_prefs_blob_value(PROGRESS_KEY, &progress, sizeof(progress)) &&
+        strcmp(progress.url, manifest->url) == 0 && strcmp(progress.version, manifest->version) == 0 &&
+        progress.partition_address == partition->address &&
+        progress.written > 0 && progress.written < progress.image_size;
+
+    if (is_resumable && ota_manager_get_written_crc(partition, progress.written) != progress.crc) {
+        ESP_LOGW(TAG, "partial image does not match its CRC, download starts over");
+        is_resumable = false;
+    }
+
+    if (is_resumable) {
+        ESP_LOGI(TAG, "resuming download at %u of %u bytes", progress.written, progress.image_size);
+        return;
+    }
+
+    memset(&progress, 0, sizeof(progress));
+    strlcpy(progress.url, manifest->url, OTA_URL_LENGTH);
+    strlcpy(progress.version, manifest->version, OTA_VERSION_LENGTH);
+    progress.partition_address = partition->address;
+}
+
+static void ota_manager_clear_progress() {
+
+    progress.written = 0;
+    progress.image_size = 0;
+    ota_manager_save_progress();
+}
+
+static esp_err_t ota_manager_request_range(esp_http_client_handle_t client, int *status_code) {
+
+    char range[OTA_CONTENT_RANGE_LENGTH];
+    snprintf(range, sizeof(range), "bytes=%u-%u", progress.written, progress.written + OTA_CHUNK_SIZE - 1);
+    esp_http_client_set_header(client, "Range", range);
+
+    // a changed image is sent whole with 200 instead of the range
+    if (progress.written > 0 && progress.etag[0] != '\0') {
+        esp_http_client_set_header(client, "If-Range", progress.etag);
+    }
+
+    received_etag[0] = '\0';
+    received_content_range[0] = '\0';
+
+    esp_err_t err = esp_http_client_open(client, 0);
+    if (err == ESP_OK) {
+        esp_http_client_fetch_headers(client);
+        *status_code = esp_http_client_get_status_code(client);
+    }
+
+    return err;
+}
+
+/**
+ * Write a 206 response at the current offset, progress is saved once the chunk is complete
+ */
+static esp_err_t ota_manager_write_chunk(esp_http_client_handle_t client, const esp_partition_t *partition) {
+
+    uint32_t start, end, image_size;
+    if (sscanf(received_content_range, "bytes %u-%u/%u", &start, &end, &image_size) != 3 ||
+        start != progress.written || end < start || end >= image_size || image_size > partition->size ||
+        (progress.image_size > 0 && image_size != progress.image_size) ||
+        ((end + 1) % OTA_SECTOR_SIZE != 0 && end + 1 != image_size)) {
+        ESP_LOGE(TAG, "unexpected content range: %s", received_content_range);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    if (progress.written == 0) {
+        progress.image_size = image_size;
+        strlcpy(progress.etag, received_etag, OTA_ETAG_LENGTH);
+    }
+
+    // chunks start on a sector boundary, a partially written chunk is erased again on resume
+    uint32_t erase_end = (end + OTA_SECTOR_SIZE) / OTA_SECTOR_SIZE * OTA_SECTOR_SIZE;
+    esp_err_t err = esp_partition_erase_range(partition, start, erase_end - start);
+
+    uint32_t offset = start;
+    uint32_t crc = progress.crc;
+
+    while (err == ESP_OK && offset <= end) {
+        int length = ota_manager_read(client, ota_buffer, OTA_BUFFER_SIZE);
+        if (length <= 0 || offset + length > end + 1) {
+            err = ESP_ERR_INVALID_SIZE;
+            break;
+        }
+        err = esp_partition_write(partition, offset, ota_buffer, length);
+        crc = esp_rom_crc32_le(crc, ota_buffer, length);
+        offset += length;
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "chunk at %u interrupted: %s", start, esp_err_to_name(err));
+        return err;
+    }
+
+    progress.written = offset;
+    progress.crc = crc;
+    ota_manager_save_progress();
+
+    ESP_LOGI(TAG, "downloaded %u of %u bytes", progress.written, progress.image_size);
+
+    return ESP_OK;
+}
+
+/**
+ * Check the downloaded image before it's selected for the next boot
+ */
+static esp_err_t ota_manager_activate(const esp_partition_t *partition, const ota_manifest_t *manifest) {
+
+    // the appended SHA-256 is checked against the image content on the way
+    uint8_t image_hash[DELTA_PATCH_HASH_SIZE];
+    esp_err_t err = esp_partition_get_sha256(partition, image_hash);
+
+    if (err == ESP_OK && manifest->has_image_hash && memcmp(image_hash, manifest->image_hash, DELTA_PATCH_HASH_SIZE) != 0) {
+        ESP_LOGE(TAG, "downloaded image is not the one of the manifest");
+        err = ESP_ERR_INVALID_CRC;
+    }
+
+    if (err == ESP_OK) {
+        err = esp_ota_set_boot_partition(partition);
+    }
+
+    return err;
+}
+
+static bool ota_manager_parse_hash(const char *hex, uint8_t *hash) {
+
+    if (strlen(hex) != DELTA_PATCH_HASH_SIZE * 2) {
+        return false;
+    }
+
+    for (int i = 0; i < DELTA_PATCH_HASH_SIZE; i++) {
+        unsigned int byte;
+        if (sscanf(hex + i * 2, "%2x", &byte) != 1) {
+            return false;
+        }
+        hash[i] = byte;
+    }
+
+    return true;
+}
+
+static bool ota_manager_parse_manifest(const char *json, ota_manifest_t *manifest) {
+
+    cJSON *root = cJSON_Parse(json);
+
+    const cJSON *version = cJSON_GetObjectItemCaseSensitive(root, "version");
+    const cJSON *url = cJSON_GetObjectItemCaseSensitive(root, "url");
+    const cJSON *image_hash = cJSON_GetObjectItemCaseSensitive(root, "sha256");
+
+    bool is_valid = cJSON_IsString(version);
+    if (is_valid) {
+        strlcpy(manifest->version, version->valuestring, OTA_VERSION_LENGTH);
+        // the update URL is the configured one unless the manifest points elsewhere
+        strlcpy(manifest->url, cJSON_IsString(url) ? url->valuestring : CONFIG_FW_UPDATE_URL, OTA_URL_LENGTH);
+        manifest->has_image_hash = cJSON_IsString(image_hash) &&
+            ota_manager_parse_hash(image_hash->valuestring, manifest->image_hash);
+    }
+
+    cJSON_Delete(root);
+    return is_valid;
+}
+
+/**
+ * Fetch the release manifest, a conditional request answered with 304 while
+ * it's unchanged. is_modified is false when there is nothing new to look at.
+ */
+static esp_err_t ota_manager_fetch_manifest(ota_manifest_t *manifest, bool *is_modified) {
 
     esp_http_client_config_t config = {
-        .url = CONFIG_FW_UPDATE_URL,
+        .url = CONFIG_FW_MANIFEST_URL,
         .event_handler = ota_manager_http_event_handler,
         .skip_cert_common_name_check = true
     };
-    
+
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (client == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (manifest_etag[0] != '\0') {
+        esp_http_client_set_header(client, "If-None-Match", manifest_etag);
+    }
+
+    received_etag[0] = '\0';
+    *is_modified = false;
+
+    esp_err_t err = esp_http_client_open(client, 0);
+    if (err == ESP_OK) {
+        esp_http_client_fetch_headers(client);
+        int status_code = esp_http_client_get_status_code(client);
+
+        if (status_code == 200) {
+            int length = ota_manager_read(client, ota_buffer, OTA_BUFFER_SIZE - 1);
+            ota_buffer[length > 0 ? length : 0] = '\0';
+            *is_modified = length > 0 && ota_manager_parse_manifest((const char *) ota_buffer, manifest);
+            err = *is_modified ? ESP_OK : ESP_ERR_INVALID_RESPONSE;
+        } else if (status_code != 304) {
+            ESP_LOGW(TAG, "manifest request failed, status %d", status_code);
+            err = ESP_ERR_INVALID_RESPONSE;
+        }
+    }
+
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+
+    return err;
+}
+
+/**
+ * The image hash identifies the build, the version is compared when the manifest has no hash
+ */
+static bool ota_manager_is_update_available(const ota_manifest_t *manifest) {
+
+    if (manifest->has_image_hash && running_image_hash_hex[0] != '\0') {
+        return memcmp(manifest->image_hash, running_image_hash, DELTA_PATCH_HASH_SIZE) != 0;
+    }
+
+    return strcmp(manifest->version, ota_manager_get_fw_version()) != 0;
+}
+
+/**
+ * A release rolled back by this device failed its self-test, it isn't downloaded again
+ */
+static bool ota_manager_is_rejected(const ota_manifest_t *manifest) {
+
+    const esp_partition_t *invalid_partition = esp_ota_get_last_invalid_partition();
+    if (invalid_partition == NULL) {
+        return false;
+    }
+
+    if (manifest->has_image_hash) {
+        uint8_t image_hash[DELTA_PATCH_HASH_SIZE];
+        return esp_partition_get_sha256(invalid_partition, image_hash) == ESP_OK &&
+            memcmp(image_hash, manifest->image_hash, DELTA_PATCH_HASH_SIZE) == 0;
+    }
+
+    esp_app_desc_t description;
+    return esp_ota_get_partition_description(invalid_partition, &description) == ESP_OK &&
+        strcmp(description.version, manifest->version) == 0;
+}
+
+/**
+ * Download the update into the inactive partition. Full images come in ranges
+ * and the download goes on from the last complete chunk after a failure or a
+ * restart; a server answering 200 sends a delta patch or doesn't serve ranges.
+ */
+static esp_err_t ota_manager_download(const ota_manifest_t *manifest) {
+
+    const esp_partition_t *update_partition = esp_ota_get_next_update_partition(NULL);
+    if (update_partition == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    esp_http_client_config_t config = {
+        .url = manifest->url,
+        .event_handler = ota_manager_http_event_handler,
+        .skip_cert_common_name_check = true
+    };
+
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (client == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_http_client_set_header(client, "X-Fw-Version", ota_manager_get_fw_version());
+
+#ifdef CONFIG_FW_DELTA_UPDATES
+    if (running_image_hash_hex[0] != '\0') {
+        esp_http_client_set_header(client, "X-Fw-Sha256", running_image_hash_hex);
+    }
+#endif
+
+    ota_manager_restore_progress(manifest, update_partition);
+
+    esp_err_t err = ESP_OK;
+    bool is_completed = false;
+
+    while (err == ESP_OK && !is_completed) {
+
+        int status_code = 0;
+        err = ota_manager_request_range(client, &status_code);
+
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "update request failed: %s", esp_err_to_name(err));
+        } else if (status_code == 206) {
+            err = ota_manager_write_chunk(client, update_partition);
+            is_completed = progress.written == progress.image_size;
+        } else if (status_code == 200) {
+            ota_manager_clear_progress();
+            err = ota_manager_stream_update(client, update_partition);
+            is_completed = true;
+        } else {
+            ESP_LOGW(TAG, "update request failed, status %d", status_code);
+            err = ESP_ERR_INVALID_RESPONSE;
+        }
+
+        esp_http_client_close(client);
+    }
+
+    esp_http_client_cleanup(client);
+
+    if (is_completed && err == ESP_OK) {
+        err = ota_manager_activate(update_partition, manifest);
+        // a complete but invalid image is downloaded again from the start
+        ota_manager_clear_progress();
+    }
+
+    return err;
+}
+
+/**
+ * Return true when an interrupted download should be resumed soon
+ */
+static bool ota_manager_check() {
+
+    ota_manager_load_running_image_hash(esp_ota_get_running_partition());
+
+    ota_manifest_t manifest;
+    bool is_modified = false;
+    esp_err_t err = ota_manager_fetch_manifest(&manifest, &is_modified);
+
+    if (err != ESP_OK || !is_modified) {
+        ESP_LOGI(TAG, "firmware manifest %s", err == ESP_OK ? "not modified" : "not available");
+        return false;
+    }
+
+    if (!ota_manager_is_update_available(&manifest)) {
+        ESP_LOGI(TAG, "firmware %s is up to date", manifest.version);
+        strlcpy(manifest_etag, received_etag, OTA_ETAG_LENGTH);
+        return false;
+    }
+
+    if (ota_manager_is_rejected(&manifest)) {
+        ESP_LOGW(TAG, "firmware %s was rolled back, waiting for another release", manifest.version);
+        strlcpy(manifest_etag, received_etag, OTA_ETAG_LENGTH);
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Attempting to download firmware %s from %s", manifest.version, manifest.url);
+
+    if (ota_manager_download(&manifest) == ESP_OK) {
+        esp_restart();
+    }
+
+    // the manifest is fetched again in full on the next check
+    manifest_etag[0] = '\0';
+    ESP_LOGI(TAG, "Firmware upgrade failed");
+
+    return progress.written > 0;
+}
+
+static void ota_task(void *args) {
+
     while (true) {
 
         xEventGroupWaitBits(ota_event_group, OTA_CHECK_BIT, true, true, portMAX_DELAY);
-        
-        ESP_LOGI(TAG, "Attempting to download update from %s", config.url);
-        
-        esp_err_t ret = esp_https_ota(&config);
-    
-        if (ret == ESP_OK) {
-            esp_restart();
-        } else {
-            ESP_LOGI(TAG, "Firmware upgrade failed");
-        }    
+
+        bool is_interrupted = ota_manager_check();
+        xEventGroupSetBits(ota_event_group, OTA_CHECK_DONE_BIT);
+
+        esp_timer_start_once(check_timer, is_interrupted ? OTA_RESUME_DELAY : ota_manager_get_check_delay());
     }
 
     vTaskDelete(NULL);
@@ -77,14 +711,15 @@ int ota_manager_init() {
 
     ota_event_group = xEventGroupCreate();
 
-    const esp_timer_create_args_t periodic_timer_args = {
+    const esp_timer_create_args_t check_timer_args = {
             .callback = &ota_manager_timer_callback,
             .name = "ota-timer"
     };
 
-    esp_timer_handle_t periodic_timer;
-    esp_err_t ret = esp_timer_create(&periodic_timer_args, &periodic_timer);
-    ret = esp_timer_start_periodic(periodic_timer, OTA_TIMER_PERIOD);
+    esp_err_t ret = esp_timer_create(&check_timer_args, &check_timer);
+    if (ret == ESP_OK) {
+        ret = esp_timer_start_once(check_timer, ota_manager_get_check_delay());
+    }
 
     if (ret == ESP_OK) {
         xTaskCreate(ota_task, "ota-task", 4096, NULL, 3, NULL);
@@ -93,8 +728,51 @@ int ota_manager_init() {
     return ret;
 }
 
-char* ota_manager_get_fw_version() {
+bool ota_manager_check_now(uint32_t timeout_ms) {
+
+    esp_timer_stop(check_timer);
+    xEventGroupClearBits(ota_event_group, OTA_CHECK_DONE_BIT);
+    xEventGroupSetBits(ota_event_group, OTA_CHECK_BIT);
+
+    EventBits_t bits = xEventGroupWaitBits(ota_event_group, OTA_CHECK_DONE_BIT, true, true, pdMS_TO_TICKS(timeout_ms));
+
+    return (bits & OTA_CHECK_DONE_BIT) != 0;
+}
+
+const char* ota_manager_get_fw_version() {
     const esp_app_desc_t  *app_desc = esp_ota_get_app_description();
     return app_desc->version;
 }
 
+
+bool ota_manager_is_pending_verify() {
+
+    esp_ota_img_states_t state;
+    if (esp_ota_get_state_partition(esp_ota_get_running_partition(), &state) != ESP_OK) {
+        // factory image or rollback disabled
+        return false;
+    }
+
+    return state == ESP_OTA_IMG_PENDING_VERIFY;
+}
+
+bool ota_manager_confirm_image() {
+
+    esp_err_t err = esp_ota_mark_app_valid_cancel_rollback();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "unable to mark firmware %s valid: %d", ota_manager_get_fw_version(), err);
+        return false;
+    }
+
+    ESP_LOGI(TAG, "firmware %s marked valid", ota_manager_get_fw_version());
+    return true;
+}
+
+void ota_manager_rollback_image() {
+
+    ESP_LOGE(TAG, "firmware %s rolled back", ota_manager_get_fw_version());
+
+    // returns only if there's no image to roll back to
+    esp_err_t err = esp_ota_mark_app_invalid_rollback_and_reboot();
+    ESP_LOGE(TAG, "rollback failed: %d", err);
+}
@@ -0,0 +1,64 @@
+#ifndef SPSC_RING_INCLUDE_SPSC_RING_H_
+#define SPSC_RING_INCLUDE_SPSC_RING_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+typedef enum {
+    // a push to a full ring is refused
+    SPSC_RING_DROP_NEWEST,
+    // a push to a full ring replaces the oldest item
+    SPSC_RING_OVERWRITE_OLDEST
+} spsc_ring_policy_t;
+
+/**
+ * Lock-free ring of fixed size items between one producer and one consumer,
+ * the producer may be an ISR. Indexes run free and wrap on capacity, which
+ * must be a power of two. The consumer task is notified on every push.
+ */
+typedef struct {
+    uint8_t *items;
+    size_t item_size;
+    uint32_t capacity;
+    spsc_ring_policy_t policy;
+    TaskHandle_t consumer;
+    // written by the producer only
+    uint32_t head;
+    // written by the consumer, and by the producer when overwriting
+    uint32_t tail;
+    uint32_t dropped;
+} spsc_ring_t;
+
+/**
+ * Set up a ring over storage, capacity * item_size bytes owned by the caller
+ */
+bool spsc_ring_init(spsc_ring_t *ring, void *storage, size_t item_size, uint32_t capacity, spsc_ring_policy_t policy);
+
+/**
+ * Task to notify when an item is pushed, NULL to disable notifications
+ */
+void spsc_ring_set_consumer(spsc_ring_t *ring, TaskHandle_t consumer);
+
+/**
+ * Copy item in the ring, false if it was dropped
+ */
+bool spsc_ring_push(spsc_ring_t *ring, const void *item);
+
+bool spsc_ring_push_from_isr(spsc_ring_t *ring, const void *item);
+
+/**
+ * Copy the oldest item out of the ring, false if empty
+ */
+bool spsc_ring_pop(spsc_ring_t *ring, void *item);
+
+uint32_t spsc_ring_count(spsc_ring_t *ring);
+
+/**
+ * Items refused or overwritten since init
+ */
+uint32_t spsc_ring_get_dropped(spsc_ring_t *ring);
+
+#endif
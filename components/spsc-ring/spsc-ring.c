@@ -0,0 +1,128 @@
+#include "spsc-ring.h"
+
+#include <string.h>
+#include "esp_attr.h"
+
+bool spsc_ring_init(spsc_ring_t *ring, void *storage, size_t item_size, uint32_t capacity, spsc_ring_policy_t policy) {
+
+    if (storage == NULL || item_size == 0 || capacity == 0 || (capacity & (capacity - 1)) != 0) {
+        return false;
+    }
+
+    *ring = (spsc_ring_t) {
+        .items = storage,
+        .item_size = item_size,
+        .capacity = capacity,
+        .policy = policy,
+        .consumer = NULL,
+        .head = 0,
+        .tail = 0,
+        .dropped = 0
+    };
+
+    return true;
+}
+
+void spsc_ring_set_consumer(spsc_ring_t *ring, TaskHandle_t consumer) {
+
+    __atomic_store_n(&ring->consumer, consumer, __ATOMIC_RELEASE);
+}
+
+static inline uint8_t * IRAM_ATTR spsc_ring_item(spsc_ring_t *ring, uint32_t index) {
+
+    return ring->items + (index & (ring->capacity - 1)) * ring->item_size;
+}
+
+/**
+ * Producer side, placed in IRAM as it runs in interrupt handlers
+ */
+static bool IRAM_ATTR spsc_ring_write(spsc_ring_t *ring, const void *item) {
+
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+    if (head - tail == ring->capacity) {
+
+        if (ring->policy == SPSC_RING_DROP_NEWEST) {
+            __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+            return false;
+        }
+
+        // a failure means the consumer took the oldest item, the slot is free anyway
+        if (__atomic_compare_exchange_n(&ring->tail, &tail, tail + 1, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    memcpy(spsc_ring_item(ring, head), item, ring->item_size);
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+bool spsc_ring_push(spsc_ring_t *ring, const void *item) {
+
+    bool is_pushed = spsc_ring_write(ring, item);
+
+    TaskHandle_t consumer = __atomic_load_n(&ring->consumer, __ATOMIC_ACQUIRE);
+    if (is_pushed && consumer != NULL) {
+        xTaskNotifyGive(consumer);
+    }
+
+    return is_pushed;
+}
+
+bool IRAM_ATTR spsc_ring_push_from_isr(spsc_ring_t *ring, const void *item) {
+
+    bool is_pushed = spsc_ring_write(ring, item);
+
+    TaskHandle_t consumer = __atomic_load_n(&ring->consumer, __ATOMIC_ACQUIRE);
+    if (is_pushed && consumer != NULL) {
+        BaseType_t is_task_woken = pdFALSE;
+        vTaskNotifyGiveFromISR(consumer, &is_task_woken);
+        if (is_task_woken) {
+            portYIELD_FROM_ISR();
+        }
+    }
+
+    return is_pushed;
+}
+
+bool spsc_ring_pop(spsc_ring_t *ring, void *item) {
+
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+    while (true) {
+
+        uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (tail == head) {
+            return false;
+        }
+
+        memcpy(item, spsc_ring_item(ring, tail), ring->item_size);
+
+        if (ring->policy == SPSC_RING_DROP_NEWEST) {
+            __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+            return true;
+        }
+
+        // the producer moves tail before overwriting a slot, a failed exchange
+        // means the copy may be torn and tail now points to the next oldest item
+        if (__atomic_compare_exchange_n(&ring->tail, &tail, tail + 1, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return true;
+        }
+    }
+}
+
+uint32_t spsc_ring_count(spsc_ring_t *ring) {
+
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+    return head - tail;
+}
+
+uint32_t spsc_ring_get_dropped(spsc_ring_t *ring) {
+
+    return __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,66 @@
+#!/usr/bin/env python
+#
+# Build an indexed blob image from the files of a directory.
+#
+# Image layout, little endian, read in place by storage-blobs.c:
+#   header   magic "BLOB", u16 version, u16 entries count, u32 image size
+#   entries  char name[32] zero padded, u32 data offset, u32 data length
+#   data     file contents, each one zero terminated and 4 bytes aligned
+#
+# usage: blobgen.py <partition size> <base dir> <output image>
+
+import os
+import struct
+import sys
+
+BLOB_MAGIC = b'BLOB'
+BLOB_VERSION = 1
+BLOB_NAME_LENGTH = 32
+HEADER_FORMAT = '<4sHHI'
+ENTRY_FORMAT = '<%dsII' % BLOB_NAME_LENGTH
+
+
+def align(value):
+    return (value + 3) & ~3
+
+
+def main():
+    if len(sys.argv) != 4:
+        sys.exit('usage: blobgen.py <partition size> <base dir> <output image>')
+
+    partition_size = int(sys.argv[1], 0)
+    base_dir = sys.argv[2]
+    output = sys.argv[3]
+
+    names = sorted(name for name in os.listdir(base_dir)
+                   if os.path.isfile(os.path.join(base_dir, name)) and not name.startswith('.'))
+
+    offset = struct.calcsize(HEADER_FORMAT) + struct.calcsize(ENTRY_FORMAT) * len(names)
+    entries = b''
+    data = b''
+
+    for name in names:
+        encoded_name = name.encode('utf-8')
+        if len(encoded_name) >= BLOB_NAME_LENGTH:
+            sys.exit('blob name too long: %s' % name)
+
+        with open(os.path.join(base_dir, name), 'rb') as f:
+            content = f.read()
+
+        entries += struct.pack(ENTRY_FORMAT, encoded_name, offset + len(data), len(content))
+        # zero terminated so that text blobs are used in place as C strings
+        data += content + b'\0'
+        data += b'\0' * (align(len(data)) - len(data))
+
+    image_size = offset + len(data)
+    if image_size > partition_size:
+        sys.exit('blob image of %d bytes does not fit a %d bytes partition' % (image_size, partition_size))
+
+    header = struct.pack(HEADER_FORMAT, BLOB_MAGIC, BLOB_VERSION, len(names), image_size)
+
+    with open(output, 'wb') as f:
+        f.write(header + entries + data)
+
+
+if __name__ == '__main__':
+    main()
@@ -2,15 +2,59 @@
 #define STORAGE_MANAGER_INCLUDE_STORAGE_MANAGER_H_
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define STORAGE_MANAGER_SPOOL_PAYLOAD_SIZE 52
+
+#define STORAGE_MANAGER_DEVICE_PARTITION "device"
+
+#define STORAGE_MANAGER_SECURITY_PARTITION "security"
 
 bool storage_manager_init();
 
-char *storage_manager_read_file(char *file_path);
+/**
+ * Map a blob of the device or security partition and return a read only,
+ * zero terminated pointer into flash, NULL if missing. Nothing is copied,
+ * the pointer stays valid until reboot. Length excludes the terminator.
+ */
+const char *storage_manager_map_blob(const char *partition_label, const char *name, size_t *length);
 
 bool storage_manager_get_prefs_bool_value(char *key, bool def_value);
 
 bool storage_manager_set_prefs_bool_value(char *key, bool value);
 
+/**
+ * Read a fixed size preference, false if missing or of a different size
+ */
+bool storage_manager_get_prefs_blob_value(char *key, void *value, size_t length);
+
+bool storage_manager_set_prefs_blob_value(char *key, const void *value, size_t length);
+
 bool storage_manager_reset();
 
+/**
+ * Mount the offline spool, a crash safe ring log of fixed size records.
+ * Spool functions are not thread safe and must be called from a single task.
+ */
+bool storage_manager_spool_init();
+
+/**
+ * Append a record, the oldest records are dropped when the spool is full
+ */
+bool storage_manager_spool_append(const void *data, size_t length);
+
+/**
+ * Copy the oldest pending record without removing it.
+ * is_current_boot tells whether the record was appended since the spool was mounted.
+ */
+bool storage_manager_spool_peek(void *data, size_t length, bool *is_current_boot);
+
+/**
+ * Remove the record returned by the last successful peek
+ */
+bool storage_manager_spool_pop();
+
+uint32_t storage_manager_spool_count();
+
 #endif
\ No newline at end of file
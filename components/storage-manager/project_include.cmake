@@ -0,0 +1,52 @@
+set(BLOBGEN_PY ${CMAKE_CURRENT_LIST_DIR}/blobgen.py)
+
+# blob_create_partition_image
+#
+# Create a blob image, read by storage_manager_map_blob, from the files of
+# base_dir that fits the partition named 'partition'. FLASH_IN_PROJECT
+# indicates that the generated image should be flashed when the entire
+# project is flashed to the target with 'idf.py -p PORT flash'.
+function(blob_create_partition_image partition base_dir)
+    set(options FLASH_IN_PROJECT)
+    set(multi DEPENDS)
+    cmake_parse_arguments(arg "${options}" "" "${multi}" "${ARGN}")
+
+    idf_build_get_property(python PYTHON)
+    set(blobgen_py ${python} ${BLOBGEN_PY})
+
+    get_filename_component(base_dir_full_path ${base_dir} ABSOLUTE)
+
+    partition_table_get_partition_info(size "--partition-name ${partition}" "size")
+    partition_table_get_partition_info(offset "--partition-name ${partition}" "offset")
+
+    if("${size}" AND "${offset}")
+        set(image_file ${CMAKE_BINARY_DIR}/${partition}.bin)
+
+        file(GLOB blob_files ${base_dir_full_path}/*)
+
+        add_custom_target(blob_${partition}_bin ALL
+            COMMAND ${blobgen_py} ${size} ${base_dir_full_path} ${image_file}
+            DEPENDS ${blob_files} ${arg_DEPENDS}
+            )
+
+        set_property(DIRECTORY "${CMAKE_CURRENT_SOURCE_DIR}" APPEND PROPERTY
+            ADDITIONAL_MAKE_CLEAN_FILES
+            ${image_file})
+
+        idf_component_get_property(main_args esptool_py FLASH_ARGS)
+        idf_component_get_property(sub_args esptool_py FLASH_SUB_ARGS)
+        esptool_py_flash_target(${partition}-flash "${main_args}" "${sub_args}")
+        esptool_py_flash_target_image(${partition}-flash "${partition}" "${offset}" "${image_file}")
+
+        add_dependencies(${partition}-flash blob_${partition}_bin)
+
+        if(arg_FLASH_IN_PROJECT)
+            esptool_py_flash_target_image(flash "${partition}" "${offset}" "${image_file}")
+            add_dependencies(flash blob_${partition}_bin)
+        endif()
+    else()
+        set(message "Failed to create blob image for partition '${partition}'. "
+                    "Check project configuration if using the correct partition table file.")
+        fail_at_build_time(blob_${partition}_bin "${message}")
+    endif()
+endfunction()
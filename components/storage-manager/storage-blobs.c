@@ -0,0 +1,128 @@
+/*
+ *  Read only blobs stored on the "device" and "security" data partitions.
+ *
+ *  Images are generated at build time by blobgen.py: a header, an index of
+ *  named entries and the blobs, each one zero terminated. The image is mapped
+ *  in the data address space on first use, lookups return pointers into flash
+ *  so certificates and configuration are used in place without heap copies.
+ *  Mappings are never released, pointers stay valid until reboot.
+ */
+
+#include "storage-manager.h"
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_partition.h"
+
+#define BLOB_MAGIC 0x424F4C42
+
+#define BLOB_VERSION 1
+
+#define BLOB_NAME_LENGTH 32
+
+#define BLOB_PARTITIONS_COUNT 2
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+    uint32_t image_size;
+} blob_header_t;
+
+typedef struct __attribute__((packed)) {
+    char name[BLOB_NAME_LENGTH];
+    uint32_t offset;
+    uint32_t length;
+} blob_entry_t;
+
+typedef struct {
+    const char *label;
+    const uint8_t *image;
+    spi_flash_mmap_handle_t handle;
+} blob_partition_t;
+
+static const char *TAG = "storage-blobs";
+
+static blob_partition_t blob_partitions[BLOB_PARTITIONS_COUNT] = {
+    { .label = STORAGE_MANAGER_DEVICE_PARTITION },
+    { .label = STORAGE_MANAGER_SECURITY_PARTITION }
+};
+
+static blob_partition_t *storage_blobs_get_partition(const char *label) {
+
+    for (int i = 0; i < BLOB_PARTITIONS_COUNT; i++) {
+        if (strcmp(blob_partitions[i].label, label) == 0) {
+            return &blob_partitions[i];
+        }
+    }
+
+    return NULL;
+}
+
+static bool storage_blobs_map_partition(blob_partition_t *blob_partition) {
+
+    if (blob_partition->image != NULL) {
+        return true;
+    }
+
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, blob_partition->label);
+    if (partition == NULL) {
+        ESP_LOGE(TAG, "%s partition not found", blob_partition->label);
+        return false;
+    }
+
+    blob_header_t header;
+    if (esp_partition_read(partition, 0, &header, sizeof(header)) != ESP_OK ||
+        header.magic != BLOB_MAGIC || header.version != BLOB_VERSION ||
+        header.image_size > partition->size) {
+        ESP_LOGE(TAG, "%s partition holds no blob image", blob_partition->label);
+        return false;
+    }
+
+    // only the image is mapped, not the whole partition
+    const void *image = NULL;
+    esp_err_t err = esp_partition_mmap(partition, 0, header.image_size, SPI_FLASH_MMAP_DATA, &image, &blob_partition->handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "unable to map %s partition: %d", blob_partition->label, err);
+        return false;
+    }
+
+    blob_partition->image = image;
+    ESP_LOGI(TAG, "%s partition mapped, %u blobs in %u bytes", blob_partition->label, header.count, header.image_size);
+
+    return true;
+}
+
+const char *storage_manager_map_blob(const char *partition_label, const char *name, size_t *length) {
+
+    blob_partition_t *blob_partition = storage_blobs_get_partition(partition_label);
+    if (blob_partition == NULL || !storage_blobs_map_partition(blob_partition)) {
+        return NULL;
+    }
+
+    const blob_header_t *header = (const blob_header_t *) blob_partition->image;
+    const blob_entry_t *entries = (const blob_entry_t *) (blob_partition->image + sizeof(blob_header_t));
+
+    for (int i = 0; i < header->count; i++) {
+
+        const blob_entry_t *entry = &entries[i];
+        if (strncmp(entry->name, name, BLOB_NAME_LENGTH) != 0) {
+            continue;
+        }
+
+        // the terminator must be inside the image as well
+        if (entry->offset + entry->length >= header->image_size) {
+            ESP_LOGE(TAG, "blob %s out of image bounds", name);
+            return NULL;
+        }
+
+        if (length != NULL) {
+            *length = entry->length;
+        }
+
+        return (const char *) blob_partition->image + entry->offset;
+    }
+
+    ESP_LOGE(TAG, "blob %s not found in %s partition", name, partition_label);
+    return NULL;
+}
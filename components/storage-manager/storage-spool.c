@@ -0,0 +1,269 @@
+/*
+ *  Append-only ring log of fixed size records stored on the "spool" data partition.
+ *
+ *  The partition is split in 64 bytes slots written sequentially, when the head
+ *  enters a new sector the whole sector is erased first, dropping the oldest
+ *  records if the log is full. Every sector is therefore erased once per lap,
+ *  which bounds flash wear to (records written / records per sector) erase cycles.
+ *
+ *  Each record carries a monotonic sequence number and a CRC32. A record torn by a
+ *  power loss fails the CRC check and is skipped. Consumed records are marked in
+ *  place clearing the state byte, no erase is needed. On boot the partition is
+ *  scanned to rebuild head, tail and pending records count.
+ */
+
+#include "storage-manager.h"
+
+#include <stddef.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+
+#define SPOOL_PARTITION_LABEL "spool"
+
+#define SPOOL_SECTOR_SIZE 4096
+
+#define SPOOL_ERASED_SEQUENCE 0xFFFFFFFF
+
+#define RECORD_STATE_WRITTEN 0xFE
+
+#define RECORD_STATE_CONSUMED 0x00
+
+typedef struct __attribute__((packed)) {
+    uint32_t sequence;
+    uint16_t length;
+    uint8_t reserved;
+    uint8_t state;
+    uint8_t payload[STORAGE_MANAGER_SPOOL_PAYLOAD_SIZE];
+    uint32_t crc;
+} spool_record_t;
+
+_Static_assert(SPOOL_SECTOR_SIZE % sizeof(spool_record_t) == 0, "spool records must not cross sectors");
+
+#define RECORDS_PER_SECTOR (SPOOL_SECTOR_SIZE / sizeof(spool_record_t))
+
+static const char *TAG = "storage-spool";
+
+static const esp_partition_t *spool_partition = NULL;
+
+static uint32_t slots_count = 0;
+
+static uint32_t head_slot = 0;
+
+static uint32_t tail_slot = 0;
+
+static uint32_t pending_records = 0;
+
+static uint32_t next_sequence = 0;
+
+// first sequence of this boot, older records were written before the restart
+static uint32_t boot_sequence = 0;
+
+static uint32_t spool_record_crc(const spool_record_t *record) {
+    // state byte and crc itself are excluded, state changes when a record is consumed
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *) &record->sequence, sizeof(record->sequence));
+    crc = esp_rom_crc32_le(crc, (const uint8_t *) &record->length, sizeof(record->length));
+    return esp_rom_crc32_le(crc, record->payload, sizeof(record->payload));
+}
+
+static bool spool_read_record(uint32_t slot, spool_record_t *record) {
+    return esp_partition_read(spool_partition, slot * sizeof(spool_record_t), record, sizeof(spool_record_t)) == ESP_OK;
+}
+
+static bool spool_is_record_valid(const spool_record_t *record) {
+    return record->sequence != SPOOL_ERASED_SEQUENCE &&
+        record->length <= STORAGE_MANAGER_SPOOL_PAYLOAD_SIZE &&
+        record->crc == spool_record_crc(record);
+}
+
+static bool spool_is_record_pending(const spool_record_t *record) {
+    return record->state == RECORD_STATE_WRITTEN && spool_is_record_valid(record);
+}
+
+static bool spool_is_slot_blank(uint32_t slot) {
+
+    spool_record_t record;
+    if (!spool_read_record(slot, &record)) {
+        return false;
+    }
+
+    const uint8_t *bytes = (const uint8_t *) &record;
+    for (size_t i = 0; i < sizeof(record); i++) {
+        if (bytes[i] != 0xFF) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static uint32_t spool_next_slot(uint32_t slot) {
+    return (slot + 1) % slots_count;
+}
+
+/**
+ * Erase the sector starting at head slot, dropping pending records stored in it
+ */
+static bool spool_erase_head_sector() {
+
+    uint32_t first_slot = head_slot;
+    uint32_t last_slot = head_slot + RECORDS_PER_SECTOR;
+
+    for (uint32_t slot = first_slot; slot < last_slot && pending_records > 0; slot++) {
+        spool_record_t record;
+        if (spool_read_record(slot, &record) && spool_is_record_pending(&record)) {
+            pending_records--;
+        }
+    }
+
+    if (tail_slot >= first_slot && tail_slot < last_slot) {
+        tail_slot = last_slot % slots_count;
+    }
+
+    if (pending_records == 0) {
+        tail_slot = head_slot;
+    }
+
+    esp_err_t err = esp_partition_erase_range(spool_partition, first_slot * sizeof(spool_record_t), SPOOL_SECTOR_SIZE);
+    return err == ESP_OK;
+}
+
+bool storage_manager_spool_init() {
+
+    spool_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, SPOOL_PARTITION_LABEL);
+    if (spool_partition == NULL) {
+        ESP_LOGE(TAG, "spool partition not found");
+        return false;
+    }
+
+    slots_count = (spool_partition->size / SPOOL_SECTOR_SIZE) * RECORDS_PER_SECTOR;
+
+    bool has_records = false;
+    bool has_pending = false;
+    uint32_t max_sequence = 0;
+    uint32_t min_pending_sequence = 0;
+
+    pending_records = 0;
+    head_slot = 0;
+    tail_slot = 0;
+
+    for (uint32_t slot = 0; slot < slots_count; slot++) {
+
+        spool_record_t record;
+        if (!spool_read_record(slot, &record) || !spool_is_record_valid(&record)) {
+            continue;
+        }
+
+        if (!has_records || record.sequence > max_sequence) {
+            max_sequence = record.sequence;
+            head_slot = spool_next_slot(slot);
+            has_records = true;
+        }
+
+        if (record.state != RECORD_STATE_WRITTEN) {
+            continue;
+        }
+
+        pending_records++;
+        if (!has_pending || record.sequence < min_pending_sequence) {
+            min_pending_sequence = record.sequence;
+            tail_slot = slot;
+            has_pending = true;
+        }
+    }
+
+    next_sequence = has_records ? max_sequence + 1 : 0;
+    boot_sequence = next_sequence;
+
+    // skip slots left dirty by a write interrupted by a power loss
+    while (head_slot % RECORDS_PER_SECTOR != 0 && !spool_is_slot_blank(head_slot)) {
+        head_slot = spool_next_slot(head_slot);
+    }
+
+    if (!has_pending) {
+        tail_slot = head_slot;
+    }
+
+    ESP_LOGI(TAG, "spool ready: %u slots, %u pending records", slots_count, pending_records);
+
+    return true;
+}
+
+bool storage_manager_spool_append(const void *data, size_t length) {
+
+    if (spool_partition == NULL || length > STORAGE_MANAGER_SPOOL_PAYLOAD_SIZE) {
+        return false;
+    }
+
+    if (head_slot % RECORDS_PER_SECTOR == 0 && !spool_erase_head_sector()) {
+        ESP_LOGE(TAG, "unable to erase spool sector");
+        return false;
+    }
+
+    spool_record_t record;
+    memset(&record, 0xFF, sizeof(record));
+    record.sequence = next_sequence;
+    record.length = length;
+    record.state = RECORD_STATE_WRITTEN;
+    memcpy(record.payload, data, length);
+    record.crc = spool_record_crc(&record);
+
+    esp_err_t err = esp_partition_write(spool_partition, head_slot * sizeof(spool_record_t), &record, sizeof(record));
+
+    // the slot is burnt even when the write fails
+    next_sequence++;
+    head_slot = spool_next_slot(head_slot);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "spool write failed: %d", err);
+        return false;
+    }
+
+    pending_records++;
+    return true;
+}
+
+bool storage_manager_spool_peek(void *data, size_t length, bool *is_current_boot) {
+
+    if (spool_partition == NULL) {
+        return false;
+    }
+
+    while (pending_records > 0 && tail_slot != head_slot) {
+
+        spool_record_t record;
+        if (spool_read_record(tail_slot, &record) && spool_is_record_pending(&record)) {
+            size_t copy_length = length < record.length ? length : record.length;
+            memcpy(data, record.payload, copy_length);
+            *is_current_boot = record.sequence >= boot_sequence;
+            return true;
+        }
+
+        tail_slot = spool_next_slot(tail_slot);
+    }
+
+    // tail reached head, nothing left to replay
+    pending_records = 0;
+    return false;
+}
+
+bool storage_manager_spool_pop() {
+
+    if (spool_partition == NULL || pending_records == 0) {
+        return false;
+    }
+
+    uint8_t state = RECORD_STATE_CONSUMED;
+    size_t state_offset = tail_slot * sizeof(spool_record_t) + offsetof(spool_record_t, state);
+    esp_err_t err = esp_partition_write(spool_partition, state_offset, &state, sizeof(state));
+
+    pending_records--;
+    tail_slot = spool_next_slot(tail_slot);
+
+    return err == ESP_OK;
+}
+
+uint32_t storage_manager_spool_count() {
+    return pending_records;
+}
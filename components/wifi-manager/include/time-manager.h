@@ -2,13 +2,43 @@
 #define TIME_MANAGER_INCLUDE_TIME_MANAGER_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 
-#define ISO_DATE_LENGTH 21
+// YYYY-MM-DDTHH:MM:SS.mmmZ
+#define ISO_TIMESTAMP_LENGTH 25
+
+/**
+ * ISO 8601 timestamp with milliseconds updated incrementally: the date is
+ * rendered again only when the day changes. No strftime, integer math only.
+ */
+typedef struct {
+    int64_t day;
+    char value[ISO_TIMESTAMP_LENGTH];
+} iso_timestamp_t;
 
 void time_manager_sync_time();
 
 bool time_manager_is_time_synched();
 
-void time_manager_format_time(char *out, int length);
+/**
+ * Milliseconds from boot on the esp_timer clock, samples are stamped with it
+ */
+int64_t time_manager_get_monotonic_ms();
+
+/**
+ * Convert a monotonic timestamp of this boot to milliseconds from epoch
+ * through the boot epoch offset, known once the wall clock is set.
+ * Return false while it is not.
+ */
+bool time_manager_monotonic_to_epoch_ms(int64_t monotonic_ms, int64_t *epoch_ms);
+
+/**
+ * Current time in milliseconds from epoch or 0 if time is not synched
+ */
+int64_t time_manager_get_epoch_ms();
+
+void time_manager_init_iso_timestamp(iso_timestamp_t *iso_timestamp);
+
+const char* time_manager_update_iso_timestamp(iso_timestamp_t *iso_timestamp, int64_t epoch_ms);
 
 #endif
\ No newline at end of file
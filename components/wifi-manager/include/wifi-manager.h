@@ -2,12 +2,18 @@
 #define WIFI_MANAGER_INCLUDE_WIFI_MANAGER_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
 uint32_t wifi_manager_init(void);
 
 bool wifi_manager_is_connected();
 
+/**
+ * Connection attempts since boot, including the successful ones
+ */
+uint32_t wifi_manager_get_connection_attempts();
+
 void wifi_manager_deinit(void);
 
 #endif
\ No newline at end of file
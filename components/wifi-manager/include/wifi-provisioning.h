@@ -2,6 +2,7 @@
 #define WIFI_PROVISIONING_INCLUDE_WIFI_PROVISIONING_H_
 
 #include <stdio.h>
+#include <stdint.h>
 
 uint32_t wifi_provisioning_start();
 
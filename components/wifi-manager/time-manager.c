@@ -4,13 +4,28 @@
 #include "freertos/task.h"
 #include "esp_sntp.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include <time.h>
+#include <sys/time.h>
 
 #define RETRY_CONT 20
 
+#define MILLISECONDS_PER_DAY 86400000
+
+// offset of the hours field in YYYY-MM-DDTHH:MM:SS.mmmZ
+#define ISO_TIME_OFFSET 11
+
 static const char *TAG = "time-manager";
 
 static bool is_sntp_initialized = false;
 
+// wall clock at boot, ms from epoch, written by the SNTP task
+static portMUX_TYPE boot_epoch_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static int64_t boot_epoch_ms = 0;
+
+static bool is_boot_epoch_known = false;
+
 static void sync_time_task(void *args) {
 
     int retry = 0;
@@ -20,13 +35,38 @@ static void sync_time_task(void *args) {
         vTaskDelay(2000 / portTICK_PERIOD_MS);
     }
     
-    char strftime_buf[ISO_DATE_LENGTH] = {'\0'};
-    time_manager_format_time(strftime_buf, ISO_DATE_LENGTH);
-    ESP_LOGI(TAG, "The current UTC date/time is: %s", strftime_buf);
+    struct timeval now;
+    gettimeofday(&now, NULL);
+
+    iso_timestamp_t iso_timestamp;
+    time_manager_init_iso_timestamp(&iso_timestamp);
+    ESP_LOGI(TAG, "The current UTC date/time is: %s",
+        time_manager_update_iso_timestamp(&iso_timestamp, (int64_t) now.tv_sec * 1000 + now.tv_usec / 1000));
 
     vTaskDelete(NULL);
 }
 
+int64_t time_manager_get_monotonic_ms() {
+    return esp_timer_get_time() / 1000;
+}
+
+static void time_manager_set_boot_epoch(const struct timeval *now) {
+
+    int64_t epoch_ms = (int64_t) now->tv_sec * 1000 + now->tv_usec / 1000;
+    int64_t offset = epoch_ms - time_manager_get_monotonic_ms();
+
+    portENTER_CRITICAL(&boot_epoch_mux);
+    boot_epoch_ms = offset;
+    is_boot_epoch_known = true;
+    portEXIT_CRITICAL(&boot_epoch_mux);
+}
+
+static void time_manager_on_time_sync(struct timeval *now) {
+
+    // also called on periodic syncs, the offset follows clock corrections
+    time_manager_set_boot_epoch(now);
+}
+
 void time_manager_sync_time() {
 
     if (time_manager_is_time_synched()) {
@@ -38,6 +78,7 @@ void time_manager_sync_time() {
         is_sntp_initialized = true;
         sntp_setoperatingmode(SNTP_OPMODE_POLL);
         sntp_setservername(0, CONFIG_SNTP_SERVER);
+        sntp_set_time_sync_notification_cb(time_manager_on_time_sync);
         sntp_init();
     }
 
@@ -53,11 +94,92 @@ bool time_manager_is_time_synched() {
     return timeinfo.tm_year > (2020 - 1900);
 }
 
-void time_manager_format_time(char *out, int length) {
-    
-    time_t now = 0;
-    struct tm timeinfo = { 0 };
-    time(&now);
-    localtime_r(&now, &timeinfo);
-    strftime(out, length, "%Y-%m-%dT%H:%M:%SZ", &timeinfo);
-}
\ No newline at end of file
+bool time_manager_monotonic_to_epoch_ms(int64_t monotonic_ms, int64_t *epoch_ms) {
+
+    portENTER_CRITICAL(&boot_epoch_mux);
+    bool is_known = is_boot_epoch_known;
+    int64_t offset = boot_epoch_ms;
+    portEXIT_CRITICAL(&boot_epoch_mux);
+
+    // the clock may have been set without SNTP, e.g. kept by the RTC in deep sleep
+    if (!is_known && time_manager_is_time_synched()) {
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        time_manager_set_boot_epoch(&now);
+        return time_manager_monotonic_to_epoch_ms(monotonic_ms, epoch_ms);
+    }
+
+    if (!is_known) {
+        return false;
+    }
+
+    *epoch_ms = monotonic_ms + offset;
+    return true;
+}
+
+int64_t time_manager_get_epoch_ms() {
+
+    int64_t epoch_ms = 0;
+    return time_manager_monotonic_to_epoch_ms(time_manager_get_monotonic_ms(), &epoch_ms) ? epoch_ms : 0;
+}
+
+void time_manager_init_iso_timestamp(iso_timestamp_t *iso_timestamp) {
+
+    iso_timestamp->day = -1;
+    iso_timestamp->value[0] = '\0';
+}
+
+static void time_manager_put_digits(char *out, int value, int count) {
+
+    for (int i = count - 1; i >= 0; i--) {
+        out[i] = '0' + value % 10;
+        value /= 10;
+    }
+}
+
+/**
+ * Gregorian date of a day count from epoch (H. Hinnant's civil_from_days)
+ */
+static void time_manager_put_date(char *out, int64_t days) {
+
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    uint32_t day_of_era = days - era * 146097;
+    uint32_t year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    uint32_t day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    uint32_t shifted_month = (5 * day_of_year + 2) / 153;
+    uint32_t day = day_of_year - (153 * shifted_month + 2) / 5 + 1;
+    uint32_t month = shifted_month < 10 ? shifted_month + 3 : shifted_month - 9;
+    int64_t year = year_of_era + era * 400 + (month <= 2 ? 1 : 0);
+
+    time_manager_put_digits(out, year, 4);
+    out[4] = '-';
+    time_manager_put_digits(out + 5, month, 2);
+    out[7] = '-';
+    time_manager_put_digits(out + 8, day, 2);
+    out[10] = 'T';
+}
+
+const char* time_manager_update_iso_timestamp(iso_timestamp_t *iso_timestamp, int64_t epoch_ms) {
+
+    int64_t day = epoch_ms / MILLISECONDS_PER_DAY;
+    int32_t ms_of_day = epoch_ms % MILLISECONDS_PER_DAY;
+
+    if (day != iso_timestamp->day) {
+        time_manager_put_date(iso_timestamp->value, day);
+        iso_timestamp->day = day;
+    }
+
+    char *time_field = iso_timestamp->value + ISO_TIME_OFFSET;
+    time_manager_put_digits(time_field, ms_of_day / 3600000, 2);
+    time_field[2] = ':';
+    time_manager_put_digits(time_field + 3, (ms_of_day / 60000) % 60, 2);
+    time_field[5] = ':';
+    time_manager_put_digits(time_field + 6, (ms_of_day / 1000) % 60, 2);
+    time_field[8] = '.';
+    time_manager_put_digits(time_field + 9, ms_of_day % 1000, 3);
+    time_field[12] = 'Z';
+    time_field[13] = '\0';
+
+    return iso_timestamp->value;
+}
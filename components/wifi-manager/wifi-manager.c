@@ -1,10 +1,13 @@
 #include "wifi-manager.h"
 #include "wifi-events.h"
 
+#include <string.h>
 #include "esp_wifi.h"
+#include "esp_timer.h"
 #include "freertos/event_groups.h"
 #include "esp_log.h"
 #include "freertos/task.h"
+#include "storage-manager.h"
 
 #define WIFI_RETRY_CONNECTION_BIT BIT0
 
@@ -12,33 +15,177 @@
 
 #define CONNECTION_MAX_RETRY_DELAY 60000
 
+#define CONNECTION_CACHE_KEY "wifi_cache"
+
+/**
+ * Last access point and DHCP lease that led to a connection.
+ * A directed connect on the cached BSSID and channel skips the scan,
+ * the lease can be reused as static IP to skip DHCP too.
+ */
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t channel;
+    esp_netif_ip_info_t ip_info;
+    esp_ip4_addr_t dns;
+} wifi_connection_cache_t;
+
 static const char *TAG = "wifi-manager";
 
 static EventGroupHandle_t s_wifi_event_group;
 
+static esp_netif_t *sta_netif = NULL;
+
 static int connection_retry_count = 0;
 
+static uint32_t connection_attempts_count = 0;
+
 static bool is_connected = false;
 
+static wifi_connection_cache_t connection_cache;
+
+static bool is_cache_valid = false;
+
+static bool is_fast_connect = false;
+
+static int64_t connection_start_time = 0;
+
+static int64_t association_time = 0;
+
 static void wifi_manager_send_event(int32_t event_id);
 
 ESP_EVENT_DEFINE_BASE(WIFI_MANAGER_EVENTS);
 
+static int64_t get_milliseconds_from_boot() {
+    return esp_timer_get_time() / 1000;
+}
+
+static void wifi_manager_load_connection_cache() {
+
+#ifdef CONFIG_WIFI_FAST_RECONNECT
+    is_cache_valid = storage_manager_get_prefs_blob_value(CONNECTION_CACHE_KEY, &connection_cache, sizeof(connection_cache)) &&
+        connection_cache.channel != 0;
+#endif
+}
+
+static void wifi_manager_update_connection_cache(const esp_netif_ip_info_t *ip_info) {
+
+#ifdef CONFIG_WIFI_FAST_RECONNECT
+    wifi_ap_record_t ap_info;
+    if (esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK) {
+        return;
+    }
+
+    wifi_connection_cache_t cache = { 0 };
+    memcpy(cache.bssid, ap_info.bssid, sizeof(cache.bssid));
+    cache.channel = ap_info.primary;
+    cache.ip_info = *ip_info;
+
+    esp_netif_dns_info_t dns_info;
+    if (esp_netif_get_dns_info(sta_netif, ESP_NETIF_DNS_MAIN, &dns_info) == ESP_OK) {
+        cache.dns = dns_info.ip.u_addr.ip4;
+    }
+
+    // spare NVS writes, the cache rarely changes
+    if (is_cache_valid && memcmp(&cache, &connection_cache, sizeof(cache)) == 0) {
+        return;
+    }
+
+    connection_cache = cache;
+    is_cache_valid = storage_manager_set_prefs_blob_value(CONNECTION_CACHE_KEY, &connection_cache, sizeof(connection_cache));
+#endif
+}
+
+#ifdef CONFIG_WIFI_REUSE_DHCP_LEASE
+
+/**
+ * Static IP from the cached lease, DHCP is restored when the lease was not used
+ */
+static void wifi_manager_configure_ip(bool use_cached_lease) {
+
+    if (use_cached_lease) {
+        esp_netif_dhcpc_stop(sta_netif);
+        esp_netif_set_ip_info(sta_netif, &connection_cache.ip_info);
+
+        esp_netif_dns_info_t dns_info = { 0 };
+        dns_info.ip.type = ESP_IPADDR_TYPE_V4;
+        dns_info.ip.u_addr.ip4 = connection_cache.dns;
+        esp_netif_set_dns_info(sta_netif, ESP_NETIF_DNS_MAIN, &dns_info);
+        return;
+    }
+
+    esp_netif_dhcpc_start(sta_netif);
+}
+
+#endif
+
+/**
+ * Directed connect on the cached access point, or full scan
+ */
+static void wifi_manager_configure_connection(bool fast_connect) {
+
+    wifi_config_t wifi_config;
+    if (esp_wifi_get_config(WIFI_IF_STA, &wifi_config) != ESP_OK) {
+        return;
+    }
+
+    if (fast_connect) {
+        wifi_config.sta.bssid_set = true;
+        memcpy(wifi_config.sta.bssid, connection_cache.bssid, sizeof(wifi_config.sta.bssid));
+        wifi_config.sta.channel = connection_cache.channel;
+        wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+    } else {
+        wifi_config.sta.bssid_set = false;
+        wifi_config.sta.channel = 0;
+        wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+    }
+
+    esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+
+#ifdef CONFIG_WIFI_REUSE_DHCP_LEASE
+    wifi_manager_configure_ip(fast_connect);
+#endif
+}
+
+static void wifi_manager_connect() {
+
+    // a failed directed connect falls back to a full scan
+    bool fast_connect = is_cache_valid && !is_fast_connect;
+    wifi_manager_configure_connection(fast_connect);
+    is_fast_connect = fast_connect;
+
+    ESP_LOGI(TAG, "connection attemp no. %d%s", connection_retry_count, fast_connect ? ", directed" : "");
+
+    connection_start_time = get_milliseconds_from_boot();
+    association_time = 0;
+    connection_attempts_count++;
+    esp_wifi_connect();
+}
+
 static void wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data) {
 
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
         ESP_LOGI(TAG, "connect to the AP");
         xEventGroupSetBits(s_wifi_event_group, WIFI_RETRY_CONNECTION_BIT);
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        association_time = get_milliseconds_from_boot();
+        ESP_LOGI(TAG, "associated in %lld ms (%s)", association_time - connection_start_time, is_fast_connect ? "no scan" : "scan");
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
         ESP_LOGI(TAG, "retry to connect to the AP");
         is_connected = false;
         wifi_manager_send_event(WIFI_EVENT_DISCONNECTED);
         xEventGroupSetBits(s_wifi_event_group, WIFI_RETRY_CONNECTION_BIT);
-        connection_retry_count++;
+        // the full scan fallback is tried right away
+        if (!is_fast_connect) {
+            connection_retry_count++;
+        }
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
-        ESP_LOGI(TAG, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
+        int64_t now = get_milliseconds_from_boot();
+        ESP_LOGI(TAG, "got ip:" IPSTR " in %lld ms (ip %lld ms)", IP2STR(&event->ip_info.ip),
+            now - connection_start_time, association_time > 0 ? now - association_time : 0);
         is_connected = true;
+        wifi_manager_update_connection_cache(&event->ip_info);
+        is_fast_connect = false;
         wifi_manager_send_event(WIFI_EVENT_CONNECTED);
         connection_retry_count = 0;
     }
@@ -54,8 +201,7 @@ static void wifi_manager_reconnection_task(void *ctx) {
         vTaskDelay(delay / portTICK_RATE_MS);
         
         if (!is_connected) {
-            ESP_LOGI(TAG, "connection attemp no. %d", connection_retry_count);
-            esp_wifi_connect();
+            wifi_manager_connect();
         }
     }
     
@@ -67,15 +213,20 @@ uint32_t wifi_manager_init(void) {
     s_wifi_event_group = xEventGroupCreate();
     esp_err_t result_code = esp_netif_init();
 
-    esp_netif_create_default_wifi_sta();
+    sta_netif = esp_netif_create_default_wifi_sta();
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     result_code += esp_wifi_init(&cfg);
 
+    // BSSID and channel set for directed connects must not overwrite the stored configuration
+    result_code += esp_wifi_set_storage(WIFI_STORAGE_RAM);
+
     result_code += esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL);
     result_code += esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &wifi_event_handler, NULL);
     
     result_code += esp_wifi_set_mode(WIFI_MODE_STA);
+
+    wifi_manager_load_connection_cache();
     
     if (result_code == ESP_OK) {
         xTaskCreate(wifi_manager_reconnection_task, "wifi reconnect task", 2048, NULL, 5, NULL);
@@ -89,6 +240,10 @@ bool wifi_manager_is_connected() {
     return is_connected;
 }
 
+uint32_t wifi_manager_get_connection_attempts() {
+    return connection_attempts_count;
+}
+
 static void wifi_manager_send_event(int32_t event_id) {
     esp_event_post(WIFI_MANAGER_EVENTS, event_id, NULL, 0, portMAX_DELAY);
 }
@@ -100,4 +255,3 @@ void wifi_manager_deinit(void) {
     esp_wifi_disconnect();
     esp_wifi_stop();
 }
-
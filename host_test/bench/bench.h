@@ -0,0 +1,96 @@
+/*
+ *  Benchmark helpers. A benchmark prints one JSON line per measured path,
+ *  with the keys of the firmware profiler lines, checked by compare.py
+ *  against the stored baselines.
+ */
+
+#ifndef HOST_BENCH_BENCH_H_
+#define HOST_BENCH_BENCH_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include "host.h"
+}
+
+namespace bench {
+
+// runs of a measure, the median one is reported
+constexpr int RUNS = 7;
+
+// host cycles are reported for a 240 MHz core
+constexpr double CPU_MHZ = 240.0;
+
+struct metrics_t {
+    // host time per operation
+    double ns;
+    // firmware heap allocations per operation
+    double allocations;
+    // heap in use above the starting level, bytes
+    size_t heap_peak;
+};
+
+/**
+ * Call operation iterations times per run. Allocations and heap are counted
+ * over all runs, time is the median run. A single run measures a cold path.
+ */
+inline metrics_t measure(int iterations, const std::function<void()> &operation, int runs = RUNS) {
+
+    host_heap_reset(esp_get_free_heap_size());
+    size_t heap_start = host_heap_get_in_use();
+
+    std::vector<double> times;
+    for (int run = 0; run < runs; run++) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            operation();
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        times.push_back(std::chrono::duration<double, std::nano>(elapsed).count() / iterations);
+    }
+
+    std::sort(times.begin(), times.end());
+
+    return metrics_t {
+        times[runs / 2],
+        (double) host_heap_get_allocations() / (iterations * runs),
+        host_heap_get_peak() - heap_start
+    };
+}
+
+/**
+ * Print a result line: {"path":"...","key":value,...}
+ */
+inline void report(const std::string &path, const std::vector<std::pair<std::string, double>> &values) {
+
+    std::string line = "{\"path\":\"" + path + "\"";
+    for (const auto &value : values) {
+        char number[32];
+        snprintf(number, sizeof(number), "%.6g", value.second);
+        line += ",\"" + value.first + "\":" + number;
+    }
+    line += "}";
+
+    printf("%s\n", line.c_str());
+    fflush(stdout);
+}
+
+inline void report(const std::string &path, const metrics_t &metrics) {
+
+    report(path, {
+        {"ns", metrics.ns},
+        {"cycles", metrics.ns * CPU_MHZ / 1000.0},
+        {"allocations", metrics.allocations},
+        {"heap", (double) metrics.heap_peak}
+    });
+}
+
+}
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ *  Publish path of the data sender: a PMS sample from the queue to the bytes
+ *  sent to the broker, device configuration lookup.
+ */
+
+#include "bench.h"
+#include "data_sender_setup.h"
+
+namespace {
+
+void bench_device_config() {
+
+    // the first lookup parses config.json
+    bench::report("device_config_cold", bench::measure(1, []() {
+        device_helper_get_device_config();
+    }, 1));
+
+    bench::report("device_config_warm", bench::measure(20000, []() {
+        if (device_helper_get_device_config() == NULL) {
+            abort();
+        }
+    }));
+}
+
+void bench_pms_publish() {
+
+    telemetry_sample_t sample = data_sender_setup::pms_sample(1000, SAMPLE_CLOCK_MONOTONIC);
+
+    // first publish of the connection
+    data_sender_enqueue_sample(&sample);
+    host_settle();
+    host_mqtt_clear_sent();
+
+    const int iterations = 200;
+    bench::metrics_t metrics = bench::measure(iterations, [&]() {
+        data_sender_enqueue_sample(&sample);
+        host_settle();
+    });
+
+    size_t wire_bytes = 0;
+    for (int i = 0; i < host_mqtt_get_sent_count(); i++) {
+        wire_bytes += host_mqtt_get_sent(i)->wire_bytes;
+    }
+
+    bench::report("pms_encode_publish", metrics);
+    bench::report("pms_encode_publish", {
+        {"wireBytes", (double) wire_bytes / host_mqtt_get_sent_count()},
+        {"messages", (double) host_mqtt_get_sent_count() / (iterations * bench::RUNS)}
+    });
+}
+
+}
+
+int main() {
+
+    host_log_set_level(ESP_LOG_WARN);
+    if (!data_sender_setup::load_partitions()) {
+        return 1;
+    }
+
+    bench_device_config();
+
+    if (!data_sender_setup::start()) {
+        return 1;
+    }
+
+    bench_pms_publish();
+
+    return 0;
+}
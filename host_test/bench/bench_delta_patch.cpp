@@ -0,0 +1,83 @@
+/*
+ *  Delta update of a 256KB app image: the patch generated by deltagen.py is
+ *  applied from memory in the 1KB chunks of the ota-manager download loop,
+ *  against a full image copied through the same target writes. The decoder
+ *  is the whole RAM of an update besides the download buffer, it allocates
+ *  nothing.
+ */
+
+#include "bench.h"
+#include "delta_images.h"
+
+using delta_images::bytes_t;
+
+namespace {
+
+// as ota-manager
+const size_t OTA_BUFFER_SIZE = 1024;
+
+const size_t PAYLOAD_SIZE = 256 * 1024;
+
+const int EDITS = 400;
+
+delta_patch_t decoder;
+
+}
+
+int main() {
+
+    host_log_set_level(ESP_LOG_WARN);
+
+    bytes_t payload = delta_images::build_payload(1, PAYLOAD_SIZE);
+    bytes_t source = delta_images::build_image("1.0.0", payload);
+    bytes_t target = delta_images::build_image("1.1.0", delta_images::edit_payload(payload, 1, EDITS));
+    bytes_t patch = delta_images::generate_patch(source, target);
+    if (patch.empty()) {
+        return 1;
+    }
+
+    delta_images::apply_context_t context = {};
+    context.source = &source;
+    context.target.reserve(target.size());
+
+    bench::metrics_t metrics = bench::measure(1, [&]() {
+        context.target.clear();
+        context.source_bytes = 0;
+        if (delta_images::apply_patch(&decoder, patch, &context, []() { return OTA_BUFFER_SIZE; }) != ESP_OK) {
+            abort();
+        }
+    });
+    if (context.target != target) {
+        return 1;
+    }
+
+    bench::report("delta_apply", {
+        {"ns", metrics.ns},
+        {"cycles", metrics.ns * bench::CPU_MHZ / 1000.0},
+        {"allocations", metrics.allocations},
+        {"heap", (double) metrics.heap_peak},
+        {"bytesPerSecond", target.size() * 1e9 / metrics.ns},
+        {"patchBytes", (double) patch.size()},
+        {"targetBytes", (double) target.size()},
+        {"sourceReadBytes", (double) context.source_bytes},
+        {"decoderBytes", (double) sizeof(delta_patch_t)}
+    });
+
+    metrics = bench::measure(1, [&]() {
+        context.target.clear();
+        for (size_t offset = 0; offset < target.size(); offset += OTA_BUFFER_SIZE) {
+            delta_images::write_target(&context, target.data() + offset, std::min(OTA_BUFFER_SIZE, target.size() - offset));
+        }
+    });
+
+    bench::report("full_image_write", {
+        {"ns", metrics.ns},
+        {"cycles", metrics.ns * bench::CPU_MHZ / 1000.0},
+        {"allocations", metrics.allocations},
+        {"heap", (double) metrics.heap_peak},
+        {"bytesPerSecond", target.size() * 1e9 / metrics.ns},
+        {"downloadBytes", (double) target.size()}
+    });
+
+    return 0;
+}
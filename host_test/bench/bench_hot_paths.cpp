@@ -0,0 +1,79 @@
+/*
+ *  Hot paths of the firmware that don't depend on cJSON: DHT decode and
+ *  read, certificates mapping.
+ */
+
+#include "bench.h"
+#include "dht_frames.h"
+
+extern "C" {
+#include "dht-decoder.h"
+#include "dht-manager.h"
+#include "storage-manager.h"
+}
+
+namespace {
+
+void bench_dht_decode() {
+
+    std::vector<dht_pulse_t> pulses = dht_frames::build_pulses(dht_frames::am2301_data(553, 225), 6);
+    uint8_t data[DHT_DATA_BYTES];
+
+    bench::report("dht_decode", bench::measure(20000, [&]() {
+        if (dht_decode_pulses(pulses.data(), pulses.size(), data) != DHT_DECODE_OK) {
+            abort();
+        }
+    }));
+}
+
+void bench_dht_read() {
+
+    std::vector<rmt_item32_t> frame = dht_frames::to_rmt_items(
+        dht_frames::build_pulses(dht_frames::am2301_data(553, 225), 6));
+    host_rmt_set_frame(RMT_CHANNEL_4, frame.data(), frame.size());
+
+    dht_reading_t reading;
+    // the RMT channel is set up on the first read
+    dht_manager_read(&reading);
+
+    bench::report("dht_read", bench::measure(2000, [&]() {
+        if (dht_manager_read(&reading) != ESP_OK) {
+            abort();
+        }
+    }));
+}
+
+void bench_certificates_map() {
+
+    const char *names[] = {"ca.pem", "client.pem", "client.key"};
+    size_t length;
+
+    // the first map parses the partition header
+    bench::report("certificates_map_cold", bench::measure(1, [&]() {
+        for (const char *name : names) {
+            storage_manager_map_blob(STORAGE_MANAGER_SECURITY_PARTITION, name, &length);
+        }
+    }, 1));
+
+    bench::report("certificates_map", bench::measure(20000, [&]() {
+        for (const char *name : names) {
+            if (storage_manager_map_blob(STORAGE_MANAGER_SECURITY_PARTITION, name, &length) == NULL) {
+                abort();
+            }
+        }
+    }));
+}
+
+}
+
+int main() {
+
+    host_log_set_level(ESP_LOG_WARN);
+    host_partition_load_file("security", HOST_FIXTURES_DIR "/security.bin");
+
+    bench_dht_decode();
+    bench_dht_read();
+    bench_certificates_map();
+
+    return 0;
+}
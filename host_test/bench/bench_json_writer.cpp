@@ -0,0 +1,90 @@
+/*
+ *  PMS message encoding with the json writer against the cJSON tree it
+ *  replaced. cJSON results are reported for reference only.
+ */
+
+#include <cstring>
+
+#include "bench.h"
+#include "data_sender_setup.h"
+
+extern "C" {
+#include "json-writer.h"
+#include "cJSON.h"
+}
+
+namespace {
+
+const char *DEVICE_ID = "7c5bbcaf-7772-4b82-ac7a-20707bfa8cd2";
+
+const char *TIMESTAMP = "2021-03-04T05:06:07.089Z";
+
+size_t encode_writer(const pollution_data_t &data, char *buffer, size_t size) {
+
+    json_writer_t writer;
+    json_writer_init(&writer, buffer, size);
+    json_writer_begin_object(&writer, NULL);
+    json_writer_add_string(&writer, "deviceId", DEVICE_ID);
+    json_writer_add_string(&writer, "timestamp", TIMESTAMP);
+    json_writer_add_number(&writer, "pm1.0", data.pm1_0);
+    json_writer_add_number(&writer, "pm2.5", data.pm2_5);
+    json_writer_add_number(&writer, "pm10", data.pm10);
+    json_writer_add_number(&writer, "particlesCount0.3", data.particles_03um);
+    json_writer_add_number(&writer, "particlesCount0.5", data.particles_05um);
+    json_writer_add_number(&writer, "particlesCount1.0", data.particles_10um);
+    json_writer_add_number(&writer, "particlesCount2.5", data.particles_25um);
+    json_writer_add_number(&writer, "particlesCount5.0", data.particles_50um);
+    json_writer_add_number(&writer, "particlesCount10.0", data.particles_100um);
+    json_writer_end_object(&writer);
+
+    const char *result = json_writer_finish(&writer);
+    return result != NULL ? writer.length : 0;
+}
+
+size_t encode_cjson(const pollution_data_t &data) {
+
+    cJSON *message = cJSON_CreateObject();
+    cJSON_AddItemToObject(message, "deviceId", cJSON_CreateString(DEVICE_ID));
+    cJSON_AddItemToObject(message, "timestamp", cJSON_CreateString(TIMESTAMP));
+    cJSON_AddItemToObject(message, "pm1.0", cJSON_CreateNumber(data.pm1_0));
+    cJSON_AddItemToObject(message, "pm2.5", cJSON_CreateNumber(data.pm2_5));
+    cJSON_AddItemToObject(message, "pm10", cJSON_CreateNumber(data.pm10));
+    cJSON_AddItemToObject(message, "particlesCount0.3", cJSON_CreateNumber(data.particles_03um));
+    cJSON_AddItemToObject(message, "particlesCount0.5", cJSON_CreateNumber(data.particles_05um));
+    cJSON_AddItemToObject(message, "particlesCount1.0", cJSON_CreateNumber(data.particles_10um));
+    cJSON_AddItemToObject(message, "particlesCount2.5", cJSON_CreateNumber(data.particles_25um));
+    cJSON_AddItemToObject(message, "particlesCount5.0", cJSON_CreateNumber(data.particles_50um));
+    cJSON_AddItemToObject(message, "particlesCount10.0", cJSON_CreateNumber(data.particles_100um));
+
+    char *payload = cJSON_PrintUnformatted(message);
+    size_t length = payload != NULL ? strlen(payload) : 0;
+
+    cJSON_Delete(message);
+    cJSON_free(payload);
+
+    return length;
+}
+
+}
+
+int main() {
+
+    host_log_set_level(ESP_LOG_WARN);
+
+    const pollution_data_t data = data_sender_setup::pms_sample(0, SAMPLE_CLOCK_NONE).pollution;
+    char buffer[384];
+
+    bench::report("pms_encode_writer", bench::measure(20000, [&]() {
+        if (encode_writer(data, buffer, sizeof(buffer)) == 0) {
+            abort();
+        }
+    }));
+
+    bench::report("pms_encode_cjson", bench::measure(20000, [&]() {
+        if (encode_cjson(data) == 0) {
+            abort();
+        }
+    }));
+
+    return 0;
+}
@@ -0,0 +1,60 @@
+/*
+ *  Telemetry throughput of the QoS 1 pipeline against a broker answering
+ *  after a fixed round trip, in virtual time: a backlog of samples goes
+ *  through the spool and the in-flight window. Built once per window size.
+ */
+
+#include <cstring>
+
+#include "bench.h"
+#include "data_sender_setup.h"
+
+namespace {
+
+// 2021-03-04T05:06:07.089Z
+const int64_t START_EPOCH_MS = 1614834367089LL;
+
+const uint32_t BROKER_ROUND_TRIP_MS = 100;
+
+const int SAMPLES = 240;
+
+}
+
+int main() {
+
+    host_log_set_level(ESP_LOG_WARN);
+
+    if (!data_sender_setup::load_partitions() || !data_sender_setup::start()) {
+        return 1;
+    }
+
+    host_mqtt_set_ack_delay(BROKER_ROUND_TRIP_MS);
+    host_mqtt_clear_sent();
+    host_heap_reset(esp_get_free_heap_size());
+    size_t heap_start = host_heap_get_in_use();
+
+    int64_t start_us = host_now_us();
+
+    for (int i = 0; i < SAMPLES; i++) {
+        telemetry_sample_t sample = data_sender_setup::pms_sample(START_EPOCH_MS + i * 1000LL, SAMPLE_CLOCK_EPOCH);
+        if (!data_sender_enqueue_sample(&sample)) {
+            return 1;
+        }
+    }
+
+    if (!data_sender_flush(SAMPLES * BROKER_ROUND_TRIP_MS * 2)) {
+        return 1;
+    }
+
+    double elapsed_s = (host_now_us() - start_us) / 1e6;
+
+    int messages = host_mqtt_count_sent("/telemetry/pollution");
+
+    bench::report("qos1_backlog", {
+        {"messages", (double) messages},
+        {"messagesPerSecond", messages / elapsed_s},
+        {"heapPeak", (double) (host_heap_get_peak() - heap_start)}
+    });
+
+    return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ *  Per message cost of the publish path. The firmware built with
+ *  TELEMETRY_PROFILING reports sample_encode and sample_publish itself,
+ *  its log is sent to stdout for compare.py. The message header, topic,
+ *  device id and timestamp, is also measured rendered for every message as
+ *  before the publish context and taken from it.
+ */
+
+#include <cstdio>
+#include <ctime>
+#include <unistd.h>
+
+#include "bench.h"
+#include "data_sender_setup.h"
+
+extern "C" {
+#include "json-writer.h"
+#include "time-manager.h"
+}
+
+namespace {
+
+// 2021-03-04T05:06:07.089Z
+const int64_t START_EPOCH_MS = 1614834367089LL;
+
+const int MESSAGES = 500;
+
+void render_timestamp(char *out, size_t size, int64_t epoch_ms) {
+
+    time_t seconds = epoch_ms / 1000;
+    struct tm timeinfo;
+    gmtime_r(&seconds, &timeinfo);
+
+    char date[32];
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", &timeinfo);
+    snprintf(out, size, "%s.%03dZ", date, (int) (epoch_ms % 1000));
+}
+
+void bench_message_header() {
+
+    const char *uid = device_helper_get_device_config()->uid;
+    char buffer[256];
+    char topic[80];
+    int64_t epoch_ms = START_EPOCH_MS;
+
+    bench::report("message_header_rendered", bench::measure(20000, [&]() {
+        snprintf(topic, sizeof(topic), "%s/telemetry/pollution", uid);
+
+        char timestamp[32];
+        render_timestamp(timestamp, sizeof(timestamp), epoch_ms += 1000);
+
+        json_writer_t writer;
+        json_writer_init(&writer, buffer, sizeof(buffer));
+        json_writer_begin_object(&writer, NULL);
+        json_writer_add_string(&writer, "deviceId", uid);
+        json_writer_add_string(&writer, "timestamp", timestamp);
+        json_writer_end_object(&writer);
+        if (json_writer_finish(&writer) == NULL) {
+            abort();
+        }
+    }));
+
+    // as data_sender_get_publish_context renders them once
+    char device_id_member[64];
+    snprintf(topic, sizeof(topic), "%s/telemetry/pollution", uid);
+    snprintf(device_id_member, sizeof(device_id_member), "\"deviceId\":\"%s\"", uid);
+    iso_timestamp_t iso_timestamp;
+    time_manager_init_iso_timestamp(&iso_timestamp);
+    epoch_ms = START_EPOCH_MS;
+
+    bench::report("message_header_cached", bench::measure(20000, [&]() {
+        json_writer_t writer;
+        json_writer_init(&writer, buffer, sizeof(buffer));
+        json_writer_begin_object(&writer, NULL);
+        json_writer_add_raw_member(&writer, device_id_member);
+        json_writer_add_string(&writer, "timestamp", time_manager_update_iso_timestamp(&iso_timestamp, epoch_ms += 1000));
+        json_writer_end_object(&writer);
+        if (json_writer_finish(&writer) == NULL || topic[0] == '\0') {
+            abort();
+        }
+    }));
+}
+
+void bench_sample_messages() {
+
+    // profiler lines are logged at info level
+    host_log_set_level(ESP_LOG_INFO);
+
+    for (int i = 0; i < MESSAGES; i++) {
+        telemetry_sample_t sample = data_sender_setup::float_sample(TEMPERATURE_SAMPLE, 21.5f, START_EPOCH_MS + i * 1000LL, SAMPLE_CLOCK_EPOCH);
+        data_sender_enqueue_sample(&sample);
+        host_settle();
+    }
+
+    host_log_set_level(ESP_LOG_WARN);
+}
+
+}
+
+int main() {
+
+    // the firmware logs on stderr
+    dup2(STDOUT_FILENO, STDERR_FILENO);
+    host_log_set_level(ESP_LOG_WARN);
+
+    if (!data_sender_setup::load_partitions() || !data_sender_setup::start()) {
+        return 1;
+    }
+
+    bench_message_header();
+    bench_sample_messages();
+
+    return 0;
+}
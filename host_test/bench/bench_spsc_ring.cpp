@@ -0,0 +1,84 @@
+/*
+ *  Hand-off of telemetry samples and gpio events: the SPSC ring against the
+ *  FreeRTOS queue it replaced, a send and a receive per operation. The ring
+ *  notifies its consumer task on every push as in data-sender. On the host
+ *  the queue pays the kernel lock of the simulator, standing for its
+ *  critical sections.
+ */
+
+#include "bench.h"
+
+extern "C" {
+#include "app-models.h"
+#include "spsc-ring.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+}
+
+namespace {
+
+// as data-sender and gpio-manager
+const uint32_t SAMPLES_LENGTH = 8;
+
+const uint32_t EVENTS_LENGTH = 32;
+
+TaskHandle_t consumer = NULL;
+
+void idle_consumer_task(void *args) {
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+template <typename T>
+void bench_ring(const char *path, uint32_t length, bool is_from_isr) {
+
+    static uint8_t storage[64 * sizeof(telemetry_sample_t)];
+    spsc_ring_t ring;
+    spsc_ring_init(&ring, storage, sizeof(T), length, SPSC_RING_DROP_NEWEST);
+    spsc_ring_set_consumer(&ring, consumer);
+
+    T item = {};
+    bench::report(path, bench::measure(200000, [&]() {
+        bool is_pushed = is_from_isr ? spsc_ring_push_from_isr(&ring, &item) : spsc_ring_push(&ring, &item);
+        if (!is_pushed || !spsc_ring_pop(&ring, &item)) {
+            abort();
+        }
+    }));
+}
+
+template <typename T>
+void bench_queue(const char *path, uint32_t length, bool is_from_isr) {
+
+    QueueHandle_t queue = xQueueCreate(length, sizeof(T));
+
+    T item = {};
+    bench::report(path, bench::measure(200000, [&]() {
+        BaseType_t is_sent = is_from_isr ? xQueueSendFromISR(queue, &item, NULL) : xQueueSend(queue, &item, 0);
+        if (is_sent != pdTRUE || xQueueReceive(queue, &item, 0) != pdTRUE) {
+            abort();
+        }
+    }));
+
+    vQueueDelete(queue);
+}
+
+}
+
+int main() {
+
+    host_log_set_level(ESP_LOG_WARN);
+
+    xTaskCreate(idle_consumer_task, "consumer", 2048, NULL, 5, &consumer);
+    host_settle();
+
+    bench_ring<telemetry_sample_t>("spsc_ring_sample", SAMPLES_LENGTH, false);
+    bench_queue<telemetry_sample_t>("xqueue_sample", SAMPLES_LENGTH, false);
+
+    bench_ring<uint8_t>("spsc_ring_gpio_event", EVENTS_LENGTH, true);
+    bench_queue<uint8_t>("xqueue_gpio_event", EVENTS_LENGTH, true);
+
+    return 0;
+}
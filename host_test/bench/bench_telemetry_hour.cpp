@@ -0,0 +1,79 @@
+/*
+ *  One hour of telemetry at the default read intervals, in virtual time:
+ *  MQTT messages and bytes on the wire per sample. Built once per
+ *  firmware variant, batched and not.
+ */
+
+#include <cstring>
+
+#include "bench.h"
+#include "data_sender_setup.h"
+
+namespace {
+
+// 2021-03-04T05:06:07.089Z
+const int64_t START_EPOCH_MS = 1614834367089LL;
+
+// TLS 1.2 record header, explicit nonce and tag of AES-GCM, added to each message
+const int TLS_RECORD_OVERHEAD = 29;
+
+const int HOUR_SECONDS = 3600;
+
+}
+
+int main() {
+
+    host_log_set_level(ESP_LOG_WARN);
+
+    if (!data_sender_setup::load_partitions() || !data_sender_setup::start()) {
+        return 1;
+    }
+
+    host_mqtt_clear_sent();
+
+    int samples = 0;
+    for (int second = 0; second < HOUR_SECONDS; second += CONFIG_DHT_READ_INTERVAL) {
+        int64_t timestamp = START_EPOCH_MS + second * 1000LL;
+        float offset = (second / CONFIG_DHT_READ_INTERVAL % 10) / 10.0f;
+
+        telemetry_sample_t temperature = data_sender_setup::float_sample(TEMPERATURE_SAMPLE, 21.4f + offset, timestamp, SAMPLE_CLOCK_EPOCH);
+        telemetry_sample_t humidity = data_sender_setup::float_sample(HUMIDITY_SAMPLE, 47.2f - offset, timestamp, SAMPLE_CLOCK_EPOCH);
+        data_sender_enqueue_sample(&temperature);
+        data_sender_enqueue_sample(&humidity);
+        samples += 2;
+
+        if (second % CONFIG_PMS_READ_INTERVAL == 0) {
+            telemetry_sample_t pollution = data_sender_setup::pms_sample(timestamp, SAMPLE_CLOCK_EPOCH);
+            pollution.pollution.pm2_5 += second / CONFIG_PMS_READ_INTERVAL;
+            data_sender_enqueue_sample(&pollution);
+            samples++;
+        }
+
+        host_run_for_ms(CONFIG_DHT_READ_INTERVAL * 1000);
+    }
+
+    // samples still batched are published
+    if (!data_sender_flush(10000)) {
+        return 1;
+    }
+
+    int messages = 0;
+    size_t wire_bytes = 0;
+    for (int i = 0; i < host_mqtt_get_sent_count(); i++) {
+        const host_mqtt_message_t *message = host_mqtt_get_sent(i);
+        if (strstr(message->topic, "/telemetry/") != NULL) {
+            messages++;
+            wire_bytes += message->wire_bytes;
+        }
+    }
+
+    bench::report("telemetry_hour", {
+        {"samples", (double) samples},
+        {"messages", (double) messages},
+        {"wireBytes", (double) wire_bytes},
+        {"wireBytesPerSample", (double) wire_bytes / samples},
+        {"tlsBytesPerSample", (double) (wire_bytes + messages * TLS_RECORD_OVERHEAD) / samples}
+    });
+
+    return 0;
+}
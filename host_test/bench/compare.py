@@ -0,0 +1,143 @@
+#!/usr/bin/env python
+#
+# Check benchmark results against stored baselines.
+#
+# Results are JSON lines {"path": name, metric: value, ...}, as printed by the
+# host benchmarks and by the firmware built with TELEMETRY_PROFILING, taken
+# from the output of a command or from a log file. Lines with the same path
+# are reduced to their median value.
+#
+# Baselines map path and metric to a value and a tolerance: a result above
+# value * (1 + tolerance) is a regression, a null tolerance only reports it.
+# Free heap and throughput metrics regress the other way, below value * (1 - tolerance).
+# Time measures get a loose tolerance, counts and sizes an exact one. Time of
+# single run measures, e.g. cold paths, is too noisy to be checked and only
+# reported.
+#
+# usage: compare.py <baselines.json> [--update] (--log <file> | -- <command>...)
+
+import json
+import subprocess
+import sys
+
+TIME_METRICS = ('ns', 'cycles', 'us')
+TIME_TOLERANCE = 2.0
+
+# metrics where a lower value is a regression
+HIGHER_IS_BETTER_METRICS = ('minHeap', 'messagesPerSecond')
+
+
+def parse_results(lines):
+    values = {}
+    for line in lines:
+        start = line.find('{"path":')
+        if start < 0:
+            continue
+        try:
+            record = json.loads(line[start:])
+        except ValueError:
+            continue
+        path = record.pop('path')
+        for metric, value in record.items():
+            if isinstance(value, (int, float)):
+                values.setdefault(path, {}).setdefault(metric, []).append(value)
+
+    results = {}
+    for path, metrics in values.items():
+        results[path] = {metric: sorted(samples)[len(samples) // 2] for metric, samples in metrics.items()}
+    return results
+
+
+def default_tolerance(metric):
+    return TIME_TOLERANCE if metric in TIME_METRICS else 0.0
+
+
+def update(baselines_path, baselines, results):
+    for path, metrics in results.items():
+        stored = baselines.setdefault(path, {})
+        for metric, value in metrics.items():
+            tolerance = stored[metric]['tolerance'] if metric in stored else default_tolerance(metric)
+            stored[metric] = {'value': value, 'tolerance': tolerance}
+
+    with open(baselines_path, 'w') as f:
+        json.dump(baselines, f, indent=2, sort_keys=True)
+        f.write('\n')
+
+
+def compare(baselines, results):
+    failures = 0
+    for path in sorted(baselines):
+        if path not in results:
+            print('%-32s missing from results' % path)
+            failures += 1
+            continue
+        for metric in sorted(baselines[path]):
+            baseline = baselines[path][metric]
+            value = results[path].get(metric)
+            if value is None:
+                print('%-32s %-12s missing from results' % (path, metric))
+                failures += 1
+                continue
+            tolerance = baseline['tolerance']
+            if tolerance is None:
+                status = 'info'
+                limit = '-'
+            else:
+                if metric in HIGHER_IS_BETTER_METRICS:
+                    limit_value = baseline['value'] * (1 - tolerance)
+                    is_ok = value >= limit_value - 1e-9
+                else:
+                    # a zero baseline allows no growth at all
+                    limit_value = baseline['value'] * (1 + tolerance)
+                    is_ok = value <= limit_value + 1e-9
+                status = 'ok' if is_ok else 'REGRESSION'
+                limit = '%.6g' % limit_value
+                failures += status != 'ok'
+            print('%-32s %-12s %12.6g  baseline %12.6g  limit %12s  %s' % (path, metric, value, baseline['value'], limit, status))
+    return failures
+
+
+def main():
+    args = sys.argv[1:]
+    if not args:
+        sys.exit('usage: compare.py <baselines.json> [--update] (--log <file> | -- <command>...)')
+
+    baselines_path = args.pop(0)
+    is_update = '--update' in args
+    if is_update:
+        args.remove('--update')
+
+    if args[:1] == ['--log'] and len(args) == 2:
+        with open(args[1]) as f:
+            lines = f.readlines()
+    elif args[:1] == ['--'] and len(args) > 1:
+        run = subprocess.run(args[1:], stdout=subprocess.PIPE, universal_newlines=True)
+        if run.returncode != 0:
+            sys.stdout.write(run.stdout)
+            sys.exit('benchmark failed with status %d' % run.returncode)
+        lines = run.stdout.splitlines()
+    else:
+        sys.exit('usage: compare.py <baselines.json> [--update] (--log <file> | -- <command>...)')
+
+    results = parse_results(lines)
+    if not results:
+        sys.exit('no results found')
+
+    try:
+        with open(baselines_path) as f:
+            baselines = json.load(f)
+    except IOError:
+        baselines = {}
+
+    if is_update:
+        update(baselines_path, baselines, results)
+        print('baselines updated: %s' % baselines_path)
+        return
+
+    failures = compare(baselines, results)
+    if failures:
+        sys.exit('%d regressions, see above. Run with --update to accept them.' % failures)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,116 @@
+#!/usr/bin/env python
+#
+# Generate the sdkconfig.h of a host build from the Kconfig files of the
+# project: every option takes its default value, or the one given on the
+# command line, and options whose dependencies are not met are left out,
+# as menuconfig would do.
+#
+# usage: kconfig_defaults.py <output header> <Kconfig>... [-- NAME=value...]
+
+import re
+import sys
+
+# defined by ESP-IDF components, not by the project Kconfig files
+IDF_OPTIONS = {
+    'FREERTOS_HZ': ('int', '100'),
+    'LOG_DEFAULT_LEVEL': ('int', '3'),
+}
+
+
+def parse(path, options):
+    current = None
+    with open(path) as f:
+        for line in f:
+            words = line.strip().split(None, 1)
+            if not words:
+                continue
+            keyword = words[0]
+            rest = words[1] if len(words) > 1 else ''
+            if keyword in ('config', 'menuconfig'):
+                current = {'name': rest, 'type': None, 'default': None, 'depends': []}
+                options[rest] = current
+            elif keyword in ('menu', 'endmenu', 'choice', 'endchoice', 'if', 'endif', 'comment'):
+                current = None
+            elif current is None:
+                continue
+            elif keyword in ('bool', 'int', 'hex', 'string'):
+                current['type'] = keyword
+            elif keyword == 'default' and current['default'] is None:
+                current['default'] = rest.split(' if ')[0].strip()
+            elif keyword == 'depends' and rest.startswith('on '):
+                current['depends'].append(rest[3:].strip())
+
+
+def evaluate(expression, values):
+    # only the operators used by the project Kconfig files
+    python = re.sub(r'[A-Z_][A-Z0-9_]*', lambda m: repr(values.get(m.group(0)) == 'y'), expression)
+    python = python.replace('&&', ' and ').replace('||', ' or ').replace('!', ' not ')
+    return eval(python)
+
+
+def resolve(options, overrides):
+    values = {}
+    # options are declared after the ones they depend on
+    for name, option in options.items():
+        value = overrides.get(name, option['default'])
+        if option['type'] == 'bool' and value is None:
+            value = 'n'
+        if not all(evaluate(expression, values) for expression in option['depends']):
+            value = 'n' if option['type'] == 'bool' else None
+        values[name] = value
+    return values
+
+
+def render(options, values):
+    lines = ['/* generated by kconfig_defaults.py, do not edit */', '#pragma once', '']
+    for name, (kind, value) in IDF_OPTIONS.items():
+        lines.append('#define CONFIG_%s %s' % (name, value))
+    for name, option in options.items():
+        value = values[name]
+        if value is None or value == 'n':
+            continue
+        if option['type'] == 'bool':
+            lines.append('#define CONFIG_%s 1' % name)
+        elif option['type'] == 'string':
+            lines.append('#define CONFIG_%s %s' % (name, value if value.startswith('"') else '"%s"' % value))
+        else:
+            lines.append('#define CONFIG_%s %s' % (name, value))
+    return '\n'.join(lines) + '\n'
+
+
+def main():
+    args = sys.argv[1:]
+    if '--' in args:
+        split = args.index('--')
+        args, assignments = args[:split], args[split + 1:]
+    else:
+        assignments = []
+
+    if len(args) < 2:
+        sys.exit('usage: kconfig_defaults.py <output header> <Kconfig>... [-- NAME=value...]')
+
+    options = {}
+    for path in args[1:]:
+        parse(path, options)
+
+    overrides = dict(assignment.split('=', 1) for assignment in assignments)
+    unknown = set(overrides) - set(options)
+    if unknown:
+        sys.exit('unknown options: %s' % ', '.join(sorted(unknown)))
+
+    header = render(options, resolve(options, overrides))
+
+    # rewritten only when changed, so that sources are not rebuilt needlessly
+    try:
+        with open(args[0]) as f:
+            if f.read() == header:
+                return
+    except IOError:
+        pass
+
+    with open(args[0], 'w') as f:
+        f.write(header)
+
+
+if __name__ == '__main__':
+    main()
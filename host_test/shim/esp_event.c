@@ -0,0 +1,153 @@
+/*
+ *  Default event loop: posts are copied to a queue and dispatched by the
+ *  "sys_evt" task to the handlers matching base and id.
+ */
+
+#include "esp_event.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#define EVENT_QUEUE_LENGTH 32
+
+#define EVENT_TASK_PRIORITY 20
+
+typedef struct event_handler {
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t handler;
+    void *arg;
+    struct event_handler *next;
+} event_handler_t;
+
+typedef struct {
+    esp_event_base_t base;
+    int32_t id;
+    void *data;
+} posted_event_t;
+
+static QueueHandle_t events_queue = NULL;
+
+static event_handler_t *handlers = NULL;
+
+static void esp_event_task(void *arg) {
+
+    posted_event_t event;
+
+    while (true) {
+
+        xQueueReceive(events_queue, &event, portMAX_DELAY);
+
+        for (event_handler_t *handler = handlers; handler != NULL; handler = handler->next) {
+            if ((handler->base == ESP_EVENT_ANY_BASE || handler->base == event.base) &&
+                (handler->id == ESP_EVENT_ANY_ID || handler->id == event.id)) {
+                handler->handler(handler->arg, event.base, event.id, event.data);
+            }
+        }
+
+        free(event.data);
+    }
+}
+
+esp_err_t esp_event_loop_create_default(void) {
+
+    if (events_queue != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    events_queue = xQueueCreate(EVENT_QUEUE_LENGTH, sizeof(posted_event_t));
+    if (events_queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    xTaskCreate(esp_event_task, "sys_evt", 2304, NULL, EVENT_TASK_PRIORITY, NULL);
+
+    return ESP_OK;
+}
+
+esp_err_t esp_event_loop_delete_default(void) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_event_handler_register(esp_event_base_t event_base, int32_t event_id,
+        esp_event_handler_t event_handler, void *event_handler_arg) {
+
+    event_handler_t *handler = malloc(sizeof(event_handler_t));
+    if (handler == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    *handler = (event_handler_t) {
+        .base = event_base,
+        .id = event_id,
+        .handler = event_handler,
+        .arg = event_handler_arg
+    };
+
+    // appended, handlers are called in registration order
+    event_handler_t **link = &handlers;
+    while (*link != NULL) {
+        link = &(*link)->next;
+    }
+    *link = handler;
+
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_unregister(esp_event_base_t event_base, int32_t event_id,
+        esp_event_handler_t event_handler) {
+
+    for (event_handler_t **link = &handlers; *link != NULL; link = &(*link)->next) {
+        event_handler_t *handler = *link;
+        if (handler->base == event_base && handler->id == event_id && handler->handler == event_handler) {
+            *link = handler->next;
+            free(handler);
+            return ESP_OK;
+        }
+    }
+
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t esp_event_handler_instance_register(esp_event_base_t event_base, int32_t event_id,
+        esp_event_handler_t event_handler, void *event_handler_arg, esp_event_handler_instance_t *instance) {
+
+    esp_err_t err = esp_event_handler_register(event_base, event_id, event_handler, event_handler_arg);
+    if (instance != NULL) {
+        *instance = (esp_event_handler_instance_t) event_handler;
+    }
+
+    return err;
+}
+
+esp_err_t esp_event_post(esp_event_base_t event_base, int32_t event_id,
+        const void *event_data, size_t event_data_size, uint32_t ticks_to_wait) {
+
+    if (events_queue == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    posted_event_t event = {
+        .base = event_base,
+        .id = event_id,
+        .data = NULL
+    };
+
+    if (event_data != NULL && event_data_size > 0) {
+        event.data = malloc(event_data_size);
+        if (event.data == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        memcpy(event.data, event_data, event_data_size);
+    }
+
+    if (xQueueSend(events_queue, &event, ticks_to_wait) != pdTRUE) {
+        free(event.data);
+        return ESP_ERR_TIMEOUT;
+    }
+
+    return ESP_OK;
+}
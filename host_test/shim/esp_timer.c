@@ -0,0 +1,176 @@
+/*
+ *  esp_timer: callbacks run on the "esp_timer" task of the highest priority,
+ *  one at a time and in deadline order, as ESP_TIMER_TASK dispatch does.
+ */
+
+#include "esp_timer.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "kernel.h"
+
+#define ESP_TIMER_TASK_PRIORITY 22
+
+struct host_esp_timer {
+    esp_timer_cb_t callback;
+    void *arg;
+    const char *name;
+    bool is_armed;
+    int64_t alarm;
+    uint64_t period;
+    struct host_esp_timer *next;
+};
+
+static struct host_esp_timer *timers = NULL;
+
+static bool is_task_started = false;
+
+// wait object of the timer task, woken when timers are armed
+static const char timers_changed = 0;
+
+static struct host_esp_timer *esp_timer_get_earliest(void) {
+
+    struct host_esp_timer *earliest = NULL;
+
+    for (struct host_esp_timer *timer = timers; timer != NULL; timer = timer->next) {
+        if (timer->is_armed && (earliest == NULL || timer->alarm < earliest->alarm)) {
+            earliest = timer;
+        }
+    }
+
+    return earliest;
+}
+
+static void esp_timer_task(void *arg) {
+
+    kernel_lock();
+
+    while (true) {
+
+        struct host_esp_timer *timer = esp_timer_get_earliest();
+
+        if (timer == NULL || timer->alarm > kernel_now()) {
+            kernel_wait(&timers_changed, timer == NULL ? KERNEL_FOREVER : timer->alarm);
+            continue;
+        }
+
+        if (timer->period > 0) {
+            timer->alarm += timer->period;
+        } else {
+            timer->is_armed = false;
+        }
+
+        // callbacks may start and stop timers
+        kernel_unlock();
+        timer->callback(timer->arg);
+        kernel_lock();
+    }
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle) {
+
+    if (create_args == NULL || create_args->callback == NULL || out_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct host_esp_timer *timer = malloc(sizeof(struct host_esp_timer));
+    if (timer == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    kernel_lock();
+    *timer = (struct host_esp_timer) {
+        .callback = create_args->callback,
+        .arg = create_args->arg,
+        .name = create_args->name,
+        .next = timers
+    };
+    timers = timer;
+    bool is_task_needed = !is_task_started;
+    is_task_started = true;
+    kernel_unlock();
+
+    if (is_task_needed) {
+        xTaskCreate(esp_timer_task, "esp_timer", 3584, NULL, ESP_TIMER_TASK_PRIORITY, NULL);
+    }
+
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+static esp_err_t esp_timer_start(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period) {
+
+    kernel_lock();
+
+    esp_err_t err = ESP_OK;
+    if (timer->is_armed) {
+        err = ESP_ERR_INVALID_STATE;
+    } else {
+        timer->is_armed = true;
+        timer->alarm = kernel_now() + timeout_us;
+        timer->period = period;
+        kernel_wake_all(&timers_changed);
+    }
+
+    kernel_unlock();
+
+    return err;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    return esp_timer_start(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period) {
+    return esp_timer_start(timer, period, period);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+
+    kernel_lock();
+    esp_err_t err = timer->is_armed ? ESP_OK : ESP_ERR_INVALID_STATE;
+    timer->is_armed = false;
+    kernel_unlock();
+
+    return err;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+
+    kernel_lock();
+
+    if (timer->is_armed) {
+        kernel_unlock();
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    for (struct host_esp_timer **link = &timers; *link != NULL; link = &(*link)->next) {
+        if (*link == timer) {
+            *link = timer->next;
+            break;
+        }
+    }
+
+    kernel_unlock();
+
+    free(timer);
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer) {
+
+    kernel_lock();
+    bool is_armed = timer->is_armed;
+    kernel_unlock();
+
+    return is_armed;
+}
+
+int64_t esp_timer_get_time(void) {
+
+    kernel_lock();
+    int64_t time = kernel_now() - kernel_boot_time();
+    kernel_unlock();
+
+    return time;
+}
@@ -0,0 +1,422 @@
+/*
+ *  Queues, semaphores, event groups and ring buffers over the host kernel.
+ *  Waiters block on the object and check their condition again once woken.
+ */
+
+#include "kernel.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "freertos/ringbuf.h"
+
+struct host_queue {
+    uint8_t *items;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t count;
+    UBaseType_t head;
+    // semaphores are queues of empty items, a mutex remembers its holder
+    bool is_mutex;
+    TaskHandle_t holder;
+};
+
+struct host_event_group {
+    EventBits_t bits;
+};
+
+typedef struct ringbuf_item {
+    size_t size;
+    struct ringbuf_item *next;
+    uint8_t data[];
+} ringbuf_item_t;
+
+struct host_ringbuf {
+    size_t size;
+    size_t used;
+    ringbuf_item_t *first;
+    ringbuf_item_t *last;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+
+    if (length == 0) {
+        return NULL;
+    }
+
+    // one allocation like xQueueGenericCreate
+    struct host_queue *queue = malloc(sizeof(struct host_queue) + length * item_size);
+    if (queue == NULL) {
+        return NULL;
+    }
+
+    *queue = (struct host_queue) {
+        .items = (uint8_t *) (queue + 1),
+        .length = length,
+        .item_size = item_size
+    };
+
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    free(queue);
+}
+
+static uint8_t *queue_slot(QueueHandle_t queue, UBaseType_t index) {
+    return queue->items + (index % queue->length) * queue->item_size;
+}
+
+static BaseType_t queue_send(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait, bool is_front, bool is_overwrite) {
+
+    kernel_lock();
+
+    int64_t deadline = kernel_deadline_from_ticks(ticks_to_wait);
+    bool is_sent = false;
+
+    while (true) {
+
+        if (queue->count < queue->length || is_overwrite) {
+
+            UBaseType_t index;
+            if (is_overwrite && queue->count == queue->length) {
+                index = queue->head + queue->count - 1;
+            } else if (is_front) {
+                queue->head = (queue->head + queue->length - 1) % queue->length;
+                index = queue->head;
+                queue->count++;
+            } else {
+                index = queue->head + queue->count;
+                queue->count++;
+            }
+
+            if (queue->item_size > 0) {
+                memcpy(queue_slot(queue, index), item, queue->item_size);
+            }
+
+            if (queue->is_mutex) {
+                queue->holder = NULL;
+            }
+
+            kernel_wake_all(queue);
+            is_sent = true;
+            break;
+        }
+
+        if (ticks_to_wait == 0 || !kernel_wait(queue, deadline)) {
+            // a slot may have been freed at the deadline
+            if (queue->count == queue->length || ticks_to_wait == 0) {
+                break;
+            }
+        }
+    }
+
+    kernel_unlock();
+
+    return is_sent ? pdTRUE : errQUEUE_FULL;
+}
+
+static BaseType_t queue_receive(QueueHandle_t queue, void *item, TickType_t ticks_to_wait, bool is_peek) {
+
+    kernel_lock();
+
+    int64_t deadline = kernel_deadline_from_ticks(ticks_to_wait);
+    bool is_received = false;
+
+    while (true) {
+
+        if (queue->count > 0) {
+
+            if (queue->item_size > 0) {
+                memcpy(item, queue_slot(queue, queue->head), queue->item_size);
+            }
+
+            if (!is_peek) {
+                queue->head = (queue->head + 1) % queue->length;
+                queue->count--;
+                if (queue->is_mutex) {
+                    queue->holder = kernel_self();
+                }
+                kernel_wake_all(queue);
+            }
+
+            is_received = true;
+            break;
+        }
+
+        if (ticks_to_wait == 0 || !kernel_wait(queue, deadline)) {
+            if (queue->count == 0 || ticks_to_wait == 0) {
+                break;
+            }
+        }
+    }
+
+    kernel_unlock();
+
+    return is_received ? pdTRUE : errQUEUE_EMPTY;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait) {
+    return queue_send(queue, item, ticks_to_wait, false, false);
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait) {
+    return queue_send(queue, item, ticks_to_wait, false, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait) {
+    return queue_send(queue, item, ticks_to_wait, true, false);
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *higher_priority_task_woken) {
+    return queue_send(queue, item, 0, false, false);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item) {
+    return queue_send(queue, item, 0, false, true);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks_to_wait) {
+    return queue_receive(queue, item, ticks_to_wait, false);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t ticks_to_wait) {
+    return queue_receive(queue, item, ticks_to_wait, true);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+
+    kernel_lock();
+    UBaseType_t count = queue->count;
+    kernel_unlock();
+
+    return count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+
+    kernel_lock();
+    UBaseType_t spaces = queue->length - queue->count;
+    kernel_unlock();
+
+    return spaces;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+
+    kernel_lock();
+    queue->head = 0;
+    queue->count = 0;
+    kernel_wake_all(queue);
+    kernel_unlock();
+
+    return pdPASS;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+
+    SemaphoreHandle_t mutex = xQueueCreate(1, 0);
+    if (mutex != NULL) {
+        mutex->is_mutex = true;
+        mutex->count = 1;
+    }
+
+    return mutex;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return xQueueCreate(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count) {
+
+    SemaphoreHandle_t semaphore = xQueueCreate(max_count, 0);
+    if (semaphore != NULL) {
+        semaphore->count = initial_count;
+    }
+
+    return semaphore;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait) {
+    return queue_receive(semaphore, NULL, ticks_to_wait, false);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    return queue_send(semaphore, NULL, 0, false, false);
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t *higher_priority_task_woken) {
+    return queue_send(semaphore, NULL, 0, false, false);
+}
+
+EventGroupHandle_t xEventGroupCreate(void) {
+
+    struct host_event_group *event_group = malloc(sizeof(struct host_event_group));
+    if (event_group != NULL) {
+        event_group->bits = 0;
+    }
+
+    return event_group;
+}
+
+void vEventGroupDelete(EventGroupHandle_t event_group) {
+    free(event_group);
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t event_group, const EventBits_t bits) {
+
+    kernel_lock();
+    event_group->bits |= bits;
+    EventBits_t value = event_group->bits;
+    kernel_wake_all(event_group);
+    kernel_unlock();
+
+    return value;
+}
+
+BaseType_t xEventGroupSetBitsFromISR(EventGroupHandle_t event_group, const EventBits_t bits, BaseType_t *higher_priority_task_woken) {
+
+    xEventGroupSetBits(event_group, bits);
+    return pdPASS;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t event_group, const EventBits_t bits) {
+
+    kernel_lock();
+    EventBits_t value = event_group->bits;
+    event_group->bits &= ~bits;
+    kernel_unlock();
+
+    return value;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t event_group) {
+
+    kernel_lock();
+    EventBits_t value = event_group->bits;
+    kernel_unlock();
+
+    return value;
+}
+
+static bool event_group_is_satisfied(EventBits_t value, EventBits_t bits, BaseType_t wait_for_all) {
+    return wait_for_all ? (value & bits) == bits : (value & bits) != 0;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t event_group, const EventBits_t bits,
+        const BaseType_t clear_on_exit, const BaseType_t wait_for_all, TickType_t ticks_to_wait) {
+
+    kernel_lock();
+
+    int64_t deadline = kernel_deadline_from_ticks(ticks_to_wait);
+
+    while (!event_group_is_satisfied(event_group->bits, bits, wait_for_all) && ticks_to_wait > 0) {
+        if (!kernel_wait(event_group, deadline)) {
+            break;
+        }
+    }
+
+    EventBits_t value = event_group->bits;
+    if (clear_on_exit && event_group_is_satisfied(value, bits, wait_for_all)) {
+        event_group->bits &= ~bits;
+    }
+
+    kernel_unlock();
+
+    return value;
+}
+
+RingbufHandle_t xRingbufferCreate(size_t size, RingbufferType_t type) {
+
+    struct host_ringbuf *ringbuf = malloc(sizeof(struct host_ringbuf));
+    if (ringbuf != NULL) {
+        *ringbuf = (struct host_ringbuf) { .size = size };
+    }
+
+    return ringbuf;
+}
+
+void vRingbufferDelete(RingbufHandle_t ringbuf) {
+
+    while (ringbuf->first != NULL) {
+        ringbuf_item_t *item = ringbuf->first;
+        ringbuf->first = item->next;
+        host_free(item);
+    }
+
+    free(ringbuf);
+}
+
+BaseType_t xRingbufferSend(RingbufHandle_t ringbuf, const void *data, size_t item_size, TickType_t ticks_to_wait) {
+
+    kernel_lock();
+
+    // items are 4 bytes aligned and carry an 8 bytes header on the target
+    size_t charge = ((item_size + 3) & ~3) + 8;
+    bool is_sent = ringbuf->used + charge <= ringbuf->size;
+
+    if (is_sent) {
+        ringbuf_item_t *item = host_alloc(sizeof(ringbuf_item_t) + item_size);
+        item->size = item_size;
+        item->next = NULL;
+        memcpy(item->data, data, item_size);
+
+        if (ringbuf->last != NULL) {
+            ringbuf->last->next = item;
+        } else {
+            ringbuf->first = item;
+        }
+        ringbuf->last = item;
+        ringbuf->used += charge;
+
+        kernel_wake_all(ringbuf);
+    }
+
+    kernel_unlock();
+
+    return is_sent ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xRingbufferSendFromISR(RingbufHandle_t ringbuf, const void *data, size_t item_size, BaseType_t *higher_priority_task_woken) {
+    return xRingbufferSend(ringbuf, data, item_size, 0);
+}
+
+void *xRingbufferReceive(RingbufHandle_t ringbuf, size_t *item_size, TickType_t ticks_to_wait) {
+
+    kernel_lock();
+
+    int64_t deadline = kernel_deadline_from_ticks(ticks_to_wait);
+
+    while (ringbuf->first == NULL && ticks_to_wait > 0) {
+        if (!kernel_wait(ringbuf, deadline)) {
+            break;
+        }
+    }
+
+    ringbuf_item_t *item = ringbuf->first;
+    if (item != NULL) {
+        ringbuf->first = item->next;
+        if (ringbuf->first == NULL) {
+            ringbuf->last = NULL;
+        }
+        *item_size = item->size;
+    }
+
+    kernel_unlock();
+
+    return item != NULL ? item->data : NULL;
+}
+
+void vRingbufferReturnItem(RingbufHandle_t ringbuf, void *data) {
+
+    ringbuf_item_t *item = (ringbuf_item_t *) ((uint8_t *) data - offsetof(ringbuf_item_t, data));
+
+    kernel_lock();
+    ringbuf->used -= ((item->size + 3) & ~3) + 8;
+    kernel_unlock();
+
+    host_free(item);
+}
@@ -0,0 +1,224 @@
+/*
+ *  Pads driven by the tests. Inputs read the level set with
+ *  host_gpio_set_input, or the pull resistor level until set; outputs keep
+ *  the last level written. ISR handlers run in the caller of
+ *  host_gpio_set_input, as interrupts preempt the running task; only one
+ *  task runs at a time so pads need no locking.
+ */
+
+#include "driver/gpio.h"
+
+#include "host.h"
+
+typedef struct {
+    gpio_mode_t mode;
+    gpio_pull_mode_t pull;
+    gpio_int_type_t intr_type;
+    gpio_isr_t isr_handler;
+    void *isr_args;
+    bool has_input_level;
+    int input_level;
+    int output_level;
+} gpio_pad_t;
+
+static gpio_pad_t pads[GPIO_NUM_MAX];
+
+static bool is_isr_service_installed = false;
+
+static bool gpio_is_valid(gpio_num_t gpio_num) {
+    return gpio_num >= 0 && gpio_num < GPIO_NUM_MAX;
+}
+
+esp_err_t gpio_config(const gpio_config_t *config) {
+
+    for (int i = 0; i < GPIO_NUM_MAX; i++) {
+        if (config->pin_bit_mask & (1ULL << i)) {
+            pads[i].mode = config->mode;
+            pads[i].pull = config->pull_up_en ? GPIO_PULLUP_ONLY :
+                config->pull_down_en ? GPIO_PULLDOWN_ONLY : GPIO_FLOATING;
+            pads[i].intr_type = config->intr_type;
+        }
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num) {
+
+    if (!gpio_is_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pads[gpio_num].mode = GPIO_MODE_DISABLE;
+    pads[gpio_num].pull = GPIO_PULLUP_ONLY;
+    pads[gpio_num].intr_type = GPIO_INTR_DISABLE;
+
+    return ESP_OK;
+}
+
+void gpio_pad_select_gpio(uint32_t gpio_num) {
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode) {
+
+    if (!gpio_is_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pads[gpio_num].mode = mode;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_pull_mode(gpio_num_t gpio_num, gpio_pull_mode_t pull) {
+
+    if (!gpio_is_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pads[gpio_num].pull = pull;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type) {
+
+    if (!gpio_is_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pads[gpio_num].intr_type = intr_type;
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags) {
+
+    if (is_isr_service_installed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    is_isr_service_installed = true;
+    return ESP_OK;
+}
+
+void gpio_uninstall_isr_service(void) {
+    is_isr_service_installed = false;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args) {
+
+    if (!is_isr_service_installed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (!gpio_is_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pads[gpio_num].isr_handler = isr_handler;
+    pads[gpio_num].isr_args = args;
+
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num) {
+
+    if (!gpio_is_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pads[gpio_num].isr_handler = NULL;
+    return ESP_OK;
+}
+
+static int gpio_get_input_level(const gpio_pad_t *pad) {
+
+    if (pad->has_input_level) {
+        return pad->input_level;
+    }
+
+    // pads are pulled up after reset
+    return pad->pull == GPIO_PULLUP_ONLY || pad->pull == GPIO_PULLUP_PULLDOWN ? 1 : 0;
+}
+
+int gpio_get_level(gpio_num_t gpio_num) {
+
+    if (!gpio_is_valid(gpio_num)) {
+        return 0;
+    }
+
+    const gpio_pad_t *pad = &pads[gpio_num];
+    if (pad->mode == GPIO_MODE_OUTPUT) {
+        return pad->output_level;
+    }
+
+    // an open drain line driven low reads low
+    if ((pad->mode == GPIO_MODE_INPUT_OUTPUT_OD || pad->mode == GPIO_MODE_OUTPUT_OD) && pad->output_level == 0) {
+        return 0;
+    }
+
+    return gpio_get_input_level(pad);
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level) {
+
+    if (!gpio_is_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pads[gpio_num].output_level = level != 0;
+    return ESP_OK;
+}
+
+esp_err_t gpio_hold_en(gpio_num_t gpio_num) {
+    return gpio_is_valid(gpio_num) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_hold_dis(gpio_num_t gpio_num) {
+    return gpio_is_valid(gpio_num) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+void gpio_deep_sleep_hold_en(void) {
+}
+
+void gpio_deep_sleep_hold_dis(void) {
+}
+
+static bool gpio_is_interrupt(gpio_int_type_t intr_type, int previous_level, int level) {
+
+    switch (intr_type) {
+        case GPIO_INTR_POSEDGE:
+            return previous_level == 0 && level == 1;
+        case GPIO_INTR_NEGEDGE:
+            return previous_level == 1 && level == 0;
+        case GPIO_INTR_ANYEDGE:
+            return previous_level != level;
+        case GPIO_INTR_LOW_LEVEL:
+            return level == 0;
+        case GPIO_INTR_HIGH_LEVEL:
+            return level == 1;
+        default:
+            return false;
+    }
+}
+
+void host_gpio_set_input(gpio_num_t gpio_num, int level) {
+
+    gpio_pad_t *pad = &pads[gpio_num];
+    level = level != 0;
+
+    int previous_level = gpio_get_input_level(pad);
+    pad->input_level = level;
+    pad->has_input_level = true;
+
+    if (is_isr_service_installed && pad->isr_handler != NULL &&
+        gpio_is_interrupt(pad->intr_type, previous_level, level)) {
+        pad->isr_handler(pad->isr_args);
+    }
+}
+
+int host_gpio_get_output(gpio_num_t gpio_num) {
+    return pads[gpio_num].output_level;
+}
+
+gpio_mode_t host_gpio_get_direction(gpio_num_t gpio_num) {
+    return pads[gpio_num].mode;
+}
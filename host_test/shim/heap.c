@@ -0,0 +1,211 @@
+/*
+ *  Simulated heap. The host build links with --wrap=malloc,calloc,realloc,free
+ *  so that allocations made by the firmware, the shims and the tests are
+ *  charged to a heap of the ESP32 size and fail when it's exhausted. Each
+ *  block carries a header with its size, blocks of libraries not linked with
+ *  the wrappers are released without accounting.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_system.h"
+#include "kernel.h"
+#include "host.h"
+
+// free heap of the firmware once WiFi is started
+#define HEAP_DEFAULT_SIZE (180 * 1024)
+
+#define HEAP_MAGIC 0x48454150424c4f43ULL
+
+// multi_heap block overhead
+#define HEAP_BLOCK_OVERHEAD 8
+
+typedef struct {
+    uint64_t magic;
+    uint64_t size;
+} heap_header_t;
+
+void *__real_malloc(size_t size);
+
+void __real_free(void *ptr);
+
+void *__real_realloc(void *ptr, size_t size);
+
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static size_t heap_size = HEAP_DEFAULT_SIZE;
+
+static size_t in_use = 0;
+
+static size_t peak = 0;
+
+static size_t allocations = 0;
+
+static size_t heap_charge(size_t size) {
+    return ((size + 3) & ~3) + HEAP_BLOCK_OVERHEAD;
+}
+
+static bool heap_reserve(size_t size) {
+
+    pthread_mutex_lock(&heap_lock);
+
+    size_t charge = heap_charge(size);
+    bool is_available = in_use + charge <= heap_size;
+    if (is_available) {
+        in_use += charge;
+        allocations++;
+        if (in_use > peak) {
+            peak = in_use;
+        }
+    }
+
+    pthread_mutex_unlock(&heap_lock);
+
+    return is_available;
+}
+
+static void heap_release(size_t size) {
+
+    pthread_mutex_lock(&heap_lock);
+    in_use -= heap_charge(size);
+    pthread_mutex_unlock(&heap_lock);
+}
+
+static heap_header_t *heap_get_header(void *ptr) {
+
+    heap_header_t *header = (heap_header_t *) ptr - 1;
+    return header->magic == HEAP_MAGIC ? header : NULL;
+}
+
+void *__wrap_malloc(size_t size) {
+
+    if (!heap_reserve(size)) {
+        return NULL;
+    }
+
+    heap_header_t *header = __real_malloc(sizeof(heap_header_t) + size);
+    if (header == NULL) {
+        heap_release(size);
+        return NULL;
+    }
+
+    header->magic = HEAP_MAGIC;
+    header->size = size;
+
+    return header + 1;
+}
+
+void __wrap_free(void *ptr) {
+
+    if (ptr == NULL) {
+        return;
+    }
+
+    heap_header_t *header = heap_get_header(ptr);
+    if (header == NULL) {
+        __real_free(ptr);
+        return;
+    }
+
+    heap_release(header->size);
+    header->magic = 0;
+    __real_free(header);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+
+    if (size != 0 && count > SIZE_MAX / size) {
+        return NULL;
+    }
+
+    void *ptr = __wrap_malloc(count * size);
+    if (ptr != NULL) {
+        memset(ptr, 0, count * size);
+    }
+
+    return ptr;
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+
+    if (ptr == NULL) {
+        return __wrap_malloc(size);
+    }
+
+    heap_header_t *header = heap_get_header(ptr);
+    if (header == NULL) {
+        return __real_realloc(ptr, size);
+    }
+
+    void *moved = __wrap_malloc(size);
+    if (moved != NULL) {
+        memcpy(moved, ptr, header->size < size ? header->size : size);
+        __wrap_free(ptr);
+    }
+
+    return moved;
+}
+
+void *host_alloc(size_t size) {
+
+    void *ptr = __real_malloc(size);
+    if (ptr == NULL) {
+        abort();
+    }
+
+    return ptr;
+}
+
+void host_free(void *ptr) {
+    __real_free(ptr);
+}
+
+char *host_strdup(const char *s) {
+
+    size_t length = strlen(s) + 1;
+    char *copy = host_alloc(length);
+    memcpy(copy, s, length);
+
+    return copy;
+}
+
+uint32_t esp_get_free_heap_size(void) {
+
+    pthread_mutex_lock(&heap_lock);
+    uint32_t free_size = heap_size - in_use;
+    pthread_mutex_unlock(&heap_lock);
+
+    return free_size;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void) {
+
+    pthread_mutex_lock(&heap_lock);
+    uint32_t minimum = heap_size - peak;
+    pthread_mutex_unlock(&heap_lock);
+
+    return minimum;
+}
+
+void host_heap_reset(size_t free_size) {
+
+    pthread_mutex_lock(&heap_lock);
+    // blocks still allocated stay charged
+    heap_size = free_size + in_use;
+    peak = in_use;
+    allocations = 0;
+    pthread_mutex_unlock(&heap_lock);
+}
+
+size_t host_heap_get_allocations(void) {
+    return allocations;
+}
+
+size_t host_heap_get_in_use(void) {
+    return in_use;
+}
+
+size_t host_heap_get_peak(void) {
+    return peak;
+}
@@ -0,0 +1,274 @@
+/*
+ *  esp_http_client answered by a handler of the test, the server stand-in.
+ *  A request is handed over on esp_http_client_open with the headers set so
+ *  far; the response body is read from the buffer the handler points to.
+ */
+
+#include "esp_http_client.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "host.h"
+#include "kernel.h"
+
+typedef struct {
+    char *key;
+    char *value;
+} http_header_t;
+
+struct esp_http_client {
+    char *url;
+    esp_http_client_method_t method;
+    http_event_handle_cb event_handler;
+    void *user_data;
+    http_header_t headers[HOST_HTTP_MAX_HEADERS];
+    int headers_count;
+    bool is_open;
+    host_http_response_t response;
+    size_t read_offset;
+};
+
+static host_http_handler_f http_handler = NULL;
+
+static void *http_handler_context = NULL;
+
+static int requests_count = 0;
+
+static const char *http_method_name(esp_http_client_method_t method) {
+
+    static const char *names[] = { "GET", "POST", "PUT", "PATCH", "DELETE", "HEAD" };
+    return method <= HTTP_METHOD_HEAD ? names[method] : "GET";
+}
+
+static void http_dispatch(esp_http_client_handle_t client, esp_http_client_event_id_t event_id,
+        char *header_key, char *header_value) {
+
+    if (client->event_handler == NULL) {
+        return;
+    }
+
+    esp_http_client_event_t event = {
+        .event_id = event_id,
+        .client = client,
+        .user_data = client->user_data,
+        .header_key = header_key,
+        .header_value = header_value
+    };
+
+    client->event_handler(&event);
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config) {
+
+    if (config->url == NULL) {
+        return NULL;
+    }
+
+    esp_http_client_handle_t client = calloc(1, sizeof(struct esp_http_client));
+    if (client == NULL) {
+        return NULL;
+    }
+
+    client->url = host_strdup(config->url);
+    client->method = config->method;
+    client->event_handler = config->event_handler;
+    client->user_data = config->user_data;
+
+    return client;
+}
+
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t client, const char *url) {
+
+    host_free(client->url);
+    client->url = host_strdup(url);
+
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value) {
+
+    for (int i = 0; i < client->headers_count; i++) {
+        if (strcasecmp(client->headers[i].key, key) == 0) {
+            host_free(client->headers[i].value);
+            client->headers[i].value = host_strdup(value);
+            return ESP_OK;
+        }
+    }
+
+    if (client->headers_count == HOST_HTTP_MAX_HEADERS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    client->headers[client->headers_count++] = (http_header_t) {
+        .key = host_strdup(key),
+        .value = host_strdup(value)
+    };
+
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_delete_header(esp_http_client_handle_t client, const char *key) {
+
+    for (int i = 0; i < client->headers_count; i++) {
+        if (strcasecmp(client->headers[i].key, key) == 0) {
+            host_free(client->headers[i].key);
+            host_free(client->headers[i].value);
+            client->headers[i] = client->headers[--client->headers_count];
+            return ESP_OK;
+        }
+    }
+
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len) {
+
+    host_http_request_t request = {
+        .method = http_method_name(client->method),
+        .url = client->url,
+        .headers_count = client->headers_count
+    };
+
+    for (int i = 0; i < client->headers_count; i++) {
+        request.header_keys[i] = client->headers[i].key;
+        request.header_values[i] = client->headers[i].value;
+    }
+
+    memset(&client->response, 0, sizeof(client->response));
+    client->response.fail_after = -1;
+    client->read_offset = 0;
+    requests_count++;
+
+    if (http_handler != NULL) {
+        http_handler(http_handler_context, &request, &client->response);
+    }
+
+    if (client->response.status == 0) {
+        http_dispatch(client, HTTP_EVENT_ERROR, NULL, NULL);
+        return ESP_ERR_HTTP_CONNECT;
+    }
+
+    client->is_open = true;
+    http_dispatch(client, HTTP_EVENT_ON_CONNECTED, NULL, NULL);
+    http_dispatch(client, HTTP_EVENT_HEADERS_SENT, NULL, NULL);
+
+    return ESP_OK;
+}
+
+int esp_http_client_fetch_headers(esp_http_client_handle_t client) {
+
+    if (!client->is_open) {
+        return ESP_FAIL;
+    }
+
+    host_http_response_t *response = &client->response;
+    for (int i = 0; i < response->headers_count; i++) {
+        http_dispatch(client, HTTP_EVENT_ON_HEADER, response->header_keys[i], response->header_values[i]);
+    }
+
+    return response->body_length;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client) {
+    return client->response.status;
+}
+
+int esp_http_client_get_content_length(esp_http_client_handle_t client) {
+    return client->response.body_length;
+}
+
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len) {
+
+    if (!client->is_open) {
+        return -1;
+    }
+
+    host_http_response_t *response = &client->response;
+    size_t available = response->body_length - client->read_offset;
+
+    // the connection drops once fail_after bytes went through
+    if (response->fail_after >= 0) {
+        if (client->read_offset >= (size_t) response->fail_after) {
+            return -1;
+        }
+        if (available > response->fail_after - client->read_offset) {
+            available = response->fail_after - client->read_offset;
+        }
+    }
+
+    size_t length = (size_t) len < available ? (size_t) len : available;
+    memcpy(buffer, response->body + client->read_offset, length);
+    client->read_offset += length;
+
+    if (length > 0) {
+        http_dispatch(client, HTTP_EVENT_ON_DATA, NULL, NULL);
+    }
+
+    return length;
+}
+
+bool esp_http_client_is_complete_data_received(esp_http_client_handle_t client) {
+    return client->read_offset == client->response.body_length;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client) {
+
+    if (client->is_open) {
+        client->is_open = false;
+        http_dispatch(client, HTTP_EVENT_ON_FINISH, NULL, NULL);
+        http_dispatch(client, HTTP_EVENT_DISCONNECTED, NULL, NULL);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client) {
+
+    if (client == NULL) {
+        return ESP_FAIL;
+    }
+
+    esp_http_client_close(client);
+
+    for (int i = 0; i < client->headers_count; i++) {
+        host_free(client->headers[i].key);
+        host_free(client->headers[i].value);
+    }
+
+    host_free(client->url);
+    free(client);
+
+    return ESP_OK;
+}
+
+void host_http_set_handler(host_http_handler_f handler, void *context) {
+
+    http_handler = handler;
+    http_handler_context = context;
+    requests_count = 0;
+}
+
+const char *host_http_get_header(const host_http_request_t *request, const char *key) {
+
+    for (int i = 0; i < request->headers_count; i++) {
+        if (strcasecmp(request->header_keys[i], key) == 0) {
+            return request->header_values[i];
+        }
+    }
+
+    return NULL;
+}
+
+void host_http_add_header(host_http_response_t *response, const char *key, const char *value) {
+
+    if (response->headers_count < HOST_HTTP_MAX_HEADERS) {
+        strlcpy(response->header_keys[response->headers_count], key, sizeof(response->header_keys[0]));
+        strlcpy(response->header_values[response->headers_count], value, sizeof(response->header_values[0]));
+        response->headers_count++;
+    }
+}
+
+int host_http_get_requests_count(void) {
+    return requests_count;
+}
@@ -0,0 +1,34 @@
+#ifndef HOST_ESP_APP_FORMAT_H_
+#define HOST_ESP_APP_FORMAT_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ESP_IMAGE_HEADER_MAGIC 0xE9
+
+#define ESP_APP_DESC_MAGIC_WORD 0xABCD5432
+
+/**
+ * Application description, the first 256 bytes of the first image segment
+ */
+typedef struct {
+    uint32_t magic_word;
+    uint32_t secure_version;
+    uint32_t reserv1[2];
+    char version[32];
+    char project_name[32];
+    char time[16];
+    char date[16];
+    char idf_ver[32];
+    uint8_t app_elf_sha256[32];
+    uint32_t reserv2[20];
+} esp_app_desc_t;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef HOST_ESP_ATTR_H_
+#define HOST_ESP_ATTR_H_
+
+#include "esp_bit_defs.h"
+
+// memory placement has no meaning on the host, RTC data survives a simulated deep sleep as any static
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define RTC_FAST_ATTR
+#define RTC_SLOW_ATTR
+
+#endif
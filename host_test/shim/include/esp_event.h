@@ -0,0 +1,52 @@
+#ifndef HOST_ESP_EVENT_H_
+#define HOST_ESP_EVENT_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef const char *esp_event_base_t;
+
+typedef void *esp_event_loop_handle_t;
+
+typedef void (*esp_event_handler_t)(void *event_handler_arg, esp_event_base_t event_base, int32_t event_id, void *event_data);
+
+typedef void *esp_event_handler_instance_t;
+
+#define ESP_EVENT_DECLARE_BASE(id) extern esp_event_base_t id
+#define ESP_EVENT_DEFINE_BASE(id) esp_event_base_t id = #id
+
+#define ESP_EVENT_ANY_BASE NULL
+#define ESP_EVENT_ANY_ID -1
+
+/**
+ * Handlers run on the "sys_evt" task, in the order they were registered
+ */
+esp_err_t esp_event_loop_create_default(void);
+
+esp_err_t esp_event_loop_delete_default(void);
+
+esp_err_t esp_event_handler_register(esp_event_base_t event_base, int32_t event_id,
+        esp_event_handler_t event_handler, void *event_handler_arg);
+
+esp_err_t esp_event_handler_unregister(esp_event_base_t event_base, int32_t event_id,
+        esp_event_handler_t event_handler);
+
+esp_err_t esp_event_handler_instance_register(esp_event_base_t event_base, int32_t event_id,
+        esp_event_handler_t event_handler, void *event_handler_arg, esp_event_handler_instance_t *instance);
+
+/**
+ * Event data is copied, ESP_ERR_INVALID_STATE without the default loop
+ */
+esp_err_t esp_event_post(esp_event_base_t event_base, int32_t event_id,
+        const void *event_data, size_t event_data_size, uint32_t ticks_to_wait);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
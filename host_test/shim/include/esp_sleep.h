@@ -0,0 +1,56 @@
+#ifndef HOST_ESP_SLEEP_H_
+#define HOST_ESP_SLEEP_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    ESP_SLEEP_WAKEUP_UNDEFINED,
+    ESP_SLEEP_WAKEUP_ALL,
+    ESP_SLEEP_WAKEUP_EXT0,
+    ESP_SLEEP_WAKEUP_EXT1,
+    ESP_SLEEP_WAKEUP_TIMER,
+    ESP_SLEEP_WAKEUP_TOUCHPAD,
+    ESP_SLEEP_WAKEUP_ULP,
+    ESP_SLEEP_WAKEUP_GPIO,
+    ESP_SLEEP_WAKEUP_UART
+} esp_sleep_wakeup_cause_t;
+
+typedef esp_sleep_wakeup_cause_t esp_sleep_source_t;
+
+typedef enum {
+    ESP_EXT1_WAKEUP_ALL_LOW = 0,
+    ESP_EXT1_WAKEUP_ANY_HIGH = 1
+} esp_sleep_ext1_wakeup_mode_t;
+
+/**
+ * Cause set by the test, see host_sleep_set_wakeup_cause
+ */
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause(void);
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us);
+
+esp_err_t esp_sleep_enable_ext0_wakeup(gpio_num_t gpio_num, int level);
+
+esp_err_t esp_sleep_enable_ext1_wakeup(uint64_t mask, esp_sleep_ext1_wakeup_mode_t mode);
+
+esp_err_t esp_sleep_disable_wakeup_source(esp_sleep_source_t source);
+
+uint64_t esp_sleep_get_ext1_wakeup_status(void);
+
+/**
+ * Recorded with the wake up sources, see host_sleep_get_last. A task calling
+ * it is terminated, the test thread gets control back.
+ */
+void esp_deep_sleep_start(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
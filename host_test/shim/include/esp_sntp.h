@@ -0,0 +1,41 @@
+#ifndef HOST_ESP_SNTP_H_
+#define HOST_ESP_SNTP_H_
+
+#include <stdint.h>
+#include <sys/time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SNTP_OPMODE_POLL 0
+#define SNTP_OPMODE_LISTENONLY 1
+
+typedef enum {
+    SNTP_SYNC_STATUS_RESET,
+    SNTP_SYNC_STATUS_COMPLETED,
+    SNTP_SYNC_STATUS_IN_PROGRESS
+} sntp_sync_status_t;
+
+typedef void (*sntp_sync_time_cb_t)(struct timeval *tv);
+
+void sntp_setoperatingmode(uint8_t operating_mode);
+
+void sntp_setservername(uint8_t idx, const char *server);
+
+void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t callback);
+
+/**
+ * Nothing is sent, the clock is set by host_sntp_sync
+ */
+void sntp_init(void);
+
+void sntp_stop(void);
+
+sntp_sync_status_t sntp_get_sync_status(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
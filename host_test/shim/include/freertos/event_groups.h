@@ -0,0 +1,33 @@
+#ifndef HOST_FREERTOS_EVENT_GROUPS_H_
+#define HOST_FREERTOS_EVENT_GROUPS_H_
+
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint32_t EventBits_t;
+
+typedef struct host_event_group *EventGroupHandle_t;
+
+EventGroupHandle_t xEventGroupCreate(void);
+
+void vEventGroupDelete(EventGroupHandle_t event_group);
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t event_group, const EventBits_t bits);
+
+BaseType_t xEventGroupSetBitsFromISR(EventGroupHandle_t event_group, const EventBits_t bits, BaseType_t *higher_priority_task_woken);
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t event_group, const EventBits_t bits);
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t event_group);
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t event_group, const EventBits_t bits,
+        const BaseType_t clear_on_exit, const BaseType_t wait_for_all, TickType_t ticks_to_wait);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef HOST_FREERTOS_RINGBUF_H_
+#define HOST_FREERTOS_RINGBUF_H_
+
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    RINGBUF_TYPE_NOSPLIT = 0,
+    RINGBUF_TYPE_ALLOWSPLIT,
+    RINGBUF_TYPE_BYTEBUF
+} RingbufferType_t;
+
+typedef struct host_ringbuf *RingbufHandle_t;
+
+/**
+ * Item buffer only, every item is a separate allocation
+ */
+RingbufHandle_t xRingbufferCreate(size_t size, RingbufferType_t type);
+
+void vRingbufferDelete(RingbufHandle_t ringbuf);
+
+BaseType_t xRingbufferSend(RingbufHandle_t ringbuf, const void *item, size_t item_size, TickType_t ticks_to_wait);
+
+BaseType_t xRingbufferSendFromISR(RingbufHandle_t ringbuf, const void *item, size_t item_size, BaseType_t *higher_priority_task_woken);
+
+void *xRingbufferReceive(RingbufHandle_t ringbuf, size_t *item_size, TickType_t ticks_to_wait);
+
+void vRingbufferReturnItem(RingbufHandle_t ringbuf, void *item);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
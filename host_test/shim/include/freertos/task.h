@@ -0,0 +1,53 @@
+#ifndef HOST_FREERTOS_TASK_H_
+#define HOST_FREERTOS_TASK_H_
+
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct host_task *TaskHandle_t;
+
+typedef void (*TaskFunction_t)(void *);
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack_depth,
+        void *parameters, UBaseType_t priority, TaskHandle_t *created_task);
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stack_depth,
+        void *parameters, UBaseType_t priority, TaskHandle_t *created_task, BaseType_t core_id);
+
+void vTaskDelete(TaskHandle_t task);
+
+void vTaskDelay(TickType_t ticks);
+
+TickType_t xTaskGetTickCount(void);
+
+TickType_t xTaskGetTickCountFromISR(void);
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+
+TaskHandle_t xTaskGetHandle(const char *name);
+
+char *pcTaskGetTaskName(TaskHandle_t task);
+
+/**
+ * Half of the stack depth given at creation, the host has no stack to measure
+ */
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_priority_task_woken);
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait);
+
+void vTaskSuspendAll(void);
+
+BaseType_t xTaskResumeAll(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
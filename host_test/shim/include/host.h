@@ -0,0 +1,285 @@
+/*
+ *  Control of the simulated device from tests: virtual time, heap, flash,
+ *  network stand-ins and pads. Calls are made from the test thread, which is
+ *  a task of the lowest priority: firmware tasks run only while it waits in
+ *  host_settle, host_run_for_ms or in a blocking FreeRTOS call.
+ */
+
+#ifndef HOST_HOST_H_
+#define HOST_HOST_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_partition.h"
+#include "esp_ota_ops.h"
+#include "esp_sleep.h"
+#include "driver/gpio.h"
+#include "driver/rmt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// esp-mqtt OUTBOX_EXPIRED_TIMEOUT_MS
+#define HOST_MQTT_OUTBOX_EXPIRATION 30000
+
+// esp-mqtt MQTT_RECONNECT_TIMEOUT_MS
+#define HOST_MQTT_RECONNECT_TIMEOUT 10000
+
+#define HOST_MQTT_TOPIC_LENGTH 128
+
+#define HOST_HTTP_MAX_HEADERS 16
+
+/* kernel */
+
+/**
+ * Run the ready tasks until all of them are blocked, time does not move
+ */
+void host_settle(void);
+
+/**
+ * Let ms of virtual time go by, timers and timeouts falling due in it run
+ */
+void host_run_for_ms(uint32_t ms);
+
+/**
+ * Run in steps of step_ms until condition holds, false after timeout_ms
+ */
+bool host_run_until(bool (*condition)(void *context), void *context, uint32_t step_ms, uint32_t timeout_ms);
+
+/**
+ * Virtual microseconds since the start of the test, not reset by host_reboot
+ */
+int64_t host_now_us(void);
+
+/**
+ * Start a new boot: esp_timer_get_time counts from zero again. Tasks are not
+ * stopped, RTC data and statics are kept as they are through a deep sleep.
+ */
+void host_reboot(void);
+
+/* log */
+
+void host_log_set_level(esp_log_level_t level);
+
+/* heap, allocations of the firmware sources only */
+
+/**
+ * Free heap at boot, the allocation counters start over
+ */
+void host_heap_reset(size_t free_size);
+
+size_t host_heap_get_allocations(void);
+
+size_t host_heap_get_in_use(void);
+
+size_t host_heap_get_peak(void);
+
+/* system */
+
+void host_random_seed(uint32_t seed);
+
+int host_get_restart_count(void);
+
+void host_set_reset_reason(esp_reset_reason_t reason);
+
+/* deep sleep */
+
+typedef struct {
+    int count;
+    uint64_t timer_us;
+    int ext0_gpio;
+    int ext0_level;
+    uint64_t ext1_mask;
+    esp_sleep_ext1_wakeup_mode_t ext1_mode;
+} host_sleep_t;
+
+void host_sleep_set_wakeup_cause(esp_sleep_wakeup_cause_t cause);
+
+void host_sleep_set_ext1_status(uint64_t status);
+
+/**
+ * Wake up sources of the last esp_deep_sleep_start, cleared by it
+ */
+const host_sleep_t *host_sleep_get_last(void);
+
+/* wall clock, at epoch 0 until set like an unsynchronized ESP32 */
+
+void host_clock_set_epoch_ms(int64_t epoch_ms);
+
+/**
+ * Set the clock and complete the SNTP sync, its callback is called
+ */
+void host_sntp_sync(int64_t epoch_ms);
+
+/* NVS */
+
+void host_nvs_clear(void);
+
+/* flash partitions */
+
+const esp_partition_t *host_partition_get(const char *label);
+
+/**
+ * Raw content of the partition, for checks and fault injection
+ */
+uint8_t *host_partition_data(const char *label);
+
+void host_partition_erase(const char *label);
+
+/**
+ * Erase the partition and write the file at its start, false if it doesn't fit
+ */
+bool host_partition_load_file(const char *label, const char *path);
+
+/**
+ * Bytes written before writes fail, -1 for no limit. The write crossing the
+ * budget is torn: the bytes up to it are written and ESP_FAIL is returned.
+ */
+void host_flash_set_write_budget(long budget);
+
+/* OTA */
+
+/**
+ * Build an app image holding an application description with version and
+ * payload, with the SHA-256 appended like esptool does. Size of the image,
+ * 0 if it doesn't fit out_size.
+ */
+size_t host_ota_build_image(const char *version, const void *payload, size_t payload_size, uint8_t *out, size_t out_size);
+
+/**
+ * Write an image built by host_ota_build_image to the running partition
+ */
+void host_ota_install_running_image(const char *version, const void *payload, size_t payload_size);
+
+void host_ota_set_state(const char *label, esp_ota_img_states_t state);
+
+/**
+ * Restart into the boot partition. A new image boots pending verification,
+ * one still pending is marked invalid and the previous image boots instead,
+ * as the bootloader rollback does.
+ */
+void host_ota_boot(void);
+
+/* HTTP server stand-in */
+
+typedef struct {
+    const char *method;
+    const char *url;
+    int headers_count;
+    const char *header_keys[HOST_HTTP_MAX_HEADERS];
+    const char *header_values[HOST_HTTP_MAX_HEADERS];
+} host_http_request_t;
+
+/**
+ * Status 0 fails the connection. The body is not copied and must outlive
+ * the request, reads fail with -1 once fail_after bytes were read if set.
+ */
+typedef struct {
+    int status;
+    int headers_count;
+    char header_keys[HOST_HTTP_MAX_HEADERS][32];
+    char header_values[HOST_HTTP_MAX_HEADERS][128];
+    const uint8_t *body;
+    size_t body_length;
+    long fail_after;
+} host_http_response_t;
+
+typedef void (*host_http_handler_f)(void *context, const host_http_request_t *request, host_http_response_t *response);
+
+void host_http_set_handler(host_http_handler_f handler, void *context);
+
+/**
+ * Case insensitive lookup, NULL when missing
+ */
+const char *host_http_get_header(const host_http_request_t *request, const char *key);
+
+void host_http_add_header(host_http_response_t *response, const char *key, const char *value);
+
+int host_http_get_requests_count(void);
+
+/* MQTT broker stand-in */
+
+typedef struct {
+    char topic[HOST_MQTT_TOPIC_LENGTH];
+    uint8_t *data;
+    int data_len;
+    int qos;
+    int retain;
+    int msg_id;
+    bool dup;
+    int64_t time_us;
+    // size of the PUBLISH packet
+    size_t wire_bytes;
+} host_mqtt_message_t;
+
+/**
+ * Offline brokers refuse connections, going offline drops the connection
+ */
+void host_mqtt_set_broker_online(bool is_online);
+
+/**
+ * QoS 1 messages are acknowledged when received unless disabled
+ */
+void host_mqtt_set_auto_ack(bool is_enabled);
+
+/**
+ * Time from sending a QoS 1 message to its automatic acknowledgement, 0 by default
+ */
+void host_mqtt_set_ack_delay(uint32_t delay_ms);
+
+bool host_mqtt_ack(int msg_id);
+
+int host_mqtt_ack_all(void);
+
+bool host_mqtt_is_connected(void);
+
+void host_mqtt_deliver(const char *topic, const void *data, int data_len);
+
+int host_mqtt_get_sent_count(void);
+
+const host_mqtt_message_t *host_mqtt_get_sent(int index);
+
+/**
+ * Sent messages of a topic suffix, e.g. "/telemetry/batch"
+ */
+int host_mqtt_count_sent(const char *topic_suffix);
+
+size_t host_mqtt_get_wire_bytes(void);
+
+void host_mqtt_clear_sent(void);
+
+int host_mqtt_get_outbox_count(void);
+
+int host_mqtt_get_subscriptions_count(void);
+
+const char *host_mqtt_get_subscription(int index);
+
+/* pads */
+
+/**
+ * Drive an input, the ISR runs right away on a matching edge
+ */
+void host_gpio_set_input(gpio_num_t gpio_num, int level);
+
+int host_gpio_get_output(gpio_num_t gpio_num);
+
+gpio_mode_t host_gpio_get_direction(gpio_num_t gpio_num);
+
+/**
+ * Frame received on the next rmt_rx_start of the channel, none with count 0
+ */
+void host_rmt_set_frame(rmt_channel_t channel, const rmt_item32_t *items, size_t count);
+
+/* WiFi, wifi-manager is not built on the host */
+
+void host_wifi_set_connection_attempts(uint32_t attempts);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
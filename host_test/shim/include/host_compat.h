@@ -0,0 +1,24 @@
+/*
+ *  Included before every firmware source of the host build: the generated
+ *  sdkconfig.h and what newlib has and glibc may lack.
+ */
+
+#ifndef HOST_HOST_COMPAT_H_
+#define HOST_HOST_COMPAT_H_
+
+#include "sdkconfig.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef HOST_HAVE_STRLCPY
+size_t strlcpy(char *dst, const char *src, size_t size);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef HOST_ROM_ETS_SYS_H_
+#define HOST_ROM_ETS_SYS_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Busy wait on the target, a task delay in virtual time on the host
+ */
+void ets_delay_us(uint32_t us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
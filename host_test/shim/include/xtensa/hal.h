@@ -0,0 +1,20 @@
+#ifndef HOST_XTENSA_HAL_H_
+#define HOST_XTENSA_HAL_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Cycles of a 240 MHz core over the host monotonic clock: host code speed,
+ * not ESP32 speed, comparable between runs on the same machine only
+ */
+uint32_t xthal_get_ccount(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,527 @@
+/*
+ *  A discrete event FreeRTOS scheduler. Every task is a thread but only the
+ *  one holding the CPU runs, it keeps it until it blocks: tasks switch at
+ *  blocking calls only, in priority order, so runs are reproducible. Once
+ *  every task is blocked the virtual clock jumps to the earliest timeout.
+ *  A task blocked forever with nothing left to run is a deadlock, the task
+ *  states are printed and the test aborts.
+ */
+
+#include "kernel.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host.h"
+
+// pthread stacks, task stack depths are for the Xtensa ABI and too small here
+#define KERNEL_THREAD_STACK_SIZE (256 * 1024)
+
+#define TASK_NAME_LENGTH 16
+
+typedef enum {
+    TASK_READY,
+    TASK_RUNNING,
+    TASK_BLOCKED,
+    TASK_DELETED
+} task_state_t;
+
+struct host_task {
+    char name[TASK_NAME_LENGTH];
+    TaskFunction_t function;
+    void *parameters;
+    UBaseType_t priority;
+    uint32_t stack_depth;
+    pthread_t thread;
+    pthread_cond_t cond;
+    task_state_t state;
+    // order of readiness, tasks of the same priority run first in first out
+    uint64_t ready_order;
+    const void *waiting_on;
+    int64_t deadline;
+    bool is_timed_out;
+    uint32_t notification;
+    struct host_task *next;
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct host_task *tasks = NULL;
+
+static struct host_task *current = NULL;
+
+static struct host_task *test_task = NULL;
+
+static __thread struct host_task *self = NULL;
+
+static uint64_t ready_counter = 0;
+
+static int64_t now_us = 0;
+
+static int64_t boot_us = 0;
+
+// wait object of plain delays, nothing wakes it up
+static const char delay_object = 0;
+
+void kernel_lock(void) {
+    pthread_mutex_lock(&lock);
+}
+
+void kernel_unlock(void) {
+    pthread_mutex_unlock(&lock);
+}
+
+static struct host_task *kernel_new_task(const char *name, UBaseType_t priority, uint32_t stack_depth) {
+
+    struct host_task *task = host_alloc(sizeof(struct host_task));
+    memset(task, 0, sizeof(*task));
+    strncpy(task->name, name, TASK_NAME_LENGTH - 1);
+    task->priority = priority;
+    task->stack_depth = stack_depth;
+    pthread_cond_init(&task->cond, NULL);
+
+    task->next = tasks;
+    tasks = task;
+
+    return task;
+}
+
+TaskHandle_t kernel_self(void) {
+
+    if (self == NULL && test_task == NULL) {
+        host_system_init();
+        test_task = kernel_new_task("test", tskIDLE_PRIORITY, 8192);
+        test_task->state = TASK_RUNNING;
+        test_task->thread = pthread_self();
+        current = test_task;
+        self = test_task;
+    }
+
+    return self;
+}
+
+static void kernel_make_ready(struct host_task *task) {
+
+    task->state = TASK_READY;
+    task->ready_order = ready_counter++;
+    task->waiting_on = NULL;
+}
+
+static const char *kernel_state_name(task_state_t state) {
+
+    static const char *names[] = { "ready", "running", "blocked", "deleted" };
+    return names[state];
+}
+
+static void kernel_abort_deadlock(void) {
+
+    fprintf(stderr, "host kernel: deadlock at %lld us, every task is blocked forever\n", (long long) now_us);
+    for (struct host_task *task = tasks; task != NULL; task = task->next) {
+        fprintf(stderr, "  %-16s priority %2u %s on %p\n", task->name, task->priority,
+            kernel_state_name(task->state), task->waiting_on);
+    }
+    abort();
+}
+
+static struct host_task *kernel_pick_next(void) {
+
+    struct host_task *next = NULL;
+
+    for (struct host_task *task = tasks; task != NULL; task = task->next) {
+        if (task->state != TASK_READY) {
+            continue;
+        }
+        if (next == NULL || task->priority > next->priority ||
+            (task->priority == next->priority && task->ready_order < next->ready_order)) {
+            next = task;
+        }
+    }
+
+    return next;
+}
+
+/**
+ * Move the clock to the earliest timeout and wake up the tasks due then
+ */
+static void kernel_advance_time(void) {
+
+    int64_t earliest = KERNEL_FOREVER;
+
+    for (struct host_task *task = tasks; task != NULL; task = task->next) {
+        if (task->state == TASK_BLOCKED && task->deadline != KERNEL_FOREVER &&
+            (earliest == KERNEL_FOREVER || task->deadline < earliest)) {
+            earliest = task->deadline;
+        }
+    }
+
+    if (earliest == KERNEL_FOREVER) {
+        kernel_abort_deadlock();
+    }
+
+    if (earliest > now_us) {
+        now_us = earliest;
+    }
+
+    for (struct host_task *task = tasks; task != NULL; task = task->next) {
+        if (task->state == TASK_BLOCKED && task->deadline != KERNEL_FOREVER && task->deadline <= now_us) {
+            task->is_timed_out = true;
+            kernel_make_ready(task);
+        }
+    }
+}
+
+/**
+ * Give the CPU to the next task and wait to get it back, the calling task
+ * has already set its own state
+ */
+static void kernel_switch(void) {
+
+    struct host_task *next = kernel_pick_next();
+    while (next == NULL) {
+        kernel_advance_time();
+        next = kernel_pick_next();
+    }
+
+    next->state = TASK_RUNNING;
+    current = next;
+
+    if (next == self) {
+        return;
+    }
+
+    pthread_cond_signal(&next->cond);
+
+    if (self->state == TASK_DELETED) {
+        return;
+    }
+
+    while (current != self) {
+        pthread_cond_wait(&self->cond, &lock);
+    }
+}
+
+bool kernel_wait(const void *object, int64_t deadline) {
+
+    if (kernel_self() == NULL) {
+        fprintf(stderr, "host kernel: blocking call from a thread that is not a task\n");
+        abort();
+    }
+
+    self->state = TASK_BLOCKED;
+    self->waiting_on = object;
+    self->deadline = deadline;
+    self->is_timed_out = false;
+
+    kernel_switch();
+
+    return !self->is_timed_out;
+}
+
+void kernel_wake_all(const void *object) {
+
+    for (struct host_task *task = tasks; task != NULL; task = task->next) {
+        if (task->state == TASK_BLOCKED && task->waiting_on == object) {
+            kernel_make_ready(task);
+        }
+    }
+}
+
+int64_t kernel_deadline_from_ticks(TickType_t ticks) {
+
+    if (ticks == portMAX_DELAY) {
+        return KERNEL_FOREVER;
+    }
+
+    int64_t tick = (now_us - boot_us) / KERNEL_TICK_US;
+    return boot_us + (tick + ticks) * KERNEL_TICK_US;
+}
+
+int64_t kernel_now(void) {
+    return now_us;
+}
+
+int64_t kernel_boot_time(void) {
+    return boot_us;
+}
+
+void kernel_terminate_self(void) {
+
+    if (kernel_self() == test_task) {
+        return;
+    }
+
+    self->state = TASK_DELETED;
+    kernel_switch();
+    kernel_unlock();
+    pthread_exit(NULL);
+}
+
+static void *kernel_task_entry(void *arg) {
+
+    struct host_task *task = arg;
+
+    kernel_lock();
+    self = task;
+    while (current != task) {
+        pthread_cond_wait(&task->cond, &lock);
+    }
+    kernel_unlock();
+
+    task->function(task->parameters);
+
+    // returning from a task function is a fault on the target, tests let it go
+    kernel_lock();
+    kernel_terminate_self();
+
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stack_depth,
+        void *parameters, UBaseType_t priority, TaskHandle_t *created_task, BaseType_t core_id) {
+
+    kernel_lock();
+    kernel_self();
+
+    struct host_task *task = kernel_new_task(name, priority, stack_depth);
+    task->function = function;
+    task->parameters = parameters;
+    kernel_make_ready(task);
+
+    if (created_task != NULL) {
+        *created_task = task;
+    }
+
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setstacksize(&attributes, KERNEL_THREAD_STACK_SIZE);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+    int err = pthread_create(&task->thread, &attributes, kernel_task_entry, task);
+    pthread_attr_destroy(&attributes);
+
+    if (err != 0) {
+        task->state = TASK_DELETED;
+    }
+
+    kernel_unlock();
+
+    return err == 0 ? pdPASS : pdFAIL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack_depth,
+        void *parameters, UBaseType_t priority, TaskHandle_t *created_task) {
+
+    return xTaskCreatePinnedToCore(function, name, stack_depth, parameters, priority, created_task, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+
+    kernel_lock();
+
+    if (task == NULL || task == kernel_self()) {
+        if (self == test_task) {
+            fprintf(stderr, "host kernel: the test task can't be deleted\n");
+            abort();
+        }
+        kernel_terminate_self();
+    }
+
+    // its thread stays parked, handles are never reused
+    task->state = TASK_DELETED;
+    kernel_unlock();
+}
+
+void vTaskDelay(TickType_t ticks) {
+
+    kernel_lock();
+    kernel_self();
+
+    if (ticks == 0) {
+        kernel_make_ready(self);
+        kernel_switch();
+    } else {
+        kernel_wait(&delay_object, kernel_deadline_from_ticks(ticks));
+    }
+
+    kernel_unlock();
+}
+
+void ets_delay_us(uint32_t us) {
+
+    kernel_lock();
+    kernel_self();
+    kernel_wait(&delay_object, now_us + us);
+    kernel_unlock();
+}
+
+TickType_t xTaskGetTickCount(void) {
+
+    kernel_lock();
+    TickType_t ticks = (now_us - boot_us) / KERNEL_TICK_US;
+    kernel_unlock();
+
+    return ticks;
+}
+
+TickType_t xTaskGetTickCountFromISR(void) {
+    return xTaskGetTickCount();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+
+    kernel_lock();
+    TaskHandle_t task = kernel_self();
+    kernel_unlock();
+
+    return task;
+}
+
+TaskHandle_t xTaskGetHandle(const char *name) {
+
+    TaskHandle_t found = NULL;
+
+    kernel_lock();
+    for (struct host_task *task = tasks; task != NULL && found == NULL; task = task->next) {
+        if (task->state != TASK_DELETED && strncmp(task->name, name, TASK_NAME_LENGTH - 1) == 0) {
+            found = task;
+        }
+    }
+    kernel_unlock();
+
+    return found;
+}
+
+char *pcTaskGetTaskName(TaskHandle_t task) {
+
+    if (task == NULL) {
+        task = xTaskGetCurrentTaskHandle();
+    }
+
+    return task->name;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+
+    if (task == NULL) {
+        task = xTaskGetCurrentTaskHandle();
+    }
+
+    return task->stack_depth / 2;
+}
+
+static void kernel_notify(TaskHandle_t task) {
+
+    task->notification++;
+    kernel_wake_all(task);
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+
+    kernel_lock();
+    kernel_notify(task);
+    kernel_unlock();
+
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_priority_task_woken) {
+
+    kernel_lock();
+    kernel_notify(task);
+    if (higher_priority_task_woken != NULL && current != NULL && task->priority > current->priority) {
+        *higher_priority_task_woken = pdTRUE;
+    }
+    kernel_unlock();
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait) {
+
+    kernel_lock();
+    kernel_self();
+
+    if (self->notification == 0 && ticks_to_wait > 0) {
+        kernel_wait(self, kernel_deadline_from_ticks(ticks_to_wait));
+    }
+
+    uint32_t value = self->notification;
+    if (value > 0) {
+        self->notification = clear_on_exit ? 0 : value - 1;
+    }
+
+    kernel_unlock();
+
+    return value;
+}
+
+void vTaskSuspendAll(void) {
+}
+
+BaseType_t xTaskResumeAll(void) {
+    return pdFALSE;
+}
+
+void vPortCPUInitializeMutex(portMUX_TYPE *mux) {
+
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&mux->mutex, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+}
+
+void vPortEnterCritical(portMUX_TYPE *mux) {
+    pthread_mutex_lock(&mux->mutex);
+}
+
+void vPortExitCritical(portMUX_TYPE *mux) {
+    pthread_mutex_unlock(&mux->mutex);
+}
+
+void host_settle(void) {
+
+    kernel_lock();
+    kernel_self();
+    kernel_make_ready(self);
+    kernel_switch();
+    kernel_unlock();
+}
+
+void host_run_for_ms(uint32_t ms) {
+
+    kernel_lock();
+    kernel_self();
+    kernel_wait(&delay_object, now_us + (int64_t) ms * 1000);
+    kernel_unlock();
+
+    // tasks woken at the deadline too run before the test goes on
+    host_settle();
+}
+
+bool host_run_until(bool (*condition)(void *context), void *context, uint32_t step_ms, uint32_t timeout_ms) {
+
+    host_settle();
+
+    for (uint32_t elapsed = 0; !condition(context); elapsed += step_ms) {
+        if (elapsed >= timeout_ms) {
+            return false;
+        }
+        host_run_for_ms(step_ms);
+    }
+
+    return true;
+}
+
+int64_t host_now_us(void) {
+
+    kernel_lock();
+    int64_t now = now_us;
+    kernel_unlock();
+
+    return now;
+}
+
+void host_reboot(void) {
+
+    kernel_lock();
+    boot_us = now_us;
+    kernel_unlock();
+}
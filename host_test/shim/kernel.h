@@ -0,0 +1,67 @@
+/*
+ *  Internals of the host kernel shared by the shim sources. Functions below
+ *  are called with the kernel lock held unless stated otherwise.
+ */
+
+#ifndef HOST_KERNEL_H_
+#define HOST_KERNEL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// no timeout
+#define KERNEL_FOREVER -1
+
+#define KERNEL_TICK_US (1000000 / CONFIG_FREERTOS_HZ)
+
+void kernel_lock(void);
+
+void kernel_unlock(void);
+
+/**
+ * Task of the calling thread. The first thread to call in is registered as
+ * the test task, other threads not created by xTaskCreate get NULL and may
+ * only use calls that don't block.
+ */
+TaskHandle_t kernel_self(void);
+
+/**
+ * Block until woken up through object or until deadline, false on timeout
+ */
+bool kernel_wait(const void *object, int64_t deadline);
+
+/**
+ * Make the tasks waiting on object ready, they run once the current one blocks
+ */
+void kernel_wake_all(const void *object);
+
+/**
+ * Absolute deadline of a FreeRTOS timeout, tick aligned as on the target
+ */
+int64_t kernel_deadline_from_ticks(TickType_t ticks);
+
+int64_t kernel_now(void);
+
+int64_t kernel_boot_time(void);
+
+/**
+ * Stop the calling task as vTaskDelete(NULL) does, the test task returns instead
+ */
+void kernel_terminate_self(void);
+
+/* allocations not charged to the simulated heap, see heap.c */
+
+void *host_alloc(size_t size);
+
+void host_free(void *ptr);
+
+char *host_strdup(const char *s);
+
+/* one-time setup of the shims, see system.c */
+
+void host_system_init(void);
+
+#endif
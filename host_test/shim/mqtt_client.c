@@ -0,0 +1,824 @@
+/*
+ *  esp-mqtt 4.3 client against a broker stand-in. The client task connects
+ *  while the broker is online, sends what waits in the outbox and dispatches
+ *  events to the registered handlers, as esp-mqtt does on its own task.
+ *
+ *  Outbox entries are kept until acknowledged, at most
+ *  HOST_MQTT_OUTBOX_EXPIRATION after they were stored, and are sent again
+ *  with the dup flag on reconnect and every message_retransmit_timeout
+ *  while connected. The broker acknowledges QoS 1 messages on receipt, or
+ *  after the round trip set by host_mqtt_set_ack_delay. Only the client
+ *  side is simulated: no sockets, TLS, keepalive or broker side QoS 1
+ *  deduplication.
+ */
+
+#include "mqtt_client.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "host.h"
+#include "kernel.h"
+
+#define MQTT_TASK_PRIORITY 5
+
+#define MQTT_TASK_STACK 6144
+
+#define MQTT_HANDLERS_MAX 4
+
+#define MQTT_SUBSCRIPTIONS_MAX 8
+
+#define MQTT_RETRANSMIT_TIMEOUT 1000
+
+ESP_EVENT_DEFINE_BASE(MQTT_EVENTS);
+
+typedef enum {
+    MQTT_STATE_STOPPED,
+    MQTT_STATE_INIT,
+    MQTT_STATE_CONNECTED,
+    MQTT_STATE_WAIT_RECONNECT,
+    MQTT_STATE_DISCONNECTED
+} mqtt_state_t;
+
+typedef enum {
+    OUTBOX_QUEUED,
+    OUTBOX_TRANSMITTED,
+    OUTBOX_ACKNOWLEDGED
+} outbox_state_t;
+
+typedef struct outbox_item {
+    int msg_id;
+    int qos;
+    int retain;
+    char *topic;
+    uint8_t *data;
+    int data_len;
+    outbox_state_t state;
+    int64_t stored_at;
+    int64_t transmitted_at;
+    struct outbox_item *next;
+} outbox_item_t;
+
+typedef struct incoming_message {
+    char *topic;
+    uint8_t *data;
+    int data_len;
+    struct incoming_message *next;
+} incoming_message_t;
+
+typedef struct {
+    esp_event_handler_t handler;
+    void *arg;
+    esp_mqtt_event_id_t event;
+} mqtt_handler_t;
+
+struct esp_mqtt_client {
+    esp_mqtt_client_config_t config;
+    mqtt_state_t state;
+    mqtt_handler_t handlers[MQTT_HANDLERS_MAX];
+    int handlers_count;
+    uint16_t last_msg_id;
+    int64_t reconnect_at;
+    bool has_session;
+    outbox_item_t *outbox;
+    incoming_message_t *incoming;
+    // msg_id of SUBSCRIBE packets waiting for their SUBACK, 0 if none
+    int pending_subscriptions[MQTT_SUBSCRIPTIONS_MAX];
+    TaskHandle_t task;
+};
+
+static const char *TAG = "mqtt_client";
+
+static esp_mqtt_client_handle_t active_client = NULL;
+
+static bool is_broker_online = true;
+
+static bool is_auto_ack = true;
+
+// round trip of the automatic acknowledgements
+static uint32_t ack_delay_ms = 0;
+
+static host_mqtt_message_t *sent_messages = NULL;
+
+static int sent_count = 0;
+
+static int sent_capacity = 0;
+
+static size_t wire_bytes = 0;
+
+static char subscriptions[MQTT_SUBSCRIPTIONS_MAX][HOST_MQTT_TOPIC_LENGTH];
+
+static int subscriptions_count = 0;
+
+static int64_t mqtt_now_ms(void) {
+    return host_now_us() / 1000;
+}
+
+static size_t mqtt_varint_length(size_t value) {
+
+    size_t length = 1;
+    while (value >= 128) {
+        value /= 128;
+        length++;
+    }
+
+    return length;
+}
+
+static size_t mqtt_publish_packet_size(const char *topic, int data_len, int qos) {
+
+    size_t remaining = 2 + strlen(topic) + (qos > 0 ? 2 : 0) + data_len;
+    return 1 + mqtt_varint_length(remaining) + remaining;
+}
+
+static int mqtt_next_msg_id(esp_mqtt_client_handle_t client) {
+
+    if (++client->last_msg_id == 0) {
+        client->last_msg_id = 1;
+    }
+
+    return client->last_msg_id;
+}
+
+static void mqtt_dispatch(esp_mqtt_client_handle_t client, esp_mqtt_event_t *event) {
+
+    event->client = client;
+    event->user_context = client->config.user_context;
+
+    if (client->config.event_handle != NULL) {
+        client->config.event_handle(event);
+    }
+
+    for (int i = 0; i < client->handlers_count; i++) {
+        mqtt_handler_t *handler = &client->handlers[i];
+        if (handler->event == MQTT_EVENT_ANY || handler->event == event->event_id) {
+            handler->handler(handler->arg, MQTT_EVENTS, event->event_id, event);
+        }
+    }
+}
+
+static void mqtt_dispatch_simple(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event_id, int msg_id) {
+
+    esp_mqtt_event_t event = {
+        .event_id = event_id,
+        .msg_id = msg_id
+    };
+
+    mqtt_dispatch(client, &event);
+}
+
+/**
+ * Record a PUBLISH packet as received by the broker
+ */
+static void mqtt_transmit(const char *topic, const void *data, int data_len, int qos, int retain, int msg_id, bool dup) {
+
+    if (sent_count == sent_capacity) {
+        sent_capacity = sent_capacity > 0 ? sent_capacity * 2 : 64;
+        host_mqtt_message_t *messages = host_alloc(sent_capacity * sizeof(host_mqtt_message_t));
+        if (sent_messages != NULL) {
+            memcpy(messages, sent_messages, sent_count * sizeof(host_mqtt_message_t));
+            host_free(sent_messages);
+        }
+        sent_messages = messages;
+    }
+
+    host_mqtt_message_t *message = &sent_messages[sent_count++];
+    memset(message, 0, sizeof(*message));
+    strlcpy(message->topic, topic, sizeof(message->topic));
+    message->data = host_alloc(data_len + 1);
+    memcpy(message->data, data, data_len);
+    message->data[data_len] = '\0';
+    message->data_len = data_len;
+    message->qos = qos;
+    message->retain = retain;
+    message->msg_id = msg_id;
+    message->dup = dup;
+    message->time_us = host_now_us();
+    message->wire_bytes = mqtt_publish_packet_size(topic, data_len, qos);
+
+    wire_bytes += message->wire_bytes;
+}
+
+static void mqtt_outbox_delete(esp_mqtt_client_handle_t client, outbox_item_t *item) {
+
+    for (outbox_item_t **link = &client->outbox; *link != NULL; link = &(*link)->next) {
+        if (*link == item) {
+            *link = item->next;
+            free(item->topic);
+            free(item->data);
+            free(item);
+            return;
+        }
+    }
+}
+
+static outbox_item_t *mqtt_outbox_store(esp_mqtt_client_handle_t client, const char *topic,
+        const char *data, int len, int qos, int retain) {
+
+    // stored like esp-mqtt does, in the device heap
+    outbox_item_t *item = malloc(sizeof(outbox_item_t));
+    char *topic_copy = malloc(strlen(topic) + 1);
+    uint8_t *data_copy = malloc(len > 0 ? len : 1);
+
+    if (item == NULL || topic_copy == NULL || data_copy == NULL) {
+        free(item);
+        free(topic_copy);
+        free(data_copy);
+        return NULL;
+    }
+
+    strcpy(topic_copy, topic);
+    memcpy(data_copy, data, len);
+
+    *item = (outbox_item_t) {
+        .msg_id = mqtt_next_msg_id(client),
+        .qos = qos,
+        .retain = retain,
+        .topic = topic_copy,
+        .data = data_copy,
+        .data_len = len,
+        .state = OUTBOX_QUEUED,
+        .stored_at = mqtt_now_ms()
+    };
+
+    outbox_item_t **link = &client->outbox;
+    while (*link != NULL) {
+        link = &(*link)->next;
+    }
+    *link = item;
+
+    return item;
+}
+
+static void mqtt_outbox_transmit(outbox_item_t *item) {
+
+    bool dup = item->state == OUTBOX_TRANSMITTED;
+    mqtt_transmit(item->topic, item->data, item->data_len, item->qos, item->retain, item->msg_id, dup);
+
+    item->state = OUTBOX_TRANSMITTED;
+    item->transmitted_at = mqtt_now_ms();
+
+    if (is_auto_ack && ack_delay_ms == 0) {
+        item->state = OUTBOX_ACKNOWLEDGED;
+    }
+}
+
+static bool mqtt_is_ack_due(esp_mqtt_client_handle_t client, const outbox_item_t *item, int64_t now) {
+
+    return is_auto_ack && ack_delay_ms > 0 && client->state == MQTT_STATE_CONNECTED &&
+        item->state == OUTBOX_TRANSMITTED && item->qos > 0 && now >= item->transmitted_at + ack_delay_ms;
+}
+
+/**
+ * Send queued messages, and those not acknowledged in time again
+ */
+static void mqtt_outbox_resend(esp_mqtt_client_handle_t client, bool is_reconnect) {
+
+    int64_t now = mqtt_now_ms();
+    int retransmit_timeout = client->config.message_retransmit_timeout > 0 ?
+        client->config.message_retransmit_timeout : MQTT_RETRANSMIT_TIMEOUT;
+
+    for (outbox_item_t *item = client->outbox; item != NULL; item = item->next) {
+        if (item->state == OUTBOX_QUEUED ||
+            (item->state == OUTBOX_TRANSMITTED && (is_reconnect || now - item->transmitted_at >= retransmit_timeout))) {
+            mqtt_outbox_transmit(item);
+        }
+    }
+}
+
+/**
+ * Acknowledged messages leave the outbox with a PUBLISHED event, QoS 0
+ * ones once sent, expired ones silently as esp-mqtt does
+ */
+static void mqtt_outbox_process(esp_mqtt_client_handle_t client) {
+
+    int64_t now = mqtt_now_ms();
+
+    outbox_item_t *item = client->outbox;
+    while (item != NULL) {
+        outbox_item_t *next = item->next;
+
+        if (mqtt_is_ack_due(client, item, now)) {
+            item->state = OUTBOX_ACKNOWLEDGED;
+        }
+
+        if (item->state == OUTBOX_ACKNOWLEDGED) {
+            int msg_id = item->msg_id;
+            int qos = item->qos;
+            mqtt_outbox_delete(client, item);
+            if (qos > 0) {
+                mqtt_dispatch_simple(client, MQTT_EVENT_PUBLISHED, msg_id);
+            }
+        } else if (item->state == OUTBOX_TRANSMITTED && item->qos == 0) {
+            mqtt_outbox_delete(client, item);
+        } else if (now - item->stored_at >= HOST_MQTT_OUTBOX_EXPIRATION) {
+            ESP_LOGD(TAG, "outbox item %d expired", item->msg_id);
+            mqtt_outbox_delete(client, item);
+        }
+
+        item = next;
+    }
+}
+
+static void mqtt_connect(esp_mqtt_client_handle_t client) {
+
+    mqtt_dispatch_simple(client, MQTT_EVENT_BEFORE_CONNECT, 0);
+
+    if (!is_broker_online) {
+        ESP_LOGD(TAG, "broker unreachable");
+        mqtt_dispatch_simple(client, MQTT_EVENT_ERROR, 0);
+        mqtt_dispatch_simple(client, MQTT_EVENT_DISCONNECTED, 0);
+        client->state = MQTT_STATE_WAIT_RECONNECT;
+        client->reconnect_at = mqtt_now_ms() + (client->config.reconnect_timeout_ms > 0 ?
+            client->config.reconnect_timeout_ms : HOST_MQTT_RECONNECT_TIMEOUT);
+        return;
+    }
+
+    client->state = MQTT_STATE_CONNECTED;
+
+    esp_mqtt_event_t event = {
+        .event_id = MQTT_EVENT_CONNECTED,
+        .session_present = client->config.disable_clean_session && client->has_session
+    };
+
+    client->has_session = client->config.disable_clean_session;
+    mqtt_dispatch(client, &event);
+
+    mqtt_outbox_resend(client, true);
+}
+
+static void mqtt_abort_connection(esp_mqtt_client_handle_t client, mqtt_state_t state) {
+
+    client->state = state;
+    client->reconnect_at = mqtt_now_ms() + (client->config.reconnect_timeout_ms > 0 ?
+        client->config.reconnect_timeout_ms : HOST_MQTT_RECONNECT_TIMEOUT);
+
+    for (int i = 0; i < MQTT_SUBSCRIPTIONS_MAX; i++) {
+        client->pending_subscriptions[i] = 0;
+    }
+
+    mqtt_dispatch_simple(client, MQTT_EVENT_DISCONNECTED, 0);
+}
+
+static void mqtt_process_incoming(esp_mqtt_client_handle_t client) {
+
+    for (int i = 0; i < MQTT_SUBSCRIPTIONS_MAX; i++) {
+        if (client->pending_subscriptions[i] != 0) {
+            int msg_id = client->pending_subscriptions[i];
+            client->pending_subscriptions[i] = 0;
+            mqtt_dispatch_simple(client, MQTT_EVENT_SUBSCRIBED, msg_id);
+        }
+    }
+
+    while (client->incoming != NULL) {
+
+        incoming_message_t *message = client->incoming;
+        client->incoming = message->next;
+
+        esp_mqtt_event_t event = {
+            .event_id = MQTT_EVENT_DATA,
+            .data = (char *) message->data,
+            .data_len = message->data_len,
+            .total_data_len = message->data_len,
+            .topic = message->topic,
+            .topic_len = strlen(message->topic)
+        };
+
+        mqtt_dispatch(client, &event);
+
+        host_free(message->topic);
+        host_free(message->data);
+        host_free(message);
+    }
+}
+
+static int64_t mqtt_next_deadline(esp_mqtt_client_handle_t client) {
+
+    int64_t deadline = KERNEL_FOREVER;
+
+    if (client->state == MQTT_STATE_WAIT_RECONNECT && !client->config.disable_auto_reconnect) {
+        deadline = client->reconnect_at;
+    }
+
+    int retransmit_timeout = client->config.message_retransmit_timeout > 0 ?
+        client->config.message_retransmit_timeout : MQTT_RETRANSMIT_TIMEOUT;
+
+    for (outbox_item_t *item = client->outbox; item != NULL; item = item->next) {
+        int64_t item_deadline = item->stored_at + HOST_MQTT_OUTBOX_EXPIRATION;
+        if (item->state == OUTBOX_TRANSMITTED && client->state == MQTT_STATE_CONNECTED &&
+            item->transmitted_at + retransmit_timeout < item_deadline) {
+            item_deadline = item->transmitted_at + retransmit_timeout;
+        }
+        // the broker acknowledges before the item deadline
+        if (mqtt_is_ack_due(client, item, item_deadline)) {
+            item_deadline = item->transmitted_at + ack_delay_ms;
+        }
+        if (deadline == KERNEL_FOREVER || item_deadline < deadline) {
+            deadline = item_deadline;
+        }
+    }
+
+    return deadline == KERNEL_FOREVER ? KERNEL_FOREVER : deadline * 1000;
+}
+
+static void mqtt_task(void *arg) {
+
+    esp_mqtt_client_handle_t client = arg;
+
+    while (client->state != MQTT_STATE_STOPPED) {
+
+        switch (client->state) {
+            case MQTT_STATE_INIT:
+                mqtt_connect(client);
+                break;
+            case MQTT_STATE_CONNECTED:
+                if (!is_broker_online) {
+                    mqtt_abort_connection(client, MQTT_STATE_WAIT_RECONNECT);
+                    break;
+                }
+                mqtt_process_incoming(client);
+                mqtt_outbox_resend(client, false);
+                break;
+            case MQTT_STATE_WAIT_RECONNECT:
+                if (mqtt_now_ms() >= client->reconnect_at && !client->config.disable_auto_reconnect) {
+                    mqtt_connect(client);
+                }
+                break;
+            default:
+                break;
+        }
+
+        mqtt_outbox_process(client);
+
+        // events may have changed the state, the loop runs again before waiting
+        kernel_lock();
+        bool has_work = (client->state == MQTT_STATE_CONNECTED && (!is_broker_online || client->incoming != NULL)) ||
+            client->state == MQTT_STATE_INIT;
+        for (outbox_item_t *item = client->outbox; item != NULL && !has_work; item = item->next) {
+            has_work = item->state == OUTBOX_ACKNOWLEDGED ||
+                (item->state == OUTBOX_QUEUED && client->state == MQTT_STATE_CONNECTED);
+        }
+        for (int i = 0; i < MQTT_SUBSCRIPTIONS_MAX && !has_work; i++) {
+            has_work = client->pending_subscriptions[i] != 0;
+        }
+        if (!has_work) {
+            kernel_wait(client, mqtt_next_deadline(client));
+        }
+        kernel_unlock();
+    }
+
+    client->task = NULL;
+    vTaskDelete(NULL);
+}
+
+static void mqtt_wake(esp_mqtt_client_handle_t client) {
+
+    kernel_lock();
+    kernel_wake_all(client);
+    kernel_unlock();
+}
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config) {
+
+    esp_mqtt_client_handle_t client = calloc(1, sizeof(struct esp_mqtt_client));
+    if (client == NULL) {
+        return NULL;
+    }
+
+    client->config = *config;
+    client->state = MQTT_STATE_STOPPED;
+    active_client = client;
+
+    return client;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event,
+        esp_event_handler_t event_handler, void *event_handler_arg) {
+
+    if (client == NULL || client->handlers_count == MQTT_HANDLERS_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    client->handlers[client->handlers_count++] = (mqtt_handler_t) {
+        .handler = event_handler,
+        .arg = event_handler_arg,
+        .event = event
+    };
+
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client) {
+
+    if (client == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (client->state != MQTT_STATE_STOPPED) {
+        return ESP_FAIL;
+    }
+
+    client->state = MQTT_STATE_INIT;
+    if (xTaskCreate(mqtt_task, "mqtt_task", MQTT_TASK_STACK, client, MQTT_TASK_PRIORITY, &client->task) != pdPASS) {
+        client->state = MQTT_STATE_STOPPED;
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_reconnect(esp_mqtt_client_handle_t client) {
+
+    if (client == NULL || client->state == MQTT_STATE_STOPPED) {
+        return ESP_FAIL;
+    }
+
+    if (client->state == MQTT_STATE_WAIT_RECONNECT || client->state == MQTT_STATE_DISCONNECTED) {
+        client->state = MQTT_STATE_INIT;
+        mqtt_wake(client);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_disconnect(esp_mqtt_client_handle_t client) {
+
+    if (client == NULL || client->state != MQTT_STATE_CONNECTED) {
+        return ESP_FAIL;
+    }
+
+    // no automatic reconnect until esp_mqtt_client_reconnect
+    mqtt_abort_connection(client, MQTT_STATE_DISCONNECTED);
+    mqtt_wake(client);
+
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client) {
+
+    if (client == NULL || client->state == MQTT_STATE_STOPPED) {
+        return ESP_FAIL;
+    }
+
+    if (client->state == MQTT_STATE_CONNECTED) {
+        mqtt_abort_connection(client, MQTT_STATE_STOPPED);
+    }
+
+    client->state = MQTT_STATE_STOPPED;
+    mqtt_wake(client);
+
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_destroy(esp_mqtt_client_handle_t client) {
+
+    if (client == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (client->state != MQTT_STATE_STOPPED) {
+        esp_mqtt_client_stop(client);
+    }
+
+    // the task leaves its loop the next time it runs
+    host_settle();
+
+    while (client->outbox != NULL) {
+        mqtt_outbox_delete(client, client->outbox);
+    }
+
+    if (active_client == client) {
+        active_client = NULL;
+    }
+
+    free(client);
+    return ESP_OK;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos, int retain) {
+
+    if (client == NULL || client->state != MQTT_STATE_CONNECTED) {
+        return -1;
+    }
+
+    if (len <= 0 && data != NULL) {
+        len = strlen(data);
+    }
+
+    if (qos == 0) {
+        // written right away by the calling task
+        mqtt_transmit(topic, data, len, qos, retain, 0, false);
+        return 0;
+    }
+
+    outbox_item_t *item = mqtt_outbox_store(client, topic, data, len, qos, retain);
+    if (item == NULL) {
+        return -1;
+    }
+
+    mqtt_outbox_transmit(item);
+    mqtt_wake(client);
+
+    return item->msg_id;
+}
+
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos, int retain, bool store) {
+
+    if (client == NULL) {
+        return -1;
+    }
+
+    if (len <= 0 && data != NULL) {
+        len = strlen(data);
+    }
+
+    outbox_item_t *item = mqtt_outbox_store(client, topic, data, len, qos, retain);
+    if (item == NULL) {
+        return -1;
+    }
+
+    mqtt_wake(client);
+
+    return qos > 0 ? item->msg_id : 0;
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos) {
+
+    if (client == NULL || client->state != MQTT_STATE_CONNECTED) {
+        return -1;
+    }
+
+    int msg_id = mqtt_next_msg_id(client);
+
+    if (subscriptions_count < MQTT_SUBSCRIPTIONS_MAX) {
+        strlcpy(subscriptions[subscriptions_count++], topic, HOST_MQTT_TOPIC_LENGTH);
+    }
+
+    for (int i = 0; i < MQTT_SUBSCRIPTIONS_MAX; i++) {
+        if (client->pending_subscriptions[i] == 0) {
+            client->pending_subscriptions[i] = msg_id;
+            break;
+        }
+    }
+
+    mqtt_wake(client);
+
+    return msg_id;
+}
+
+int esp_mqtt_client_unsubscribe(esp_mqtt_client_handle_t client, const char *topic) {
+
+    if (client == NULL || client->state != MQTT_STATE_CONNECTED) {
+        return -1;
+    }
+
+    for (int i = 0; i < subscriptions_count; i++) {
+        if (strcmp(subscriptions[i], topic) == 0) {
+            memmove(subscriptions[i], subscriptions[i + 1], (subscriptions_count - i - 1) * HOST_MQTT_TOPIC_LENGTH);
+            subscriptions_count--;
+            break;
+        }
+    }
+
+    return mqtt_next_msg_id(client);
+}
+
+void host_mqtt_set_broker_online(bool is_online) {
+
+    is_broker_online = is_online;
+    if (active_client != NULL) {
+        mqtt_wake(active_client);
+    }
+}
+
+void host_mqtt_set_auto_ack(bool is_enabled) {
+    is_auto_ack = is_enabled;
+}
+
+void host_mqtt_set_ack_delay(uint32_t delay_ms) {
+    ack_delay_ms = delay_ms;
+}
+
+bool host_mqtt_ack(int msg_id) {
+
+    if (active_client == NULL) {
+        return false;
+    }
+
+    for (outbox_item_t *item = active_client->outbox; item != NULL; item = item->next) {
+        if (item->msg_id == msg_id && item->state == OUTBOX_TRANSMITTED && item->qos > 0) {
+            item->state = OUTBOX_ACKNOWLEDGED;
+            mqtt_wake(active_client);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int host_mqtt_ack_all(void) {
+
+    int count = 0;
+
+    if (active_client == NULL) {
+        return 0;
+    }
+
+    for (outbox_item_t *item = active_client->outbox; item != NULL; item = item->next) {
+        if (item->state == OUTBOX_TRANSMITTED && item->qos > 0) {
+            item->state = OUTBOX_ACKNOWLEDGED;
+            count++;
+        }
+    }
+
+    mqtt_wake(active_client);
+
+    return count;
+}
+
+bool host_mqtt_is_connected(void) {
+    return active_client != NULL && active_client->state == MQTT_STATE_CONNECTED;
+}
+
+void host_mqtt_deliver(const char *topic, const void *data, int data_len) {
+
+    if (!host_mqtt_is_connected()) {
+        return;
+    }
+
+    incoming_message_t *message = host_alloc(sizeof(incoming_message_t));
+    message->topic = host_strdup(topic);
+    message->data = host_alloc(data_len + 1);
+    memcpy(message->data, data, data_len);
+    message->data[data_len] = '\0';
+    message->data_len = data_len;
+    message->next = NULL;
+
+    incoming_message_t **link = &active_client->incoming;
+    while (*link != NULL) {
+        link = &(*link)->next;
+    }
+    *link = message;
+
+    mqtt_wake(active_client);
+}
+
+int host_mqtt_get_sent_count(void) {
+    return sent_count;
+}
+
+const host_mqtt_message_t *host_mqtt_get_sent(int index) {
+    return index >= 0 && index < sent_count ? &sent_messages[index] : NULL;
+}
+
+int host_mqtt_count_sent(const char *topic_suffix) {
+
+    int count = 0;
+    size_t suffix_length = strlen(topic_suffix);
+
+    for (int i = 0; i < sent_count; i++) {
+        size_t topic_length = strlen(sent_messages[i].topic);
+        if (topic_length >= suffix_length && strcmp(sent_messages[i].topic + topic_length - suffix_length, topic_suffix) == 0) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+size_t host_mqtt_get_wire_bytes(void) {
+    return wire_bytes;
+}
+
+void host_mqtt_clear_sent(void) {
+
+    for (int i = 0; i < sent_count; i++) {
+        host_free(sent_messages[i].data);
+    }
+
+    sent_count = 0;
+    wire_bytes = 0;
+}
+
+int host_mqtt_get_outbox_count(void) {
+
+    int count = 0;
+
+    if (active_client != NULL) {
+        for (outbox_item_t *item = active_client->outbox; item != NULL; item = item->next) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+int host_mqtt_get_subscriptions_count(void) {
+    return subscriptions_count;
+}
+
+const char *host_mqtt_get_subscription(int index) {
+    return index >= 0 && index < subscriptions_count ? subscriptions[index] : NULL;
+}
@@ -0,0 +1,246 @@
+/*
+ *  NVS kept in memory: typed entries by namespace and key, which survive
+ *  host_reboot like flash does. Commits always succeed.
+ */
+
+#include "nvs_flash.h"
+
+#include <string.h>
+#include "kernel.h"
+#include "host.h"
+
+#define NVS_NAMESPACES_COUNT 8
+
+#define NVS_NAMESPACE_NAME_LENGTH 16
+
+typedef enum {
+    NVS_TYPE_U8,
+    NVS_TYPE_I32,
+    NVS_TYPE_U32,
+    NVS_TYPE_STR,
+    NVS_TYPE_BLOB
+} nvs_type_t;
+
+typedef struct nvs_entry {
+    nvs_handle_t namespace_index;
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    nvs_type_t type;
+    size_t length;
+    uint8_t *value;
+    struct nvs_entry *next;
+} nvs_entry_t;
+
+static bool is_initialized = false;
+
+static char namespaces[NVS_NAMESPACES_COUNT][NVS_NAMESPACE_NAME_LENGTH];
+
+static nvs_entry_t *entries = NULL;
+
+esp_err_t nvs_flash_init(void) {
+
+    is_initialized = true;
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_deinit(void) {
+
+    is_initialized = false;
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void) {
+
+    host_nvs_clear();
+    return ESP_OK;
+}
+
+void host_nvs_clear(void) {
+
+    while (entries != NULL) {
+        nvs_entry_t *entry = entries;
+        entries = entry->next;
+        host_free(entry->value);
+        host_free(entry);
+    }
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle) {
+
+    if (!is_initialized) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+
+    if (strlen(name) >= NVS_NAMESPACE_NAME_LENGTH) {
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    }
+
+    for (nvs_handle_t i = 0; i < NVS_NAMESPACES_COUNT; i++) {
+        if (namespaces[i][0] == '\0') {
+            strcpy(namespaces[i], name);
+        }
+        if (strcmp(namespaces[i], name) == 0) {
+            // handle 0 is never valid
+            *out_handle = i + 1;
+            return ESP_OK;
+        }
+    }
+
+    return ESP_ERR_NVS_NO_FREE_PAGES;
+}
+
+void nvs_close(nvs_handle_t handle) {
+}
+
+static nvs_entry_t *nvs_find(nvs_handle_t handle, const char *key) {
+
+    for (nvs_entry_t *entry = entries; entry != NULL; entry = entry->next) {
+        if (entry->namespace_index == handle && strcmp(entry->key, key) == 0) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+static esp_err_t nvs_set(nvs_handle_t handle, const char *key, nvs_type_t type, const void *value, size_t length) {
+
+    if (handle == 0 || handle > NVS_NAMESPACES_COUNT) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+
+    if (strlen(key) >= NVS_KEY_NAME_MAX_SIZE) {
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    }
+
+    nvs_entry_t *entry = nvs_find(handle, key);
+    if (entry == NULL) {
+        entry = host_alloc(sizeof(nvs_entry_t));
+        memset(entry, 0, sizeof(*entry));
+        entry->namespace_index = handle;
+        strcpy(entry->key, key);
+        entry->next = entries;
+        entries = entry;
+    } else {
+        host_free(entry->value);
+    }
+
+    entry->type = type;
+    entry->length = length;
+    entry->value = host_alloc(length > 0 ? length : 1);
+    memcpy(entry->value, value, length);
+
+    return ESP_OK;
+}
+
+static esp_err_t nvs_get(nvs_handle_t handle, const char *key, nvs_type_t type, void *value, size_t *length) {
+
+    if (handle == 0 || handle > NVS_NAMESPACES_COUNT) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+
+    nvs_entry_t *entry = nvs_find(handle, key);
+    if (entry == NULL) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    if (entry->type != type) {
+        return ESP_ERR_NVS_TYPE_MISMATCH;
+    }
+
+    if (value == NULL) {
+        *length = entry->length;
+        return ESP_OK;
+    }
+
+    if (*length < entry->length) {
+        *length = entry->length;
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+
+    memcpy(value, entry->value, entry->length);
+    *length = entry->length;
+
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char *key, uint8_t value) {
+    return nvs_set(handle, key, NVS_TYPE_U8, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char *key, uint8_t *out_value) {
+
+    size_t length = sizeof(*out_value);
+    return nvs_get(handle, key, NVS_TYPE_U8, out_value, &length);
+}
+
+esp_err_t nvs_set_i32(nvs_handle_t handle, const char *key, int32_t value) {
+    return nvs_set(handle, key, NVS_TYPE_I32, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_i32(nvs_handle_t handle, const char *key, int32_t *out_value) {
+
+    size_t length = sizeof(*out_value);
+    return nvs_get(handle, key, NVS_TYPE_I32, out_value, &length);
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value) {
+    return nvs_set(handle, key, NVS_TYPE_U32, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value) {
+
+    size_t length = sizeof(*out_value);
+    return nvs_get(handle, key, NVS_TYPE_U32, out_value, &length);
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value) {
+    return nvs_set(handle, key, NVS_TYPE_STR, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out_value, size_t *length) {
+    return nvs_get(handle, key, NVS_TYPE_STR, out_value, length);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length) {
+    return nvs_set(handle, key, NVS_TYPE_BLOB, value, length);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length) {
+    return nvs_get(handle, key, NVS_TYPE_BLOB, out_value, length);
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key) {
+
+    for (nvs_entry_t **link = &entries; *link != NULL; link = &(*link)->next) {
+        nvs_entry_t *entry = *link;
+        if (entry->namespace_index == handle && strcmp(entry->key, key) == 0) {
+            *link = entry->next;
+            host_free(entry->value);
+            host_free(entry);
+            return ESP_OK;
+        }
+    }
+
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle) {
+
+    nvs_entry_t **link = &entries;
+    while (*link != NULL) {
+        nvs_entry_t *entry = *link;
+        if (entry->namespace_index == handle) {
+            *link = entry->next;
+            host_free(entry->value);
+            host_free(entry);
+        } else {
+            link = &entry->next;
+        }
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    return handle == 0 || handle > NVS_NAMESPACES_COUNT ? ESP_ERR_NVS_INVALID_HANDLE : ESP_OK;
+}
@@ -0,0 +1,320 @@
+/*
+ *  OTA updates between the ota_0 and ota_1 partitions, with the app rollback
+ *  states the bootloader keeps in otadata. The device runs from ota_0 until
+ *  host_ota_boot starts the image selected with esp_ota_set_boot_partition.
+ */
+
+#include "esp_ota_ops.h"
+
+#include <string.h>
+#include "esp_system.h"
+#include "host.h"
+#include "kernel.h"
+#include "partition.h"
+#include "sha256.h"
+
+#define OTA_SLOTS_COUNT 2
+
+#define OTA_SECTOR_SIZE 4096
+
+// load address of the DROM segment holding the application description
+#define OTA_DROM_ADDRESS 0x3f400020
+
+#define OTA_CHECKSUM_SEED 0xEF
+
+typedef struct {
+    const esp_partition_t *partition;
+    size_t offset;
+    bool is_active;
+} ota_write_t;
+
+static esp_ota_img_states_t states[OTA_SLOTS_COUNT] = { ESP_OTA_IMG_UNDEFINED, ESP_OTA_IMG_UNDEFINED };
+
+static int running_slot = 0;
+
+static int boot_slot = 0;
+
+static ota_write_t ota_write = { 0 };
+
+static esp_app_desc_t running_app_desc;
+
+static const esp_partition_t *ota_get_slot_partition(int slot) {
+    return esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_0 + slot, NULL);
+}
+
+static int ota_get_slot(const esp_partition_t *partition) {
+
+    if (partition == NULL || partition->type != ESP_PARTITION_TYPE_APP ||
+        partition->subtype < ESP_PARTITION_SUBTYPE_APP_OTA_0 ||
+        partition->subtype >= ESP_PARTITION_SUBTYPE_APP_OTA_0 + OTA_SLOTS_COUNT) {
+        return -1;
+    }
+
+    return partition->subtype - ESP_PARTITION_SUBTYPE_APP_OTA_0;
+}
+
+const esp_partition_t *esp_ota_get_running_partition(void) {
+    return ota_get_slot_partition(running_slot);
+}
+
+const esp_partition_t *esp_ota_get_boot_partition(void) {
+    return ota_get_slot_partition(boot_slot);
+}
+
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from) {
+
+    int slot = ota_get_slot(start_from != NULL ? start_from : esp_ota_get_running_partition());
+    return slot < 0 ? NULL : ota_get_slot_partition((slot + 1) % OTA_SLOTS_COUNT);
+}
+
+esp_err_t esp_ota_get_partition_description(const esp_partition_t *partition, esp_app_desc_t *app_desc) {
+
+    if (partition == NULL || app_desc == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = esp_partition_read(partition, PARTITION_APP_DESC_OFFSET, app_desc, sizeof(*app_desc));
+    if (err == ESP_OK && app_desc->magic_word != ESP_APP_DESC_MAGIC_WORD) {
+        err = ESP_ERR_NOT_FOUND;
+    }
+
+    return err;
+}
+
+const esp_app_desc_t *esp_ota_get_app_description(void) {
+
+    if (esp_ota_get_partition_description(esp_ota_get_running_partition(), &running_app_desc) != ESP_OK) {
+        memset(&running_app_desc, 0, sizeof(running_app_desc));
+        running_app_desc.magic_word = ESP_APP_DESC_MAGIC_WORD;
+        strcpy(running_app_desc.version, "0.0.0-host");
+        strcpy(running_app_desc.project_name, "breathe-fw");
+    }
+
+    return &running_app_desc;
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle) {
+
+    int slot = ota_get_slot(partition);
+    if (slot < 0 || out_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (slot == running_slot) {
+        return ESP_ERR_OTA_PARTITION_CONFLICT;
+    }
+
+    if (image_size != OTA_SIZE_UNKNOWN && image_size > partition->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    size_t erase_size = partition->size;
+    if (image_size != OTA_SIZE_UNKNOWN && image_size != OTA_WITH_SEQUENTIAL_WRITES) {
+        erase_size = (image_size + OTA_SECTOR_SIZE - 1) / OTA_SECTOR_SIZE * OTA_SECTOR_SIZE;
+    }
+
+    esp_err_t err = esp_partition_erase_range(partition, 0, erase_size);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    ota_write = (ota_write_t) { .partition = partition, .offset = 0, .is_active = true };
+    *out_handle = 1;
+
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size) {
+
+    if (handle != 1 || !ota_write.is_active || data == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (size == 0) {
+        return ESP_OK;
+    }
+
+    // the first byte of an image is checked as esp_ota_write does
+    if (ota_write.offset == 0 && ((const uint8_t *) data)[0] != ESP_IMAGE_HEADER_MAGIC) {
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+
+    esp_err_t err = esp_partition_write(ota_write.partition, ota_write.offset, data, size);
+    if (err == ESP_OK) {
+        ota_write.offset += size;
+    }
+
+    return err;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle) {
+
+    if (handle != 1 || !ota_write.is_active) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    ota_write.is_active = false;
+
+    if (ota_write.offset == 0 || !partition_verify_image(ota_write.partition, NULL)) {
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle) {
+
+    if (handle != 1 || !ota_write.is_active) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    ota_write.is_active = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition) {
+
+    int slot = ota_get_slot(partition);
+    if (slot < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!partition_verify_image(partition, NULL)) {
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+
+    boot_slot = slot;
+    if (slot != running_slot) {
+        states[slot] = ESP_OTA_IMG_NEW;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_get_state_partition(const esp_partition_t *partition, esp_ota_img_states_t *ota_state) {
+
+    int slot = ota_get_slot(partition);
+    if (slot < 0 || ota_state == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // no otadata entry, as for an image flashed over the serial port
+    if (states[slot] == ESP_OTA_IMG_UNDEFINED) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    *ota_state = states[slot];
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_mark_app_valid_cancel_rollback(void) {
+
+    states[running_slot] = ESP_OTA_IMG_VALID;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_mark_app_invalid_rollback_and_reboot(void) {
+
+    int other_slot = (running_slot + 1) % OTA_SLOTS_COUNT;
+    const esp_partition_t *other_partition = ota_get_slot_partition(other_slot);
+
+    if (states[other_slot] == ESP_OTA_IMG_INVALID || states[other_slot] == ESP_OTA_IMG_ABORTED ||
+        !partition_verify_image(other_partition, NULL)) {
+        return ESP_ERR_OTA_ROLLBACK_FAILED;
+    }
+
+    states[running_slot] = ESP_OTA_IMG_INVALID;
+    boot_slot = other_slot;
+
+    esp_restart();
+    return ESP_OK;
+}
+
+const esp_partition_t *esp_ota_get_last_invalid_partition(void) {
+
+    int other_slot = (running_slot + 1) % OTA_SLOTS_COUNT;
+    if (states[other_slot] == ESP_OTA_IMG_INVALID || states[other_slot] == ESP_OTA_IMG_ABORTED) {
+        return ota_get_slot_partition(other_slot);
+    }
+
+    return NULL;
+}
+
+size_t host_ota_build_image(const char *version, const void *payload, size_t payload_size, uint8_t *out, size_t out_size) {
+
+    esp_app_desc_t app_desc = {
+        .magic_word = ESP_APP_DESC_MAGIC_WORD
+    };
+    strlcpy(app_desc.version, version, sizeof(app_desc.version));
+    strlcpy(app_desc.project_name, "breathe-fw", sizeof(app_desc.project_name));
+    strlcpy(app_desc.idf_ver, "v4.3-host", sizeof(app_desc.idf_ver));
+
+    uint32_t segment_length = (sizeof(app_desc) + payload_size + 3) & ~3;
+    size_t length = PARTITION_APP_DESC_OFFSET + segment_length;
+    size_t image_size = (length | 15) + 1 + SHA256_DIGEST_SIZE;
+
+    if (image_size > out_size) {
+        return 0;
+    }
+
+    memset(out, 0, image_size);
+    out[0] = ESP_IMAGE_HEADER_MAGIC;
+    out[1] = 1;
+    out[PARTITION_IMAGE_HASH_APPENDED_OFFSET] = 1;
+
+    uint32_t load_address = OTA_DROM_ADDRESS;
+    memcpy(out + PARTITION_IMAGE_HEADER_SIZE, &load_address, sizeof(load_address));
+    memcpy(out + PARTITION_IMAGE_HEADER_SIZE + 4, &segment_length, sizeof(segment_length));
+    memcpy(out + PARTITION_APP_DESC_OFFSET, &app_desc, sizeof(app_desc));
+    memcpy(out + PARTITION_APP_DESC_OFFSET + sizeof(app_desc), payload, payload_size);
+
+    uint8_t checksum = OTA_CHECKSUM_SEED;
+    for (uint32_t i = 0; i < segment_length; i++) {
+        checksum ^= out[PARTITION_APP_DESC_OFFSET + i];
+    }
+    out[length | 15] = checksum;
+
+    sha256_context_t context;
+    sha256_init(&context);
+    sha256_update(&context, out, image_size - SHA256_DIGEST_SIZE);
+    sha256_finish(&context, out + image_size - SHA256_DIGEST_SIZE);
+
+    return image_size;
+}
+
+void host_ota_install_running_image(const char *version, const void *payload, size_t payload_size) {
+
+    const esp_partition_t *partition = esp_ota_get_running_partition();
+    size_t size = partition->size;
+    uint8_t *image = host_alloc(size);
+
+    size_t image_size = host_ota_build_image(version, payload, payload_size, image, size);
+    size_t erase_size = (image_size + OTA_SECTOR_SIZE - 1) / OTA_SECTOR_SIZE * OTA_SECTOR_SIZE;
+
+    esp_partition_erase_range(partition, 0, erase_size);
+    esp_partition_write(partition, 0, image, image_size);
+
+    host_free(image);
+}
+
+void host_ota_set_state(const char *label, esp_ota_img_states_t state) {
+
+    int slot = ota_get_slot(host_partition_get(label));
+    if (slot >= 0) {
+        states[slot] = state;
+    }
+}
+
+void host_ota_boot(void) {
+
+    if (states[boot_slot] == ESP_OTA_IMG_NEW) {
+        states[boot_slot] = ESP_OTA_IMG_PENDING_VERIFY;
+    } else if (states[boot_slot] == ESP_OTA_IMG_PENDING_VERIFY) {
+        // never confirmed, the bootloader goes back to the previous image
+        states[boot_slot] = ESP_OTA_IMG_ABORTED;
+        boot_slot = (boot_slot + 1) % OTA_SLOTS_COUNT;
+    }
+
+    running_slot = boot_slot;
+    host_reboot();
+}
@@ -0,0 +1,353 @@
+/*
+ *  Flash partitions of the project partitions.csv, each one held in memory
+ *  and erased to 0xff when first used. Writes clear bits only, as on NOR
+ *  flash, so that data written over unerased sectors shows up corrupted.
+ *  App images are parsed like the bootloader does to find their SHA-256.
+ */
+
+#include "esp_partition.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_app_format.h"
+#include "host.h"
+#include "kernel.h"
+#include "partition.h"
+#include "sha256.h"
+
+#define PARTITIONS_MAX 16
+
+#define SECTOR_SIZE 4096
+
+typedef struct {
+    esp_partition_t partition;
+    uint8_t *data;
+} host_partition_t;
+
+static host_partition_t partitions[PARTITIONS_MAX];
+
+static int partitions_count = -1;
+
+static long write_budget = -1;
+
+static int partition_parse_subtype(const char *type, const char *subtype) {
+
+    static const struct {
+        const char *type;
+        const char *name;
+        int value;
+    } subtypes[] = {
+        { "app", "factory", ESP_PARTITION_SUBTYPE_APP_FACTORY },
+        { "app", "ota_0", ESP_PARTITION_SUBTYPE_APP_OTA_0 },
+        { "app", "ota_1", ESP_PARTITION_SUBTYPE_APP_OTA_1 },
+        { "data", "ota", ESP_PARTITION_SUBTYPE_DATA_OTA },
+        { "data", "phy", ESP_PARTITION_SUBTYPE_DATA_PHY },
+        { "data", "nvs", ESP_PARTITION_SUBTYPE_DATA_NVS },
+        { "data", "nvs_keys", ESP_PARTITION_SUBTYPE_DATA_NVS_KEYS },
+        { "data", "spiffs", ESP_PARTITION_SUBTYPE_DATA_SPIFFS }
+    };
+
+    for (size_t i = 0; i < sizeof(subtypes) / sizeof(subtypes[0]); i++) {
+        if (strcmp(subtypes[i].type, type) == 0 && strcmp(subtypes[i].name, subtype) == 0) {
+            return subtypes[i].value;
+        }
+    }
+
+    return strtol(subtype, NULL, 0);
+}
+
+static char *partition_trim(char *field) {
+
+    while (*field == ' ' || *field == '\t') {
+        field++;
+    }
+
+    char *end = field + strlen(field);
+    while (end > field && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\n' || end[-1] == '\r')) {
+        *--end = '\0';
+    }
+
+    return field;
+}
+
+static void partition_load_table(void) {
+
+    if (partitions_count >= 0) {
+        return;
+    }
+
+    partitions_count = 0;
+
+    FILE *file = fopen(HOST_PARTITIONS_CSV, "r");
+    if (file == NULL) {
+        fprintf(stderr, "host flash: unable to open %s\n", HOST_PARTITIONS_CSV);
+        abort();
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL && partitions_count < PARTITIONS_MAX) {
+
+        char *fields[5];
+        char *cursor = line;
+        int count = 0;
+
+        if (partition_trim(line)[0] == '#') {
+            continue;
+        }
+
+        while (count < 5 && cursor != NULL) {
+            fields[count++] = partition_trim(strsep(&cursor, ","));
+        }
+
+        if (count < 5 || fields[0][0] == '\0') {
+            continue;
+        }
+
+        esp_partition_t *partition = &partitions[partitions_count++].partition;
+        strncpy(partition->label, fields[0], sizeof(partition->label) - 1);
+        partition->type = strcmp(fields[1], "app") == 0 ? ESP_PARTITION_TYPE_APP : ESP_PARTITION_TYPE_DATA;
+        partition->subtype = partition_parse_subtype(fields[1], fields[2]);
+        partition->address = strtoul(fields[3], NULL, 0);
+        partition->size = strtoul(fields[4], NULL, 0);
+    }
+
+    fclose(file);
+}
+
+static host_partition_t *partition_get(const esp_partition_t *partition) {
+
+    host_partition_t *host_partition = (host_partition_t *) partition;
+    if (host_partition->data == NULL) {
+        host_partition->data = host_alloc(partition->size);
+        memset(host_partition->data, 0xff, partition->size);
+    }
+
+    return host_partition;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label) {
+
+    partition_load_table();
+
+    for (int i = 0; i < partitions_count; i++) {
+        esp_partition_t *partition = &partitions[i].partition;
+        if (partition->type == type &&
+            (subtype == ESP_PARTITION_SUBTYPE_ANY || partition->subtype == subtype) &&
+            (label == NULL || strcmp(partition->label, label) == 0)) {
+            return partition;
+        }
+    }
+
+    return NULL;
+}
+
+const esp_partition_t *host_partition_get(const char *label) {
+
+    partition_load_table();
+
+    for (int i = 0; i < partitions_count; i++) {
+        if (strcmp(partitions[i].partition.label, label) == 0) {
+            return &partitions[i].partition;
+        }
+    }
+
+    return NULL;
+}
+
+static bool partition_is_in_bounds(const esp_partition_t *partition, size_t offset, size_t size) {
+    return offset <= partition->size && size <= partition->size - offset;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size) {
+
+    if (partition == NULL || dst == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!partition_is_in_bounds(partition, src_offset, size)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    memcpy(dst, partition_get(partition)->data + src_offset, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size) {
+
+    if (partition == NULL || src == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!partition_is_in_bounds(partition, dst_offset, size)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    size_t written = size;
+    if (write_budget >= 0 && (size_t) write_budget < size) {
+        written = write_budget;
+    }
+
+    uint8_t *data = partition_get(partition)->data + dst_offset;
+    const uint8_t *bytes = src;
+    for (size_t i = 0; i < written; i++) {
+        data[i] &= bytes[i];
+    }
+
+    if (write_budget >= 0) {
+        write_budget -= written;
+    }
+
+    return written == size ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size) {
+
+    if (partition == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (offset % SECTOR_SIZE != 0 || size % SECTOR_SIZE != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!partition_is_in_bounds(partition, offset, size)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    memset(partition_get(partition)->data + offset, 0xff, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t *partition, size_t offset, size_t size,
+        spi_flash_mmap_memory_t memory, const void **out_ptr, spi_flash_mmap_handle_t *out_handle) {
+
+    if (partition == NULL || out_ptr == NULL || out_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!partition_is_in_bounds(partition, offset, size)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    *out_ptr = partition_get(partition)->data + offset;
+    *out_handle = partition->address + offset;
+
+    return ESP_OK;
+}
+
+void spi_flash_munmap(spi_flash_mmap_handle_t handle) {
+}
+
+size_t partition_get_image_length(const esp_partition_t *partition) {
+
+    const uint8_t *data = partition_get(partition)->data;
+    if (data[0] != ESP_IMAGE_HEADER_MAGIC) {
+        return 0;
+    }
+
+    uint8_t segments_count = data[1];
+    size_t offset = PARTITION_IMAGE_HEADER_SIZE;
+
+    for (int i = 0; i < segments_count; i++) {
+        uint32_t length;
+        if (!partition_is_in_bounds(partition, offset, 8)) {
+            return 0;
+        }
+        memcpy(&length, data + offset + 4, sizeof(length));
+        offset += 8 + length;
+        if (!partition_is_in_bounds(partition, offset, 0)) {
+            return 0;
+        }
+    }
+
+    // padding, then the checksum byte ending a 16 bytes block
+    offset = (offset | 15) + 1;
+
+    if (data[PARTITION_IMAGE_HASH_APPENDED_OFFSET] == 1) {
+        offset += SHA256_DIGEST_SIZE;
+    }
+
+    return partition_is_in_bounds(partition, 0, offset) ? offset : 0;
+}
+
+bool partition_verify_image(const esp_partition_t *partition, uint8_t *image_hash) {
+
+    size_t length = partition_get_image_length(partition);
+    const uint8_t *data = partition_get(partition)->data;
+
+    if (length == 0 || data[PARTITION_IMAGE_HASH_APPENDED_OFFSET] != 1) {
+        return false;
+    }
+
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    sha256_context_t context;
+    sha256_init(&context);
+    sha256_update(&context, data, length - SHA256_DIGEST_SIZE);
+    sha256_finish(&context, digest);
+
+    if (memcmp(digest, data + length - SHA256_DIGEST_SIZE, SHA256_DIGEST_SIZE) != 0) {
+        return false;
+    }
+
+    if (image_hash != NULL) {
+        memcpy(image_hash, digest, SHA256_DIGEST_SIZE);
+    }
+
+    return true;
+}
+
+esp_err_t esp_partition_get_sha256(const esp_partition_t *partition, uint8_t *sha_256) {
+
+    if (partition == NULL || sha_256 == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (partition->type == ESP_PARTITION_TYPE_APP) {
+        return partition_verify_image(partition, sha_256) ? ESP_OK : PARTITION_ERR_IMAGE_INVALID;
+    }
+
+    sha256_context_t context;
+    sha256_init(&context);
+    sha256_update(&context, partition_get(partition)->data, partition->size);
+    sha256_finish(&context, sha_256);
+
+    return ESP_OK;
+}
+
+uint8_t *host_partition_data(const char *label) {
+
+    const esp_partition_t *partition = host_partition_get(label);
+    return partition != NULL ? partition_get(partition)->data : NULL;
+}
+
+void host_partition_erase(const char *label) {
+
+    const esp_partition_t *partition = host_partition_get(label);
+    memset(partition_get(partition)->data, 0xff, partition->size);
+}
+
+bool host_partition_load_file(const char *label, const char *path) {
+
+    const esp_partition_t *partition = host_partition_get(label);
+    FILE *file = fopen(path, "rb");
+    if (partition == NULL || file == NULL) {
+        if (file != NULL) {
+            fclose(file);
+        }
+        return false;
+    }
+
+    uint8_t *data = partition_get(partition)->data;
+    memset(data, 0xff, partition->size);
+
+    size_t length = fread(data, 1, partition->size, file);
+    bool is_loaded = length > 0 && fgetc(file) == EOF;
+    fclose(file);
+
+    return is_loaded;
+}
+
+void host_flash_set_write_budget(long budget) {
+    write_budget = budget;
+}
@@ -0,0 +1,30 @@
+#ifndef HOST_PARTITION_H_
+#define HOST_PARTITION_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_partition.h"
+
+// ESP_ERR_IMAGE_INVALID of bootloader_support
+#define PARTITION_ERR_IMAGE_INVALID 0x2001
+
+#define PARTITION_IMAGE_HEADER_SIZE 24
+
+#define PARTITION_IMAGE_HASH_APPENDED_OFFSET 23
+
+// the application description leads the first segment
+#define PARTITION_APP_DESC_OFFSET (PARTITION_IMAGE_HEADER_SIZE + 8)
+
+/**
+ * Length of the app image at the start of the partition, SHA-256 included,
+ * 0 when there is no image
+ */
+size_t partition_get_image_length(const esp_partition_t *partition);
+
+/**
+ * Check the SHA-256 appended to the app image, copied to image_hash if set
+ */
+bool partition_verify_image(const esp_partition_t *partition, uint8_t *image_hash);
+
+#endif
@@ -0,0 +1,98 @@
+/*
+ *  RMT receive channels. A frame set by the test is pushed into the channel
+ *  ring buffer as one item when reception starts, as the peripheral does
+ *  once the line stays idle past the threshold.
+ */
+
+#include "driver/rmt.h"
+
+#include <string.h>
+#include "host.h"
+#include "kernel.h"
+
+#define RMT_FRAME_MAX_ITEMS 128
+
+typedef struct {
+    bool is_configured;
+    RingbufHandle_t ringbuf;
+    rmt_item32_t frame[RMT_FRAME_MAX_ITEMS];
+    size_t frame_count;
+} rmt_host_channel_t;
+
+static rmt_host_channel_t channels[RMT_CHANNEL_MAX];
+
+esp_err_t rmt_config(const rmt_config_t *rmt_param) {
+
+    if (rmt_param == NULL || rmt_param->channel >= RMT_CHANNEL_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    channels[rmt_param->channel].is_configured = true;
+    return ESP_OK;
+}
+
+esp_err_t rmt_driver_install(rmt_channel_t channel, size_t rx_buf_size, int intr_alloc_flags) {
+
+    if (channel >= RMT_CHANNEL_MAX || !channels[channel].is_configured) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (channels[channel].ringbuf != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    channels[channel].ringbuf = xRingbufferCreate(rx_buf_size, RINGBUF_TYPE_NOSPLIT);
+    return channels[channel].ringbuf != NULL ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t rmt_driver_uninstall(rmt_channel_t channel) {
+
+    if (channel >= RMT_CHANNEL_MAX || channels[channel].ringbuf == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    vRingbufferDelete(channels[channel].ringbuf);
+    channels[channel].ringbuf = NULL;
+
+    return ESP_OK;
+}
+
+esp_err_t rmt_get_ringbuf_handle(rmt_channel_t channel, RingbufHandle_t *buf_handle) {
+
+    if (channel >= RMT_CHANNEL_MAX || buf_handle == NULL || channels[channel].ringbuf == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *buf_handle = channels[channel].ringbuf;
+    return ESP_OK;
+}
+
+esp_err_t rmt_rx_start(rmt_channel_t channel, bool rx_idx_rst) {
+
+    if (channel >= RMT_CHANNEL_MAX || channels[channel].ringbuf == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    rmt_host_channel_t *host_channel = &channels[channel];
+    if (host_channel->frame_count > 0) {
+        BaseType_t is_task_woken;
+        xRingbufferSendFromISR(host_channel->ringbuf, host_channel->frame,
+            host_channel->frame_count * sizeof(rmt_item32_t), &is_task_woken);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t rmt_rx_stop(rmt_channel_t channel) {
+    return channel < RMT_CHANNEL_MAX ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+void host_rmt_set_frame(rmt_channel_t channel, const rmt_item32_t *items, size_t count) {
+
+    if (count > RMT_FRAME_MAX_ITEMS) {
+        count = RMT_FRAME_MAX_ITEMS;
+    }
+
+    memcpy(channels[channel].frame, items, count * sizeof(rmt_item32_t));
+    channels[channel].frame_count = count;
+}
@@ -0,0 +1,22 @@
+#ifndef HOST_SHA256_H_
+#define HOST_SHA256_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_DIGEST_SIZE 32
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;
+    uint8_t block[64];
+    size_t block_length;
+} sha256_context_t;
+
+void sha256_init(sha256_context_t *context);
+
+void sha256_update(sha256_context_t *context, const void *data, size_t length);
+
+void sha256_finish(sha256_context_t *context, uint8_t digest[SHA256_DIGEST_SIZE]);
+
+#endif
@@ -0,0 +1,325 @@
+/*
+ *  Log, random numbers, restarts, deep sleep, wall clock and SNTP, CRC32 and
+ *  the few libc functions newlib has and glibc lacks.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_sleep.h"
+#include "esp_sntp.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "xtensa/hal.h"
+#include "kernel.h"
+#include "host.h"
+
+static esp_log_level_t log_level = ESP_LOG_WARN;
+
+static uint32_t random_state = 0x2545F491;
+
+static int restart_count = 0;
+
+static esp_reset_reason_t reset_reason = ESP_RST_POWERON;
+
+static esp_sleep_wakeup_cause_t wakeup_cause = ESP_SLEEP_WAKEUP_UNDEFINED;
+
+static uint64_t ext1_wakeup_status = 0;
+
+static host_sleep_t pending_sleep = { .ext0_gpio = -1 };
+
+static host_sleep_t last_sleep = { .ext0_gpio = -1 };
+
+// wall clock minus virtual time, in microseconds
+static int64_t clock_offset_us = 0;
+
+static sntp_sync_status_t sync_status = SNTP_SYNC_STATUS_RESET;
+
+static sntp_sync_time_cb_t sync_callback = NULL;
+
+static uint32_t wifi_connection_attempts = 0;
+
+void host_system_init(void) {
+
+    // the target has no time zone set either
+    setenv("TZ", "UTC", 1);
+    tzset();
+
+    const char *level = getenv("HOST_LOG_LEVEL");
+    if (level != NULL) {
+        log_level = atoi(level);
+    }
+}
+
+const char *esp_err_to_name(esp_err_t code) {
+
+    switch (code) {
+        case ESP_OK: return "ESP_OK";
+        case ESP_FAIL: return "ESP_FAIL";
+        case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_INVALID_RESPONSE: return "ESP_ERR_INVALID_RESPONSE";
+        case ESP_ERR_INVALID_CRC: return "ESP_ERR_INVALID_CRC";
+        case ESP_ERR_INVALID_VERSION: return "ESP_ERR_INVALID_VERSION";
+        default: return "UNKNOWN ERROR";
+    }
+}
+
+int host_log_is_enabled(esp_log_level_t level) {
+    return level <= log_level;
+}
+
+void host_log_set_level(esp_log_level_t level) {
+    log_level = level;
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level) {
+}
+
+uint32_t esp_log_timestamp(void) {
+    return esp_timer_get_time() / 1000;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...) {
+
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
+
+uint32_t esp_random(void) {
+
+    // xorshift32, reproducible across runs
+    kernel_lock();
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    uint32_t value = random_state;
+    kernel_unlock();
+
+    return value;
+}
+
+void esp_fill_random(void *buf, size_t len) {
+
+    uint8_t *bytes = buf;
+    for (size_t i = 0; i < len; i++) {
+        bytes[i] = esp_random();
+    }
+}
+
+void host_random_seed(uint32_t seed) {
+    random_state = seed != 0 ? seed : 1;
+}
+
+void esp_restart(void) {
+
+    kernel_lock();
+    restart_count++;
+    reset_reason = ESP_RST_SW;
+    kernel_terminate_self();
+    kernel_unlock();
+}
+
+int host_get_restart_count(void) {
+    return restart_count;
+}
+
+esp_reset_reason_t esp_reset_reason(void) {
+    return reset_reason;
+}
+
+void host_set_reset_reason(esp_reset_reason_t reason) {
+    reset_reason = reason;
+}
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause(void) {
+    return wakeup_cause;
+}
+
+void host_sleep_set_wakeup_cause(esp_sleep_wakeup_cause_t cause) {
+    wakeup_cause = cause;
+}
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us) {
+
+    pending_sleep.timer_us = time_in_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_ext0_wakeup(gpio_num_t gpio_num, int level) {
+
+    pending_sleep.ext0_gpio = gpio_num;
+    pending_sleep.ext0_level = level;
+    return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_ext1_wakeup(uint64_t mask, esp_sleep_ext1_wakeup_mode_t mode) {
+
+    pending_sleep.ext1_mask = mask;
+    pending_sleep.ext1_mode = mode;
+    return ESP_OK;
+}
+
+esp_err_t esp_sleep_disable_wakeup_source(esp_sleep_source_t source) {
+
+    if (source == ESP_SLEEP_WAKEUP_TIMER) {
+        pending_sleep.timer_us = 0;
+    } else if (source == ESP_SLEEP_WAKEUP_EXT0) {
+        pending_sleep.ext0_gpio = -1;
+    } else if (source == ESP_SLEEP_WAKEUP_EXT1) {
+        pending_sleep.ext1_mask = 0;
+    }
+
+    return ESP_OK;
+}
+
+uint64_t esp_sleep_get_ext1_wakeup_status(void) {
+    return ext1_wakeup_status;
+}
+
+void host_sleep_set_ext1_status(uint64_t status) {
+    ext1_wakeup_status = status;
+}
+
+void esp_deep_sleep_start(void) {
+
+    kernel_lock();
+    last_sleep = pending_sleep;
+    last_sleep.count++;
+    pending_sleep = (host_sleep_t) { .ext0_gpio = -1, .count = last_sleep.count };
+    reset_reason = ESP_RST_DEEPSLEEP;
+    kernel_terminate_self();
+    kernel_unlock();
+}
+
+const host_sleep_t *host_sleep_get_last(void) {
+    return &last_sleep;
+}
+
+static int64_t system_get_wall_clock_us(void) {
+    return host_now_us() + clock_offset_us;
+}
+
+void host_clock_set_epoch_ms(int64_t epoch_ms) {
+    clock_offset_us = epoch_ms * 1000 - host_now_us();
+}
+
+time_t __wrap_time(time_t *out) {
+
+    time_t now = system_get_wall_clock_us() / 1000000;
+    if (out != NULL) {
+        *out = now;
+    }
+
+    return now;
+}
+
+int __wrap_gettimeofday(struct timeval *tv, void *tz) {
+
+    int64_t now = system_get_wall_clock_us();
+    tv->tv_sec = now / 1000000;
+    tv->tv_usec = now % 1000000;
+
+    return 0;
+}
+
+int __wrap_settimeofday(const struct timeval *tv, const struct timezone *tz) {
+
+    clock_offset_us = (int64_t) tv->tv_sec * 1000000 + tv->tv_usec - host_now_us();
+    return 0;
+}
+
+void sntp_setoperatingmode(uint8_t operating_mode) {
+}
+
+void sntp_setservername(uint8_t idx, const char *server) {
+}
+
+void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t callback) {
+    sync_callback = callback;
+}
+
+void sntp_init(void) {
+}
+
+void sntp_stop(void) {
+}
+
+sntp_sync_status_t sntp_get_sync_status(void) {
+
+    // reset once read, as lwIP SNTP does
+    sntp_sync_status_t status = sync_status;
+    if (status == SNTP_SYNC_STATUS_COMPLETED) {
+        sync_status = SNTP_SYNC_STATUS_RESET;
+    }
+
+    return status;
+}
+
+void host_sntp_sync(int64_t epoch_ms) {
+
+    host_clock_set_epoch_ms(epoch_ms);
+    sync_status = SNTP_SYNC_STATUS_COMPLETED;
+
+    if (sync_callback != NULL) {
+        struct timeval now;
+        __wrap_gettimeofday(&now, NULL);
+        sync_callback(&now);
+    }
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+
+    return ~crc;
+}
+
+uint32_t xthal_get_ccount(void) {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+
+    return (uint64_t) now.tv_sec * 240000000ULL + (uint64_t) now.tv_nsec * 240 / 1000;
+}
+
+#ifndef HOST_HAVE_STRLCPY
+size_t strlcpy(char *dst, const char *src, size_t size) {
+
+    size_t length = strlen(src);
+    if (size > 0) {
+        size_t copied = length < size - 1 ? length : size - 1;
+        memcpy(dst, src, copied);
+        dst[copied] = '\0';
+    }
+
+    return length;
+}
+#endif
+
+uint32_t wifi_manager_get_connection_attempts(void) {
+    return wifi_connection_attempts;
+}
+
+void host_wifi_set_connection_attempts(uint32_t attempts) {
+    wifi_connection_attempts = attempts;
+}
@@ -0,0 +1,75 @@
+/*
+ *  Start the data sender as main.c does: device and security partitions,
+ *  storage, MQTT connected to the broker stand-in.
+ */
+
+#ifndef HOST_TESTS_DATA_SENDER_SETUP_H_
+#define HOST_TESTS_DATA_SENDER_SETUP_H_
+
+extern "C" {
+#include "data-sender.h"
+#include "device-helper.h"
+#include "mqtt-manager.h"
+#include "storage-manager.h"
+#include "esp_event.h"
+#include "host.h"
+}
+
+namespace data_sender_setup {
+
+inline void load_certificates(mqtt_certificates_t *certificates) {
+
+    certificates->ca_cert = device_helper_get_ca_cert();
+    certificates->device_cert = device_helper_get_device_cert();
+    certificates->device_key = device_helper_get_device_key();
+}
+
+inline bool is_connected(void *) {
+    return mqtt_manager_is_connected();
+}
+
+inline bool load_partitions() {
+
+    return host_partition_load_file("device", HOST_FIXTURES_DIR "/device.bin") &&
+        host_partition_load_file("security", HOST_FIXTURES_DIR "/security.bin") &&
+        storage_manager_init();
+}
+
+inline bool start() {
+
+    if (esp_event_loop_create_default() != ESP_OK ||
+        mqtt_manager_init(load_certificates) != ESP_OK ||
+        mqtt_manager_connect() != ESP_OK) {
+        return false;
+    }
+
+    return host_run_until(is_connected, NULL, 10, 1000) && data_sender_init();
+}
+
+inline telemetry_sample_t pms_sample(int64_t timestamp, sample_clock_t clock) {
+
+    telemetry_sample_t sample = {};
+    sample.type = POLLUTION_SAMPLE;
+    sample.clock = clock;
+    sample.timestamp = timestamp;
+    sample.pollution = {12, 25, 31, 2100, 640, 120, 18, 4, 1};
+    return sample;
+}
+
+inline telemetry_sample_t float_sample(sample_type_t type, float value, int64_t timestamp, sample_clock_t clock) {
+
+    telemetry_sample_t sample = {};
+    sample.type = type;
+    sample.clock = clock;
+    sample.timestamp = timestamp;
+    if (type == TEMPERATURE_SAMPLE) {
+        sample.temperature = value;
+    } else {
+        sample.humidity = value;
+    }
+    return sample;
+}
+
+}
+
+#endif
@@ -0,0 +1,199 @@
+/*
+ *  App images and delta patches for tests and benchmarks: payloads shaped
+ *  like firmware, the edits a new build makes to them, patches generated by
+ *  deltagen.py and applied by the delta-patch decoder from memory.
+ */
+
+#ifndef HOST_TESTS_DELTA_IMAGES_H_
+#define HOST_TESTS_DELTA_IMAGES_H_
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "delta-patch.h"
+#include "host.h"
+}
+
+namespace delta_images {
+
+typedef std::vector<uint8_t> bytes_t;
+
+/**
+ * Code like payload: instruction words drawn from a small set, with a
+ * sprinkle of literals
+ */
+inline bytes_t build_payload(uint32_t seed, size_t size) {
+
+    std::mt19937 generator(seed);
+    std::vector<uint32_t> words(512);
+    for (uint32_t &word : words) {
+        word = generator();
+    }
+
+    bytes_t payload(size);
+    for (size_t i = 0; i + 4 <= size; i += 4) {
+        uint32_t word = generator() % 8 == 0 ? generator() : words[generator() % words.size()];
+        memcpy(&payload[i], &word, 4);
+    }
+    return payload;
+}
+
+/**
+ * The payload of a new build: functions inserted and removed, constants
+ * changed, and the addresses of a region moved by the inserted code
+ */
+inline bytes_t edit_payload(const bytes_t &payload, uint32_t seed, int edits) {
+
+    std::mt19937 generator(seed);
+    bytes_t edited = payload;
+
+    for (int i = 0; i < edits; i++) {
+        size_t position = generator() % (edited.size() + 1);
+        size_t length = 1 + generator() % 256;
+        switch (generator() % 4) {
+            case 0: {
+                bytes_t inserted = build_payload(generator(), length);
+                edited.insert(edited.begin() + position, inserted.begin(), inserted.end());
+                break;
+            }
+            case 1:
+                length = std::min(length, edited.size() - position);
+                edited.erase(edited.begin() + position, edited.begin() + position + length);
+                break;
+            case 2:
+                if (position < edited.size()) {
+                    edited[position] ^= 1 + generator() % 255;
+                }
+                break;
+            default: {
+                uint32_t shift = 4 * (1 + generator() % 64);
+                size_t end = std::min(edited.size(), position + 4 * length);
+                for (size_t j = position; j + 4 <= end; j += 4) {
+                    uint32_t word;
+                    memcpy(&word, &edited[j], 4);
+                    word += shift;
+                    memcpy(&edited[j], &word, 4);
+                }
+                break;
+            }
+        }
+    }
+    return edited;
+}
+
+inline bytes_t build_image(const char *version, const bytes_t &payload) {
+
+    bytes_t image(payload.size() + 1024);
+    image.resize(host_ota_build_image(version, payload.data(), payload.size(), image.data(), image.size()));
+    return image;
+}
+
+inline bool write_file(const std::string &path, const bytes_t &data) {
+
+    std::ofstream file(path, std::ios::binary);
+    file.write((const char *) data.data(), data.size());
+    return file.good();
+}
+
+inline bytes_t read_file(const std::string &path) {
+
+    std::ifstream file(path, std::ios::binary);
+    return bytes_t(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+/**
+ * Patch from source to target generated by deltagen.py, empty on failure
+ */
+inline bytes_t generate_patch(const bytes_t &source, const bytes_t &target) {
+
+    char directory[] = "/tmp/delta-images-XXXXXX";
+    if (mkdtemp(directory) == NULL) {
+        return {};
+    }
+
+    std::string base(directory);
+    bytes_t patch;
+    if (write_file(base + "/source.bin", source) && write_file(base + "/target.bin", target)) {
+        std::string command = std::string(HOST_PYTHON " " HOST_SOURCE_DIR "/../components/delta-patch/deltagen.py diff ") +
+            base + "/source.bin " + base + "/target.bin " + base + "/patch.bin > /dev/null";
+        if (std::system(command.c_str()) == 0) {
+            patch = read_file(base + "/patch.bin");
+        }
+    }
+
+    std::system(("rm -rf " + base).c_str());
+    return patch;
+}
+
+/**
+ * Source image and rebuilt target as seen by the decoder callbacks
+ */
+struct apply_context_t {
+    const bytes_t *source;
+    bytes_t target;
+    uint32_t source_reads;
+    uint32_t source_bytes;
+    esp_err_t write_error;
+};
+
+inline esp_err_t read_source(void *context, uint32_t offset, void *data, size_t length) {
+
+    apply_context_t *apply = static_cast<apply_context_t *>(context);
+    if (offset + length > apply->source->size()) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    memcpy(data, apply->source->data() + offset, length);
+    apply->source_reads++;
+    apply->source_bytes += length;
+    return ESP_OK;
+}
+
+inline esp_err_t write_target(void *context, const void *data, size_t length) {
+
+    apply_context_t *apply = static_cast<apply_context_t *>(context);
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    apply->target.insert(apply->target.end(), bytes, bytes + length);
+    return apply->write_error;
+}
+
+/**
+ * Feed the patch body to decoder in chunks of the sizes returned by
+ * next_chunk, as the download loop of ota-manager does, then finish it
+ */
+template <typename F>
+esp_err_t apply_patch(delta_patch_t *decoder, const bytes_t &patch, apply_context_t *context, F next_chunk) {
+
+    delta_patch_header_t header;
+    if (!delta_patch_parse_header(patch.data(), patch.size(), &header)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    delta_patch_init(decoder, &header, read_source, write_target, context);
+
+    size_t offset = DELTA_PATCH_HEADER_SIZE;
+    while (offset < patch.size()) {
+        size_t length = std::min<size_t>(next_chunk(), patch.size() - offset);
+        esp_err_t err = delta_patch_feed(decoder, patch.data() + offset, length);
+        if (err != ESP_OK) {
+            return err;
+        }
+        offset += length;
+    }
+
+    return delta_patch_finish(decoder);
+}
+
+}
+
+#endif
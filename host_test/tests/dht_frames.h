@@ -0,0 +1,115 @@
+/*
+ *  DHT frames for tests and benchmarks: pulse traces as captured on the data
+ *  line, from the sensor response on, and the RMT items they are received as.
+ */
+
+#ifndef HOST_TESTS_DHT_FRAMES_H_
+#define HOST_TESTS_DHT_FRAMES_H_
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "dht-decoder.h"
+#include "driver/rmt.h"
+}
+
+namespace dht_frames {
+
+/**
+ * AM2301 payload: humidity and temperature in tenths, the temperature sign
+ * in the top bit, then the checksum
+ */
+inline std::vector<uint8_t> am2301_data(int humidity_tenths, int temperature_tenths) {
+
+    uint16_t temperature = temperature_tenths < 0 ? (0x8000 | -temperature_tenths) : temperature_tenths;
+    std::vector<uint8_t> data = {
+        (uint8_t) (humidity_tenths >> 8), (uint8_t) humidity_tenths,
+        (uint8_t) (temperature >> 8), (uint8_t) temperature
+    };
+    data.push_back((uint8_t) (data[0] + data[1] + data[2] + data[3]));
+
+    return data;
+}
+
+/**
+ * Pulses of a frame with datasheet timings: the line released by the host,
+ * the 80us response, 40 bits of 50us low then 26us or 70us high, the end
+ * of frame. Durations vary by up to jitter microseconds.
+ */
+inline std::vector<dht_pulse_t> build_pulses(const std::vector<uint8_t> &data, int jitter = 0, unsigned seed = 1) {
+
+    auto vary = [&](int duration) {
+        return (uint16_t) (jitter > 0 ? duration + (int) (rand_r(&seed) % (2 * jitter + 1)) - jitter : duration);
+    };
+
+    std::vector<dht_pulse_t> pulses = {{1, vary(30)}, {0, vary(80)}, {1, vary(80)}};
+
+    for (int bit = 0; bit < DHT_DATA_BITS; bit++) {
+        bool is_one = data[bit / 8] & (0x80 >> (bit % 8));
+        pulses.push_back({0, vary(50)});
+        pulses.push_back({1, vary(is_one ? 70 : 26)});
+    }
+
+    pulses.push_back({0, vary(50)});
+
+    return pulses;
+}
+
+/**
+ * Trace file: one "level duration" pair per line, # starts a comment
+ */
+inline std::vector<dht_pulse_t> load_trace(const std::string &path) {
+
+    std::vector<dht_pulse_t> pulses;
+
+    FILE *f = fopen(path.c_str(), "r");
+    if (f == NULL) {
+        return pulses;
+    }
+
+    char line[128];
+    while (fgets(line, sizeof(line), f) != NULL) {
+        unsigned level, duration;
+        if (line[0] != '#' && sscanf(line, "%u %u", &level, &duration) == 2) {
+            pulses.push_back({(uint8_t) level, (uint16_t) duration});
+        }
+    }
+
+    fclose(f);
+
+    return pulses;
+}
+
+/**
+ * RMT items of a trace, two pulses per item, closed by a zero duration
+ */
+inline std::vector<rmt_item32_t> to_rmt_items(const std::vector<dht_pulse_t> &pulses) {
+
+    std::vector<rmt_item32_t> items;
+
+    for (size_t i = 0; i < pulses.size(); i += 2) {
+        rmt_item32_t item = {};
+        item.level0 = pulses[i].level;
+        item.duration0 = pulses[i].duration;
+        if (i + 1 < pulses.size()) {
+            item.level1 = pulses[i + 1].level;
+            item.duration1 = pulses[i + 1].duration;
+        }
+        items.push_back(item);
+    }
+
+    if (pulses.size() % 2 == 0) {
+        rmt_item32_t end = {};
+        end.level0 = 1;
+        items.push_back(end);
+    }
+
+    return items;
+}
+
+}
+
+#endif
@@ -0,0 +1,181 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "acquisition-scheduler.h"
+#include "freertos/FreeRTOS.h"
+#include "host.h"
+}
+
+namespace {
+
+struct event_t {
+    std::string what;
+    int64_t at_ms;
+};
+
+std::vector<event_t> events;
+
+// the task wakes up on the tick following a deadline, a window waiting for
+// a warm up started on such a tick is read one tick later
+const int64_t TICK_MS = portTICK_PERIOD_MS;
+
+void record(const std::string &what) {
+    events.push_back({what, host_now_us() / 1000});
+}
+
+bool sink(const telemetry_sample_t *sample) {
+    return true;
+}
+
+esp_err_t pms_prepare() {
+    record("pms prepare");
+    return ESP_OK;
+}
+
+esp_err_t pms_read(sample_sink_f sink) {
+    record("pms read");
+    return ESP_OK;
+}
+
+esp_err_t dht_read(sample_sink_f sink) {
+    record("dht read");
+    return ESP_OK;
+}
+
+esp_err_t slow_prepare() {
+    record("slow prepare");
+    return ESP_OK;
+}
+
+esp_err_t slow_read(sample_sink_f sink) {
+    record("slow read");
+    return ESP_OK;
+}
+
+// as the drivers of sensor-drivers.c
+const sensor_driver_t pms_driver = {"pms", 300000, 0, 30000, NULL, pms_prepare, pms_read};
+
+const sensor_driver_t dht_driver = {"dht", 30000, 10000, 0, NULL, NULL, dht_read};
+
+std::vector<int64_t> times_of(const std::string &what) {
+
+    std::vector<int64_t> times;
+    for (const event_t &event : events) {
+        if (event.what == what) {
+            times.push_back(event.at_ms);
+        }
+    }
+    return times;
+}
+
+}
+
+TEST(acquisition_scheduler, prepares_a_sensor_ahead_of_its_own_read) {
+
+    // the DHT window at 280s comes after the start of the PMS warm up at 270s
+    const sensor_driver_t dht = {"dht", 40000, 10000, 0, NULL, NULL, dht_read};
+    ASSERT_TRUE(acquisition_scheduler_register(&pms_driver));
+    ASSERT_TRUE(acquisition_scheduler_register(&dht));
+    ASSERT_TRUE(acquisition_scheduler_start(sink));
+
+    host_run_for_ms(3 * 300000 + 1000);
+
+    std::vector<int64_t> pms_prepares = times_of("pms prepare");
+    std::vector<int64_t> pms_reads = times_of("pms read");
+    ASSERT_EQ(pms_prepares.size(), 3u);
+    ASSERT_EQ(pms_reads.size(), 3u);
+    for (int i = 0; i < 3; i++) {
+        EXPECT_GE(pms_prepares[i], (i + 1) * 300000 - 30000);
+        EXPECT_LE(pms_prepares[i], (i + 1) * 300000 - 30000 + TICK_MS);
+        EXPECT_GE(pms_reads[i], pms_prepares[i] + 30000);
+        EXPECT_LE(pms_reads[i], (i + 1) * 300000 + 2 * TICK_MS);
+    }
+
+    // no DHT read waits for the PMS warm up
+    std::vector<int64_t> dht_reads = times_of("dht read");
+    ASSERT_EQ(dht_reads.size(), 22u);
+    for (size_t i = 0; i < dht_reads.size(); i++) {
+        int64_t scheduled = (int64_t) (i + 1) * 40000;
+        EXPECT_GE(dht_reads[i], scheduled - 10000) << i;
+        EXPECT_LE(dht_reads[i], scheduled + 2 * TICK_MS) << i;
+    }
+}
+
+TEST(acquisition_scheduler, anticipates_reads_within_jitter_only) {
+
+    // DHT reads at 30s steps join the PMS ones at 95s steps when 10s apart at most
+    const sensor_driver_t pms = {"pms", 95000, 0, 5000, NULL, pms_prepare, pms_read};
+    ASSERT_TRUE(acquisition_scheduler_register(&pms));
+    ASSERT_TRUE(acquisition_scheduler_register(&dht_driver));
+    ASSERT_TRUE(acquisition_scheduler_start(sink));
+
+    host_run_for_ms(600000);
+
+    std::vector<int64_t> pms_reads = times_of("pms read");
+    std::vector<int64_t> dht_reads = times_of("dht read");
+    ASSERT_FALSE(dht_reads.empty());
+
+    for (size_t i = 0; i < pms_reads.size(); i++) {
+        EXPECT_GE(pms_reads[i], (int64_t) (i + 1) * 95000) << i;
+        EXPECT_LE(pms_reads[i], (int64_t) (i + 1) * 95000 + 2 * TICK_MS) << i;
+    }
+
+    bool is_shared = false;
+    for (size_t i = 0; i < dht_reads.size(); i++) {
+        int64_t scheduled = (int64_t) (i + 1) * 30000;
+        // early by the jitter at most, never late
+        EXPECT_GE(dht_reads[i], scheduled - 10000) << i;
+        EXPECT_LE(dht_reads[i], scheduled + 2 * TICK_MS) << i;
+        for (int64_t pms_read : pms_reads) {
+            is_shared |= pms_read == dht_reads[i] && dht_reads[i] < scheduled;
+        }
+    }
+    EXPECT_TRUE(is_shared);
+}
+
+TEST(acquisition_scheduler, bounds_the_wait_for_a_late_warm_up) {
+
+    // warm up longer than the interval, the sensor can't be ready in time
+    const sensor_driver_t slow = {"slow", 10000, 0, 15000, NULL, slow_prepare, slow_read};
+    ASSERT_TRUE(acquisition_scheduler_register(&slow));
+    ASSERT_TRUE(acquisition_scheduler_register(&dht_driver));
+    ASSERT_TRUE(acquisition_scheduler_start(sink));
+
+    host_run_for_ms(31000);
+
+    std::vector<int64_t> slow_reads = times_of("slow read");
+    ASSERT_FALSE(slow_reads.empty());
+    EXPECT_GE(slow_reads[0], 10000 + ACQUISITION_SCHEDULER_MAX_LATENESS_MS);
+    EXPECT_LE(slow_reads[0], 10000 + ACQUISITION_SCHEDULER_MAX_LATENESS_MS + TICK_MS);
+
+    std::vector<int64_t> dht_reads = times_of("dht read");
+    ASSERT_FALSE(dht_reads.empty());
+    EXPECT_LE(dht_reads[0], 30000 + ACQUISITION_SCHEDULER_MAX_LATENESS_MS + TICK_MS);
+}
+
+TEST(acquisition_scheduler, reads_every_sensor_right_away_when_started_now) {
+
+    ASSERT_TRUE(acquisition_scheduler_register(&pms_driver));
+    ASSERT_TRUE(acquisition_scheduler_register(&dht_driver));
+    ASSERT_TRUE(acquisition_scheduler_start_now(sink));
+
+    host_run_for_ms(30000 + 300000 + 1000);
+
+    // warmed up from the start, then on the timebase of the first window
+    std::vector<int64_t> pms_prepares = times_of("pms prepare");
+    std::vector<int64_t> pms_reads = times_of("pms read");
+    ASSERT_EQ(pms_reads.size(), 2u);
+    ASSERT_FALSE(pms_prepares.empty());
+    EXPECT_LE(pms_prepares[0], TICK_MS);
+    EXPECT_GE(pms_reads[0], 30000);
+    EXPECT_LE(pms_reads[0], 30000 + 2 * TICK_MS);
+    EXPECT_GE(pms_reads[1], 330000);
+    EXPECT_LE(pms_reads[1], 330000 + 2 * TICK_MS);
+
+    std::vector<int64_t> dht_reads = times_of("dht read");
+    ASSERT_FALSE(dht_reads.empty());
+    EXPECT_EQ(dht_reads[0], pms_reads[0]);
+}
@@ -0,0 +1,219 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+extern "C" {
+#include "sdkconfig.h"
+#include "aggregator.h"
+#include "host.h"
+}
+
+namespace {
+
+const uint32_t WINDOW_MS = CONFIG_TELEMETRY_AGGREGATION_WINDOW * 1000;
+
+// as aggregator.c
+const int EXACT_VALUES = 32;
+
+const int SEEDS = 100;
+
+std::vector<summary_data_t> summaries;
+
+bool summary_sink(const telemetry_sample_t *sample) {
+
+    if (sample->type == SUMMARY_SAMPLE) {
+        summaries.push_back(sample->summary);
+    }
+    return true;
+}
+
+telemetry_sample_t temperature_sample(float value) {
+
+    telemetry_sample_t sample = {};
+    sample.timestamp = host_now_us() / 1000;
+    sample.clock = SAMPLE_CLOCK_MONOTONIC;
+    sample.type = TEMPERATURE_SAMPLE;
+    sample.temperature = value;
+    return sample;
+}
+
+/**
+ * Temperature summary of a window holding values, closed by a sample of the
+ * next window
+ */
+summary_data_t summarize(const std::vector<float> &values) {
+
+    summaries.clear();
+    aggregator_init(summary_sink);
+
+    for (float value : values) {
+        telemetry_sample_t sample = temperature_sample(value);
+        aggregator_add_sample(&sample);
+    }
+
+    host_run_for_ms(WINDOW_MS);
+    telemetry_sample_t sample = temperature_sample(0);
+    aggregator_add_sample(&sample);
+
+    EXPECT_EQ(summaries.size(), 1u);
+    return summaries.empty() ? summary_data_t{} : summaries.back();
+}
+
+float get_nearest_rank(std::vector<float> values, double quantile) {
+
+    std::sort(values.begin(), values.end());
+    size_t rank = (size_t) std::ceil(quantile * values.size());
+    return values[rank > 0 ? rank - 1 : 0];
+}
+
+/**
+ * Fraction of the values below estimate, ties counted for half
+ */
+double get_rank(std::vector<float> values, float estimate) {
+
+    std::sort(values.begin(), values.end());
+    auto lower = std::lower_bound(values.begin(), values.end(), estimate);
+    auto upper = std::upper_bound(values.begin(), values.end(), estimate);
+    return ((lower - values.begin()) + (upper - values.begin())) / 2.0 / values.size();
+}
+
+template <typename D>
+std::vector<float> draw(D distribution, uint32_t seed, int count) {
+
+    std::mt19937 generator(seed);
+    std::vector<float> values(count);
+    for (float &value : values) {
+        value = distribution(generator);
+    }
+    return values;
+}
+
+struct rank_error_t {
+    double mean;
+    double worst;
+};
+
+void add_rank_error(rank_error_t *error, double value) {
+
+    error->mean += value / SEEDS;
+    error->worst = std::max(error->worst, value);
+}
+
+/**
+ * Bounds on the rank error of the estimates over windows drawn from
+ * distribution, on the mean over the seeds and on the worst seed: the
+ * estimator is tight on average but a few windows of a few dozens of values
+ * stray further
+ */
+template <typename D>
+void expect_rank_errors(const char *name, D distribution) {
+
+    const struct {
+        int count;
+        double mean;
+        double worst;
+    } bounds[] = {
+        // just past the exact values, and an hour of temperature readings
+        { EXACT_VALUES + 8, 0.03, 0.2 },
+        { 120, 0.03, 0.2 },
+        { 1000, 0.01, 0.07 },
+    };
+
+    for (const auto &bound : bounds) {
+        rank_error_t p50 = {};
+        rank_error_t p90 = {};
+        for (int seed = 1; seed <= SEEDS; seed++) {
+            std::vector<float> values = draw(distribution, seed, bound.count);
+            summary_data_t summary = summarize(values);
+            add_rank_error(&p50, std::fabs(get_rank(values, summary.p50) - 0.5));
+            add_rank_error(&p90, std::fabs(get_rank(values, summary.p90) - 0.9));
+        }
+
+        EXPECT_LE(p50.mean, bound.mean) << name << " p50 of " << bound.count;
+        EXPECT_LE(p50.worst, bound.worst) << name << " p50 of " << bound.count;
+        EXPECT_LE(p90.mean, bound.mean) << name << " p90 of " << bound.count;
+        EXPECT_LE(p90.worst, bound.worst) << name << " p90 of " << bound.count;
+    }
+}
+
+}
+
+TEST(aggregator, summarizes_a_window_exactly_besides_quantiles) {
+
+    std::vector<float> values = draw(std::normal_distribution<float>(21, 3), 7, 500);
+    summary_data_t summary = summarize(values);
+
+    double mean = 0;
+    for (float value : values) {
+        mean += value;
+    }
+    mean /= values.size();
+    double m2 = 0;
+    for (float value : values) {
+        m2 += (value - mean) * (value - mean);
+    }
+
+    EXPECT_EQ(summary.metric, AGGREGATE_TEMPERATURE);
+    EXPECT_EQ(summary.count, values.size());
+    EXPECT_EQ(summary.window_length, (uint32_t) CONFIG_TELEMETRY_AGGREGATION_WINDOW);
+    EXPECT_EQ(summary.min, *std::min_element(values.begin(), values.end()));
+    EXPECT_EQ(summary.max, *std::max_element(values.begin(), values.end()));
+    EXPECT_NEAR(summary.mean, mean, 1e-4);
+    EXPECT_NEAR(summary.stddev, std::sqrt(m2 / (values.size() - 1)), 1e-4);
+}
+
+TEST(aggregator, gives_nearest_rank_quantiles_of_short_windows) {
+
+    summary_data_t summary = summarize({ 5, 1, 4, 2, 3 });
+    EXPECT_EQ(summary.p50, 3);
+    EXPECT_EQ(summary.p90, 5);
+
+    for (int count = 1; count <= EXACT_VALUES; count++) {
+        std::vector<float> values = draw(std::normal_distribution<float>(21, 3), count, count);
+        summary = summarize(values);
+        EXPECT_EQ(summary.p50, get_nearest_rank(values, 0.5)) << count << " values";
+        EXPECT_EQ(summary.p90, get_nearest_rank(values, 0.9)) << count << " values";
+    }
+}
+
+TEST(aggregator, keeps_quantiles_of_constant_values) {
+
+    summary_data_t summary = summarize(std::vector<float>(300, 21.5f));
+
+    EXPECT_EQ(summary.p50, 21.5f);
+    EXPECT_EQ(summary.p90, 21.5f);
+}
+
+TEST(aggregator, estimates_quantiles_of_a_uniform_distribution) {
+
+    expect_rank_errors("uniform", std::uniform_real_distribution<float>(15, 25));
+}
+
+TEST(aggregator, estimates_quantiles_of_a_normal_distribution) {
+
+    expect_rank_errors("normal", std::normal_distribution<float>(21, 3));
+}
+
+TEST(aggregator, estimates_quantiles_of_a_skewed_distribution) {
+
+    // particle concentrations, a long tail of pollution peaks
+    expect_rank_errors("lognormal", std::lognormal_distribution<float>(2, 0.8f));
+}
+
+TEST(aggregator, estimates_quantiles_of_sorted_values) {
+
+    std::vector<float> ascending(1000);
+    for (size_t i = 0; i < ascending.size(); i++) {
+        ascending[i] = 15 + i * 0.01f;
+    }
+    std::vector<float> descending(ascending.rbegin(), ascending.rend());
+
+    for (const auto &values : {ascending, descending}) {
+        summary_data_t summary = summarize(values);
+        EXPECT_NEAR(get_rank(values, summary.p50), 0.5, 0.01);
+        EXPECT_NEAR(get_rank(values, summary.p90), 0.9, 0.01);
+    }
+}
@@ -0,0 +1,405 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "data_sender_setup.h"
+
+extern "C" {
+#include "cbor-writer.h"
+#include "time-manager.h"
+}
+
+namespace {
+
+typedef std::vector<uint8_t> bytes_t;
+
+/**
+ * Decoded data item, map pairs and array items in children
+ */
+struct item_t {
+    int major;
+    int info;
+    uint64_t argument;
+    std::string text;
+    std::vector<item_t> children;
+};
+
+/**
+ * Decode the item at offset, definite lengths only as the writer
+ */
+bool decode(const bytes_t &data, size_t *offset, item_t *item) {
+
+    if (*offset >= data.size()) {
+        return false;
+    }
+
+    uint8_t initial = data[(*offset)++];
+    item->major = initial >> 5;
+    item->info = initial & 0x1f;
+
+    size_t length = 0;
+    if (item->info < 24) {
+        item->argument = item->info;
+    } else if (item->info <= 27) {
+        length = 1 << (item->info - 24);
+    } else {
+        return false;
+    }
+
+    if (*offset + length > data.size()) {
+        return false;
+    }
+    if (length > 0) {
+        item->argument = 0;
+    }
+    for (size_t i = 0; i < length; i++) {
+        item->argument = (item->argument << 8) | data[(*offset)++];
+    }
+
+    switch (item->major) {
+        case 3:
+            if (*offset + item->argument > data.size()) {
+                return false;
+            }
+            item->text.assign((const char *) data.data() + *offset, item->argument);
+            *offset += item->argument;
+            break;
+        case 4:
+        case 5: {
+            uint64_t count = item->major == 5 ? 2 * item->argument : item->argument;
+            item->children.resize(count);
+            for (item_t &child : item->children) {
+                if (!decode(data, offset, &child)) {
+                    return false;
+                }
+            }
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool decode_all(const bytes_t &data, item_t *item) {
+
+    size_t offset = 0;
+    return decode(data, &offset, item) && offset == data.size();
+}
+
+/**
+ * Integer keys of a map to their values
+ */
+std::map<uint64_t, item_t> pairs_of(const item_t &map) {
+
+    std::map<uint64_t, item_t> pairs;
+    for (size_t i = 0; i + 1 < map.children.size(); i += 2) {
+        EXPECT_EQ(map.children[i].major, 0) << "key " << i / 2 << " is not an unsigned integer";
+        pairs[map.children[i].argument] = map.children[i + 1];
+    }
+    return pairs;
+}
+
+bytes_t write_uint(uint64_t value) {
+
+    uint8_t buffer[16];
+    cbor_writer_t writer;
+    cbor_writer_init(&writer, buffer, sizeof(buffer));
+    cbor_writer_add_uint(&writer, value);
+    return bytes_t(buffer, buffer + writer.length);
+}
+
+bytes_t write_int(int64_t value) {
+
+    uint8_t buffer[16];
+    cbor_writer_t writer;
+    cbor_writer_init(&writer, buffer, sizeof(buffer));
+    cbor_writer_add_int(&writer, value);
+    return bytes_t(buffer, buffer + writer.length);
+}
+
+bytes_t write_float(float value) {
+
+    uint8_t buffer[16];
+    cbor_writer_t writer;
+    cbor_writer_init(&writer, buffer, sizeof(buffer));
+    cbor_writer_add_float(&writer, value);
+    return bytes_t(buffer, buffer + writer.length);
+}
+
+uint32_t bits_of(float value) {
+
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// as data-sender
+enum {
+    KEY_TIMESTAMP = 1,
+    KEY_PM1_0,
+    KEY_PM2_5,
+    KEY_PM10,
+    KEY_PARTICLES_03UM,
+    KEY_PARTICLES_05UM,
+    KEY_PARTICLES_10UM,
+    KEY_PARTICLES_25UM,
+    KEY_PARTICLES_50UM,
+    KEY_PARTICLES_100UM,
+    KEY_TEMPERATURE,
+    KEY_HUMIDITY
+};
+
+// 2021-03-04T05:06:07.089Z
+const int64_t SAMPLE_EPOCH_MS = 1614834367089LL;
+
+/**
+ * Publish sample and decode the single message it produced
+ */
+item_t publish(const telemetry_sample_t &sample, std::string *topic) {
+
+    host_mqtt_clear_sent();
+    EXPECT_TRUE(data_sender_enqueue_sample(&sample));
+    host_settle();
+
+    item_t message = {};
+    EXPECT_EQ(host_mqtt_get_sent_count(), 1);
+    if (host_mqtt_get_sent_count() != 1) {
+        return message;
+    }
+
+    const host_mqtt_message_t *sent = host_mqtt_get_sent(0);
+    *topic = sent->topic;
+    EXPECT_TRUE(decode_all(bytes_t(sent->data, sent->data + sent->data_len), &message));
+    return message;
+}
+
+void expect_pollution_values(const std::map<uint64_t, item_t> &pairs, const pollution_data_t &data) {
+
+    const std::pair<int, uint16_t> expected[] = {
+        {KEY_PM1_0, data.pm1_0}, {KEY_PM2_5, data.pm2_5}, {KEY_PM10, data.pm10},
+        {KEY_PARTICLES_03UM, data.particles_03um}, {KEY_PARTICLES_05UM, data.particles_05um},
+        {KEY_PARTICLES_10UM, data.particles_10um}, {KEY_PARTICLES_25UM, data.particles_25um},
+        {KEY_PARTICLES_50UM, data.particles_50um}, {KEY_PARTICLES_100UM, data.particles_100um}
+    };
+
+    for (const auto &value : expected) {
+        ASSERT_EQ(pairs.count(value.first), 1u) << value.first;
+        EXPECT_EQ(pairs.at(value.first).major, 0) << value.first;
+        EXPECT_EQ(pairs.at(value.first).argument, value.second) << value.first;
+    }
+}
+
+}
+
+TEST(cbor_writer, uints_use_the_shortest_head) {
+
+    const std::pair<uint64_t, bytes_t> samples[] = {
+        {0, {0x00}},
+        {23, {0x17}},
+        {24, {0x18, 0x18}},
+        {255, {0x18, 0xff}},
+        {256, {0x19, 0x01, 0x00}},
+        {65535, {0x19, 0xff, 0xff}},
+        {65536, {0x1a, 0x00, 0x01, 0x00, 0x00}},
+        {4294967295ULL, {0x1a, 0xff, 0xff, 0xff, 0xff}},
+        {4294967296ULL, {0x1b, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00}},
+        // an epoch timestamp in milliseconds
+        {(uint64_t) SAMPLE_EPOCH_MS, {0x1b, 0x00, 0x00, 0x01, 0x77, 0xfb, 0xa0, 0xfa, 0x71}},
+        {std::numeric_limits<uint64_t>::max(), {0x1b, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff}}
+    };
+
+    for (const auto &sample : samples) {
+        EXPECT_EQ(write_uint(sample.first), sample.second) << sample.first;
+    }
+}
+
+TEST(cbor_writer, negative_ints_are_encoded_as_minus_one_minus_value) {
+
+    const std::pair<int64_t, bytes_t> samples[] = {
+        {-1, {0x20}},
+        {-24, {0x37}},
+        {-25, {0x38, 0x18}},
+        {-256, {0x38, 0xff}},
+        {-257, {0x39, 0x01, 0x00}},
+        {std::numeric_limits<int64_t>::min(), {0x3b, 0x7f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff}},
+        // positive ones as uints
+        {100, {0x18, 0x64}}
+    };
+
+    for (const auto &sample : samples) {
+        EXPECT_EQ(write_int(sample.first), sample.second) << sample.first;
+    }
+}
+
+TEST(cbor_writer, floats_are_single_precision_big_endian) {
+
+    EXPECT_EQ(write_float(22.3f), bytes_t({0xfa, 0x41, 0xb2, 0x66, 0x66}));
+    EXPECT_EQ(write_float(-0.0f), bytes_t({0xfa, 0x80, 0x00, 0x00, 0x00}));
+
+    const float samples[] = {
+        0, 1, -7.9f, 48.1f, 1e-7f, std::numeric_limits<float>::max(), std::numeric_limits<float>::denorm_min(),
+        std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(), std::nanf("")
+    };
+
+    for (float value : samples) {
+        item_t item;
+        ASSERT_TRUE(decode_all(write_float(value), &item)) << value;
+        EXPECT_EQ(item.major, 7) << value;
+        EXPECT_EQ(item.info, 26) << value;
+        // bit for bit, NaN included
+        EXPECT_EQ(item.argument, bits_of(value)) << value;
+    }
+}
+
+TEST(cbor_writer, nested_containers_decode) {
+
+    uint8_t buffer[128];
+    cbor_writer_t writer;
+    cbor_writer_init(&writer, buffer, sizeof(buffer));
+    cbor_writer_begin_map(&writer, 2);
+    cbor_writer_add_uint(&writer, 13);
+    cbor_writer_begin_array(&writer, 3);
+    cbor_writer_add_string(&writer, "");
+    cbor_writer_add_string(&writer, "a string longer than 23 bytes");
+    cbor_writer_begin_map(&writer, 0);
+    cbor_writer_add_uint(&writer, 1);
+    cbor_writer_add_int(&writer, -1000);
+
+    ASSERT_NE(cbor_writer_finish(&writer), nullptr);
+
+    item_t map;
+    ASSERT_TRUE(decode_all(bytes_t(buffer, buffer + writer.length), &map));
+    ASSERT_EQ(map.major, 5);
+    ASSERT_EQ(map.argument, 2u);
+
+    std::map<uint64_t, item_t> pairs = pairs_of(map);
+    const item_t &array = pairs[13];
+    ASSERT_EQ(array.major, 4);
+    ASSERT_EQ(array.children.size(), 3u);
+    EXPECT_EQ(array.children[0].text, "");
+    EXPECT_EQ(array.children[1].text, "a string longer than 23 bytes");
+    // the length needs a uint8 head
+    EXPECT_EQ(array.children[1].info, 24);
+    EXPECT_EQ(array.children[2].major, 5);
+    EXPECT_TRUE(array.children[2].children.empty());
+
+    EXPECT_EQ(pairs[1].major, 1);
+    EXPECT_EQ(pairs[1].argument, 999u);
+}
+
+TEST(cbor_writer, fails_when_the_buffer_is_too_small) {
+
+    // {1: 1614834367089, 11: 22.3}
+    const bytes_t expected = {
+        0xa2, 0x01, 0x1b, 0x00, 0x00, 0x01, 0x77, 0xfb, 0xa0, 0xfa, 0x71, 0x0b, 0xfa, 0x41, 0xb2, 0x66, 0x66
+    };
+
+    for (size_t size = 0; size <= expected.size() + 1; size++) {
+        bytes_t buffer(size + 1, '#');
+        cbor_writer_t writer;
+        cbor_writer_init(&writer, size > 0 ? buffer.data() : NULL, size);
+        cbor_writer_begin_map(&writer, 2);
+        cbor_writer_add_uint(&writer, KEY_TIMESTAMP);
+        cbor_writer_add_uint(&writer, SAMPLE_EPOCH_MS);
+        cbor_writer_add_uint(&writer, KEY_TEMPERATURE);
+        cbor_writer_add_float(&writer, 22.3f);
+
+        const uint8_t *result = cbor_writer_finish(&writer);
+        if (size >= expected.size()) {
+            ASSERT_NE(result, nullptr) << size;
+            EXPECT_EQ(bytes_t(result, result + writer.length), expected);
+        } else {
+            EXPECT_EQ(result, nullptr) << size;
+        }
+        // nothing written past the buffer
+        EXPECT_EQ(buffer[size], '#') << size;
+    }
+}
+
+TEST(cbor_writer, publishes_pollution_samples_with_integer_keys) {
+
+    ASSERT_TRUE(data_sender_setup::load_partitions());
+    ASSERT_TRUE(data_sender_setup::start());
+
+    telemetry_sample_t sample = data_sender_setup::pms_sample(SAMPLE_EPOCH_MS, SAMPLE_CLOCK_EPOCH);
+    std::string topic;
+    item_t message = publish(sample, &topic);
+
+    EXPECT_EQ(topic.substr(topic.find("/telemetry/")), "/telemetry/pollution/cbor");
+    ASSERT_EQ(message.major, 5);
+    // the values and the timestamp, the type is carried by the topic
+    EXPECT_EQ(message.argument, 10u);
+
+    std::map<uint64_t, item_t> pairs = pairs_of(message);
+    EXPECT_EQ(pairs.count(0), 0u);
+    ASSERT_EQ(pairs.count(KEY_TIMESTAMP), 1u);
+    EXPECT_EQ(pairs[KEY_TIMESTAMP].major, 0);
+    EXPECT_EQ(pairs[KEY_TIMESTAMP].argument, (uint64_t) SAMPLE_EPOCH_MS);
+    expect_pollution_values(pairs, sample.pollution);
+}
+
+TEST(cbor_writer, publishes_temperature_and_humidity_as_floats) {
+
+    ASSERT_TRUE(data_sender_setup::load_partitions());
+    ASSERT_TRUE(data_sender_setup::start());
+
+    const std::pair<telemetry_sample_t, int> samples[] = {
+        {data_sender_setup::float_sample(TEMPERATURE_SAMPLE, 22.3f, SAMPLE_EPOCH_MS, SAMPLE_CLOCK_EPOCH), KEY_TEMPERATURE},
+        {data_sender_setup::float_sample(TEMPERATURE_SAMPLE, -7.9f, SAMPLE_EPOCH_MS + 1000, SAMPLE_CLOCK_EPOCH), KEY_TEMPERATURE},
+        {data_sender_setup::float_sample(HUMIDITY_SAMPLE, 48.1f, SAMPLE_EPOCH_MS + 2000, SAMPLE_CLOCK_EPOCH), KEY_HUMIDITY}
+    };
+
+    for (const auto &sample : samples) {
+        std::string topic;
+        item_t message = publish(sample.first, &topic);
+
+        ASSERT_EQ(message.major, 5);
+        EXPECT_EQ(message.argument, 2u);
+
+        std::map<uint64_t, item_t> pairs = pairs_of(message);
+        EXPECT_EQ(pairs[KEY_TIMESTAMP].argument, (uint64_t) sample.first.timestamp);
+        ASSERT_EQ(pairs.count(sample.second), 1u);
+        const item_t &value = pairs[sample.second];
+        EXPECT_EQ(value.major, 7);
+        EXPECT_EQ(value.info, 26);
+        float expected = sample.second == KEY_TEMPERATURE ? sample.first.temperature : sample.first.humidity;
+        EXPECT_EQ(value.argument, bits_of(expected));
+    }
+}
+
+TEST(cbor_writer, leaves_the_timestamp_out_until_the_time_is_synched) {
+
+    ASSERT_TRUE(data_sender_setup::load_partitions());
+    ASSERT_TRUE(data_sender_setup::start());
+
+    int64_t taken_at = time_manager_get_monotonic_ms();
+    telemetry_sample_t sample = data_sender_setup::pms_sample(taken_at, SAMPLE_CLOCK_MONOTONIC);
+    std::string topic;
+    item_t message = publish(sample, &topic);
+
+    ASSERT_EQ(message.major, 5);
+    EXPECT_EQ(message.argument, 9u);
+    std::map<uint64_t, item_t> pairs = pairs_of(message);
+    EXPECT_EQ(pairs.count(KEY_TIMESTAMP), 0u);
+    expect_pollution_values(pairs, sample.pollution);
+
+    // once synched, samples of this boot are stamped
+    time_manager_sync_time();
+    host_sntp_sync(SAMPLE_EPOCH_MS);
+    host_settle();
+
+    int64_t epoch_ms;
+    ASSERT_TRUE(time_manager_monotonic_to_epoch_ms(taken_at, &epoch_ms));
+    message = publish(sample, &topic);
+
+    ASSERT_EQ(message.major, 5);
+    EXPECT_EQ(message.argument, 10u);
+    pairs = pairs_of(message);
+    EXPECT_EQ(pairs[KEY_TIMESTAMP].argument, (uint64_t) epoch_ms);
+    expect_pollution_values(pairs, sample.pollution);
+}
@@ -0,0 +1,202 @@
+#include <gtest/gtest.h>
+
+#include <random>
+
+#include "delta_images.h"
+
+using delta_images::bytes_t;
+
+namespace {
+
+delta_patch_t decoder;
+
+struct round_trip_t {
+    bytes_t target;
+    bytes_t patch;
+    delta_images::apply_context_t context;
+    esp_err_t err;
+};
+
+/**
+ * Patch source into target with deltagen.py and rebuild target with the
+ * decoder, the patch fed in random chunks of up to max_chunk bytes
+ */
+round_trip_t round_trip(const bytes_t &source, const bytes_t &target, uint32_t seed, size_t max_chunk) {
+
+    round_trip_t result = {};
+    result.patch = delta_images::generate_patch(source, target);
+    EXPECT_FALSE(result.patch.empty());
+
+    result.context.source = &source;
+    std::mt19937 generator(seed);
+    result.err = delta_images::apply_patch(&decoder, result.patch, &result.context, [&]() {
+        return 1 + generator() % max_chunk;
+    });
+    result.target = result.context.target;
+
+    return result;
+}
+
+bytes_t build_image(const char *version, uint32_t seed, size_t size) {
+    return delta_images::build_image(version, delta_images::build_payload(seed, size));
+}
+
+}
+
+TEST(delta_patch, rebuilds_edited_images_from_patches_fed_in_any_chunks) {
+
+    for (uint32_t seed = 1; seed <= 30; seed++) {
+        std::mt19937 generator(seed);
+        bytes_t payload = delta_images::build_payload(seed, 8192 + generator() % 65536);
+        bytes_t source = delta_images::build_image("1.0.0", payload);
+        bytes_t target = delta_images::build_image("1.1.0", delta_images::edit_payload(payload, seed, 1 + generator() % 40));
+
+        // down to single bytes, and past the decoder window
+        size_t max_chunk = seed % 3 == 0 ? 1 : 1 + generator() % (2 * DELTA_PATCH_WINDOW_SIZE);
+        round_trip_t result = round_trip(source, target, seed, max_chunk);
+
+        ASSERT_EQ(result.err, ESP_OK) << "seed " << seed;
+        ASSERT_EQ(result.target, target) << "seed " << seed;
+        EXPECT_LT(result.patch.size(), target.size() / 2) << "seed " << seed;
+    }
+}
+
+TEST(delta_patch, rebuilds_an_identical_image_from_a_few_controls) {
+
+    bytes_t source = build_image("1.0.0", 1, 65536);
+
+    round_trip_t result = round_trip(source, source, 1, 512);
+
+    ASSERT_EQ(result.err, ESP_OK);
+    EXPECT_EQ(result.target, source);
+    EXPECT_LT(result.patch.size(), DELTA_PATCH_HEADER_SIZE + 32u);
+}
+
+TEST(delta_patch, rebuilds_an_unrelated_image_from_extra_bytes) {
+
+    bytes_t source = build_image("1.0.0", 1, 16384);
+    bytes_t target = build_image("2.0.0", 2, 20000);
+
+    round_trip_t result = round_trip(source, target, 1, 700);
+
+    ASSERT_EQ(result.err, ESP_OK);
+    EXPECT_EQ(result.target, target);
+}
+
+TEST(delta_patch, rebuilds_shrunk_and_grown_images) {
+
+    bytes_t payload = delta_images::build_payload(3, 40000);
+    bytes_t source = delta_images::build_image("1.0.0", payload);
+
+    bytes_t shrunk(payload.begin() + 10000, payload.begin() + 25000);
+    bytes_t grown = payload;
+    bytes_t appended = delta_images::build_payload(4, 30000);
+    grown.insert(grown.begin() + 20000, appended.begin(), appended.end());
+
+    for (const bytes_t &target_payload : {shrunk, grown}) {
+        bytes_t target = delta_images::build_image("1.1.0", target_payload);
+        round_trip_t result = round_trip(source, target, 5, 1500);
+
+        ASSERT_EQ(result.err, ESP_OK) << target_payload.size();
+        EXPECT_EQ(result.target, target) << target_payload.size();
+    }
+}
+
+TEST(delta_patch, reads_the_source_in_blocks) {
+
+    bytes_t payload = delta_images::build_payload(6, 65536);
+    bytes_t source = delta_images::build_image("1.0.0", payload);
+    bytes_t target = delta_images::build_image("1.1.0", delta_images::edit_payload(payload, 6, 10));
+
+    round_trip_t result = round_trip(source, target, 6, 1);
+
+    ASSERT_EQ(result.err, ESP_OK);
+    // byte sized chunks don't make the decoder read the source again
+    EXPECT_LE(result.context.source_bytes, 2 * source.size());
+    EXPECT_LE(result.context.source_reads, 2 * source.size() / DELTA_PATCH_SOURCE_BLOCK_SIZE + 20);
+}
+
+TEST(delta_patch, rejects_truncated_patches) {
+
+    bytes_t payload = delta_images::build_payload(7, 20000);
+    bytes_t source = delta_images::build_image("1.0.0", payload);
+    bytes_t target = delta_images::build_image("1.1.0", delta_images::edit_payload(payload, 7, 10));
+    bytes_t patch = delta_images::generate_patch(source, target);
+    ASSERT_FALSE(patch.empty());
+
+    for (size_t cut : {1, 2, 17, 500}) {
+        bytes_t truncated(patch.begin(), patch.end() - cut);
+        delta_images::apply_context_t context = {};
+        context.source = &source;
+
+        EXPECT_EQ(delta_images::apply_patch(&decoder, truncated, &context, []() { return 256; }),
+            ESP_ERR_INVALID_SIZE) << cut;
+    }
+}
+
+TEST(delta_patch, rejects_bytes_past_the_target) {
+
+    bytes_t source = build_image("1.0.0", 8, 10000);
+    bytes_t patch = delta_images::generate_patch(source, source);
+    ASSERT_FALSE(patch.empty());
+    patch.push_back(0);
+
+    delta_images::apply_context_t context = {};
+    context.source = &source;
+
+    EXPECT_EQ(delta_images::apply_patch(&decoder, patch, &context, []() { return 4096; }), ESP_ERR_INVALID_SIZE);
+}
+
+TEST(delta_patch, rejects_controls_outside_the_source) {
+
+    bytes_t source = build_image("1.0.0", 9, 10000);
+    bytes_t patch = delta_images::generate_patch(source, source);
+    ASSERT_FALSE(patch.empty());
+
+    // the same patch against a shorter source copies past its end
+    bytes_t shorter(source.begin(), source.begin() + source.size() / 2);
+    delta_images::apply_context_t context = {};
+    context.source = &shorter;
+    delta_patch_header_t header;
+    ASSERT_TRUE(delta_patch_parse_header(patch.data(), patch.size(), &header));
+    header.source_size = shorter.size();
+
+    delta_patch_init(&decoder, &header, delta_images::read_source, delta_images::write_target, &context);
+    EXPECT_EQ(delta_patch_feed(&decoder, patch.data() + DELTA_PATCH_HEADER_SIZE, patch.size() - DELTA_PATCH_HEADER_SIZE),
+        ESP_ERR_INVALID_SIZE);
+}
+
+TEST(delta_patch, stops_on_write_errors) {
+
+    bytes_t source = build_image("1.0.0", 10, 20000);
+    bytes_t patch = delta_images::generate_patch(source, source);
+    ASSERT_FALSE(patch.empty());
+
+    delta_images::apply_context_t context = {};
+    context.source = &source;
+    context.write_error = ESP_FAIL;
+
+    EXPECT_EQ(delta_images::apply_patch(&decoder, patch, &context, []() { return 4096; }), ESP_FAIL);
+    EXPECT_EQ(context.target.size(), (size_t) DELTA_PATCH_WINDOW_SIZE);
+}
+
+TEST(delta_patch, parses_patch_headers_only) {
+
+    bytes_t source = build_image("1.0.0", 11, 4096);
+    bytes_t target = build_image("1.1.0", 12, 4096);
+    bytes_t patch = delta_images::generate_patch(source, target);
+    ASSERT_GE(patch.size(), (size_t) DELTA_PATCH_HEADER_SIZE);
+
+    delta_patch_header_t header;
+    ASSERT_TRUE(delta_patch_parse_header(patch.data(), patch.size(), &header));
+    EXPECT_EQ(header.source_size, source.size());
+    EXPECT_EQ(header.target_size, target.size());
+    EXPECT_EQ(memcmp(header.source_hash, source.data() + source.size() - DELTA_PATCH_HASH_SIZE, DELTA_PATCH_HASH_SIZE), 0);
+    EXPECT_EQ(memcmp(header.target_hash, target.data() + target.size() - DELTA_PATCH_HASH_SIZE, DELTA_PATCH_HASH_SIZE), 0);
+
+    // a full image, a short read, unknown flags
+    EXPECT_FALSE(delta_patch_parse_header(target.data(), target.size(), &header));
+    EXPECT_FALSE(delta_patch_parse_header(patch.data(), DELTA_PATCH_HEADER_SIZE - 1, &header));
+    patch[12] = 1;
+    EXPECT_FALSE(delta_patch_parse_header(patch.data(), patch.size(), &header));
+}
@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "dht_frames.h"
+
+extern "C" {
+#include "dht-decoder.h"
+#include "dht-manager.h"
+#include "host.h"
+}
+
+namespace {
+
+std::vector<dht_pulse_t> load(const char *name) {
+    return dht_frames::load_trace(std::string(HOST_SOURCE_DIR "/fixtures/dht/") + name + ".trace");
+}
+
+dht_decode_result_t decode(const std::vector<dht_pulse_t> &pulses, std::vector<uint8_t> &data) {
+
+    data.assign(DHT_DATA_BYTES, 0);
+    return dht_decode_pulses(pulses.data(), pulses.size(), data.data());
+}
+
+void set_frame(const std::vector<dht_pulse_t> &pulses) {
+
+    std::vector<rmt_item32_t> items = dht_frames::to_rmt_items(pulses);
+    host_rmt_set_frame(RMT_CHANNEL_4, items.data(), items.size());
+}
+
+}
+
+TEST(dht_decoder, decodes_recorded_frames) {
+
+    struct {
+        const char *trace;
+        int humidity_tenths;
+        int temperature_tenths;
+    } frames[] = {
+        {"am2301_positive", 553, 225},
+        {"am2301_negative", 400, -101},
+        {"response_bounds", 998, 851}
+    };
+
+    for (const auto &frame : frames) {
+        std::vector<dht_pulse_t> pulses = load(frame.trace);
+        ASSERT_FALSE(pulses.empty()) << frame.trace;
+
+        std::vector<uint8_t> data;
+        EXPECT_EQ(decode(pulses, data), DHT_DECODE_OK) << frame.trace;
+        EXPECT_EQ(data, dht_frames::am2301_data(frame.humidity_tenths, frame.temperature_tenths)) << frame.trace;
+    }
+}
+
+TEST(dht_decoder, reports_broken_frames) {
+
+    std::vector<uint8_t> data;
+
+    EXPECT_EQ(decode(load("bad_checksum"), data), DHT_DECODE_BAD_CHECKSUM);
+    EXPECT_EQ(decode(load("truncated"), data), DHT_DECODE_TRUNCATED);
+    EXPECT_EQ(decode(load("no_response"), data), DHT_DECODE_NO_RESPONSE);
+    EXPECT_EQ(decode(load("glitch"), data), DHT_DECODE_BAD_LEVEL);
+    EXPECT_EQ(decode({}, data), DHT_DECODE_NO_RESPONSE);
+}
+
+TEST(dht_decoder, tolerates_timing_jitter) {
+
+    // bits are told apart by 24us or 20us against the 50us low pulse
+    for (unsigned seed = 1; seed <= 200; seed++) {
+        int humidity = seed * 5 % 1000;
+        int temperature = (int) (seed * 7 % 1200) - 400;
+        std::vector<dht_pulse_t> pulses = dht_frames::build_pulses(dht_frames::am2301_data(humidity, temperature), 8, seed);
+
+        std::vector<uint8_t> data;
+        ASSERT_EQ(decode(pulses, data), DHT_DECODE_OK) << seed;
+        ASSERT_EQ(data, dht_frames::am2301_data(humidity, temperature)) << seed;
+    }
+}
+
+TEST(dht_manager, reads_frames_received_by_rmt) {
+
+    set_frame(load("am2301_negative"));
+
+    dht_reading_t reading;
+    ASSERT_EQ(dht_manager_read(&reading), ESP_OK);
+    EXPECT_FLOAT_EQ(reading.humidity, 40.0f);
+    EXPECT_FLOAT_EQ(reading.temperature, -10.1f);
+
+    // odd pulse count, the end of frame is the zero duration of the last item
+    set_frame(load("response_bounds"));
+    ASSERT_EQ(dht_manager_read(&reading), ESP_OK);
+    EXPECT_FLOAT_EQ(reading.humidity, 99.8f);
+    EXPECT_FLOAT_EQ(reading.temperature, 85.1f);
+}
+
+TEST(dht_manager, stamps_readings_with_the_start_of_the_frame) {
+
+    host_run_for_ms(12345);
+    int64_t started_at = host_now_us();
+
+    set_frame(load("am2301_positive"));
+    dht_reading_t reading;
+    ASSERT_EQ(dht_manager_read(&reading), ESP_OK);
+    EXPECT_EQ(reading.acquired_at, started_at);
+
+    dht_reading_t last;
+    ASSERT_TRUE(dht_manager_get_last_reading(&last));
+    EXPECT_EQ(last.acquired_at, started_at);
+}
+
+TEST(dht_manager, keeps_the_last_reading_on_errors) {
+
+    set_frame(load("am2301_positive"));
+    dht_reading_t reading;
+    ASSERT_EQ(dht_manager_read(&reading), ESP_OK);
+
+    set_frame(load("bad_checksum"));
+    EXPECT_EQ(dht_manager_read(&reading), ESP_ERR_INVALID_CRC);
+
+    set_frame(load("glitch"));
+    EXPECT_EQ(dht_manager_read(&reading), ESP_ERR_INVALID_RESPONSE);
+
+    host_rmt_set_frame(RMT_CHANNEL_4, NULL, 0);
+    EXPECT_EQ(dht_manager_read(&reading), ESP_ERR_TIMEOUT);
+
+    dht_reading_t last;
+    ASSERT_TRUE(dht_manager_get_last_reading(&last));
+    EXPECT_FLOAT_EQ(last.humidity, 55.3f);
+    EXPECT_FLOAT_EQ(last.temperature, 22.5f);
+}
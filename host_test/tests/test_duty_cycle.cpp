@@ -0,0 +1,244 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+extern "C" {
+#include "sdkconfig.h"
+#include "duty-cycle.h"
+#include "sensor-drivers.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "host.h"
+}
+
+namespace {
+
+const uint64_t PERIOD_MS = CONFIG_DUTY_CYCLE_PERIOD * 1000ULL;
+
+const uint32_t WARM_UP_AWAKE_MS = 200;
+
+const uint32_t MEASURE_AWAKE_MS = 1000;
+
+// as main.c, one sample per sensor reading
+const int SAMPLES_PER_MEASURE = 3;
+
+const int FW_CHECK_UPLOADS = CONFIG_FW_CHECK_INTERVAL / (CONFIG_DUTY_CYCLE_PERIOD * CONFIG_DUTY_CYCLE_UPLOAD_INTERVAL);
+
+/**
+ * One wake as run by the duty cycle task of main.c, with the sensors and the
+ * upload replaced by samples numbered by measure and a sink that may refuse them
+ */
+struct wake_t {
+    uint32_t awake_ms;
+    bool is_uploaded;
+    duty_cycle_step_t step;
+    bool is_pad_wakeup;
+    bool is_fw_check_due;
+    std::vector<int64_t> uploaded;
+};
+
+wake_t current;
+
+int measures = 0;
+
+bool upload_sink(const telemetry_sample_t *sample) {
+
+    if (!current.is_uploaded) {
+        return false;
+    }
+
+    current.uploaded.push_back(sample->timestamp);
+    return true;
+}
+
+void wake_task(void *args) {
+
+    duty_cycle_set_wakeup_pad(GPIO_NUM_0, 0);
+    current.step = duty_cycle_begin();
+    current.is_pad_wakeup = duty_cycle_is_pad_wakeup();
+
+    vTaskDelay(pdMS_TO_TICKS(current.awake_ms));
+
+    if (current.is_pad_wakeup) {
+        duty_cycle_resume_sleep();
+    }
+
+    if (current.step != DUTY_CYCLE_WARM_UP) {
+        telemetry_sample_t sample = {};
+        sample.timestamp = measures++;
+        sample.clock = SAMPLE_CLOCK_EPOCH;
+        for (int i = 0; i < SAMPLES_PER_MEASURE; i++) {
+            duty_cycle_store_sample(&sample);
+        }
+    }
+
+    if (current.step == DUTY_CYCLE_UPLOAD) {
+        current.is_fw_check_due = duty_cycle_is_fw_check_due();
+        duty_cycle_flush_samples(upload_sink);
+        duty_cycle_set_upload_result(current.is_uploaded);
+    }
+
+    duty_cycle_sleep();
+}
+
+bool has_slept(void *context) {
+    return host_sleep_get_last()->count > *static_cast<int *>(context);
+}
+
+/**
+ * Boot for cause and run the wake until deep sleep, then sleep until the timer
+ * fires, unless the test interrupts the sleep itself
+ */
+const host_sleep_t *wake(esp_sleep_wakeup_cause_t cause, uint32_t awake_ms, bool is_uploaded = true,
+    bool is_sleeping_through = true) {
+
+    int sleeps = host_sleep_get_last()->count;
+
+    host_reboot();
+    host_sleep_set_wakeup_cause(cause);
+
+    current = {};
+    current.awake_ms = awake_ms;
+    current.is_uploaded = is_uploaded;
+
+    xTaskCreate(wake_task, "duty cycle task", 4096, NULL, 5, NULL);
+    EXPECT_TRUE(host_run_until(has_slept, &sleeps, 10, awake_ms + 1000));
+
+    const host_sleep_t *sleep = host_sleep_get_last();
+    if (is_sleeping_through) {
+        host_run_for_ms(sleep->timer_us / 1000);
+    }
+
+    return sleep;
+}
+
+/**
+ * A warm up wake followed by a measure wake, return the step of the latter
+ */
+duty_cycle_step_t run_cycle(esp_sleep_wakeup_cause_t cause = ESP_SLEEP_WAKEUP_TIMER, bool is_uploaded = true) {
+
+    wake(cause, WARM_UP_AWAKE_MS);
+    EXPECT_EQ(current.step, DUTY_CYCLE_WARM_UP);
+
+    wake(ESP_SLEEP_WAKEUP_TIMER, MEASURE_AWAKE_MS, is_uploaded);
+    return current.step;
+}
+
+}
+
+TEST(duty_cycle, sleeps_through_warm_up_and_the_rest_of_the_period) {
+
+    const host_sleep_t *sleep = wake(ESP_SLEEP_WAKEUP_UNDEFINED, WARM_UP_AWAKE_MS);
+    EXPECT_EQ(current.step, DUTY_CYCLE_WARM_UP);
+    EXPECT_EQ(sleep->timer_us, SENSOR_DRIVERS_PMS_WARMUP_TIME * 1000ULL);
+    EXPECT_EQ(sleep->ext0_gpio, GPIO_NUM_0);
+    EXPECT_EQ(sleep->ext0_level, 0);
+
+    sleep = wake(ESP_SLEEP_WAKEUP_TIMER, MEASURE_AWAKE_MS);
+    EXPECT_EQ(current.step, DUTY_CYCLE_MEASURE);
+    EXPECT_EQ(sleep->timer_us, (PERIOD_MS - SENSOR_DRIVERS_PMS_WARMUP_TIME - WARM_UP_AWAKE_MS - MEASURE_AWAKE_MS) * 1000);
+    EXPECT_EQ(sleep->ext0_gpio, GPIO_NUM_0);
+}
+
+TEST(duty_cycle, uploads_every_upload_interval_measures) {
+
+    for (int cycle = 1; cycle <= 2 * CONFIG_DUTY_CYCLE_UPLOAD_INTERVAL; cycle++) {
+        duty_cycle_step_t step = run_cycle(cycle == 1 ? ESP_SLEEP_WAKEUP_UNDEFINED : ESP_SLEEP_WAKEUP_TIMER);
+
+        if (cycle % CONFIG_DUTY_CYCLE_UPLOAD_INTERVAL != 0) {
+            ASSERT_EQ(step, DUTY_CYCLE_MEASURE) << "cycle " << cycle;
+            continue;
+        }
+
+        ASSERT_EQ(step, DUTY_CYCLE_UPLOAD) << "cycle " << cycle;
+        ASSERT_EQ(current.uploaded.size(), (size_t) CONFIG_DUTY_CYCLE_UPLOAD_INTERVAL * SAMPLES_PER_MEASURE);
+        EXPECT_EQ(current.uploaded.front(), cycle - CONFIG_DUTY_CYCLE_UPLOAD_INTERVAL);
+        EXPECT_EQ(current.uploaded.back(), cycle - 1);
+    }
+}
+
+TEST(duty_cycle, checks_for_updates_at_the_first_upload_then_every_check_interval) {
+
+    ASSERT_GT(FW_CHECK_UPLOADS, 1);
+
+    std::vector<bool> checks;
+    for (int cycle = 1; cycle <= (FW_CHECK_UPLOADS + 1) * CONFIG_DUTY_CYCLE_UPLOAD_INTERVAL; cycle++) {
+        if (run_cycle(cycle == 1 ? ESP_SLEEP_WAKEUP_UNDEFINED : ESP_SLEEP_WAKEUP_TIMER) == DUTY_CYCLE_UPLOAD) {
+            checks.push_back(current.is_fw_check_due);
+        }
+    }
+
+    std::vector<bool> expected(FW_CHECK_UPLOADS + 1, false);
+    expected.front() = true;
+    expected.back() = true;
+    EXPECT_EQ(checks, expected);
+}
+
+TEST(duty_cycle, retries_a_failed_upload_at_the_next_measure) {
+
+    for (int cycle = 1; cycle < CONFIG_DUTY_CYCLE_UPLOAD_INTERVAL; cycle++) {
+        run_cycle(cycle == 1 ? ESP_SLEEP_WAKEUP_UNDEFINED : ESP_SLEEP_WAKEUP_TIMER);
+    }
+
+    ASSERT_EQ(run_cycle(ESP_SLEEP_WAKEUP_TIMER, false), DUTY_CYCLE_UPLOAD);
+    EXPECT_TRUE(current.uploaded.empty());
+    // failed uploads don't count for the firmware checks
+    EXPECT_TRUE(current.is_fw_check_due);
+
+    ASSERT_EQ(run_cycle(), DUTY_CYCLE_UPLOAD);
+    EXPECT_EQ(current.uploaded.size(), (size_t) (CONFIG_DUTY_CYCLE_UPLOAD_INTERVAL + 1) * SAMPLES_PER_MEASURE);
+    EXPECT_TRUE(current.is_fw_check_due);
+
+    EXPECT_EQ(run_cycle(), DUTY_CYCLE_MEASURE);
+}
+
+TEST(duty_cycle, keeps_the_latest_samples_while_uploads_fail) {
+
+    const int cycles = CONFIG_DUTY_CYCLE_BUFFER_SIZE / SAMPLES_PER_MEASURE + 4;
+
+    for (int cycle = 1; cycle <= cycles; cycle++) {
+        run_cycle(cycle == 1 ? ESP_SLEEP_WAKEUP_UNDEFINED : ESP_SLEEP_WAKEUP_TIMER, false);
+    }
+
+    ASSERT_EQ(run_cycle(), DUTY_CYCLE_UPLOAD);
+    ASSERT_EQ(current.uploaded.size(), (size_t) CONFIG_DUTY_CYCLE_BUFFER_SIZE);
+    EXPECT_EQ(current.uploaded.back(), cycles);
+    EXPECT_EQ(current.uploaded.front(), cycles + 1 - CONFIG_DUTY_CYCLE_BUFFER_SIZE / SAMPLES_PER_MEASURE);
+}
+
+TEST(duty_cycle, resumes_the_sleep_interrupted_by_the_pad) {
+
+    run_cycle(ESP_SLEEP_WAKEUP_UNDEFINED);
+    wake(ESP_SLEEP_WAKEUP_TIMER, WARM_UP_AWAKE_MS, true, false);
+    ASSERT_EQ(current.step, DUTY_CYCLE_WARM_UP);
+    wake(ESP_SLEEP_WAKEUP_TIMER, MEASURE_AWAKE_MS, true, false);
+    ASSERT_EQ(current.step, DUTY_CYCLE_MEASURE);
+
+    uint64_t planned_ms = host_sleep_get_last()->timer_us / 1000;
+    host_run_for_ms(100000);
+
+    const host_sleep_t *sleep = wake(ESP_SLEEP_WAKEUP_EXT0, 500);
+    EXPECT_TRUE(current.is_pad_wakeup);
+    EXPECT_EQ(sleep->timer_us / 1000, planned_ms - 100000 - 500);
+    EXPECT_EQ(sleep->ext0_gpio, GPIO_NUM_0);
+
+    // the buffer and the cycle count went through the pad wake up
+    for (int cycle = 3; cycle < CONFIG_DUTY_CYCLE_UPLOAD_INTERVAL; cycle++) {
+        ASSERT_EQ(run_cycle(), DUTY_CYCLE_MEASURE);
+    }
+    ASSERT_EQ(run_cycle(), DUTY_CYCLE_UPLOAD);
+    EXPECT_EQ(current.uploaded.size(), (size_t) CONFIG_DUTY_CYCLE_UPLOAD_INTERVAL * SAMPLES_PER_MEASURE);
+}
+
+TEST(duty_cycle, starts_over_after_a_power_on) {
+
+    run_cycle(ESP_SLEEP_WAKEUP_UNDEFINED);
+    run_cycle();
+
+    for (int cycle = 1; cycle < CONFIG_DUTY_CYCLE_UPLOAD_INTERVAL; cycle++) {
+        ASSERT_EQ(run_cycle(cycle == 1 ? ESP_SLEEP_WAKEUP_UNDEFINED : ESP_SLEEP_WAKEUP_TIMER), DUTY_CYCLE_MEASURE);
+    }
+    ASSERT_EQ(run_cycle(), DUTY_CYCLE_UPLOAD);
+    EXPECT_EQ(current.uploaded.size(), (size_t) CONFIG_DUTY_CYCLE_UPLOAD_INTERVAL * SAMPLES_PER_MEASURE);
+    EXPECT_EQ(current.uploaded.front(), 2);
+}
@@ -0,0 +1,320 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+extern "C" {
+#include "gpio-manager.h"
+#include "freertos/FreeRTOS.h"
+#include "host.h"
+}
+
+namespace {
+
+// as gpio-manager
+const int64_t DEBOUNCE_MS = 30;
+
+const int64_t LONG_CLICK_MS = 3000;
+
+const int64_t DOUBLE_CLICK_WINDOW_MS = 300;
+
+const int64_t HOLD_REPEAT_MS = 500;
+
+// timers fire on time, the event task may run a tick later
+const int64_t TICK_MS = portTICK_PERIOD_MS;
+
+const gpio_num_t BUTTON = GPIO_NUM_0;
+
+const gpio_num_t OTHER_BUTTON = GPIO_NUM_4;
+
+struct event_t {
+    uint8_t gpio;
+    pad_event_t event;
+    int64_t at_ms;
+};
+
+std::vector<event_t> events;
+
+void record(uint8_t gpio, pad_event_t event) {
+    events.push_back({gpio, event, (int64_t) (host_now_us() / 1000)});
+}
+
+/**
+ * Level of a pad from at_ms on
+ */
+struct edge_t {
+    int64_t at_ms;
+    gpio_num_t gpio;
+    int level;
+};
+
+typedef std::vector<edge_t> trace_t;
+
+/**
+ * Contact bounces: the level toggles every millisecond for bounces edges
+ * before it settles at level
+ */
+void add_transition(trace_t *trace, gpio_num_t gpio, int64_t at_ms, int level, int bounces) {
+
+    for (int i = 0; i < bounces; i++) {
+        trace->push_back({at_ms + i, gpio, i % 2 == 0 ? level : !level});
+    }
+    trace->push_back({at_ms + bounces, gpio, level});
+}
+
+/**
+ * A press of an active low button held for hold_ms, bouncing on both edges
+ */
+void add_press(trace_t *trace, gpio_num_t gpio, int64_t at_ms, int64_t hold_ms, int bounces = 6) {
+
+    add_transition(trace, gpio, at_ms, 0, bounces);
+    add_transition(trace, gpio, at_ms + hold_ms, 1, bounces);
+}
+
+/**
+ * Drive the pads through trace, times from boot, then let the gesture
+ * timers run until until_ms
+ */
+void play(trace_t trace, int64_t until_ms) {
+
+    std::stable_sort(trace.begin(), trace.end(), [](const edge_t &a, const edge_t &b) { return a.at_ms < b.at_ms; });
+
+    for (const edge_t &edge : trace) {
+        host_run_for_ms(edge.at_ms - host_now_us() / 1000);
+        host_gpio_set_input(edge.gpio, edge.level);
+    }
+    host_run_for_ms(until_ms - host_now_us() / 1000);
+}
+
+pad_conf_t button_conf(gpio_num_t gpio, uint8_t gestures) {
+
+    pad_conf_t conf = {};
+    conf.gpio_number = gpio;
+    conf.direction = GPIO_INPUT;
+    conf.pull_mode = GPIO_PULL_UP;
+    conf.interrput_mode = GPIO_INTERRUPT_FALLING;
+    conf.gestures = gestures;
+    conf.callback = record;
+    return conf;
+}
+
+pad_conf_t button = button_conf(BUTTON, 0);
+
+pad_conf_t other_button = button_conf(OTHER_BUTTON, 0);
+
+/**
+ * Released buttons, configured from the start of the virtual time
+ */
+void start(uint8_t gestures, uint8_t other_gestures = 0) {
+
+    host_gpio_set_input(BUTTON, 1);
+    host_gpio_set_input(OTHER_BUTTON, 1);
+
+    button = button_conf(BUTTON, gestures);
+    other_button = button_conf(OTHER_BUTTON, other_gestures);
+
+    ASSERT_EQ(gpio_manager_init(), (uint32_t) ESP_OK);
+    ASSERT_EQ(gpio_manager_configure_pad(&button), (uint32_t) ESP_OK);
+    ASSERT_EQ(gpio_manager_configure_pad(&other_button), (uint32_t) ESP_OK);
+    host_settle();
+    events.clear();
+}
+
+std::vector<event_t> events_of(gpio_num_t gpio) {
+
+    std::vector<event_t> pad_events;
+    for (const event_t &event : events) {
+        if (event.gpio == gpio) {
+            pad_events.push_back(event);
+        }
+    }
+    return pad_events;
+}
+
+void expect_event(const event_t &event, pad_event_t expected, int64_t expected_at_ms) {
+
+    EXPECT_EQ(event.event, expected);
+    EXPECT_GE(event.at_ms, expected_at_ms);
+    EXPECT_LE(event.at_ms, expected_at_ms + TICK_MS);
+}
+
+}
+
+TEST(gpio_manager, reports_a_bouncing_press_as_one_click) {
+
+    start(0);
+    trace_t trace;
+    add_press(&trace, BUTTON, 100, 200);
+
+    play(trace, 1000);
+
+    // the release settles after 6 bounces
+    ASSERT_EQ(events.size(), 1u);
+    expect_event(events[0], GPIO_CLICK, 300 + 6 + DEBOUNCE_MS);
+}
+
+TEST(gpio_manager, ignores_glitches_shorter_than_the_debounce) {
+
+    start(GPIO_GESTURE_DOUBLE_CLICK);
+    trace_t trace;
+    add_press(&trace, BUTTON, 100, 10, 0);
+    add_press(&trace, BUTTON, 500, 1, 0);
+
+    play(trace, 2000);
+
+    EXPECT_TRUE(events.empty());
+}
+
+TEST(gpio_manager, settles_bursts_longer_than_the_edges_ring) {
+
+    start(0);
+    host_run_for_ms(100);
+
+    // edges faster than the event task, past the ring depth
+    for (int i = 0; i < 81; i++) {
+        host_gpio_set_input(BUTTON, i % 2);
+    }
+    host_run_for_ms(200);
+    for (int i = 0; i < 81; i++) {
+        host_gpio_set_input(BUTTON, (i + 1) % 2);
+    }
+    host_run_for_ms(1000);
+
+    ASSERT_EQ(events.size(), 1u);
+    EXPECT_EQ(events[0].event, GPIO_CLICK);
+}
+
+TEST(gpio_manager, sends_a_long_click_while_the_pad_is_held) {
+
+    start(0);
+    trace_t trace;
+    add_press(&trace, BUTTON, 100, 5000);
+
+    play(trace, 6000);
+
+    // once, when the threshold is reached, and nothing on release
+    ASSERT_EQ(events.size(), 1u);
+    expect_event(events[0], GPIO_LONG_CLICK, 100 + 6 + DEBOUNCE_MS + LONG_CLICK_MS);
+}
+
+TEST(gpio_manager, repeats_while_held_after_a_long_click) {
+
+    start(GPIO_GESTURE_HOLD_REPEAT);
+    trace_t trace;
+    add_press(&trace, BUTTON, 100, 4800);
+
+    play(trace, 6000);
+
+    int64_t long_click_at = 100 + 6 + DEBOUNCE_MS + LONG_CLICK_MS;
+    ASSERT_EQ(events.size(), 4u);
+    expect_event(events[0], GPIO_LONG_CLICK, long_click_at);
+    for (int i = 1; i < 4; i++) {
+        expect_event(events[i], GPIO_HOLD_REPEAT, long_click_at + i * HOLD_REPEAT_MS);
+    }
+}
+
+TEST(gpio_manager, reports_a_double_click) {
+
+    start(GPIO_GESTURE_DOUBLE_CLICK);
+    trace_t trace;
+    add_press(&trace, BUTTON, 100, 120);
+    add_press(&trace, BUTTON, 350, 120);
+
+    play(trace, 2000);
+
+    ASSERT_EQ(events.size(), 1u);
+    expect_event(events[0], GPIO_DOUBLE_CLICK, 470 + 6 + DEBOUNCE_MS);
+}
+
+TEST(gpio_manager, sends_a_click_once_the_double_click_window_expired) {
+
+    start(GPIO_GESTURE_DOUBLE_CLICK);
+    trace_t trace;
+    add_press(&trace, BUTTON, 100, 120);
+    // too late for a double click
+    add_press(&trace, BUTTON, 800, 120);
+
+    play(trace, 2000);
+
+    ASSERT_EQ(events.size(), 2u);
+    expect_event(events[0], GPIO_CLICK, 220 + 6 + DEBOUNCE_MS + DOUBLE_CLICK_WINDOW_MS);
+    expect_event(events[1], GPIO_CLICK, 920 + 6 + DEBOUNCE_MS + DOUBLE_CLICK_WINDOW_MS);
+}
+
+TEST(gpio_manager, reports_a_click_then_a_long_click_for_a_held_second_press) {
+
+    start(GPIO_GESTURE_DOUBLE_CLICK);
+    trace_t trace;
+    add_press(&trace, BUTTON, 100, 120);
+    add_press(&trace, BUTTON, 350, 4000);
+
+    play(trace, 5000);
+
+    int64_t long_click_at = 350 + 6 + DEBOUNCE_MS + LONG_CLICK_MS;
+    ASSERT_EQ(events.size(), 2u);
+    expect_event(events[0], GPIO_CLICK, long_click_at);
+    expect_event(events[1], GPIO_LONG_CLICK, long_click_at);
+}
+
+TEST(gpio_manager, handles_pads_concurrently) {
+
+    start(GPIO_GESTURE_HOLD_REPEAT, GPIO_GESTURE_DOUBLE_CLICK);
+    trace_t trace;
+    add_press(&trace, BUTTON, 100, 3800);
+    // clicks and a double click on the other pad while the first one is held
+    add_press(&trace, OTHER_BUTTON, 1000, 100);
+    add_press(&trace, OTHER_BUTTON, 2000, 100);
+    add_press(&trace, OTHER_BUTTON, 2250, 100);
+    add_press(&trace, OTHER_BUTTON, 3300, 100);
+
+    play(trace, 5000);
+
+    std::vector<event_t> held = events_of(BUTTON);
+    int64_t long_click_at = 100 + 6 + DEBOUNCE_MS + LONG_CLICK_MS;
+    ASSERT_EQ(held.size(), 2u);
+    expect_event(held[0], GPIO_LONG_CLICK, long_click_at);
+    expect_event(held[1], GPIO_HOLD_REPEAT, long_click_at + HOLD_REPEAT_MS);
+
+    std::vector<event_t> clicked = events_of(OTHER_BUTTON);
+    ASSERT_EQ(clicked.size(), 3u);
+    expect_event(clicked[0], GPIO_CLICK, 1100 + 6 + DEBOUNCE_MS + DOUBLE_CLICK_WINDOW_MS);
+    expect_event(clicked[1], GPIO_DOUBLE_CLICK, 2350 + 6 + DEBOUNCE_MS);
+    // right when the window expires, while the first pad still repeats
+    expect_event(clicked[2], GPIO_CLICK, 3400 + 6 + DEBOUNCE_MS + DOUBLE_CLICK_WINDOW_MS);
+}
+
+TEST(gpio_manager, ignores_a_pad_held_while_configured_until_released) {
+
+    host_gpio_set_input(BUTTON, 0);
+    button = button_conf(BUTTON, 0);
+    ASSERT_EQ(gpio_manager_init(), (uint32_t) ESP_OK);
+    ASSERT_EQ(gpio_manager_configure_pad(&button), (uint32_t) ESP_OK);
+
+    trace_t trace;
+    add_transition(&trace, BUTTON, 4000, 1, 6);
+    add_press(&trace, BUTTON, 5000, 100);
+
+    play(trace, 6000);
+
+    ASSERT_EQ(events.size(), 1u);
+    expect_event(events[0], GPIO_CLICK, 5100 + 6 + DEBOUNCE_MS);
+}
+
+TEST(gpio_manager, detects_presses_of_active_high_pads) {
+
+    host_gpio_set_input(BUTTON, 0);
+    button = button_conf(BUTTON, 0);
+    button.pull_mode = GPIO_PULL_DOWN;
+    button.interrput_mode = GPIO_INTERRUPT_RISING;
+    ASSERT_EQ(gpio_manager_init(), (uint32_t) ESP_OK);
+    ASSERT_EQ(gpio_manager_configure_pad(&button), (uint32_t) ESP_OK);
+
+    trace_t trace;
+    add_transition(&trace, BUTTON, 100, 1, 4);
+    add_transition(&trace, BUTTON, 300, 0, 4);
+
+    play(trace, 1000);
+
+    ASSERT_EQ(events.size(), 1u);
+    expect_event(events[0], GPIO_CLICK, 300 + 4 + DEBOUNCE_MS);
+}
@@ -0,0 +1,270 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <ctime>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "data_sender_setup.h"
+
+extern "C" {
+#include "json-writer.h"
+#include "time-manager.h"
+#include "cJSON.h"
+}
+
+namespace {
+
+using cjson_ptr = std::unique_ptr<cJSON, decltype(&cJSON_Delete)>;
+
+std::string print(const cJSON *item) {
+
+    char *printed = cJSON_PrintUnformatted(item);
+    std::string result = printed;
+    cJSON_free(printed);
+    return result;
+}
+
+std::string write_number(double value) {
+
+    char buffer[64];
+    json_writer_t writer;
+    json_writer_init(&writer, buffer, sizeof(buffer));
+    json_writer_add_number(&writer, NULL, value);
+    const char *result = json_writer_finish(&writer);
+    return result != NULL ? result : "<overflow>";
+}
+
+std::string write_string(const char *value) {
+
+    char buffer[256];
+    json_writer_t writer;
+    json_writer_init(&writer, buffer, sizeof(buffer));
+    json_writer_add_string(&writer, NULL, value);
+    const char *result = json_writer_finish(&writer);
+    return result != NULL ? result : "<overflow>";
+}
+
+std::string reference_timestamp(int64_t epoch_ms) {
+
+    time_t seconds = epoch_ms / 1000;
+    struct tm timeinfo;
+    gmtime_r(&seconds, &timeinfo);
+
+    char date[32];
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", &timeinfo);
+
+    char out[40];
+    snprintf(out, sizeof(out), "%s.%03dZ", date, (int) (epoch_ms % 1000));
+    return out;
+}
+
+const char *DEVICE_ID = "7c5bbcaf-7772-4b82-ac7a-20707bfa8cd2";
+
+// 2021-03-04T05:06:07.089Z
+const int64_t SAMPLE_EPOCH_MS = 1614834367089LL;
+
+/**
+ * Message of the cJSON data sender this writer replaced
+ */
+cjson_ptr reference_message(const telemetry_sample_t &sample) {
+
+    cjson_ptr message(cJSON_CreateObject(), cJSON_Delete);
+    cJSON_AddItemToObject(message.get(), "deviceId", cJSON_CreateString(DEVICE_ID));
+    cJSON_AddItemToObject(message.get(), "timestamp", cJSON_CreateString(reference_timestamp(sample.timestamp).c_str()));
+
+    switch (sample.type) {
+        case POLLUTION_SAMPLE: {
+            const pollution_data_t &data = sample.pollution;
+            cJSON_AddItemToObject(message.get(), "pm1.0", cJSON_CreateNumber(data.pm1_0));
+            cJSON_AddItemToObject(message.get(), "pm2.5", cJSON_CreateNumber(data.pm2_5));
+            cJSON_AddItemToObject(message.get(), "pm10", cJSON_CreateNumber(data.pm10));
+            cJSON_AddItemToObject(message.get(), "particlesCount0.3", cJSON_CreateNumber(data.particles_03um));
+            cJSON_AddItemToObject(message.get(), "particlesCount0.5", cJSON_CreateNumber(data.particles_05um));
+            cJSON_AddItemToObject(message.get(), "particlesCount1.0", cJSON_CreateNumber(data.particles_10um));
+            cJSON_AddItemToObject(message.get(), "particlesCount2.5", cJSON_CreateNumber(data.particles_25um));
+            cJSON_AddItemToObject(message.get(), "particlesCount5.0", cJSON_CreateNumber(data.particles_50um));
+            cJSON_AddItemToObject(message.get(), "particlesCount10.0", cJSON_CreateNumber(data.particles_100um));
+            break;
+        }
+        case TEMPERATURE_SAMPLE:
+            cJSON_AddItemToObject(message.get(), "temperature", cJSON_CreateNumber(sample.temperature));
+            break;
+        case HUMIDITY_SAMPLE:
+            cJSON_AddItemToObject(message.get(), "humidity", cJSON_CreateNumber(sample.humidity));
+            break;
+    }
+
+    return message;
+}
+
+}
+
+TEST(json_writer, numbers_match_cjson) {
+
+    const double samples[] = {
+        0, -0.0, 1, -1, 42, 65535, 2147483647.0, -2147483648.0, 2147483648.0, -2147483649.0, 1e10, 1e300,
+        0.1, -0.1, 0.5, 1.0 / 3.0, 2.0 / 3.0, 22.3f, 55.7f, -12.4f, 1e-7, 123456.789, 0.30000000000000004,
+        std::numeric_limits<double>::min(), std::numeric_limits<double>::max(), std::numeric_limits<double>::epsilon(),
+        std::nan(""), std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity()
+    };
+
+    for (double value : samples) {
+        cjson_ptr number(cJSON_CreateNumber(value), cJSON_Delete);
+        EXPECT_EQ(write_number(value), print(number.get())) << value;
+    }
+
+    // every float a sensor reading can take, in tenths
+    for (int tenths = -400; tenths <= 1250; tenths++) {
+        float value = tenths / 10.0f;
+        cjson_ptr number(cJSON_CreateNumber(value), cJSON_Delete);
+        ASSERT_EQ(write_number(value), print(number.get())) << value;
+    }
+}
+
+TEST(json_writer, strings_are_escaped_as_cjson) {
+
+    std::string controls;
+    for (char c = 1; c < 32; c++) {
+        controls += c;
+    }
+
+    const std::string samples[] = {
+        "", "plain", "quote \" and backslash \\", "/slash", "tab\tnew line\nreturn\r", controls,
+        "caf\xc3\xa9 \xe2\x82\xac", "\x7f delete"
+    };
+
+    for (const std::string &value : samples) {
+        cjson_ptr string(cJSON_CreateString(value.c_str()), cJSON_Delete);
+        EXPECT_EQ(write_string(value.c_str()), print(string.get()));
+    }
+}
+
+TEST(json_writer, nested_documents_match_cjson) {
+
+    cjson_ptr reference(cJSON_CreateObject(), cJSON_Delete);
+    cJSON_AddItemToObject(reference.get(), "key \"quoted\"", cJSON_CreateString("value"));
+    cJSON_AddItemToObject(reference.get(), "empty", cJSON_CreateObject());
+    cJSON_AddItemToObject(reference.get(), "none", cJSON_CreateArray());
+    cJSON *items = cJSON_CreateArray();
+    cJSON_AddItemToObject(reference.get(), "items", items);
+    for (int i = 0; i < 3; i++) {
+        cJSON *item = cJSON_CreateObject();
+        cJSON_AddItemToObject(item, "index", cJSON_CreateNumber(i));
+        cJSON_AddItemToObject(item, "ratio", cJSON_CreateNumber(i / 7.0));
+        cJSON *nested = cJSON_CreateArray();
+        cJSON_AddItemToArray(nested, cJSON_CreateString("a"));
+        cJSON_AddItemToArray(nested, cJSON_CreateArray());
+        cJSON_AddItemToObject(item, "nested", nested);
+        cJSON_AddItemToArray(items, item);
+    }
+
+    char buffer[512];
+    json_writer_t writer;
+    json_writer_init(&writer, buffer, sizeof(buffer));
+    json_writer_begin_object(&writer, NULL);
+    json_writer_add_raw_member(&writer, "\"key \\\"quoted\\\"\":\"value\"");
+    json_writer_begin_object(&writer, "empty");
+    json_writer_end_object(&writer);
+    json_writer_begin_array(&writer, "none");
+    json_writer_end_array(&writer);
+    json_writer_begin_array(&writer, "items");
+    for (int i = 0; i < 3; i++) {
+        json_writer_begin_object(&writer, NULL);
+        json_writer_add_number(&writer, "index", i);
+        json_writer_add_number(&writer, "ratio", i / 7.0);
+        json_writer_begin_array(&writer, "nested");
+        json_writer_add_string(&writer, NULL, "a");
+        json_writer_begin_array(&writer, NULL);
+        json_writer_end_array(&writer);
+        json_writer_end_array(&writer);
+        json_writer_end_object(&writer);
+    }
+    json_writer_end_array(&writer);
+    json_writer_end_object(&writer);
+
+    const char *result = json_writer_finish(&writer);
+    ASSERT_NE(result, nullptr);
+    EXPECT_EQ(std::string(result), print(reference.get()));
+
+    // and reads back with the cJSON parser
+    cjson_ptr parsed(cJSON_Parse(result), cJSON_Delete);
+    ASSERT_NE(parsed.get(), nullptr);
+    EXPECT_EQ(print(parsed.get()), result);
+}
+
+TEST(json_writer, fails_when_the_buffer_is_too_small) {
+
+    const std::string expected = "{\"deviceId\":\"abc\",\"values\":[1,2.5]}";
+
+    for (size_t size = 0; size <= expected.size() + 1; size++) {
+        std::vector<char> buffer(size + 1, '#');
+        json_writer_t writer;
+        json_writer_init(&writer, size > 0 ? buffer.data() : NULL, size);
+        json_writer_begin_object(&writer, NULL);
+        json_writer_add_string(&writer, "deviceId", "abc");
+        json_writer_begin_array(&writer, "values");
+        json_writer_add_number(&writer, NULL, 1);
+        json_writer_add_number(&writer, NULL, 2.5);
+        json_writer_end_array(&writer);
+        json_writer_end_object(&writer);
+
+        const char *result = json_writer_finish(&writer);
+        if (size > expected.size()) {
+            ASSERT_NE(result, nullptr) << size;
+            EXPECT_EQ(std::string(result), expected);
+        } else {
+            EXPECT_EQ(result, nullptr) << size;
+        }
+        // nothing written past the buffer
+        EXPECT_EQ(buffer[size], '#') << size;
+    }
+}
+
+TEST(json_writer, refuses_unbalanced_and_too_deep_documents) {
+
+    char buffer[128];
+    json_writer_t writer;
+
+    json_writer_init(&writer, buffer, sizeof(buffer));
+    json_writer_begin_object(&writer, NULL);
+    EXPECT_EQ(json_writer_finish(&writer), nullptr);
+
+    json_writer_init(&writer, buffer, sizeof(buffer));
+    json_writer_end_array(&writer);
+    EXPECT_EQ(json_writer_finish(&writer), nullptr);
+
+    json_writer_init(&writer, buffer, sizeof(buffer));
+    for (int i = 0; i <= JSON_WRITER_MAX_DEPTH; i++) {
+        json_writer_begin_array(&writer, NULL);
+    }
+    for (int i = 0; i <= JSON_WRITER_MAX_DEPTH; i++) {
+        json_writer_end_array(&writer);
+    }
+    EXPECT_EQ(json_writer_finish(&writer), nullptr);
+}
+
+TEST(json_writer, publishes_the_messages_of_the_cjson_sender) {
+
+    ASSERT_TRUE(data_sender_setup::load_partitions());
+    ASSERT_TRUE(data_sender_setup::start());
+
+    const telemetry_sample_t samples[] = {
+        data_sender_setup::pms_sample(SAMPLE_EPOCH_MS, SAMPLE_CLOCK_EPOCH),
+        data_sender_setup::float_sample(TEMPERATURE_SAMPLE, 22.3f, SAMPLE_EPOCH_MS + 1000, SAMPLE_CLOCK_EPOCH),
+        data_sender_setup::float_sample(HUMIDITY_SAMPLE, 48.1f, SAMPLE_EPOCH_MS + 86400000, SAMPLE_CLOCK_EPOCH),
+        data_sender_setup::float_sample(TEMPERATURE_SAMPLE, -7.9f, SAMPLE_EPOCH_MS + 86400001, SAMPLE_CLOCK_EPOCH)
+    };
+
+    for (const telemetry_sample_t &sample : samples) {
+        host_mqtt_clear_sent();
+        ASSERT_TRUE(data_sender_enqueue_sample(&sample));
+        host_settle();
+
+        ASSERT_EQ(host_mqtt_get_sent_count(), 1);
+        const host_mqtt_message_t *message = host_mqtt_get_sent(0);
+        EXPECT_EQ(std::string((const char *) message->data, message->data_len), print(reference_message(sample).get()));
+    }
+}
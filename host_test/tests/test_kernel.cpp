@@ -0,0 +1,212 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/event_groups.h"
+#include "esp_event.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "host.h"
+}
+
+namespace {
+
+std::vector<std::string> trace;
+
+void record_task(void *arg) {
+
+    trace.push_back(static_cast<const char *>(arg));
+    vTaskDelete(NULL);
+}
+
+void delay_task(void *arg) {
+
+    vTaskDelay(pdMS_TO_TICKS(250));
+    trace.push_back("delayed " + std::to_string(esp_timer_get_time() / 1000));
+    vTaskDelete(NULL);
+}
+
+void queue_task(void *arg) {
+
+    QueueHandle_t queue = static_cast<QueueHandle_t>(arg);
+    int value;
+
+    while (xQueueReceive(queue, &value, pdMS_TO_TICKS(1000)) == pdTRUE) {
+        trace.push_back("received " + std::to_string(value));
+    }
+
+    trace.push_back("timeout " + std::to_string(esp_timer_get_time() / 1000));
+    vTaskDelete(NULL);
+}
+
+}
+
+TEST(kernel, runs_tasks_by_priority_then_creation_order) {
+
+    trace.clear();
+
+    xTaskCreate(record_task, "low", 2048, (void *) "low", 1, NULL);
+    xTaskCreate(record_task, "high", 2048, (void *) "high", 5, NULL);
+    xTaskCreate(record_task, "low2", 2048, (void *) "low2", 1, NULL);
+
+    EXPECT_TRUE(trace.empty());
+    host_settle();
+
+    EXPECT_EQ(trace, (std::vector<std::string> {"high", "low", "low2"}));
+}
+
+TEST(kernel, delays_advance_virtual_time) {
+
+    trace.clear();
+
+    xTaskCreate(delay_task, "delay", 2048, NULL, 5, NULL);
+
+    host_run_for_ms(249);
+    EXPECT_TRUE(trace.empty());
+
+    host_run_for_ms(1);
+    EXPECT_EQ(trace, (std::vector<std::string> {"delayed 250"}));
+    EXPECT_EQ(host_now_us(), 250000);
+}
+
+TEST(kernel, queue_receive_blocks_until_send_or_timeout) {
+
+    trace.clear();
+
+    QueueHandle_t queue = xQueueCreate(2, sizeof(int));
+    xTaskCreate(queue_task, "queue", 2048, queue, 5, NULL);
+    host_settle();
+
+    int value = 7;
+    xQueueSend(queue, &value, 0);
+    // the receiver has a higher priority but runs when the test blocks
+    EXPECT_TRUE(trace.empty());
+    host_settle();
+    EXPECT_EQ(trace, (std::vector<std::string> {"received 7"}));
+
+    host_run_for_ms(1000);
+    EXPECT_EQ(trace.back(), "timeout 1000");
+}
+
+TEST(kernel, queue_send_fails_when_full) {
+
+    QueueHandle_t queue = xQueueCreate(1, sizeof(int));
+    int value = 1;
+
+    EXPECT_EQ(xQueueSend(queue, &value, 0), pdTRUE);
+    EXPECT_EQ(xQueueSend(queue, &value, pdMS_TO_TICKS(100)), errQUEUE_FULL);
+    EXPECT_EQ(host_now_us(), 100000);
+    EXPECT_EQ(uxQueueMessagesWaiting(queue), 1u);
+
+    vQueueDelete(queue);
+}
+
+TEST(kernel, event_group_wait_returns_on_bits_or_timeout) {
+
+    EventGroupHandle_t event_group = xEventGroupCreate();
+
+    EventBits_t bits = xEventGroupWaitBits(event_group, BIT0, pdFALSE, pdTRUE, pdMS_TO_TICKS(50));
+    EXPECT_EQ(bits & BIT0, 0u);
+    EXPECT_EQ(host_now_us(), 50000);
+
+    xEventGroupSetBits(event_group, BIT0 | BIT1);
+    bits = xEventGroupWaitBits(event_group, BIT0 | BIT1, pdTRUE, pdTRUE, portMAX_DELAY);
+    EXPECT_EQ(bits & (BIT0 | BIT1), BIT0 | BIT1);
+    EXPECT_EQ(xEventGroupGetBits(event_group), 0u);
+
+    vEventGroupDelete(event_group);
+}
+
+TEST(kernel, periodic_timer_fires_on_virtual_time) {
+
+    static int fired = 0;
+    fired = 0;
+
+    esp_timer_create_args_t args = {};
+    args.callback = [](void *) { fired++; };
+    args.name = "periodic";
+
+    esp_timer_handle_t timer;
+    ASSERT_EQ(esp_timer_create(&args, &timer), ESP_OK);
+    ASSERT_EQ(esp_timer_start_periodic(timer, 100000), ESP_OK);
+
+    host_run_for_ms(1050);
+    EXPECT_EQ(fired, 10);
+
+    esp_timer_stop(timer);
+    host_run_for_ms(1000);
+    EXPECT_EQ(fired, 10);
+
+    esp_timer_delete(timer);
+}
+
+TEST(kernel, esp_timer_restarts_on_reboot) {
+
+    host_run_for_ms(500);
+    host_reboot();
+    host_run_for_ms(20);
+
+    EXPECT_EQ(esp_timer_get_time(), 20000);
+    EXPECT_EQ(host_now_us(), 520000);
+}
+
+TEST(kernel, events_are_dispatched_on_the_event_task) {
+
+    static int received = 0;
+    received = 0;
+
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+    ESP_ERROR_CHECK(esp_event_handler_register("TEST_EVENTS", 3,
+        [](void *, esp_event_base_t, int32_t, void *data) { received = *static_cast<int *>(data); }, NULL));
+
+    int value = 42;
+    ESP_ERROR_CHECK(esp_event_post("TEST_EVENTS", 3, &value, sizeof(value), 0));
+    value = 0;
+    host_settle();
+
+    EXPECT_EQ(received, 42);
+}
+
+TEST(heap, charges_allocations_and_fails_when_exhausted) {
+
+    host_heap_reset(1024);
+
+    void *block = malloc(100);
+    ASSERT_NE(block, nullptr);
+    EXPECT_EQ(host_heap_get_in_use(), 108u);
+    EXPECT_EQ(esp_get_free_heap_size(), 1024u - 108u);
+    EXPECT_EQ(malloc(1000), nullptr);
+
+    free(block);
+    EXPECT_EQ(host_heap_get_in_use(), 0u);
+    EXPECT_EQ(host_heap_get_peak(), 108u);
+    EXPECT_EQ(host_heap_get_allocations(), 1u);
+}
+
+TEST(nvs, keeps_values_until_cleared) {
+
+    ASSERT_EQ(nvs_flash_init(), ESP_OK);
+
+    nvs_handle_t handle;
+    ASSERT_EQ(nvs_open("test", NVS_READWRITE, &handle), ESP_OK);
+    ASSERT_EQ(nvs_set_u32(handle, "key", 12), ESP_OK);
+    nvs_close(handle);
+
+    uint32_t value = 0;
+    ASSERT_EQ(nvs_open("test", NVS_READONLY, &handle), ESP_OK);
+    EXPECT_EQ(nvs_get_u32(handle, "key", &value), ESP_OK);
+    EXPECT_EQ(value, 12u);
+    nvs_close(handle);
+
+    host_nvs_clear();
+    ASSERT_EQ(nvs_open("test", NVS_READONLY, &handle), ESP_OK);
+    EXPECT_EQ(nvs_get_u32(handle, "key", &value), ESP_ERR_NVS_NOT_FOUND);
+    nvs_close(handle);
+}
@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "mqtt-manager.h"
+#include "esp_event.h"
+#include "host.h"
+}
+
+namespace {
+
+std::vector<bool> deliveries;
+
+std::string received;
+
+void load_certificates(mqtt_certificates_t *certificates) {
+
+    certificates->ca_cert = "ca";
+    certificates->device_cert = "cert";
+    certificates->device_key = "key";
+}
+
+void on_delivery(void *context, bool is_delivered) {
+    deliveries.push_back(is_delivered);
+}
+
+void on_message(const char *topic, int topic_len, const char *data, int data_len) {
+    received = std::string(topic, topic_len) + " " + std::string(data, data_len);
+}
+
+bool is_connected(void *) {
+    return mqtt_manager_is_connected();
+}
+
+class mqtt_manager : public ::testing::Test {
+
+protected:
+    void SetUp() override {
+
+        deliveries.clear();
+        received.clear();
+
+        ESP_ERROR_CHECK(esp_event_loop_create_default());
+        ASSERT_EQ(mqtt_manager_init(load_certificates), (uint32_t) ESP_OK);
+        ASSERT_EQ(mqtt_manager_connect(), (uint32_t) ESP_OK);
+        ASSERT_TRUE(host_run_until(is_connected, NULL, 10, 1000));
+    }
+};
+
+}
+
+TEST_F(mqtt_manager, publishes_qos0_messages) {
+
+    ASSERT_TRUE(mqtt_manager_publish("breathe/test", "hello"));
+
+    ASSERT_EQ(host_mqtt_get_sent_count(), 1);
+    const host_mqtt_message_t *message = host_mqtt_get_sent(0);
+    EXPECT_STREQ(message->topic, "breathe/test");
+    EXPECT_EQ(std::string((const char *) message->data, message->data_len), "hello");
+    EXPECT_EQ(message->qos, 0);
+    // fixed header, topic length, topic and payload
+    EXPECT_EQ(message->wire_bytes, 2u + 2u + 12u + 5u);
+}
+
+TEST_F(mqtt_manager, reports_qos1_deliveries) {
+
+    ASSERT_TRUE(mqtt_manager_publish_qos1("breathe/test", "a", 1, on_delivery, NULL));
+    EXPECT_EQ(mqtt_manager_get_inflight_slots(), CONFIG_MQTT_INFLIGHT_WINDOW - 1);
+
+    host_settle();
+
+    EXPECT_EQ(deliveries, std::vector<bool> {true});
+    EXPECT_EQ(mqtt_manager_get_inflight_slots(), CONFIG_MQTT_INFLIGHT_WINDOW);
+}
+
+TEST_F(mqtt_manager, refuses_publishes_beyond_the_window) {
+
+    host_mqtt_set_auto_ack(false);
+
+    for (int i = 0; i < CONFIG_MQTT_INFLIGHT_WINDOW; i++) {
+        ASSERT_TRUE(mqtt_manager_publish_qos1("breathe/test", "a", 1, on_delivery, NULL));
+    }
+    EXPECT_FALSE(mqtt_manager_publish_qos1("breathe/test", "a", 1, on_delivery, NULL));
+    EXPECT_EQ(mqtt_manager_get_inflight_slots(), 0);
+
+    // enqueued messages go out from the MQTT task
+    host_settle();
+    EXPECT_EQ(host_mqtt_ack_all(), CONFIG_MQTT_INFLIGHT_WINDOW);
+    host_settle();
+
+    EXPECT_EQ(deliveries.size(), (size_t) CONFIG_MQTT_INFLIGHT_WINDOW);
+    EXPECT_EQ(mqtt_manager_get_inflight_slots(), CONFIG_MQTT_INFLIGHT_WINDOW);
+}
+
+TEST_F(mqtt_manager, resends_unacknowledged_messages_after_a_reconnect) {
+
+    host_mqtt_set_auto_ack(false);
+    ASSERT_TRUE(mqtt_manager_publish_qos1("breathe/test", "a", 1, on_delivery, NULL));
+    host_settle();
+
+    host_mqtt_set_broker_online(false);
+    host_settle();
+    EXPECT_FALSE(mqtt_manager_is_connected());
+    EXPECT_FALSE(mqtt_manager_publish("breathe/test", "lost"));
+
+    host_mqtt_clear_sent();
+    host_mqtt_set_broker_online(true);
+    host_mqtt_set_auto_ack(true);
+    ASSERT_TRUE(host_run_until(is_connected, NULL, 100, HOST_MQTT_RECONNECT_TIMEOUT + 1000));
+    host_settle();
+
+    ASSERT_GE(host_mqtt_get_sent_count(), 1);
+    EXPECT_TRUE(host_mqtt_get_sent(0)->dup);
+    EXPECT_EQ(deliveries, std::vector<bool> {true});
+}
+
+TEST_F(mqtt_manager, delivers_messages_of_subscribed_topics) {
+
+    mqtt_manager_set_message_callback(on_message);
+    ASSERT_TRUE(mqtt_manager_subscribe("breathe/commands"));
+    host_settle();
+
+    ASSERT_EQ(host_mqtt_get_subscriptions_count(), 1);
+    EXPECT_STREQ(host_mqtt_get_subscription(0), "breathe/commands");
+
+    host_mqtt_deliver("breathe/commands", "reboot", 6);
+    host_settle();
+
+    EXPECT_EQ(received, "breathe/commands reboot");
+}
+
+TEST_F(mqtt_manager, releases_a_slot_only_after_the_outbox_dropped_its_message) {
+
+    host_mqtt_set_auto_ack(false);
+    ASSERT_TRUE(mqtt_manager_publish_qos1("breathe/test", "a", 1, on_delivery, NULL));
+    host_settle();
+
+    host_run_for_ms(HOST_MQTT_OUTBOX_EXPIRATION + 1000);
+    EXPECT_EQ(host_mqtt_get_outbox_count(), 0);
+    EXPECT_EQ(mqtt_manager_get_inflight_slots(), CONFIG_MQTT_INFLIGHT_WINDOW - 1);
+    EXPECT_TRUE(deliveries.empty());
+
+    host_run_for_ms(5000);
+    EXPECT_EQ(mqtt_manager_get_inflight_slots(), CONFIG_MQTT_INFLIGHT_WINDOW);
+    EXPECT_EQ(deliveries, std::vector<bool> {false});
+}
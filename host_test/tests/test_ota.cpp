@@ -0,0 +1,137 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <vector>
+
+extern "C" {
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "host.h"
+}
+
+namespace {
+
+std::vector<uint8_t> build_image(const char *version, size_t payload_size) {
+
+    std::vector<uint8_t> payload(payload_size);
+    for (size_t i = 0; i < payload_size; i++) {
+        payload[i] = (uint8_t) (i * 31 + 7);
+    }
+
+    std::vector<uint8_t> image(payload_size + 1024);
+    size_t size = host_ota_build_image(version, payload.data(), payload.size(), image.data(), image.size());
+    image.resize(size);
+
+    return image;
+}
+
+void write_update(const std::vector<uint8_t> &image) {
+
+    const esp_partition_t *partition = esp_ota_get_next_update_partition(NULL);
+    ASSERT_NE(partition, nullptr);
+
+    esp_ota_handle_t handle;
+    ASSERT_EQ(esp_ota_begin(partition, OTA_SIZE_UNKNOWN, &handle), ESP_OK);
+    // written in chunks, as received
+    for (size_t offset = 0; offset < image.size(); offset += 1000) {
+        size_t length = std::min<size_t>(1000, image.size() - offset);
+        ASSERT_EQ(esp_ota_write(handle, image.data() + offset, length), ESP_OK);
+    }
+    ASSERT_EQ(esp_ota_end(handle), ESP_OK);
+    ASSERT_EQ(esp_ota_set_boot_partition(partition), ESP_OK);
+}
+
+esp_ota_img_states_t get_state(const char *label) {
+
+    esp_ota_img_states_t state = ESP_OTA_IMG_UNDEFINED;
+    esp_ota_get_state_partition(host_partition_get(label), &state);
+    return state;
+}
+
+}
+
+TEST(ota, installs_an_update_pending_verification) {
+
+    host_ota_install_running_image("1.0.0", "running", 7);
+    EXPECT_STREQ(esp_ota_get_app_description()->version, "1.0.0");
+
+    write_update(build_image("1.1.0", 5000));
+    EXPECT_EQ(esp_ota_get_boot_partition(), host_partition_get("ota_1"));
+    EXPECT_EQ(esp_ota_get_running_partition(), host_partition_get("ota_0"));
+
+    host_ota_boot();
+
+    EXPECT_EQ(esp_ota_get_running_partition(), host_partition_get("ota_1"));
+    EXPECT_STREQ(esp_ota_get_app_description()->version, "1.1.0");
+    EXPECT_EQ(get_state("ota_1"), ESP_OTA_IMG_PENDING_VERIFY);
+
+    ASSERT_EQ(esp_ota_mark_app_valid_cancel_rollback(), ESP_OK);
+    EXPECT_EQ(get_state("ota_1"), ESP_OTA_IMG_VALID);
+    EXPECT_EQ(esp_ota_get_last_invalid_partition(), nullptr);
+}
+
+TEST(ota, rejects_a_corrupted_image) {
+
+    std::vector<uint8_t> image = build_image("1.1.0", 5000);
+    image[2000] ^= 0x01;
+
+    const esp_partition_t *partition = esp_ota_get_next_update_partition(NULL);
+    esp_ota_handle_t handle;
+    ASSERT_EQ(esp_ota_begin(partition, image.size(), &handle), ESP_OK);
+    ASSERT_EQ(esp_ota_write(handle, image.data(), image.size()), ESP_OK);
+    EXPECT_EQ(esp_ota_end(handle), ESP_ERR_OTA_VALIDATE_FAILED);
+    EXPECT_EQ(esp_ota_set_boot_partition(partition), ESP_ERR_OTA_VALIDATE_FAILED);
+}
+
+TEST(ota, refuses_to_overwrite_the_running_image) {
+
+    esp_ota_handle_t handle;
+    EXPECT_EQ(esp_ota_begin(esp_ota_get_running_partition(), OTA_SIZE_UNKNOWN, &handle),
+        ESP_ERR_OTA_PARTITION_CONFLICT);
+}
+
+TEST(ota, rolls_back_an_image_rebooted_before_confirmation) {
+
+    host_ota_install_running_image("1.0.0", "running", 7);
+    host_ota_set_state("ota_0", ESP_OTA_IMG_VALID);
+    write_update(build_image("1.1.0", 5000));
+
+    host_ota_boot();
+    EXPECT_EQ(get_state("ota_1"), ESP_OTA_IMG_PENDING_VERIFY);
+
+    // a crash before the image was confirmed
+    host_ota_boot();
+
+    EXPECT_EQ(esp_ota_get_running_partition(), host_partition_get("ota_0"));
+    EXPECT_EQ(get_state("ota_1"), ESP_OTA_IMG_ABORTED);
+    EXPECT_EQ(esp_ota_get_last_invalid_partition(), host_partition_get("ota_1"));
+
+    esp_app_desc_t description;
+    ASSERT_EQ(esp_ota_get_partition_description(esp_ota_get_last_invalid_partition(), &description), ESP_OK);
+    EXPECT_STREQ(description.version, "1.1.0");
+}
+
+TEST(ota, rolls_back_an_image_marked_invalid) {
+
+    host_ota_install_running_image("1.0.0", "running", 7);
+    host_ota_set_state("ota_0", ESP_OTA_IMG_VALID);
+    write_update(build_image("1.1.0", 5000));
+    host_ota_boot();
+
+    int restarts = host_get_restart_count();
+    esp_ota_mark_app_invalid_rollback_and_reboot();
+
+    EXPECT_EQ(host_get_restart_count(), restarts + 1);
+    EXPECT_EQ(get_state("ota_1"), ESP_OTA_IMG_INVALID);
+    EXPECT_EQ(esp_ota_get_boot_partition(), host_partition_get("ota_0"));
+}
+
+TEST(ota, hashes_match_the_appended_digest) {
+
+    std::vector<uint8_t> image = build_image("1.1.0", 5000);
+    write_update(image);
+
+    uint8_t hash[32];
+    ASSERT_EQ(esp_partition_get_sha256(host_partition_get("ota_1"), hash), ESP_OK);
+    EXPECT_EQ(memcmp(hash, image.data() + image.size() - 32, 32), 0);
+}
@@ -0,0 +1,451 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "delta_images.h"
+
+extern "C" {
+#include "sdkconfig.h"
+#include "ota-manager.h"
+#include "storage-manager.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+}
+
+using delta_images::bytes_t;
+
+namespace {
+
+const uint32_t CHECK_TIMEOUT_MS = 60000;
+
+// as ota-manager
+const uint32_t OTA_CHUNK_SIZE = 64 * 1024;
+
+struct request_t {
+    std::string url;
+    std::string range;
+    std::string if_range;
+    std::string if_none_match;
+    int status;
+};
+
+/**
+ * Release server: the manifest and the image of the latest release, a delta
+ * patch for one source image, an interruption of the range starting at
+ * fail_offset
+ */
+struct server_t {
+    std::string manifest;
+    std::string manifest_etag;
+    bytes_t image;
+    std::string image_etag;
+    bool is_serving_ranges;
+    int image_status;
+    bytes_t patch;
+    std::string patch_source_hash;
+    long fail_offset;
+    long fail_after;
+    std::vector<request_t> requests;
+    size_t image_bytes;
+};
+
+server_t server;
+
+bytes_t payload;
+
+std::string to_hex(const uint8_t *data, size_t length) {
+
+    std::string hex;
+    char digits[3];
+    for (size_t i = 0; i < length; i++) {
+        snprintf(digits, sizeof(digits), "%02x", data[i]);
+        hex += digits;
+    }
+    return hex;
+}
+
+std::string get_image_hash(const bytes_t &image) {
+    return to_hex(image.data() + image.size() - 32, 32);
+}
+
+std::string get_header(const host_http_request_t *request, const char *key) {
+
+    const char *value = host_http_get_header(request, key);
+    return value != NULL ? value : "";
+}
+
+void serve_image(const host_http_request_t *request, host_http_response_t *response, request_t *record) {
+
+    if (server.image_status != 0) {
+        response->status = server.image_status;
+        return;
+    }
+
+    host_http_add_header(response, "ETag", server.image_etag.c_str());
+
+    if (!server.patch.empty() && get_header(request, "X-Fw-Sha256") == server.patch_source_hash) {
+        response->status = 200;
+        response->body = server.patch.data();
+        response->body_length = server.patch.size();
+        return;
+    }
+
+    unsigned int start, end;
+    bool is_range = server.is_serving_ranges && sscanf(record->range.c_str(), "bytes=%u-%u", &start, &end) == 2 &&
+        start < server.image.size() && (record->if_range.empty() || record->if_range == server.image_etag);
+
+    if (!is_range) {
+        response->status = 200;
+        response->body = server.image.data();
+        response->body_length = server.image.size();
+        return;
+    }
+
+    end = std::min<unsigned int>(end, server.image.size() - 1);
+    char content_range[64];
+    snprintf(content_range, sizeof(content_range), "bytes %u-%u/%u", start, end, (unsigned int) server.image.size());
+    host_http_add_header(response, "Content-Range", content_range);
+
+    response->status = 206;
+    response->body = server.image.data() + start;
+    response->body_length = end - start + 1;
+
+    // a single interruption
+    if ((long) start == server.fail_offset) {
+        response->fail_after = server.fail_after;
+        server.fail_offset = -1;
+    }
+}
+
+void handle_request(void *context, const host_http_request_t *request, host_http_response_t *response) {
+
+    request_t record = {
+        request->url,
+        get_header(request, "Range"),
+        get_header(request, "If-Range"),
+        get_header(request, "If-None-Match"),
+        0
+    };
+
+    if (record.url == CONFIG_FW_MANIFEST_URL) {
+        host_http_add_header(response, "ETag", server.manifest_etag.c_str());
+        if (record.if_none_match == server.manifest_etag) {
+            response->status = 304;
+        } else {
+            response->status = 200;
+            response->body = (const uint8_t *) server.manifest.data();
+            response->body_length = server.manifest.size();
+        }
+    } else if (record.url == CONFIG_FW_UPDATE_URL) {
+        serve_image(request, response, &record);
+        server.image_bytes += response->fail_after >= 0 ? response->fail_after : response->body_length;
+    } else {
+        response->status = 404;
+    }
+
+    record.status = response->status;
+    server.requests.push_back(record);
+}
+
+void release(const char *version, const bytes_t &image, const char *etag) {
+
+    server.image = image;
+    server.image_etag = std::string("\"") + etag + "\"";
+    server.manifest = std::string("{\"version\":\"") + version + "\",\"sha256\":\"" + get_image_hash(image) + "\"}";
+    server.manifest_etag = std::string("\"manifest-") + etag + "\"";
+}
+
+/**
+ * Running image 1.0.0 and its manifest, an OTA manager idle until checked
+ */
+void start() {
+
+    payload = delta_images::build_payload(1, 150000);
+    host_ota_install_running_image("1.0.0", payload.data(), payload.size());
+    host_ota_set_state("ota_0", ESP_OTA_IMG_VALID);
+
+    server = server_t();
+    server.is_serving_ranges = true;
+    server.fail_offset = -1;
+    release("1.0.0", delta_images::build_image("1.0.0", payload), "1");
+    host_http_set_handler(handle_request, NULL);
+
+    ASSERT_TRUE(storage_manager_init());
+    ASSERT_EQ(ota_manager_init(), ESP_OK);
+}
+
+bytes_t build_update(const char *version, uint32_t seed) {
+    return delta_images::build_image(version, delta_images::edit_payload(payload, seed, 20));
+}
+
+/**
+ * A check completes unless the device restarted into the update
+ */
+bool check() {
+
+    server.requests.clear();
+    server.image_bytes = 0;
+    return ota_manager_check_now(CHECK_TIMEOUT_MS);
+}
+
+std::vector<request_t> get_image_requests() {
+
+    std::vector<request_t> requests;
+    for (const request_t &request : server.requests) {
+        if (request.url == CONFIG_FW_UPDATE_URL) {
+            requests.push_back(request);
+        }
+    }
+    return requests;
+}
+
+void expect_installed(const bytes_t &image) {
+
+    const esp_partition_t *partition = host_partition_get("ota_1");
+    EXPECT_EQ(esp_ota_get_boot_partition(), partition);
+    EXPECT_EQ(memcmp(host_partition_data("ota_1"), image.data(), image.size()), 0);
+}
+
+}
+
+TEST(ota_manager_manifest, skips_a_manifest_not_modified) {
+
+    start();
+
+    ASSERT_TRUE(check());
+    ASSERT_EQ(server.requests.size(), 1u);
+    EXPECT_EQ(server.requests[0].if_none_match, "");
+    EXPECT_EQ(server.requests[0].status, 200);
+
+    ASSERT_TRUE(check());
+    ASSERT_EQ(server.requests.size(), 1u);
+    EXPECT_EQ(server.requests[0].if_none_match, server.manifest_etag);
+    EXPECT_EQ(server.requests[0].status, 304);
+
+    EXPECT_EQ(esp_ota_get_boot_partition(), host_partition_get("ota_0"));
+}
+
+TEST(ota_manager_manifest, downloads_the_release_of_a_changed_manifest) {
+
+    start();
+    ASSERT_TRUE(check());
+    std::string etag = server.manifest_etag;
+
+    bytes_t update = build_update("1.1.0", 2);
+    release("1.1.0", update, "2");
+    int restarts = host_get_restart_count();
+
+    EXPECT_FALSE(check());
+
+    ASSERT_GE(server.requests.size(), 2u);
+    EXPECT_EQ(server.requests[0].if_none_match, etag);
+    EXPECT_EQ(server.requests[0].status, 200);
+    EXPECT_EQ(host_get_restart_count(), restarts + 1);
+    expect_installed(update);
+}
+
+TEST(ota_manager_manifest, fetches_the_manifest_in_full_after_a_failed_download) {
+
+    start();
+    ASSERT_TRUE(check());
+
+    release("1.1.0", build_update("1.1.0", 2), "2");
+    server.image_status = 503;
+    ASSERT_TRUE(check());
+    EXPECT_EQ(get_image_requests().size(), 1u);
+
+    ASSERT_TRUE(check());
+    EXPECT_EQ(server.requests[0].if_none_match, "");
+    EXPECT_EQ(server.requests[0].status, 200);
+    EXPECT_EQ(esp_ota_get_boot_partition(), host_partition_get("ota_0"));
+}
+
+TEST(ota_manager_manifest, keeps_the_running_image_when_the_download_is_not_the_release) {
+
+    start();
+
+    // the server holds a newer build than the manifest describes
+    release("1.1.0", build_update("1.1.0", 2), "2");
+    server.image = build_update("1.1.0", 3);
+
+    int restarts = host_get_restart_count();
+    ASSERT_TRUE(check());
+
+    EXPECT_EQ(host_get_restart_count(), restarts);
+    EXPECT_EQ(esp_ota_get_boot_partition(), host_partition_get("ota_0"));
+}
+
+TEST(ota_manager_manifest, skips_a_release_rolled_back_before) {
+
+    start();
+    release("1.1.0", build_update("1.1.0", 2), "2");
+    EXPECT_FALSE(check());
+
+    // the self-test failed, the bootloader booted the previous image
+    host_ota_boot();
+    host_ota_boot();
+    ASSERT_EQ(esp_ota_get_running_partition(), host_partition_get("ota_0"));
+    ASSERT_EQ(ota_manager_init(), ESP_OK);
+
+    ASSERT_TRUE(check());
+    EXPECT_TRUE(get_image_requests().empty());
+
+    // unchanged since
+    ASSERT_TRUE(check());
+    ASSERT_EQ(server.requests.size(), 1u);
+    EXPECT_EQ(server.requests[0].status, 304);
+
+    bytes_t fixed = build_update("1.1.1", 3);
+    release("1.1.1", fixed, "3");
+    EXPECT_FALSE(check());
+    expect_installed(fixed);
+}
+
+TEST(ota_manager_manifest, skips_a_version_rolled_back_before) {
+
+    start();
+    release("1.1.0", build_update("1.1.0", 2), "2");
+    EXPECT_FALSE(check());
+
+    host_ota_boot();
+    host_ota_boot();
+    ASSERT_EQ(ota_manager_init(), ESP_OK);
+
+    // a manifest without the image hash
+    server.manifest = "{\"version\":\"1.1.0\"}";
+    server.manifest_etag = "\"manifest-4\"";
+    ASSERT_TRUE(check());
+    EXPECT_TRUE(get_image_requests().empty());
+}
+
+TEST(ota_manager_download, downloads_an_image_in_ranges) {
+
+    start();
+    bytes_t update = build_update("1.1.0", 2);
+    release("1.1.0", update, "2");
+
+    EXPECT_FALSE(check());
+
+    std::vector<request_t> requests = get_image_requests();
+    size_t chunks = (update.size() + OTA_CHUNK_SIZE - 1) / OTA_CHUNK_SIZE;
+    ASSERT_EQ(requests.size(), chunks);
+    for (size_t i = 0; i < chunks; i++) {
+        char range[64];
+        snprintf(range, sizeof(range), "bytes=%u-%u", (unsigned int) (i * OTA_CHUNK_SIZE),
+            (unsigned int) ((i + 1) * OTA_CHUNK_SIZE - 1));
+        EXPECT_EQ(requests[i].range, range);
+        EXPECT_EQ(requests[i].status, 206);
+        // the image of the first chunk, or a changed one sent whole
+        EXPECT_EQ(requests[i].if_range, i == 0 ? "" : server.image_etag);
+    }
+
+    EXPECT_EQ(server.image_bytes, update.size());
+    expect_installed(update);
+}
+
+TEST(ota_manager_download, resumes_an_interrupted_download_from_the_last_chunk) {
+
+    start();
+    bytes_t update = build_update("1.1.0", 2);
+    release("1.1.0", update, "2");
+    server.fail_offset = OTA_CHUNK_SIZE;
+    server.fail_after = 10000;
+    int restarts = host_get_restart_count();
+
+    ASSERT_TRUE(check());
+    EXPECT_EQ(host_get_restart_count(), restarts);
+    EXPECT_EQ(get_image_requests().size(), 2u);
+
+    EXPECT_FALSE(check());
+
+    std::vector<request_t> requests = get_image_requests();
+    ASSERT_FALSE(requests.empty());
+    char range[64];
+    snprintf(range, sizeof(range), "bytes=%u-%u", OTA_CHUNK_SIZE, 2 * OTA_CHUNK_SIZE - 1);
+    EXPECT_EQ(requests[0].range, range);
+    EXPECT_EQ(requests[0].if_range, server.image_etag);
+    EXPECT_EQ(requests[0].status, 206);
+
+    // the complete chunk isn't downloaded again
+    EXPECT_EQ(server.image_bytes, update.size() - OTA_CHUNK_SIZE);
+    EXPECT_EQ(host_get_restart_count(), restarts + 1);
+    expect_installed(update);
+}
+
+TEST(ota_manager_download, starts_over_when_the_image_changed_since_the_interruption) {
+
+    start();
+    release("1.1.0", build_update("1.1.0", 2), "2");
+    server.fail_offset = OTA_CHUNK_SIZE;
+    server.fail_after = 10000;
+    ASSERT_TRUE(check());
+
+    // the same release rebuilt
+    bytes_t rebuilt = build_update("1.1.0", 3);
+    release("1.1.0", rebuilt, "3");
+
+    EXPECT_FALSE(check());
+
+    std::vector<request_t> requests = get_image_requests();
+    ASSERT_EQ(requests.size(), 1u);
+    EXPECT_EQ(requests[0].if_range, "\"2\"");
+    EXPECT_EQ(requests[0].status, 200);
+    expect_installed(rebuilt);
+}
+
+TEST(ota_manager_download, starts_over_when_the_partial_image_is_damaged) {
+
+    start();
+    bytes_t update = build_update("1.1.0", 2);
+    release("1.1.0", update, "2");
+    server.fail_offset = OTA_CHUNK_SIZE;
+    server.fail_after = 10000;
+    ASSERT_TRUE(check());
+
+    host_partition_data("ota_1")[1000] ^= 0xFF;
+
+    EXPECT_FALSE(check());
+
+    std::vector<request_t> requests = get_image_requests();
+    ASSERT_FALSE(requests.empty());
+    EXPECT_EQ(requests[0].range, "bytes=0-65535");
+    EXPECT_EQ(requests[0].if_range, "");
+    EXPECT_EQ(server.image_bytes, update.size());
+    expect_installed(update);
+}
+
+TEST(ota_manager_download, downloads_a_full_image_from_servers_without_ranges) {
+
+    start();
+    bytes_t update = build_update("1.1.0", 2);
+    release("1.1.0", update, "2");
+    server.is_serving_ranges = false;
+
+    EXPECT_FALSE(check());
+
+    std::vector<request_t> requests = get_image_requests();
+    ASSERT_EQ(requests.size(), 1u);
+    EXPECT_EQ(requests[0].status, 200);
+    expect_installed(update);
+}
+
+TEST(ota_manager_download, applies_a_delta_patch_for_the_running_image) {
+
+    start();
+    bytes_t update = build_update("1.1.0", 2);
+    release("1.1.0", update, "2");
+    bytes_t running = delta_images::build_image("1.0.0", payload);
+    server.patch = delta_images::generate_patch(running, update);
+    server.patch_source_hash = get_image_hash(running);
+    ASSERT_FALSE(server.patch.empty());
+
+    EXPECT_FALSE(check());
+
+    std::vector<request_t> requests = get_image_requests();
+    ASSERT_EQ(requests.size(), 1u);
+    EXPECT_EQ(requests[0].status, 200);
+    EXPECT_EQ(server.image_bytes, server.patch.size());
+    expect_installed(update);
+}
@@ -0,0 +1,219 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "spsc-ring.h"
+#include "host.h"
+}
+
+namespace {
+
+// a torn copy shows up as words of different sequence numbers
+struct item_t {
+    uint32_t words[8];
+};
+
+const uint32_t CAPACITY = 16;
+
+const uint32_t STRESS_ITEMS = 500000;
+
+// the overwriting producer lets the consumer in on a single core, after more
+// items than the ring holds
+const uint32_t OVERWRITE_YIELD_INTERVAL = 37;
+
+item_t make_item(uint32_t sequence) {
+
+    item_t item;
+    for (uint32_t &word : item.words) {
+        word = sequence;
+    }
+    return item;
+}
+
+bool is_intact(const item_t &item) {
+
+    for (uint32_t word : item.words) {
+        if (word != item.words[0]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct stress_result_t {
+    uint32_t refused;
+    uint32_t received;
+    uint32_t torn;
+    uint32_t out_of_order;
+    uint32_t gaps;
+};
+
+/**
+ * A producer and a consumer thread hammering the ring without notifications,
+ * the consumer checks every item it gets and drains the ring at the end. A
+ * refused push is retried after yielding, so a dropping ring delivers all.
+ */
+stress_result_t stress(spsc_ring_t *ring) {
+
+    std::atomic<bool> is_producing(true);
+    uint32_t refused = 0;
+
+    std::thread producer([&]() {
+        for (uint32_t sequence = 1; sequence <= STRESS_ITEMS; sequence++) {
+            item_t item = make_item(sequence);
+            while (!spsc_ring_push(ring, &item)) {
+                refused++;
+                std::this_thread::yield();
+            }
+            if (ring->policy == SPSC_RING_OVERWRITE_OLDEST && sequence % OVERWRITE_YIELD_INTERVAL == 0) {
+                std::this_thread::yield();
+            }
+        }
+        is_producing.store(false, std::memory_order_release);
+    });
+
+    stress_result_t result = {};
+    uint32_t last = 0;
+    item_t item;
+
+    while (true) {
+        bool is_done = !is_producing.load(std::memory_order_acquire);
+        while (spsc_ring_pop(ring, &item)) {
+            result.received++;
+            result.torn += !is_intact(item);
+            result.out_of_order += item.words[0] <= last;
+            result.gaps += item.words[0] > last + 1;
+            last = item.words[0];
+        }
+        if (is_done) {
+            break;
+        }
+        std::this_thread::yield();
+    }
+
+    producer.join();
+    result.refused = refused;
+
+    return result;
+}
+
+}
+
+TEST(spsc_ring, refuses_capacities_not_power_of_two) {
+
+    item_t storage[12];
+    spsc_ring_t ring;
+
+    EXPECT_FALSE(spsc_ring_init(&ring, storage, sizeof(item_t), 12, SPSC_RING_DROP_NEWEST));
+    EXPECT_FALSE(spsc_ring_init(&ring, storage, sizeof(item_t), 0, SPSC_RING_DROP_NEWEST));
+    EXPECT_TRUE(spsc_ring_init(&ring, storage, sizeof(item_t), 8, SPSC_RING_DROP_NEWEST));
+}
+
+TEST(spsc_ring, drops_the_newest_item_when_full) {
+
+    item_t storage[4];
+    spsc_ring_t ring;
+    ASSERT_TRUE(spsc_ring_init(&ring, storage, sizeof(item_t), 4, SPSC_RING_DROP_NEWEST));
+
+    for (uint32_t sequence = 1; sequence <= 6; sequence++) {
+        item_t item = make_item(sequence);
+        EXPECT_EQ(spsc_ring_push(&ring, &item), sequence <= 4);
+    }
+    EXPECT_EQ(spsc_ring_count(&ring), 4u);
+    EXPECT_EQ(spsc_ring_get_dropped(&ring), 2u);
+
+    item_t item;
+    for (uint32_t sequence = 1; sequence <= 4; sequence++) {
+        ASSERT_TRUE(spsc_ring_pop(&ring, &item));
+        EXPECT_EQ(item.words[0], sequence);
+    }
+    EXPECT_FALSE(spsc_ring_pop(&ring, &item));
+}
+
+TEST(spsc_ring, overwrites_the_oldest_item_when_full) {
+
+    item_t storage[4];
+    spsc_ring_t ring;
+    ASSERT_TRUE(spsc_ring_init(&ring, storage, sizeof(item_t), 4, SPSC_RING_OVERWRITE_OLDEST));
+
+    for (uint32_t sequence = 1; sequence <= 6; sequence++) {
+        item_t item = make_item(sequence);
+        EXPECT_TRUE(spsc_ring_push(&ring, &item));
+    }
+    EXPECT_EQ(spsc_ring_count(&ring), 4u);
+    EXPECT_EQ(spsc_ring_get_dropped(&ring), 2u);
+
+    item_t item;
+    for (uint32_t sequence = 3; sequence <= 6; sequence++) {
+        ASSERT_TRUE(spsc_ring_pop(&ring, &item));
+        EXPECT_EQ(item.words[0], sequence);
+    }
+    EXPECT_FALSE(spsc_ring_pop(&ring, &item));
+}
+
+TEST(spsc_ring, wakes_the_consumer_task_on_push) {
+
+    static spsc_ring_t ring;
+    static item_t storage[4];
+    static std::vector<uint32_t> received;
+
+    ASSERT_TRUE(spsc_ring_init(&ring, storage, sizeof(item_t), 4, SPSC_RING_DROP_NEWEST));
+
+    TaskHandle_t consumer;
+    xTaskCreate([](void *) {
+        item_t item;
+        while (true) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            while (spsc_ring_pop(&ring, &item)) {
+                received.push_back(item.words[0]);
+            }
+        }
+    }, "consumer", 2048, NULL, 5, &consumer);
+    spsc_ring_set_consumer(&ring, consumer);
+    host_settle();
+
+    for (uint32_t sequence = 1; sequence <= 10; sequence++) {
+        item_t item = make_item(sequence);
+        ASSERT_TRUE(spsc_ring_push(&ring, &item));
+        host_settle();
+    }
+
+    EXPECT_EQ(received.size(), 10u);
+    EXPECT_EQ(received.back(), 10u);
+}
+
+TEST(spsc_ring, delivers_every_item_in_order_under_contention) {
+
+    static item_t storage[CAPACITY];
+    spsc_ring_t ring;
+    ASSERT_TRUE(spsc_ring_init(&ring, storage, sizeof(item_t), CAPACITY, SPSC_RING_DROP_NEWEST));
+
+    stress_result_t result = stress(&ring);
+
+    EXPECT_EQ(result.received, STRESS_ITEMS);
+    EXPECT_EQ(result.torn, 0u);
+    EXPECT_EQ(result.out_of_order, 0u);
+    EXPECT_EQ(result.gaps, 0u);
+    // the ring did fill up, every refusal is counted
+    EXPECT_GT(result.refused, 0u);
+    EXPECT_EQ(spsc_ring_get_dropped(&ring), result.refused);
+}
+
+TEST(spsc_ring, never_returns_overwritten_items_under_contention) {
+
+    static item_t storage[CAPACITY];
+    spsc_ring_t ring;
+    ASSERT_TRUE(spsc_ring_init(&ring, storage, sizeof(item_t), CAPACITY, SPSC_RING_OVERWRITE_OLDEST));
+
+    stress_result_t result = stress(&ring);
+
+    EXPECT_EQ(result.refused, 0u);
+    EXPECT_EQ(result.torn, 0u);
+    EXPECT_EQ(result.out_of_order, 0u);
+    // every item is either received or counted as overwritten
+    EXPECT_GT(spsc_ring_get_dropped(&ring), 0u);
+    EXPECT_EQ(result.received + spsc_ring_get_dropped(&ring), STRESS_ITEMS);
+}
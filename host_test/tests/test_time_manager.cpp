@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <ctime>
+#include <string>
+
+extern "C" {
+#include "time-manager.h"
+#include "host.h"
+}
+
+namespace {
+
+// 2021-03-04T05:06:07.089Z
+const int64_t SYNC_EPOCH_MS = 1614834367089LL;
+
+std::string reference_timestamp(int64_t epoch_ms) {
+
+    time_t seconds = epoch_ms / 1000;
+    struct tm timeinfo;
+    gmtime_r(&seconds, &timeinfo);
+
+    char date[32];
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", &timeinfo);
+
+    char out[40];
+    snprintf(out, sizeof(out), "%s.%03dZ", date, (int) (epoch_ms % 1000));
+    return out;
+}
+
+}
+
+TEST(time_manager, iso_timestamps_match_gmtime) {
+
+    iso_timestamp_t timestamp;
+    time_manager_init_iso_timestamp(&timestamp);
+
+    // day changes, leap days and century years
+    const int64_t samples[] = {
+        0, 999, 86399999, 86400000, 951782400000LL, 951868799999LL, 4107542400000LL,
+        1709164800123LL, 1735689599999LL, SYNC_EPOCH_MS
+    };
+
+    for (int64_t epoch_ms : samples) {
+        EXPECT_EQ(time_manager_update_iso_timestamp(&timestamp, epoch_ms), reference_timestamp(epoch_ms));
+    }
+
+    for (int64_t epoch_ms = SYNC_EPOCH_MS; epoch_ms < SYNC_EPOCH_MS + 400LL * 86400000; epoch_ms += 3599997) {
+        ASSERT_EQ(time_manager_update_iso_timestamp(&timestamp, epoch_ms), reference_timestamp(epoch_ms));
+    }
+}
+
+TEST(time_manager, is_not_synched_at_boot) {
+
+    EXPECT_FALSE(time_manager_is_time_synched());
+    EXPECT_EQ(time_manager_get_epoch_ms(), 0);
+
+    int64_t epoch_ms;
+    EXPECT_FALSE(time_manager_monotonic_to_epoch_ms(10, &epoch_ms));
+}
+
+TEST(time_manager, converts_monotonic_stamps_once_synched) {
+
+    host_run_for_ms(5000);
+    int64_t stamp = time_manager_get_monotonic_ms();
+    EXPECT_EQ(stamp, 5000);
+
+    time_manager_sync_time();
+    host_run_for_ms(3000);
+    host_sntp_sync(SYNC_EPOCH_MS);
+    host_run_for_ms(2000);
+
+    EXPECT_TRUE(time_manager_is_time_synched());
+
+    // samples taken before the sync are stamped after the fact
+    int64_t epoch_ms;
+    ASSERT_TRUE(time_manager_monotonic_to_epoch_ms(stamp, &epoch_ms));
+    EXPECT_EQ(epoch_ms, SYNC_EPOCH_MS - 3000);
+    EXPECT_EQ(time_manager_get_epoch_ms(), SYNC_EPOCH_MS + 2000);
+}
+
+TEST(time_manager, uses_a_clock_kept_through_deep_sleep) {
+
+    host_clock_set_epoch_ms(SYNC_EPOCH_MS);
+    host_reboot();
+    host_run_for_ms(100);
+
+    int64_t epoch_ms;
+    ASSERT_TRUE(time_manager_monotonic_to_epoch_ms(0, &epoch_ms));
+    EXPECT_EQ(epoch_ms, SYNC_EPOCH_MS);
+}
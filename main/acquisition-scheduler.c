@@ -0,0 +1,187 @@
+#include "acquisition-scheduler.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+typedef struct {
+    const sensor_driver_t *driver;
+    int64_t next_read;
+    int64_t prepared_at;
+    bool is_prepared;
+} sensor_entry_t;
+
+static const char *TAG = "acquisition-scheduler";
+
+static sensor_entry_t sensors[ACQUISITION_SCHEDULER_MAX_SENSORS];
+
+static uint8_t sensors_count = 0;
+
+static TaskHandle_t acquisition_task_handle = NULL;
+
+static sample_sink_f samples_sink = NULL;
+
+static int64_t get_milliseconds_from_boot() {
+    return esp_timer_get_time() / 1000;
+}
+
+/**
+ * The window opens at the earliest scheduled read, sensors whose read
+ * can be anticipated within their jitter bound join the same window
+ */
+static int64_t acquisition_scheduler_next_window() {
+
+    int64_t window = INT64_MAX;
+    for (uint8_t i = 0; i < sensors_count; i++) {
+        if (sensors[i].next_read < window) {
+            window = sensors[i].next_read;
+        }
+    }
+
+    return window;
+}
+
+static bool acquisition_scheduler_is_in_window(sensor_entry_t *sensor, int64_t window) {
+    return sensor->next_read - (int64_t) sensor->driver->jitter_ms <= window;
+}
+
+/**
+ * Prepare every sensor due to start its warm up and return the time the task
+ * has to wake up, either to prepare a sensor or to read the window
+ */
+static int64_t acquisition_scheduler_prepare_window(int64_t window, int64_t now) {
+
+    int64_t read_time = window;
+    int64_t latest_read_time = window + ACQUISITION_SCHEDULER_MAX_LATENESS_MS;
+    int64_t prepare_time = INT64_MAX;
+
+    for (uint8_t i = 0; i < sensors_count; i++) {
+
+        sensor_entry_t *sensor = &sensors[i];
+        const sensor_driver_t *driver = sensor->driver;
+
+        if (driver->prepare == NULL) {
+            continue;
+        }
+
+        // warm up ends at the sensor read, anticipated if it joins the current window
+        bool is_in_window = acquisition_scheduler_is_in_window(sensor, window);
+        int64_t sensor_prepare_time = (is_in_window ? window : sensor->next_read) - driver->warmup_ms;
+
+        if (!sensor->is_prepared && now >= sensor_prepare_time) {
+            if (driver->prepare() == ESP_OK) {
+                sensor->is_prepared = true;
+                sensor->prepared_at = now;
+            } else {
+                // read anyway, the driver reports what it can
+                ESP_LOGW(TAG, "%s prepare failed", driver->name);
+            }
+        }
+
+        if (sensor->is_prepared && is_in_window) {
+            int64_t ready_time = sensor->prepared_at + driver->warmup_ms;
+            if (ready_time > read_time) {
+                read_time = ready_time < latest_read_time ? ready_time : latest_read_time;
+            }
+        } else if (!sensor->is_prepared && now < sensor_prepare_time && sensor_prepare_time < prepare_time) {
+            prepare_time = sensor_prepare_time;
+        }
+    }
+
+    return prepare_time < read_time ? prepare_time : read_time;
+}
+
+static void acquisition_scheduler_read_window(int64_t window, int64_t now) {
+
+    for (uint8_t i = 0; i < sensors_count; i++) {
+
+        sensor_entry_t *sensor = &sensors[i];
+        const sensor_driver_t *driver = sensor->driver;
+
+        if (!acquisition_scheduler_is_in_window(sensor, window)) {
+            continue;
+        }
+
+        if (sensor->is_prepared && now < sensor->prepared_at + (int64_t) driver->warmup_ms) {
+            ESP_LOGW(TAG, "%s read before the end of its warm up", driver->name);
+        }
+
+        esp_err_t err = driver->read(samples_sink);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "%s read failed: %d", driver->name, err);
+        }
+
+        sensor->is_prepared = false;
+
+        // stay on the timebase, windows missed while busy are skipped
+        do {
+            sensor->next_read += driver->interval_ms;
+        } while (sensor->next_read <= window);
+    }
+}
+
+static void acquisition_task(void *args) {
+
+    while (true) {
+
+        int64_t window = acquisition_scheduler_next_window();
+        int64_t now = get_milliseconds_from_boot();
+        int64_t read_time = acquisition_scheduler_prepare_window(window, now);
+
+        if (read_time > now) {
+            vTaskDelay(pdMS_TO_TICKS(read_time - now) + 1);
+            continue;
+        }
+
+        acquisition_scheduler_read_window(window, now);
+    }
+}
+
+bool acquisition_scheduler_register(const sensor_driver_t *driver) {
+
+    if (acquisition_task_handle != NULL || sensors_count >= ACQUISITION_SCHEDULER_MAX_SENSORS || driver->interval_ms == 0) {
+        return false;
+    }
+
+    if (driver->init != NULL && driver->init() != ESP_OK) {
+        ESP_LOGE(TAG, "unable to init %s", driver->name);
+        return false;
+    }
+
+    sensors[sensors_count++] = (sensor_entry_t) { .driver = driver };
+    return true;
+}
+
+static bool acquisition_scheduler_launch(sample_sink_f sink, bool is_immediate) {
+
+    if (acquisition_task_handle != NULL || sensors_count == 0) {
+        return false;
+    }
+
+    samples_sink = sink;
+
+    // the first window of an immediate start is read once the slowest sensor warmed up
+    uint32_t warmup_ms = 0;
+    for (uint8_t i = 0; i < sensors_count; i++) {
+        if (sensors[i].driver->warmup_ms > warmup_ms) {
+            warmup_ms = sensors[i].driver->warmup_ms;
+        }
+    }
+
+    // every sensor starts on the same timebase
+    int64_t now = get_milliseconds_from_boot();
+    for (uint8_t i = 0; i < sensors_count; i++) {
+        sensors[i].next_read = now + (is_immediate ? warmup_ms : sensors[i].driver->interval_ms);
+    }
+
+    return xTaskCreate(&acquisition_task, "acquisition_task", 3072, NULL, 4, &acquisition_task_handle) == pdPASS;
+}
+
+bool acquisition_scheduler_start(sample_sink_f sink) {
+    return acquisition_scheduler_launch(sink, false);
+}
+
+bool acquisition_scheduler_start_now(sample_sink_f sink) {
+    return acquisition_scheduler_launch(sink, true);
+}
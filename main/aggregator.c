@@ -0,0 +1,276 @@
+#include "aggregator.h"
+
+#ifdef CONFIG_TELEMETRY_AGGREGATION
+
+#include <math.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#define P2_MARKERS 5
+
+// quantiles of up to that many values are exact, the estimator then starts
+// from them, started from five it is off by a fifth of the ranks for dozens
+#define EXACT_VALUES 32
+
+static const char *TAG = "aggregator";
+
+/**
+ * P-square quantile estimator (Jain & Chlamtac): five markers track the
+ * minimum, the quantile, the maximum and two midpoints, adjusted with a
+ * piecewise parabolic fit on every observation.
+ */
+typedef struct {
+    float quantile;
+    float heights[P2_MARKERS];
+    int32_t positions[P2_MARKERS];
+    float desired[P2_MARKERS];
+} p2_estimator_t;
+
+/**
+ * Running statistics of a metric, mean and variance use Welford's update.
+ * The first values are kept for exact quantiles of short windows.
+ */
+typedef struct {
+    uint16_t count;
+    float min;
+    float max;
+    double mean;
+    double m2;
+    float values[EXACT_VALUES];
+    p2_estimator_t p50;
+    p2_estimator_t p90;
+} metric_window_t;
+
+static sample_sink_f output_sink = NULL;
+
+static metric_window_t windows[AGGREGATES_COUNT];
+
+static int64_t window_start = 0;
+
+static int64_t window_timestamp = 0;
+
+static uint8_t window_clock = SAMPLE_CLOCK_NONE;
+
+static bool is_window_open = false;
+
+static void aggregator_sort(float *values, int count) {
+
+    for (int i = 1; i < count; i++) {
+        float value = values[i];
+        int j = i - 1;
+        for (; j >= 0 && values[j] > value; j--) {
+            values[j + 1] = values[j];
+        }
+        values[j + 1] = value;
+    }
+}
+
+/**
+ * Nearest rank quantile of count sorted values
+ */
+static float aggregator_get_rank_value(const float *sorted, int count, float quantile) {
+
+    int rank = (int) ceilf(quantile * count);
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+/**
+ * Markers placed at their desired positions among count sorted values
+ */
+static void p2_init(p2_estimator_t *estimator, float quantile, const float *sorted, int count) {
+
+    float p = quantile;
+    const float fractions[P2_MARKERS] = { 0, p / 2, p, (1 + p) / 2, 1 };
+
+    estimator->quantile = quantile;
+    for (int i = 0; i < P2_MARKERS; i++) {
+        estimator->desired[i] = fractions[i] * (count - 1);
+        estimator->positions[i] = lroundf(estimator->desired[i]);
+        estimator->heights[i] = sorted[estimator->positions[i]];
+    }
+}
+
+static float p2_parabolic(p2_estimator_t *estimator, int i, int d) {
+
+    float *q = estimator->heights;
+    int32_t *n = estimator->positions;
+
+    return q[i] + (float) d / (n[i + 1] - n[i - 1]) *
+        ((n[i] - n[i - 1] + d) * (q[i + 1] - q[i]) / (n[i + 1] - n[i]) +
+         (n[i + 1] - n[i] - d) * (q[i] - q[i - 1]) / (n[i] - n[i - 1]));
+}
+
+static float p2_linear(p2_estimator_t *estimator, int i, int d) {
+
+    float *q = estimator->heights;
+    int32_t *n = estimator->positions;
+
+    return q[i] + d * (q[i + d] - q[i]) / (n[i + d] - n[i]);
+}
+
+static void p2_add(p2_estimator_t *estimator, float value) {
+
+    float p = estimator->quantile;
+    float *q = estimator->heights;
+    int32_t *n = estimator->positions;
+
+    // cell of the new value, extremes are moved to include it
+    int k;
+    if (value < q[0]) {
+        q[0] = value;
+        k = 0;
+    } else if (value >= q[4]) {
+        q[4] = value;
+        k = 3;
+    } else {
+        for (k = 0; value >= q[k + 1]; k++);
+    }
+
+    for (int i = k + 1; i < P2_MARKERS; i++) {
+        n[i]++;
+    }
+
+    const float increments[P2_MARKERS] = { 0, p / 2, p, (1 + p) / 2, 1 };
+    for (int i = 0; i < P2_MARKERS; i++) {
+        estimator->desired[i] += increments[i];
+    }
+
+    for (int i = 1; i < P2_MARKERS - 1; i++) {
+        float delta = estimator->desired[i] - n[i];
+        if ((delta >= 1 && n[i + 1] - n[i] > 1) || (delta <= -1 && n[i - 1] - n[i] < -1)) {
+            int d = delta > 0 ? 1 : -1;
+            float height = p2_parabolic(estimator, i, d);
+            q[i] = q[i - 1] < height && height < q[i + 1] ? height : p2_linear(estimator, i, d);
+            n[i] += d;
+        }
+    }
+}
+
+static void aggregator_reset_window(metric_window_t *window) {
+
+    window->count = 0;
+    window->mean = 0;
+    window->m2 = 0;
+}
+
+static void aggregator_add_value(aggregate_metric_t metric, float value) {
+
+    metric_window_t *window = &windows[metric];
+
+    if (window->count == 0 || value < window->min) {
+        window->min = value;
+    }
+    if (window->count == 0 || value > window->max) {
+        window->max = value;
+    }
+
+    if (window->count < EXACT_VALUES) {
+        window->values[window->count] = value;
+    } else {
+        if (window->count == EXACT_VALUES) {
+            aggregator_sort(window->values, EXACT_VALUES);
+            p2_init(&window->p50, 0.5f, window->values, EXACT_VALUES);
+            p2_init(&window->p90, 0.9f, window->values, EXACT_VALUES);
+        }
+        p2_add(&window->p50, value);
+        p2_add(&window->p90, value);
+    }
+
+    window->count++;
+    double delta = value - window->mean;
+    window->mean += delta / window->count;
+    window->m2 += delta * (value - window->mean);
+}
+
+static void aggregator_emit_window() {
+
+    for (int i = 0; i < AGGREGATES_COUNT; i++) {
+
+        metric_window_t *window = &windows[i];
+        if (window->count == 0) {
+            continue;
+        }
+
+        float p50, p90;
+        if (window->count <= EXACT_VALUES) {
+            aggregator_sort(window->values, window->count);
+            p50 = aggregator_get_rank_value(window->values, window->count, 0.5f);
+            p90 = aggregator_get_rank_value(window->values, window->count, 0.9f);
+        } else {
+            p50 = window->p50.heights[2];
+            p90 = window->p90.heights[2];
+        }
+
+        telemetry_sample_t summary = {
+            .timestamp = window_timestamp,
+            .clock = window_clock,
+            .type = SUMMARY_SAMPLE,
+            .summary = {
+                .metric = i,
+                .count = window->count,
+                .window_length = CONFIG_TELEMETRY_AGGREGATION_WINDOW,
+                .min = window->min,
+                .max = window->max,
+                .mean = window->mean,
+                .stddev = window->count > 1 ? sqrt(window->m2 / (window->count - 1)) : 0,
+                .p50 = p50,
+                .p90 = p90
+            }
+        };
+
+        if (!output_sink(&summary)) {
+            ESP_LOGW(TAG, "summary of metric %d lost", i);
+        }
+
+        aggregator_reset_window(window);
+    }
+}
+
+void aggregator_init(sample_sink_f sink) {
+
+    output_sink = sink;
+
+    for (int i = 0; i < AGGREGATES_COUNT; i++) {
+        aggregator_reset_window(&windows[i]);
+    }
+}
+
+bool aggregator_add_sample(const telemetry_sample_t *sample) {
+
+    // windows follow the monotonic clock, the wall clock may be set meanwhile
+    int64_t now = esp_timer_get_time() / 1000000;
+
+    if (is_window_open && now - window_start >= CONFIG_TELEMETRY_AGGREGATION_WINDOW) {
+        aggregator_emit_window();
+        is_window_open = false;
+    }
+
+    if (!is_window_open) {
+        // tumbling windows stay aligned on the first one
+        window_start = now - (now - window_start) % CONFIG_TELEMETRY_AGGREGATION_WINDOW;
+        window_timestamp = sample->timestamp;
+        window_clock = sample->clock;
+        is_window_open = true;
+    }
+
+    switch (sample->type) {
+        case POLLUTION_SAMPLE:
+            aggregator_add_value(AGGREGATE_PM1_0, sample->pollution.pm1_0);
+            aggregator_add_value(AGGREGATE_PM2_5, sample->pollution.pm2_5);
+            aggregator_add_value(AGGREGATE_PM10, sample->pollution.pm10);
+            break;
+        case TEMPERATURE_SAMPLE:
+            aggregator_add_value(AGGREGATE_TEMPERATURE, sample->temperature);
+            break;
+        case HUMIDITY_SAMPLE:
+            aggregator_add_value(AGGREGATE_HUMIDITY, sample->humidity);
+            break;
+        default:
+            // already aggregated
+            return output_sink(sample);
+    }
+
+    return true;
+}
+
+#endif
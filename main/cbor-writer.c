@@ -0,0 +1,118 @@
+#include "cbor-writer.h"
+
+#include <string.h>
+
+#define MAJOR_TYPE_UINT 0
+#define MAJOR_TYPE_NEGATIVE_INT 1
+#define MAJOR_TYPE_TEXT_STRING 3
+#define MAJOR_TYPE_ARRAY 4
+#define MAJOR_TYPE_MAP 5
+#define MAJOR_TYPE_SIMPLE 7
+
+#define ADDITIONAL_INFO_UINT8 24
+#define ADDITIONAL_INFO_UINT16 25
+#define ADDITIONAL_INFO_UINT32 26
+#define ADDITIONAL_INFO_UINT64 27
+#define ADDITIONAL_INFO_FLOAT32 26
+
+static void cbor_writer_put_bytes(cbor_writer_t *writer, const uint8_t *bytes, size_t length) {
+
+    if (writer->length + length > writer->size) {
+        writer->overflow = true;
+        return;
+    }
+
+    memcpy(writer->buffer + writer->length, bytes, length);
+    writer->length += length;
+}
+
+/**
+ * Write initial byte followed by the big endian argument using the shortest form
+ */
+static void cbor_writer_put_head(cbor_writer_t *writer, uint8_t major_type, uint64_t argument) {
+
+    uint8_t head[9];
+    size_t length;
+    uint8_t info;
+
+    if (argument < ADDITIONAL_INFO_UINT8) {
+        info = argument;
+        length = 0;
+    } else if (argument <= UINT8_MAX) {
+        info = ADDITIONAL_INFO_UINT8;
+        length = 1;
+    } else if (argument <= UINT16_MAX) {
+        info = ADDITIONAL_INFO_UINT16;
+        length = 2;
+    } else if (argument <= UINT32_MAX) {
+        info = ADDITIONAL_INFO_UINT32;
+        length = 4;
+    } else {
+        info = ADDITIONAL_INFO_UINT64;
+        length = 8;
+    }
+
+    head[0] = (major_type << 5) | info;
+    for (size_t i = 0; i < length; i++) {
+        head[length - i] = argument >> (8 * i);
+    }
+
+    cbor_writer_put_bytes(writer, head, length + 1);
+}
+
+void cbor_writer_init(cbor_writer_t *writer, uint8_t *buffer, size_t size) {
+
+    writer->buffer = buffer;
+    writer->size = size;
+    writer->length = 0;
+    writer->overflow = buffer == NULL;
+}
+
+void cbor_writer_begin_map(cbor_writer_t *writer, size_t pairs) {
+    cbor_writer_put_head(writer, MAJOR_TYPE_MAP, pairs);
+}
+
+void cbor_writer_begin_array(cbor_writer_t *writer, size_t items) {
+    cbor_writer_put_head(writer, MAJOR_TYPE_ARRAY, items);
+}
+
+void cbor_writer_add_uint(cbor_writer_t *writer, uint64_t value) {
+    cbor_writer_put_head(writer, MAJOR_TYPE_UINT, value);
+}
+
+void cbor_writer_add_int(cbor_writer_t *writer, int64_t value) {
+
+    if (value >= 0) {
+        cbor_writer_put_head(writer, MAJOR_TYPE_UINT, value);
+    } else {
+        // negative integers are encoded as -1 - value
+        cbor_writer_put_head(writer, MAJOR_TYPE_NEGATIVE_INT, (uint64_t) (-1 - value));
+    }
+}
+
+void cbor_writer_add_float(cbor_writer_t *writer, float value) {
+
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint8_t bytes[5] = {
+        (MAJOR_TYPE_SIMPLE << 5) | ADDITIONAL_INFO_FLOAT32,
+        bits >> 24,
+        bits >> 16,
+        bits >> 8,
+        bits
+    };
+
+    cbor_writer_put_bytes(writer, bytes, sizeof(bytes));
+}
+
+void cbor_writer_add_string(cbor_writer_t *writer, const char *value) {
+
+    size_t length = strlen(value);
+    cbor_writer_put_head(writer, MAJOR_TYPE_TEXT_STRING, length);
+    cbor_writer_put_bytes(writer, (const uint8_t *) value, length);
+}
+
+const uint8_t* cbor_writer_finish(cbor_writer_t *writer) {
+    return writer->overflow ? NULL : writer->buffer;
+}
@@ -3,67 +3,336 @@
 #include "mqtt-manager.h"
 #include "device-helper.h"
 #include "time-manager.h"
+#include "storage-manager.h"
 #include "app-models.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "esp_log.h"
-#include "cJSON.h"
+#include <stdint.h>
+#include <string.h>
+#include "json-writer.h"
+#include "cbor-writer.h"
 #include "ota-manager.h"
+#include "profiler.h"
+#include "metrics.h"
+#include "esp_timer.h"
+#include "spsc-ring.h"
+#include "telemetry-filter.h"
+#include "self-test.h"
+
+#define PMS_MESSAGE_BUFFER_SIZE 384
+
+#define PROVISIONING_MESSAGE_BUFFER_SIZE 256
+
+#define HEALTH_MESSAGE_BUFFER_SIZE 768
+
+#define HEALTH_INTERVAL_TICKS (CONFIG_METRICS_HEALTH_INTERVAL * 1000 / portTICK_PERIOD_MS)
+
+// power of two, see spsc_ring_init
+#define SAMPLES_QUEUE_LENGTH 8
+
+#define SAMPLE_ENQUEUE_TIMEOUT 1000
+
+#define SAMPLE_ENQUEUE_RETRY_DELAY 10
+
+// expired deliveries are checked at this pace while messages are in flight
+#define DELIVERY_CHECK_INTERVAL 1000
+
+#define TOPIC_LENGTH 80
+
+#define DEVICE_ID_MEMBER_LENGTH 64
+
+#ifdef CONFIG_TELEMETRY_CBOR_ENCODING
+#define TELEMETRY_TOPIC_SUFFIX "/cbor"
+#define TELEMETRY_ENCODING_CAPABILITY "telemetry-cbor"
+#else
+#define TELEMETRY_TOPIC_SUFFIX ""
+#define TELEMETRY_ENCODING_CAPABILITY "telemetry-json"
+#endif
+
+_Static_assert(sizeof(telemetry_sample_t) <= STORAGE_MANAGER_SPOOL_PAYLOAD_SIZE, "telemetry sample does not fit a spool record");
 
 static const char *TAG = "data-sender";
 
 static const char *PROVISIONING_TEMPLATE_TOPIC = "%s/provisioning";
 
-static const char *POLLUTION_TELEMETRY_TEMPLATE_TOPIC = "%s/telemetry/pollution";
+static const char *HEALTH_TEMPLATE_TOPIC = "%s/health";
+
+static const char *CONFIGURATION_TEMPLATE_TOPIC = "%s/config/telemetry";
+
+// indexed by sample_type_t
+static const char *SAMPLE_TOPIC_TEMPLATES[SAMPLE_TYPES_COUNT] = {
+    "%s/telemetry/pollution" TELEMETRY_TOPIC_SUFFIX,
+    "%s/telemetry/temperature" TELEMETRY_TOPIC_SUFFIX,
+    "%s/telemetry/humidity" TELEMETRY_TOPIC_SUFFIX,
+    "%s/telemetry/summary" TELEMETRY_TOPIC_SUFFIX
+};
+
+static const char *BATCH_TELEMETRY_TEMPLATE_TOPIC = "%s/telemetry/batch" TELEMETRY_TOPIC_SUFFIX;
+
+/**
+ * Device dependent strings rendered once and reused by every publish.
+ * The timestamp cache belongs to the sender task.
+ */
+typedef struct {
+    bool is_ready;
+    char device_id_member[DEVICE_ID_MEMBER_LENGTH];
+    char provisioning_topic[TOPIC_LENGTH];
+    char health_topic[TOPIC_LENGTH];
+    char configuration_topic[TOPIC_LENGTH];
+    char batch_topic[TOPIC_LENGTH];
+    char sample_topics[SAMPLE_TYPES_COUNT][TOPIC_LENGTH];
+    iso_timestamp_t timestamp;
+} publish_context_t;
+
+static publish_context_t publish_context = {
+    .is_ready = false
+};
+
+// single producer: the acquisition task, or the duty cycle task
+static spsc_ring_t samples_ring;
+
+static telemetry_sample_t samples_ring_storage[SAMPLES_QUEUE_LENGTH];
+
+static bool is_samples_ring_ready = false;
+
+static TaskHandle_t data_sender_task_handle = NULL;
+
+// task waiting for data_sender_flush to complete
+static volatile TaskHandle_t flush_requester = NULL;
+
+static char pms_message_buffer[PMS_MESSAGE_BUFFER_SIZE];
+
+/**
+ * Samples carried by QoS 1 messages waiting for the broker acknowledgement,
+ * they go back to the spool if the message is lost. Owned by the sender task.
+ */
+typedef struct {
+    bool is_used;
+    int64_t published_at;
+    telemetry_sample_t sample;
+} pending_delivery_t;
+
+typedef struct {
+    uint8_t slot;
+    bool is_delivered;
+} delivery_report_t;
+
+// the batch in flight, if any, is reported on the slot after the sample ones
+#define BATCH_DELIVERY_SLOT CONFIG_MQTT_INFLIGHT_WINDOW
+
+static pending_delivery_t pending_deliveries[CONFIG_MQTT_INFLIGHT_WINDOW];
+
+static int pending_deliveries_count = 0;
+
+// filled from the MQTT task, drained by the sender task
+static QueueHandle_t delivery_reports_queue;
+
+static char provisioning_message_buffer[PROVISIONING_MESSAGE_BUFFER_SIZE];
 
-static const char *TEMPERATURE_TELEMETRY_TEMPLATE_TOPIC = "%s/telemetry/temperature";
+static char health_message_buffer[HEALTH_MESSAGE_BUFFER_SIZE];
 
-static const char *HUMIDITY_TELEMETRY_TEMPLATE_TOPIC = "%s/telemetry/humidity";
+static TickType_t health_deadline = 0;
 
-static QueueHandle_t mqtt_pms_data_output_queue;
+#ifdef CONFIG_TELEMETRY_BATCHING
 
-static void data_sender_init_json_message(cJSON *message, char *device_id) {
+#define BATCH_MESSAGE_BUFFER_SIZE (64 + CONFIG_TELEMETRY_BATCH_SIZE * 256)
 
-    cJSON *deviceId = cJSON_CreateString(device_id);
-    cJSON_AddItemToObject(message, "deviceId", deviceId);
+#define BATCH_TIMEOUT_TICKS (CONFIG_TELEMETRY_BATCH_TIMEOUT * 1000 / portTICK_PERIOD_MS)
 
-    if (time_manager_is_time_synched()) {
-    
-        char timestamp[ISO_DATE_LENGTH] = {'\0'};
-        time_manager_format_time(timestamp, ISO_DATE_LENGTH);
-        cJSON *t = cJSON_CreateString(timestamp);
-        cJSON_AddItemToObject(message, "timestamp", t);
+#ifndef CONFIG_TELEMETRY_CBOR_ENCODING
+static const char *SAMPLE_TYPE_NAMES[SAMPLE_TYPES_COUNT] = {
+    "pollution",
+    "temperature",
+    "humidity",
+    "summary"
+};
+#endif
+
+static char batch_message_buffer[BATCH_MESSAGE_BUFFER_SIZE];
+
+static telemetry_sample_t batch_samples[CONFIG_TELEMETRY_BATCH_SIZE];
+
+static telemetry_sample_t pending_batch_samples[CONFIG_TELEMETRY_BATCH_SIZE];
+
+static int pending_batch_count = 0;
+
+static int64_t pending_batch_published_at = 0;
+
+static int batch_count = 0;
+
+static TickType_t batch_deadline = 0;
+
+#endif
+
+/**
+ * Build the publish context once the device configuration is available
+ */
+static publish_context_t* data_sender_get_publish_context() {
+
+    if (publish_context.is_ready) {
+        return &publish_context;
     }
+
+    device_data_t *device_data = device_helper_get_device_config();
+    if (device_data == NULL) {
+        return NULL;
+    }
+
+    json_writer_t writer;
+    json_writer_init(&writer, publish_context.device_id_member, DEVICE_ID_MEMBER_LENGTH);
+    json_writer_add_string(&writer, "deviceId", device_data->uid);
+    if (json_writer_finish(&writer) == NULL) {
+        ESP_LOGE(TAG, "device id too long");
+        return NULL;
+    }
+
+    snprintf(publish_context.provisioning_topic, TOPIC_LENGTH, PROVISIONING_TEMPLATE_TOPIC, device_data->uid);
+    snprintf(publish_context.health_topic, TOPIC_LENGTH, HEALTH_TEMPLATE_TOPIC, device_data->uid);
+    snprintf(publish_context.configuration_topic, TOPIC_LENGTH, CONFIGURATION_TEMPLATE_TOPIC, device_data->uid);
+    snprintf(publish_context.batch_topic, TOPIC_LENGTH, BATCH_TELEMETRY_TEMPLATE_TOPIC, device_data->uid);
+    for (int i = 0; i < SAMPLE_TYPES_COUNT; i++) {
+        snprintf(publish_context.sample_topics[i], TOPIC_LENGTH, SAMPLE_TOPIC_TEMPLATES[i], device_data->uid);
+    }
+
+    time_manager_init_iso_timestamp(&publish_context.timestamp);
+    publish_context.is_ready = true;
+
+    return &publish_context;
 }
 
-static bool data_sender_publish_message(const char *topic_template, char *device_uid, char *payload) {
+/**
+ * Convert a monotonic sample timestamp to epoch once the wall clock is known.
+ * Return the timestamp in milliseconds from epoch, 0 if it's still unknown.
+ */
+static int64_t data_sender_resolve_timestamp(telemetry_sample_t *sample) {
+
+    if (sample->clock == SAMPLE_CLOCK_MONOTONIC && time_manager_monotonic_to_epoch_ms(sample->timestamp, &sample->timestamp)) {
+        sample->clock = SAMPLE_CLOCK_EPOCH;
+    }
 
-    char topic[80] = {'\0'};
-    sprintf(topic, topic_template, device_uid);
-    return mqtt_manager_publish(topic, payload);
+    return sample->clock == SAMPLE_CLOCK_EPOCH ? sample->timestamp : 0;
 }
 
-static cJSON* data_sender_prepare_provisioning_message(char *device_id) {
+static void data_sender_add_timestamp(json_writer_t *writer, iso_timestamp_t *iso_timestamp, int64_t timestamp) {
 
-    cJSON *provisioning_data = cJSON_CreateObject();
+    if (timestamp > 0) {
+        json_writer_add_string(writer, "timestamp", time_manager_update_iso_timestamp(iso_timestamp, timestamp));
+    }
+}
 
-    data_sender_init_json_message(provisioning_data, device_id);
+static void data_sender_init_json_message(json_writer_t *writer, publish_context_t *context, iso_timestamp_t *iso_timestamp, int64_t timestamp) {
 
-    char *fw_version = ota_manager_get_fw_version();
-    cJSON *fw = cJSON_CreateString(fw_version);
-    cJSON_AddItemToObject(provisioning_data, "fwVersion", fw);
+    json_writer_begin_object(writer, NULL);
+    json_writer_add_raw_member(writer, context->device_id_member);
+    data_sender_add_timestamp(writer, iso_timestamp, timestamp);
+}
 
-    cJSON *properties = cJSON_CreateArray();
-    cJSON_AddItemToObject(provisioning_data, "properties", properties);
+static bool data_sender_publish_message(const char *topic, const void *payload, int length) {
 
-    cJSON *capabilities = cJSON_CreateArray();
-    cJSON_AddItemToObject(provisioning_data, "capabilities", capabilities);
+    if (payload == NULL) {
+        ESP_LOGE(TAG, "message exceeds buffer size");
+        return false;
+    }
 
-    return provisioning_data;
+    return mqtt_manager_publish_data(topic, payload, length);
 }
 
-static void data_sender_log_pms_data(pm_data_t *sensor_data) {
+static void data_sender_on_delivery(void *context, bool is_delivered) {
+
+    delivery_report_t report = {
+        .slot = (uintptr_t) context,
+        .is_delivered = is_delivered
+    };
+
+    // a slot is reported once, the queue can't be full
+    xQueueSend(delivery_reports_queue, &report, 0);
+    xTaskNotifyGive(data_sender_task_handle);
+}
+
+/**
+ * QoS 1 publish, the outcome is reported on slot
+ */
+static bool data_sender_publish_tracked_message(const char *topic, const void *payload, int length, int slot) {
+
+    if (payload == NULL) {
+        ESP_LOGE(TAG, "message exceeds buffer size");
+        return false;
+    }
+
+    bool is_published = mqtt_manager_publish_qos1(topic, payload, length, &data_sender_on_delivery, (void *) (uintptr_t) slot);
+    if (is_published) {
+        metrics_increment(METRIC_MESSAGES_SENT);
+    }
+
+    return is_published;
+}
+
+static int data_sender_get_free_delivery_slot() {
+
+    for (int i = 0; i < CONFIG_MQTT_INFLIGHT_WINDOW; i++) {
+        if (!pending_deliveries[i].is_used) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static void data_sender_spool_sample(const telemetry_sample_t *sample) {
+
+    // resolved now if possible, monotonic timestamps don't survive a restart
+    telemetry_sample_t record = *sample;
+    data_sender_resolve_timestamp(&record);
+
+    if (storage_manager_spool_append(&record, sizeof(telemetry_sample_t))) {
+        metrics_increment(METRIC_SAMPLES_SPOOLED);
+    } else {
+        ESP_LOGE(TAG, "sample lost, unable to spool it");
+        metrics_increment(METRIC_SAMPLES_DROPPED);
+    }
+}
+
+static void data_sender_record_delivery(bool is_delivered, int64_t published_at) {
+
+    if (is_delivered) {
+        metrics_record_publish_latency((esp_timer_get_time() - published_at) / 1000);
+    } else {
+        metrics_increment(METRIC_DELIVERIES_LOST);
+    }
+}
+
+static const char* data_sender_prepare_provisioning_message(json_writer_t *writer, publish_context_t *context) {
+
+    // provisioning runs outside the sender task, it can't share the context timestamp cache
+    iso_timestamp_t iso_timestamp;
+    time_manager_init_iso_timestamp(&iso_timestamp);
+
+    data_sender_init_json_message(writer, context, &iso_timestamp, time_manager_get_epoch_ms());
+
+    const char *fw_version = ota_manager_get_fw_version();
+    json_writer_add_string(writer, "fwVersion", fw_version);
+
+    // only on the boot that validated a new firmware
+    int64_t time_to_valid_ms = self_test_get_time_to_valid_ms();
+    if (time_to_valid_ms >= 0) {
+        json_writer_add_number(writer, "timeToValid", time_to_valid_ms);
+    }
+
+    json_writer_begin_array(writer, "properties");
+    json_writer_end_array(writer);
+
+    json_writer_begin_array(writer, "capabilities");
+    json_writer_add_string(writer, NULL, TELEMETRY_ENCODING_CAPABILITY);
+    json_writer_end_array(writer);
+
+    json_writer_end_object(writer);
+
+    return json_writer_finish(writer);
+}
+
+static void data_sender_log_pms_data(pollution_data_t *sensor_data) {
 
     ESP_LOGI(TAG, "pm10: %d ug/m3", sensor_data->pm10);
     ESP_LOGI(TAG, "pm2.5: %d ug/m3", sensor_data->pm2_5);
@@ -76,87 +345,503 @@ static void data_sender_log_pms_data(pm_data_t *sensor_data) {
     ESP_LOGI(TAG, "particles > 10.0um / 0.1L: %d", sensor_data->particles_100um);
 }
 
-static cJSON* data_sender_prepare_pms_message(char *device_id, pm_data_t *data) {
+#ifndef CONFIG_TELEMETRY_CBOR_ENCODING
+
+// indexed by aggregate_metric_t
+static const char *AGGREGATE_METRIC_NAMES[AGGREGATES_COUNT] = {
+    "pm1.0",
+    "pm2.5",
+    "pm10",
+    "temperature",
+    "humidity"
+};
+
+static void data_sender_add_summary_data(json_writer_t *writer, summary_data_t *data) {
+
+    json_writer_add_string(writer, "metric", data->metric < AGGREGATES_COUNT ? AGGREGATE_METRIC_NAMES[data->metric] : "unknown");
+    json_writer_add_number(writer, "window", data->window_length);
+    json_writer_add_number(writer, "count", data->count);
+    json_writer_add_number(writer, "min", data->min);
+    json_writer_add_number(writer, "max", data->max);
+    json_writer_add_number(writer, "mean", data->mean);
+    json_writer_add_number(writer, "stddev", data->stddev);
+    json_writer_add_number(writer, "p50", data->p50);
+    json_writer_add_number(writer, "p90", data->p90);
+}
 
-    cJSON *pms_data = cJSON_CreateObject();
+static void data_sender_add_pms_data(json_writer_t *writer, pollution_data_t *data) {
+
+    json_writer_add_number(writer, "pm1.0", data->pm1_0);
+    json_writer_add_number(writer, "pm2.5", data->pm2_5);
+    json_writer_add_number(writer, "pm10", data->pm10);
+    json_writer_add_number(writer, "particlesCount0.3", data->particles_03um);
+    json_writer_add_number(writer, "particlesCount0.5", data->particles_05um);
+    json_writer_add_number(writer, "particlesCount1.0", data->particles_10um);
+    json_writer_add_number(writer, "particlesCount2.5", data->particles_25um);
+    json_writer_add_number(writer, "particlesCount5.0", data->particles_50um);
+    json_writer_add_number(writer, "particlesCount10.0", data->particles_100um);
+}
 
-    data_sender_init_json_message(pms_data, device_id);
+static void data_sender_add_sample_values(json_writer_t *writer, telemetry_sample_t *sample) {
+
+    switch (sample->type) {
+        case POLLUTION_SAMPLE:
+            data_sender_add_pms_data(writer, &sample->pollution);
+            break;
+        case TEMPERATURE_SAMPLE:
+            json_writer_add_number(writer, "temperature", sample->temperature);
+            break;
+        case HUMIDITY_SAMPLE:
+            json_writer_add_number(writer, "humidity", sample->humidity);
+            break;
+        case SUMMARY_SAMPLE:
+            data_sender_add_summary_data(writer, &sample->summary);
+            break;
+    }
+}
 
-    cJSON *pm1_0 = cJSON_CreateNumber(data->pm1_0);
-    cJSON_AddItemToObject(pms_data, "pm1.0", pm1_0);
-    
-    cJSON *pm2_5 = cJSON_CreateNumber(data->pm2_5);
-    cJSON_AddItemToObject(pms_data, "pm2.5", pm2_5);
-    
-    cJSON *pm10 = cJSON_CreateNumber(data->pm10);
-    cJSON_AddItemToObject(pms_data, "pm10", pm10);
+static const char* data_sender_prepare_sample_message(json_writer_t *writer, publish_context_t *context, telemetry_sample_t *sample) {
 
-    cJSON *particles0_3 = cJSON_CreateNumber(data->particles_03um);
-    cJSON_AddItemToObject(pms_data, "particlesCount0.3", particles0_3);
+    data_sender_init_json_message(writer, context, &context->timestamp, data_sender_resolve_timestamp(sample));
+    data_sender_add_sample_values(writer, sample);
+    json_writer_end_object(writer);
 
-    cJSON *particles0_5 = cJSON_CreateNumber(data->particles_05um);
-    cJSON_AddItemToObject(pms_data, "particlesCount0.5", particles0_5);
+    return json_writer_finish(writer);
+}
 
-    cJSON *particles1_0 = cJSON_CreateNumber(data->particles_10um);
-    cJSON_AddItemToObject(pms_data, "particlesCount1.0", particles1_0);
+#else
+
+/**
+ * Integer keys of CBOR encoded samples, the device id is only carried by the topic.
+ */
+enum {
+    CBOR_KEY_TYPE = 0,
+    CBOR_KEY_TIMESTAMP,
+    CBOR_KEY_PM1_0,
+    CBOR_KEY_PM2_5,
+    CBOR_KEY_PM10,
+    CBOR_KEY_PARTICLES_03UM,
+    CBOR_KEY_PARTICLES_05UM,
+    CBOR_KEY_PARTICLES_10UM,
+    CBOR_KEY_PARTICLES_25UM,
+    CBOR_KEY_PARTICLES_50UM,
+    CBOR_KEY_PARTICLES_100UM,
+    CBOR_KEY_TEMPERATURE,
+    CBOR_KEY_HUMIDITY,
+    CBOR_KEY_SAMPLES,
+    CBOR_KEY_METRIC,
+    CBOR_KEY_WINDOW,
+    CBOR_KEY_COUNT,
+    CBOR_KEY_MIN,
+    CBOR_KEY_MAX,
+    CBOR_KEY_MEAN,
+    CBOR_KEY_STDDEV,
+    CBOR_KEY_P50,
+    CBOR_KEY_P90
+};
+
+#define CBOR_POLLUTION_VALUES 9
+
+#define CBOR_SUMMARY_VALUES 9
+
+static void data_sender_add_cbor_float(cbor_writer_t *writer, uint8_t key, float value) {
+
+    cbor_writer_add_uint(writer, key);
+    cbor_writer_add_float(writer, value);
+}
+
+static void data_sender_add_cbor_value(cbor_writer_t *writer, uint8_t key, uint16_t value) {
 
-    cJSON *particles2_5 = cJSON_CreateNumber(data->particles_25um);
-    cJSON_AddItemToObject(pms_data, "particlesCount2.5", particles2_5);
+    cbor_writer_add_uint(writer, key);
+    cbor_writer_add_uint(writer, value);
+}
 
-    cJSON *particles5_0 = cJSON_CreateNumber(data->particles_50um);
-    cJSON_AddItemToObject(pms_data, "particlesCount5.0", particles5_0);
+static void data_sender_add_cbor_sample(cbor_writer_t *writer, telemetry_sample_t *sample, bool with_type) {
 
-    cJSON *particles10_0 = cJSON_CreateNumber(data->particles_100um);
-    cJSON_AddItemToObject(pms_data, "particlesCount10.0", particles10_0);
+    int64_t timestamp = data_sender_resolve_timestamp(sample);
 
-    return pms_data;
+    size_t pairs = sample->type == POLLUTION_SAMPLE ? CBOR_POLLUTION_VALUES :
+        sample->type == SUMMARY_SAMPLE ? CBOR_SUMMARY_VALUES : 1;
+    pairs += timestamp > 0 ? 1 : 0;
+    pairs += with_type ? 1 : 0;
+
+    cbor_writer_begin_map(writer, pairs);
+
+    if (with_type) {
+        cbor_writer_add_uint(writer, CBOR_KEY_TYPE);
+        cbor_writer_add_uint(writer, sample->type);
+    }
+
+    if (timestamp > 0) {
+        cbor_writer_add_uint(writer, CBOR_KEY_TIMESTAMP);
+        cbor_writer_add_uint(writer, timestamp);
+    }
+
+    pollution_data_t *data = &sample->pollution;
+
+    switch (sample->type) {
+        case POLLUTION_SAMPLE:
+            data_sender_add_cbor_value(writer, CBOR_KEY_PM1_0, data->pm1_0);
+            data_sender_add_cbor_value(writer, CBOR_KEY_PM2_5, data->pm2_5);
+            data_sender_add_cbor_value(writer, CBOR_KEY_PM10, data->pm10);
+            data_sender_add_cbor_value(writer, CBOR_KEY_PARTICLES_03UM, data->particles_03um);
+            data_sender_add_cbor_value(writer, CBOR_KEY_PARTICLES_05UM, data->particles_05um);
+            data_sender_add_cbor_value(writer, CBOR_KEY_PARTICLES_10UM, data->particles_10um);
+            data_sender_add_cbor_value(writer, CBOR_KEY_PARTICLES_25UM, data->particles_25um);
+            data_sender_add_cbor_value(writer, CBOR_KEY_PARTICLES_50UM, data->particles_50um);
+            data_sender_add_cbor_value(writer, CBOR_KEY_PARTICLES_100UM, data->particles_100um);
+            break;
+        case TEMPERATURE_SAMPLE:
+            cbor_writer_add_uint(writer, CBOR_KEY_TEMPERATURE);
+            cbor_writer_add_float(writer, sample->temperature);
+            break;
+        case HUMIDITY_SAMPLE:
+            cbor_writer_add_uint(writer, CBOR_KEY_HUMIDITY);
+            cbor_writer_add_float(writer, sample->humidity);
+            break;
+        case SUMMARY_SAMPLE:
+            data_sender_add_cbor_value(writer, CBOR_KEY_METRIC, sample->summary.metric);
+            cbor_writer_add_uint(writer, CBOR_KEY_WINDOW);
+            cbor_writer_add_uint(writer, sample->summary.window_length);
+            data_sender_add_cbor_value(writer, CBOR_KEY_COUNT, sample->summary.count);
+            data_sender_add_cbor_float(writer, CBOR_KEY_MIN, sample->summary.min);
+            data_sender_add_cbor_float(writer, CBOR_KEY_MAX, sample->summary.max);
+            data_sender_add_cbor_float(writer, CBOR_KEY_MEAN, sample->summary.mean);
+            data_sender_add_cbor_float(writer, CBOR_KEY_STDDEV, sample->summary.stddev);
+            data_sender_add_cbor_float(writer, CBOR_KEY_P50, sample->summary.p50);
+            data_sender_add_cbor_float(writer, CBOR_KEY_P90, sample->summary.p90);
+            break;
+    }
 }
 
-static cJSON* data_sender_prepare_temperature_message(char *device_id, float *temperature) {
+#endif
 
-    cJSON *temperature_data = cJSON_CreateObject();
+static bool data_sender_publish_sample(telemetry_sample_t *sample, char *buffer, size_t buffer_size) {
 
-    data_sender_init_json_message(temperature_data, device_id);
+    if (sample->type >= SAMPLE_TYPES_COUNT) {
+        ESP_LOGE(TAG, "unknown sample type %d", sample->type);
+        return false;
+    }
 
-    cJSON *t = cJSON_CreateNumber(*temperature);
-    cJSON_AddItemToObject(temperature_data, "temperature", t);
+    publish_context_t *context = data_sender_get_publish_context();
+    int slot = data_sender_get_free_delivery_slot();
+    if (context == NULL || slot < 0) {
+        return false;
+    }
 
-    return temperature_data;
+    PROFILER_START(encode_mark);
+
+#ifdef CONFIG_TELEMETRY_CBOR_ENCODING
+    cbor_writer_t writer;
+    cbor_writer_init(&writer, (uint8_t *) buffer, buffer_size);
+    data_sender_add_cbor_sample(&writer, sample, false);
+    const void *payload = cbor_writer_finish(&writer);
+    int length = writer.length;
+#else
+    json_writer_t writer;
+    json_writer_init(&writer, buffer, buffer_size);
+    const void *payload = data_sender_prepare_sample_message(&writer, context, sample);
+    int length = 0;
+#endif
+
+    PROFILER_REPORT("sample_encode", encode_mark);
+    PROFILER_START(publish_mark);
+
+    bool result = data_sender_publish_tracked_message(context->sample_topics[sample->type], payload, length, slot);
+
+    PROFILER_REPORT("sample_publish", publish_mark);
+
+    if (result) {
+        pending_deliveries[slot].is_used = true;
+        pending_deliveries[slot].published_at = esp_timer_get_time();
+        pending_deliveries[slot].sample = *sample;
+        pending_deliveries_count++;
+    }
+
+    return result;
 }
 
-static cJSON* data_sender_prepare_humidity_message(char *device_id, float *humidity) {
+#ifdef CONFIG_TELEMETRY_BATCHING
 
-    cJSON *humidity_data = cJSON_CreateObject();
+#ifndef CONFIG_TELEMETRY_CBOR_ENCODING
 
-    data_sender_init_json_message(humidity_data, device_id);
-    
-    cJSON *h = cJSON_CreateNumber(*humidity);
-    cJSON_AddItemToObject(humidity_data, "humidity", h);
-    
-    return humidity_data;
+static const char* data_sender_prepare_batch_message(json_writer_t *writer, publish_context_t *context, telemetry_sample_t *samples, int count) {
+
+    json_writer_begin_object(writer, NULL);
+    json_writer_add_raw_member(writer, context->device_id_member);
+    json_writer_begin_array(writer, "samples");
+
+    for (int i = 0; i < count; i++) {
+        json_writer_begin_object(writer, NULL);
+        json_writer_add_string(writer, "type", SAMPLE_TYPE_NAMES[samples[i].type]);
+        data_sender_add_timestamp(writer, &context->timestamp, data_sender_resolve_timestamp(&samples[i]));
+        data_sender_add_sample_values(writer, &samples[i]);
+        json_writer_end_object(writer);
+    }
+
+    json_writer_end_array(writer);
+    json_writer_end_object(writer);
+
+    return json_writer_finish(writer);
+}
+
+#endif
+
+/**
+ * Publish collected samples as a single message, samples are spooled if it fails.
+ * One batch at a time is in flight.
+ */
+static void data_sender_flush_batch() {
+
+    if (batch_count == 0) {
+        return;
+    }
+
+    bool is_published = false;
+
+    publish_context_t *context = data_sender_get_publish_context();
+    if (context != NULL && pending_batch_count == 0) {
+        PROFILER_START(batch_mark);
+#ifdef CONFIG_TELEMETRY_CBOR_ENCODING
+        cbor_writer_t writer;
+        cbor_writer_init(&writer, (uint8_t *) batch_message_buffer, sizeof(batch_message_buffer));
+        cbor_writer_begin_map(&writer, 1);
+        cbor_writer_add_uint(&writer, CBOR_KEY_SAMPLES);
+        cbor_writer_begin_array(&writer, batch_count);
+        for (int i = 0; i < batch_count; i++) {
+            data_sender_add_cbor_sample(&writer, &batch_samples[i], true);
+        }
+        is_published = data_sender_publish_tracked_message(context->batch_topic, cbor_writer_finish(&writer), writer.length, BATCH_DELIVERY_SLOT);
+#else
+        json_writer_t writer;
+        json_writer_init(&writer, batch_message_buffer, sizeof(batch_message_buffer));
+        const char *payload = data_sender_prepare_batch_message(&writer, context, batch_samples, batch_count);
+        is_published = data_sender_publish_tracked_message(context->batch_topic, payload, 0, BATCH_DELIVERY_SLOT);
+#endif
+        PROFILER_REPORT("batch_encode_publish", batch_mark);
+        ESP_LOGD(TAG, "batch of %d samples, %d bytes", batch_count, (int) writer.length);
+    }
+
+    for (int i = 0; i < batch_count; i++) {
+        if (is_published) {
+            pending_batch_samples[i] = batch_samples[i];
+        } else {
+            data_sender_spool_sample(&batch_samples[i]);
+        }
+    }
+
+    pending_batch_count = is_published ? batch_count : 0;
+    pending_batch_published_at = esp_timer_get_time();
+    batch_count = 0;
+}
+
+static void data_sender_batch_sample(telemetry_sample_t *sample) {
+
+    if (batch_count == 0) {
+        batch_deadline = xTaskGetTickCount() + BATCH_TIMEOUT_TICKS;
+    }
+
+    batch_samples[batch_count++] = *sample;
+
+    if (batch_count == CONFIG_TELEMETRY_BATCH_SIZE) {
+        data_sender_flush_batch();
+    }
+}
+
+#endif
+
+/**
+ * Publish a fresh sample. While older samples wait in the spool the new one
+ * is appended after them so that replayed data stays ordered.
+ */
+static void data_sender_process_sample(telemetry_sample_t *sample) {
+
+    if (!telemetry_filter_accept(sample)) {
+        return;
+    }
+
+#ifdef CONFIG_TELEMETRY_BATCHING
+    if (storage_manager_spool_count() == 0) {
+        data_sender_batch_sample(sample);
+        return;
+    }
+#endif
+
+    // a full in-flight window parks the sample in the spool as if offline
+    bool is_published = storage_manager_spool_count() == 0 &&
+        data_sender_publish_sample(sample, pms_message_buffer, sizeof(pms_message_buffer));
+
+    if (!is_published) {
+        data_sender_spool_sample(sample);
+    }
+}
+
+/**
+ * Release acknowledged deliveries, samples of lost messages go back to the spool
+ */
+static void data_sender_process_delivery_reports() {
+
+    delivery_report_t report;
+    while (xQueueReceive(delivery_reports_queue, &report, 0) == pdTRUE) {
+
+#ifdef CONFIG_TELEMETRY_BATCHING
+        if (report.slot == BATCH_DELIVERY_SLOT) {
+            data_sender_record_delivery(report.is_delivered, pending_batch_published_at);
+            for (int i = 0; i < pending_batch_count && !report.is_delivered; i++) {
+                data_sender_spool_sample(&pending_batch_samples[i]);
+            }
+            pending_batch_count = 0;
+            continue;
+        }
+#endif
+
+        if (report.slot >= CONFIG_MQTT_INFLIGHT_WINDOW || !pending_deliveries[report.slot].is_used) {
+            continue;
+        }
+
+        data_sender_record_delivery(report.is_delivered, pending_deliveries[report.slot].published_at);
+        if (!report.is_delivered) {
+            data_sender_spool_sample(&pending_deliveries[report.slot].sample);
+        }
+
+        pending_deliveries[report.slot].is_used = false;
+        pending_deliveries_count--;
+    }
+}
+
+static bool data_sender_has_pending_deliveries() {
+
+#ifdef CONFIG_TELEMETRY_BATCHING
+    if (pending_batch_count > 0) {
+        return true;
+    }
+#endif
+
+    return pending_deliveries_count > 0;
+}
+
+/**
+ * Replay spooled samples while the in-flight window has room. A replayed record
+ * leaves the spool once published and is appended again if the message is lost.
+ */
+static void data_sender_drain_spool() {
+
+    while (mqtt_manager_get_inflight_slots() > 0 && mqtt_manager_is_connected()) {
+
+        telemetry_sample_t sample;
+        bool is_current_boot = false;
+        if (!storage_manager_spool_peek(&sample, sizeof(sample), &is_current_boot)) {
+            return;
+        }
+
+        // spooled before a restart without a synched clock, the acquisition time is lost
+        if (!is_current_boot && sample.clock == SAMPLE_CLOCK_MONOTONIC) {
+            sample.clock = SAMPLE_CLOCK_NONE;
+        }
+
+        if (!data_sender_publish_sample(&sample, pms_message_buffer, sizeof(pms_message_buffer))) {
+            return;
+        }
+
+        storage_manager_spool_pop();
+    }
+}
+
+/**
+ * Publish runtime metrics, best effort with QoS 0
+ */
+static void data_sender_publish_health() {
+
+    publish_context_t *context = data_sender_get_publish_context();
+    if (context == NULL || !mqtt_manager_is_connected()) {
+        return;
+    }
+
+    json_writer_t writer;
+    json_writer_init(&writer, health_message_buffer, sizeof(health_message_buffer));
+    data_sender_init_json_message(&writer, context, &context->timestamp, time_manager_get_epoch_ms());
+    metrics_write_health(&writer);
+    json_writer_end_object(&writer);
+
+    data_sender_publish_message(context->health_topic, json_writer_finish(&writer), 0);
+}
+
+static void data_sender_complete_flush() {
+
+    if (data_sender_has_pending_deliveries() ||
+        (storage_manager_spool_count() > 0 && mqtt_manager_is_connected())) {
+        return;
+    }
+
+    // the requester may have given up in the meantime
+    TaskHandle_t requester = flush_requester;
+    flush_requester = NULL;
+    if (requester != NULL) {
+        xTaskNotifyGive(requester);
+    }
+}
+
+static TickType_t data_sender_get_wait_timeout() {
+
+    int32_t health_remaining = health_deadline - xTaskGetTickCount();
+    TickType_t timeout = health_remaining > 0 ? health_remaining : 0;
+
+    if (data_sender_has_pending_deliveries()) {
+        TickType_t delivery_timeout = DELIVERY_CHECK_INTERVAL / portTICK_PERIOD_MS;
+        timeout = delivery_timeout < timeout ? delivery_timeout : timeout;
+    }
+
+#ifdef CONFIG_TELEMETRY_BATCHING
+    if (batch_count > 0) {
+        int32_t remaining = batch_deadline - xTaskGetTickCount();
+        TickType_t batch_timeout = remaining > 0 ? remaining : 0;
+        timeout = batch_timeout < timeout ? batch_timeout : timeout;
+    }
+#endif
+
+    return timeout;
 }
 
 static void pms_data_sender_task(void *args) {
 
+    health_deadline = xTaskGetTickCount() + HEALTH_INTERVAL_TICKS;
+
     while (true) {
-        
-        pm_data_t pms_data;
-        xQueueReceive(mqtt_pms_data_output_queue, &pms_data, portMAX_DELAY);
 
-        data_sender_log_pms_data(&pms_data);
+        ulTaskNotifyTake(pdTRUE, data_sender_get_wait_timeout());
 
-        device_data_t *device_data = device_helper_get_device_config();
-        if (device_data == NULL) {
-            continue;
+        data_sender_process_delivery_reports();
+
+        telemetry_sample_t sample;
+        while (spsc_ring_pop(&samples_ring, &sample)) {
+
+            if (sample.type == POLLUTION_SAMPLE) {
+                data_sender_log_pms_data(&sample.pollution);
+            }
+
+            data_sender_process_sample(&sample);
+        }
+
+#ifdef CONFIG_TELEMETRY_BATCHING
+        bool is_batch_due = batch_count > 0 &&
+            (flush_requester != NULL || (int32_t) (xTaskGetTickCount() - batch_deadline) >= 0);
+        if (is_batch_due) {
+            data_sender_flush_batch();
+        }
+#endif
+
+        // also reports expired deliveries
+        data_sender_drain_spool();
+        data_sender_process_delivery_reports();
+
+        if ((int32_t) (xTaskGetTickCount() - health_deadline) >= 0) {
+            health_deadline = xTaskGetTickCount() + HEALTH_INTERVAL_TICKS;
+            data_sender_publish_health();
         }
 
-        cJSON *json_data = data_sender_prepare_pms_message(device_data->uid, &pms_data);
-        char *payload = cJSON_PrintUnformatted(json_data);
-        
-        data_sender_publish_message(POLLUTION_TELEMETRY_TEMPLATE_TOPIC, device_data->uid, payload);
-        
-        cJSON_Delete(json_data);
-        free(payload);
+        if (flush_requester != NULL) {
+            data_sender_complete_flush();
+        }
     }
 
     vTaskDelete(NULL);
@@ -164,12 +849,20 @@ static void pms_data_sender_task(void *args) {
 
 bool data_sender_init() {
 
-    mqtt_pms_data_output_queue = xQueueCreate(5, sizeof(pm_data_t));
+    if (data_sender_get_publish_context() == NULL) {
+        ESP_LOGE(TAG, "device configuration not available");
+    }
+
+    telemetry_filter_init();
+    spsc_ring_init(&samples_ring, samples_ring_storage, sizeof(telemetry_sample_t), SAMPLES_QUEUE_LENGTH, SPSC_RING_DROP_NEWEST);
+    delivery_reports_queue = xQueueCreate(CONFIG_MQTT_INFLIGHT_WINDOW + 1, sizeof(delivery_report_t));
 
-    bool is_queue_created = mqtt_pms_data_output_queue != NULL;
+    bool is_queue_created = delivery_reports_queue != NULL;
 
     if (is_queue_created) {
-        xTaskCreate(pms_data_sender_task, "pms data sender task", 4096, NULL, 5, NULL);
+        xTaskCreate(pms_data_sender_task, "pms data sender task", 4096, NULL, 5, &data_sender_task_handle);
+        spsc_ring_set_consumer(&samples_ring, data_sender_task_handle);
+        is_samples_ring_ready = true;
     }
 
     return is_queue_created;
@@ -177,64 +870,85 @@ bool data_sender_init() {
 
 bool data_sender_provision_device() {
 
-    device_data_t *device_data = device_helper_get_device_config();
-    if (device_data == NULL) {
+    publish_context_t *context = data_sender_get_publish_context();
+    if (context == NULL) {
         return false;
     }
 
-    cJSON *json_data = data_sender_prepare_provisioning_message(device_data->uid);
-    char *payload = cJSON_PrintUnformatted(json_data);
+    json_writer_t writer;
+    json_writer_init(&writer, provisioning_message_buffer, sizeof(provisioning_message_buffer));
+    const char *payload = data_sender_prepare_provisioning_message(&writer, context);
 
-    bool result = data_sender_publish_message(PROVISIONING_TEMPLATE_TOPIC, device_data->uid, payload);
+    return data_sender_publish_message(context->provisioning_topic, payload, 0);
+}
 
-    cJSON_Delete(json_data);
-    free(payload);
+static void data_sender_on_message(const char *topic, int topic_len, const char *data, int data_len) {
 
-    return result;
+    publish_context_t *context = data_sender_get_publish_context();
+    if (context == NULL) {
+        return;
+    }
+
+    bool is_configuration = strlen(context->configuration_topic) == topic_len &&
+        strncmp(context->configuration_topic, topic, topic_len) == 0;
+    if (is_configuration) {
+        telemetry_filter_configure(data, data_len);
+    }
 }
 
-bool data_sender_enqueue_pms_data(pm_data_t *data) {
+bool data_sender_subscribe_configuration() {
 
-    if (mqtt_pms_data_output_queue == NULL) {
+    publish_context_t *context = data_sender_get_publish_context();
+    if (context == NULL) {
         return false;
     }
-    
-    int result = xQueueGenericSend(mqtt_pms_data_output_queue, data, 0, queueSEND_TO_BACK);
-    return result == pdTRUE;
+
+    mqtt_manager_set_message_callback(&data_sender_on_message);
+    return mqtt_manager_subscribe(context->configuration_topic);
 }
 
-bool data_sender_send_temperature_data(float data) {
-    
-    device_data_t *device_data = device_helper_get_device_config();
-    if (device_data == NULL) {
+void data_sender_resume() {
+
+    if (data_sender_task_handle != NULL) {
+        xTaskNotifyGive(data_sender_task_handle);
+    }
+}
+
+bool data_sender_enqueue_sample(const telemetry_sample_t *sample) {
+
+    if (!is_samples_ring_ready) {
         return false;
     }
 
-    cJSON *json_data = data_sender_prepare_temperature_message(device_data->uid, &data);
-    char *payload = cJSON_PrintUnformatted(json_data);
+    // the ring never blocks, a full one is retried while the sender task catches up
+    bool is_enqueued = spsc_ring_push(&samples_ring, sample);
+    for (int waited = 0; !is_enqueued && waited < SAMPLE_ENQUEUE_TIMEOUT; waited += SAMPLE_ENQUEUE_RETRY_DELAY) {
+        vTaskDelay(SAMPLE_ENQUEUE_RETRY_DELAY / portTICK_PERIOD_MS);
+        is_enqueued = spsc_ring_push(&samples_ring, sample);
+    }
 
-    bool result = data_sender_publish_message(TEMPERATURE_TELEMETRY_TEMPLATE_TOPIC, device_data->uid, payload);
-    
-    cJSON_Delete(json_data);
-    free(payload);
+    if (is_enqueued) {
+        metrics_record_max(METRIC_SAMPLES_QUEUE_DEPTH, spsc_ring_count(&samples_ring));
+    } else {
+        metrics_increment(METRIC_SAMPLES_DROPPED);
+    }
 
-    return result;
+    return is_enqueued;
 }
 
-bool data_sender_send_humidity_data(float data) {
+bool data_sender_flush(uint32_t timeout_ms) {
 
-    device_data_t *device_data = device_helper_get_device_config();
-    if (device_data == NULL) {
+    if (data_sender_task_handle == NULL) {
         return false;
     }
 
-    cJSON *json_data = data_sender_prepare_humidity_message(device_data->uid, &data);
-    char *payload = cJSON_PrintUnformatted(json_data);
+    flush_requester = xTaskGetCurrentTaskHandle();
+    xTaskNotifyGive(data_sender_task_handle);
 
-    bool result = data_sender_publish_message(HUMIDITY_TELEMETRY_TEMPLATE_TOPIC, device_data->uid, payload);
-    
-    cJSON_Delete(json_data);
-    free(payload);
+    bool is_completed = ulTaskNotifyTake(pdTRUE, timeout_ms / portTICK_PERIOD_MS) > 0;
+    if (!is_completed) {
+        flush_requester = NULL;
+    }
 
-    return result;
+    return is_completed && storage_manager_spool_count() == 0;
 }
@@ -2,6 +2,7 @@
 
 #include "storage-manager.h"
 #include "cJSON.h"
+#include "profiler.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -11,13 +12,16 @@ static char *ENROLLMENT_KEY = "enrollment-key";
 
 device_data_t* device_helper_get_device_config() {
     
+    PROFILER_START(config_mark);
+
     if (cached_device_data != NULL) {
+        PROFILER_REPORT("device_config_warm", config_mark);
         return cached_device_data;
     }
 
-    char *file_data = storage_manager_read_file("/device/config.json");
-    cJSON *json = cJSON_Parse(file_data);
-    free(file_data);
+    // parsed in place from flash
+    const char *file_data = storage_manager_map_blob(STORAGE_MANAGER_DEVICE_PARTITION, "config.json", NULL);
+    cJSON *json = file_data != NULL ? cJSON_Parse(file_data) : NULL;
 
     if (json == NULL) {
         cJSON_Delete(json);
@@ -29,6 +33,8 @@ device_data_t* device_helper_get_device_config() {
     strcpy(cached_device_data->uid, uid->valuestring);
     cJSON_Delete(json);
 
+    PROFILER_REPORT("device_config_cold", config_mark);
+
     return cached_device_data;
 }
 
@@ -41,14 +47,23 @@ bool device_helper_set_enrollment_status(enrollment_status_t status) {
     return storage_manager_set_prefs_bool_value(ENROLLMENT_KEY, value);
 }
 
-char *device_helper_get_ca_cert() {
-    return storage_manager_read_file("/security/ca.pem");
+static const char *device_helper_map_security_file(const char *name) {
+
+    PROFILER_START(map_mark);
+    const char *file_data = storage_manager_map_blob(STORAGE_MANAGER_SECURITY_PARTITION, name, NULL);
+    PROFILER_REPORT(name, map_mark);
+
+    return file_data;
+}
+
+const char *device_helper_get_ca_cert() {
+    return device_helper_map_security_file("ca.pem");
 }
 
-char *device_helper_get_device_cert() {
-    return storage_manager_read_file("/security/client.pem");
+const char *device_helper_get_device_cert() {
+    return device_helper_map_security_file("client.pem");
 }
 
-char *device_helper_get_device_key() {
-    return storage_manager_read_file("/security/client.key");
+const char *device_helper_get_device_key() {
+    return device_helper_map_security_file("client.key");
 }
\ No newline at end of file
@@ -0,0 +1,230 @@
+/*
+ *  Deep sleep duty cycle. Every period takes two short wakes:
+ *
+ *  WARM_UP - the PMS SET line is latched high and the chip sleeps while the sensor fan spins up
+ *  MEASURE - sensors are read into a buffer in RTC slow memory, every Kth measure
+ *            (or when the buffer is about to overflow, or the last upload failed)
+ *            WiFi and MQTT are started to publish the buffer
+ *
+ *  A press of the wake up pad wakes the chip up in between, once it's handled
+ *  the chip sleeps for what was left of the interrupted sleep.
+ *
+ *  Step selection and sleep times only depend on the RTC state below, so the
+ *  state machine can be driven off target by feeding it awake times.
+ */
+
+#include "duty-cycle.h"
+
+#ifdef CONFIG_DUTY_CYCLE_MODE
+
+#include <string.h>
+#include <sys/time.h>
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "sensor-drivers.h"
+#include "time-manager.h"
+
+#define DUTY_CYCLE_MAGIC 0xB4EA7E01
+
+// one pollution, one temperature and one humidity sample per measure
+#define SAMPLES_PER_MEASURE 3
+
+#define PERIOD_MS (CONFIG_DUTY_CYCLE_PERIOD * 1000LL)
+
+#define MIN_SLEEP_MS 1000
+
+#define UPLOAD_PERIOD_S (CONFIG_DUTY_CYCLE_PERIOD * CONFIG_DUTY_CYCLE_UPLOAD_INTERVAL)
+
+// firmware checks are spaced by about FW_CHECK_INTERVAL, counted in uploads
+#define FW_CHECK_UPLOADS (CONFIG_FW_CHECK_INTERVAL > UPLOAD_PERIOD_S ? CONFIG_FW_CHECK_INTERVAL / UPLOAD_PERIOD_S : 1)
+
+typedef struct {
+    uint32_t magic;
+    uint8_t next_step;
+    bool is_upload_pending;
+    uint16_t samples_count;
+    uint32_t measures_count;
+    uint32_t uploads_count;
+    // on the RTC clock, which keeps running through deep sleep
+    int64_t wakeup_time_ms;
+    uint32_t cycle_awake_ms;
+    uint32_t max_cycle_awake_ms;
+    telemetry_sample_t samples[CONFIG_DUTY_CYCLE_BUFFER_SIZE];
+} duty_cycle_state_t;
+
+static const char *TAG = "duty-cycle";
+
+static RTC_DATA_ATTR duty_cycle_state_t state;
+
+static duty_cycle_step_t current_step = DUTY_CYCLE_WARM_UP;
+
+static gpio_num_t wakeup_pad = GPIO_NUM_NC;
+
+static int wakeup_pad_level;
+
+static int64_t duty_cycle_get_rtc_time_ms() {
+
+    struct timeval now;
+    gettimeofday(&now, NULL);
+
+    return (int64_t) now.tv_sec * 1000 + now.tv_usec / 1000;
+}
+
+static void duty_cycle_deep_sleep(int64_t sleep_time) {
+
+    state.wakeup_time_ms = duty_cycle_get_rtc_time_ms() + sleep_time;
+
+    esp_sleep_enable_timer_wakeup(sleep_time * 1000);
+    if (wakeup_pad != GPIO_NUM_NC) {
+        esp_sleep_enable_ext0_wakeup(wakeup_pad, wakeup_pad_level);
+    }
+    esp_deep_sleep_start();
+}
+
+static duty_cycle_step_t duty_cycle_plan(const duty_cycle_state_t *state) {
+
+    if (state->next_step == DUTY_CYCLE_WARM_UP) {
+        return DUTY_CYCLE_WARM_UP;
+    }
+
+    bool is_upload_due = (state->measures_count + 1) % CONFIG_DUTY_CYCLE_UPLOAD_INTERVAL == 0 ||
+        state->is_upload_pending ||
+        state->samples_count + SAMPLES_PER_MEASURE * 2 > CONFIG_DUTY_CYCLE_BUFFER_SIZE;
+
+    return is_upload_due ? DUTY_CYCLE_UPLOAD : DUTY_CYCLE_MEASURE;
+}
+
+/**
+ * Measures are SENSOR_DRIVERS_PMS_WARMUP_TIME after the warm up wake, the next
+ * warm up is scheduled so that the period holds whatever time was spent awake
+ */
+static int64_t duty_cycle_sleep_time(duty_cycle_step_t step, uint32_t cycle_awake_ms) {
+
+    if (step == DUTY_CYCLE_WARM_UP) {
+        return SENSOR_DRIVERS_PMS_WARMUP_TIME;
+    }
+
+    int64_t sleep_time = PERIOD_MS - SENSOR_DRIVERS_PMS_WARMUP_TIME - cycle_awake_ms;
+    return sleep_time > MIN_SLEEP_MS ? sleep_time : MIN_SLEEP_MS;
+}
+
+duty_cycle_step_t duty_cycle_begin() {
+
+    esp_sleep_wakeup_cause_t cause = esp_sleep_get_wakeup_cause();
+
+    if ((cause != ESP_SLEEP_WAKEUP_TIMER && cause != ESP_SLEEP_WAKEUP_EXT0) || state.magic != DUTY_CYCLE_MAGIC) {
+        memset(&state, 0, sizeof(state));
+        state.magic = DUTY_CYCLE_MAGIC;
+        state.next_step = DUTY_CYCLE_WARM_UP;
+    }
+
+    current_step = duty_cycle_plan(&state);
+
+    ESP_LOGI(TAG, "wake up for step %d, %u samples buffered", current_step, state.samples_count);
+
+    return current_step;
+}
+
+duty_cycle_step_t duty_cycle_stay_awake() {
+
+    current_step = DUTY_CYCLE_UPLOAD;
+    ESP_LOGI(TAG, "staying awake for the whole cycle");
+
+    return current_step;
+}
+
+bool duty_cycle_store_sample(const telemetry_sample_t *sample) {
+
+    if (state.samples_count == CONFIG_DUTY_CYCLE_BUFFER_SIZE) {
+        ESP_LOGW(TAG, "samples buffer full, dropping the oldest sample");
+        memmove(&state.samples[0], &state.samples[1], sizeof(telemetry_sample_t) * (CONFIG_DUTY_CYCLE_BUFFER_SIZE - 1));
+        state.samples_count--;
+    }
+
+    telemetry_sample_t *stored = &state.samples[state.samples_count++];
+    *stored = *sample;
+
+    // the monotonic clock starts over at every wake up, only epoch timestamps survive deep sleep
+    if (stored->clock == SAMPLE_CLOCK_MONOTONIC &&
+        !time_manager_monotonic_to_epoch_ms(stored->timestamp, &stored->timestamp)) {
+        stored->clock = SAMPLE_CLOCK_NONE;
+    }
+
+    return true;
+}
+
+uint16_t duty_cycle_flush_samples(sample_sink_f sink) {
+
+    uint16_t flushed = 0;
+    while (flushed < state.samples_count && sink(&state.samples[flushed])) {
+        flushed++;
+    }
+
+    state.samples_count -= flushed;
+    memmove(&state.samples[0], &state.samples[flushed], sizeof(telemetry_sample_t) * state.samples_count);
+
+    return flushed;
+}
+
+void duty_cycle_set_upload_result(bool is_uploaded) {
+
+    state.is_upload_pending = !is_uploaded;
+    if (is_uploaded) {
+        state.uploads_count++;
+    }
+}
+
+bool duty_cycle_is_fw_check_due() {
+    return state.uploads_count % FW_CHECK_UPLOADS == 0;
+}
+
+void duty_cycle_set_wakeup_pad(gpio_num_t gpio_num, int level) {
+
+    wakeup_pad = gpio_num;
+    wakeup_pad_level = level;
+}
+
+bool duty_cycle_is_pad_wakeup() {
+    return esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_EXT0 && state.wakeup_time_ms != 0;
+}
+
+void duty_cycle_resume_sleep() {
+
+    int64_t sleep_time = state.wakeup_time_ms - duty_cycle_get_rtc_time_ms();
+    // the time spent handling the pad isn't part of the cycle
+    if (sleep_time < 1) {
+        sleep_time = 1;
+    }
+
+    ESP_LOGI(TAG, "woken up by the pad, back to sleep for %lld ms", sleep_time);
+
+    duty_cycle_deep_sleep(sleep_time);
+}
+
+void duty_cycle_sleep() {
+
+    // time from wake up, boot ROM and bootloader excluded
+    uint32_t awake_ms = esp_timer_get_time() / 1000;
+    state.cycle_awake_ms += awake_ms;
+
+    int64_t sleep_time = duty_cycle_sleep_time(current_step, state.cycle_awake_ms);
+
+    if (current_step == DUTY_CYCLE_WARM_UP) {
+        state.next_step = DUTY_CYCLE_MEASURE;
+        ESP_LOGI(TAG, "warm up: awake %u ms", awake_ms);
+    } else {
+        state.next_step = DUTY_CYCLE_WARM_UP;
+        state.measures_count++;
+        if (state.cycle_awake_ms > state.max_cycle_awake_ms) {
+            state.max_cycle_awake_ms = state.cycle_awake_ms;
+        }
+        ESP_LOGI(TAG, "cycle %u: awake %u ms (max %u ms), %u samples buffered",
+            state.measures_count, state.cycle_awake_ms, state.max_cycle_awake_ms, state.samples_count);
+        state.cycle_awake_ms = 0;
+    }
+
+    duty_cycle_deep_sleep(sleep_time);
+}
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef ACQUISITION_SCHEDULER_INCLUDE_ACQUISITION_SCHEDULER_H_
+#define ACQUISITION_SCHEDULER_INCLUDE_ACQUISITION_SCHEDULER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "app-models.h"
+
+#define ACQUISITION_SCHEDULER_MAX_SENSORS 4
+
+// a window waits at most this long for a sensor still warming up
+#define ACQUISITION_SCHEDULER_MAX_LATENESS_MS 2000
+
+/**
+ * Destination of the samples produced by a read
+ */
+typedef bool (*sample_sink_f)(const telemetry_sample_t *sample);
+
+/**
+ * Sensor driver handled by the acquisition scheduler.
+ * Reads are aligned on a common timebase, a read may be anticipated up to
+ * jitter_ms to share the wake window of another sensor. Reads are never
+ * delayed past ACQUISITION_SCHEDULER_MAX_LATENESS_MS, a sensor is prepared
+ * warmup_ms ahead of its own read whichever window is due first.
+ */
+typedef struct {
+    const char *name;
+    uint32_t interval_ms;
+    uint32_t jitter_ms;
+    // time the sensor needs between prepare and read, 0 if prepare is not needed
+    uint32_t warmup_ms;
+    esp_err_t (*init)();
+    esp_err_t (*prepare)();
+    esp_err_t (*read)(sample_sink_f sink);
+} sensor_driver_t;
+
+/**
+ * Register a driver, to be called before acquisition_scheduler_start
+ */
+bool acquisition_scheduler_register(const sensor_driver_t *driver);
+
+/**
+ * Start reading, the first read of every sensor one interval after the start
+ */
+bool acquisition_scheduler_start(sample_sink_f sink);
+
+/**
+ * Start reading every sensor right away, as soon as they are all warmed up,
+ * then one interval apart
+ */
+bool acquisition_scheduler_start_now(sample_sink_f sink);
+
+#endif
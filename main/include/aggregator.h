@@ -0,0 +1,20 @@
+#ifndef AGGREGATOR_INCLUDE_AGGREGATOR_H_
+#define AGGREGATOR_INCLUDE_AGGREGATOR_H_
+
+#include <stdbool.h>
+#include "app-models.h"
+#include "acquisition-scheduler.h"
+
+/**
+ * Summaries of closed windows are passed to sink
+ */
+void aggregator_init(sample_sink_f sink);
+
+/**
+ * Sample sink folding sensor samples in the current tumbling window of
+ * CONFIG_TELEMETRY_AGGREGATION_WINDOW seconds. The window is closed by the
+ * first sample received after its end, one summary per metric is emitted.
+ */
+bool aggregator_add_sample(const telemetry_sample_t *sample);
+
+#endif
@@ -1,8 +1,85 @@
 #ifndef APP_MODELS_INCLUDE_APP_MODELS_H_
 #define APP_MODELS_INCLUDE_APP_MODELS_H_
 
+#include <stdint.h>
+
 typedef struct {
     char uid[37];
 } device_data_t;
 
-#endif
\ No newline at end of file
+typedef enum {
+    POLLUTION_SAMPLE,
+    TEMPERATURE_SAMPLE,
+    HUMIDITY_SAMPLE,
+    SUMMARY_SAMPLE,
+    SAMPLE_TYPES_COUNT
+} sample_type_t;
+
+/**
+ * Quantities summarized by the aggregator
+ */
+typedef enum {
+    AGGREGATE_PM1_0,
+    AGGREGATE_PM2_5,
+    AGGREGATE_PM10,
+    AGGREGATE_TEMPERATURE,
+    AGGREGATE_HUMIDITY,
+    AGGREGATES_COUNT
+} aggregate_metric_t;
+
+typedef struct {
+    uint16_t pm1_0;
+    uint16_t pm2_5;
+    uint16_t pm10;
+    uint16_t particles_03um;
+    uint16_t particles_05um;
+    uint16_t particles_10um;
+    uint16_t particles_25um;
+    uint16_t particles_50um;
+    uint16_t particles_100um;
+} pollution_data_t;
+
+/**
+ * Statistics of one metric over a window of window_length seconds
+ */
+typedef struct {
+    uint8_t metric;
+    uint16_t count;
+    uint32_t window_length;
+    float min;
+    float max;
+    float mean;
+    float stddev;
+    float p50;
+    float p90;
+} summary_data_t;
+
+/**
+ * Clock of a sample timestamp. Samples are stamped with the monotonic clock
+ * at acquisition and converted to epoch once the wall clock is known, a
+ * monotonic timestamp left from a previous boot can't be converted anymore.
+ */
+typedef enum {
+    SAMPLE_CLOCK_NONE = 0,
+    SAMPLE_CLOCK_MONOTONIC,
+    SAMPLE_CLOCK_EPOCH
+} sample_clock_t;
+
+/**
+ * Fixed size sample, queued and spooled as is.
+ * Timestamp is the acquisition time in milliseconds on the sample clock.
+ * Summaries are stamped with the time of the first sample of their window.
+ */
+typedef struct {
+    int64_t timestamp;
+    uint8_t type;
+    uint8_t clock;
+    union {
+        pollution_data_t pollution;
+        float temperature;
+        float humidity;
+        summary_data_t summary;
+    };
+} telemetry_sample_t;
+
+#endif
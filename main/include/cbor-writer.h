@@ -0,0 +1,39 @@
+#ifndef CBOR_WRITER_INCLUDE_CBOR_WRITER_H_
+#define CBOR_WRITER_INCLUDE_CBOR_WRITER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Minimal CBOR (RFC 7049) writer rendering into a caller provided buffer.
+ * Only definite length containers are supported, the caller states
+ * the number of items when a container is opened.
+ */
+typedef struct {
+    uint8_t *buffer;
+    size_t size;
+    size_t length;
+    bool overflow;
+} cbor_writer_t;
+
+void cbor_writer_init(cbor_writer_t *writer, uint8_t *buffer, size_t size);
+
+void cbor_writer_begin_map(cbor_writer_t *writer, size_t pairs);
+
+void cbor_writer_begin_array(cbor_writer_t *writer, size_t items);
+
+void cbor_writer_add_uint(cbor_writer_t *writer, uint64_t value);
+
+void cbor_writer_add_int(cbor_writer_t *writer, int64_t value);
+
+void cbor_writer_add_float(cbor_writer_t *writer, float value);
+
+void cbor_writer_add_string(cbor_writer_t *writer, const char *value);
+
+/**
+ * Return the encoded data or NULL if the buffer was too small
+ */
+const uint8_t* cbor_writer_finish(cbor_writer_t *writer);
+
+#endif
@@ -2,16 +2,33 @@
 #define DATA_SENDER_INCLUDE_DATA_SENDER_H_
 
 #include <stdbool.h>
-#include "pmsx-data.h"
+#include <stdint.h>
+#include "app-models.h"
 
 bool data_sender_init();
 
 bool data_sender_provision_device();
 
-bool data_sender_enqueue_pms_data(pm_data_t *data);
+/**
+ * Subscribe to the telemetry configuration topic, see telemetry_filter_configure
+ */
+bool data_sender_subscribe_configuration();
 
-bool data_sender_send_temperature_data(float data);
+/**
+ * Wake up the sender task to replay samples spooled while offline
+ */
+void data_sender_resume();
 
-bool data_sender_send_humidity_data(float data);
+/**
+ * Queue a sample for the sender task, it is published or spooled if offline.
+ * The queue is lock-free with a single producer, call it from one task only.
+ */
+bool data_sender_enqueue_sample(const telemetry_sample_t *sample);
+
+/**
+ * Publish queued, batched and spooled samples, waiting at most timeout_ms.
+ * Return true when nothing is left to publish.
+ */
+bool data_sender_flush(uint32_t timeout_ms);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,69 @@
+#ifndef DUTY_CYCLE_INCLUDE_DUTY_CYCLE_H_
+#define DUTY_CYCLE_INCLUDE_DUTY_CYCLE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "driver/gpio.h"
+#include "app-models.h"
+#include "acquisition-scheduler.h"
+
+typedef enum {
+    // wake the PMS sensor up and sleep while its fan spins up
+    DUTY_CYCLE_WARM_UP = 0,
+    // read sensors into the RTC buffer
+    DUTY_CYCLE_MEASURE,
+    // read sensors, then publish the RTC buffer
+    DUTY_CYCLE_UPLOAD
+} duty_cycle_step_t;
+
+/**
+ * Return the step the current wake is meant for.
+ * Anything but a timer or pad wake up, e.g. a power on, starts over with a fresh buffer.
+ */
+duty_cycle_step_t duty_cycle_begin();
+
+/**
+ * Turn the current wake into a whole cycle without deep sleep, return DUTY_CYCLE_UPLOAD.
+ * The PMS sensor is warmed up awake by the caller.
+ */
+duty_cycle_step_t duty_cycle_stay_awake();
+
+/**
+ * Append a sample to the RTC buffer, the oldest sample is dropped when full
+ */
+bool duty_cycle_store_sample(const telemetry_sample_t *sample);
+
+/**
+ * Move buffered samples to sink, samples refused by sink stay buffered
+ */
+uint16_t duty_cycle_flush_samples(sample_sink_f sink);
+
+void duty_cycle_set_upload_result(bool is_uploaded);
+
+/**
+ * True when the current upload should check for a firmware update,
+ * the first upload after power on and then about every FW_CHECK_INTERVAL
+ */
+bool duty_cycle_is_fw_check_due();
+
+/**
+ * Wake up from deep sleep when gpio_num, an RTC IO, is at level
+ */
+void duty_cycle_set_wakeup_pad(gpio_num_t gpio_num, int level);
+
+/**
+ * True when the current wake was caused by the wake up pad instead of the next step
+ */
+bool duty_cycle_is_pad_wakeup();
+
+/**
+ * Enter deep sleep again until the step the pad wake up interrupted
+ */
+void duty_cycle_resume_sleep();
+
+/**
+ * Log the awake time of the current wake and enter deep sleep until the next step
+ */
+void duty_cycle_sleep();
+
+#endif
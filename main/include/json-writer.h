@@ -0,0 +1,53 @@
+#ifndef JSON_WRITER_INCLUDE_JSON_WRITER_H_
+#define JSON_WRITER_INCLUDE_JSON_WRITER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSON_WRITER_MAX_DEPTH 16
+
+/**
+ * Streaming JSON writer rendering into a caller provided buffer.
+ * No heap allocation is performed and the output is byte compatible
+ * with cJSON_PrintUnformatted.
+ */
+typedef struct {
+    char *buffer;
+    size_t size;
+    size_t length;
+    uint16_t has_items;
+    uint8_t depth;
+    bool overflow;
+} json_writer_t;
+
+void json_writer_init(json_writer_t *writer, char *buffer, size_t size);
+
+/**
+ * Containers and values take a key when written inside an object,
+ * pass NULL as key for the root element and for array items.
+ */
+void json_writer_begin_object(json_writer_t *writer, const char *key);
+
+void json_writer_end_object(json_writer_t *writer);
+
+void json_writer_begin_array(json_writer_t *writer, const char *key);
+
+void json_writer_end_array(json_writer_t *writer);
+
+void json_writer_add_string(json_writer_t *writer, const char *key, const char *value);
+
+void json_writer_add_number(json_writer_t *writer, const char *key, double value);
+
+/**
+ * Append a member rendered in advance, e.g. "key":"value", already escaped
+ */
+void json_writer_add_raw_member(json_writer_t *writer, const char *member);
+
+/**
+ * Return the zero terminated document or NULL if the buffer was too small
+ * or containers are left open.
+ */
+const char* json_writer_finish(json_writer_t *writer);
+
+#endif
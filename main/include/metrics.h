@@ -0,0 +1,46 @@
+#ifndef METRICS_INCLUDE_METRICS_H_
+#define METRICS_INCLUDE_METRICS_H_
+
+#include <stdint.h>
+#include "json-writer.h"
+
+typedef enum {
+    // samples refused by the sender queue or lost because the spool was full
+    METRIC_SAMPLES_DROPPED,
+    METRIC_SAMPLES_SPOOLED,
+    // samples within the deadband of the last published one
+    METRIC_SAMPLES_SUPPRESSED,
+    // telemetry messages handed to the MQTT client
+    METRIC_MESSAGES_SENT,
+    // QoS 1 messages not acknowledged in time
+    METRIC_DELIVERIES_LOST,
+    METRIC_DHT_CHECKSUM_ERRORS,
+    METRIC_DHT_TIMEOUT_ERRORS,
+    METRIC_DHT_OTHER_ERRORS,
+    METRIC_COUNTERS_COUNT
+} metric_counter_t;
+
+/**
+ * Gauges keep the highest value recorded since the previous health report
+ */
+typedef enum {
+    METRIC_SAMPLES_QUEUE_DEPTH,
+    METRIC_GAUGES_COUNT
+} metric_gauge_t;
+
+/**
+ * Counters, gauges and the latency histogram are plain atomics in static
+ * memory, they can be updated from any task without locks.
+ */
+void metrics_increment(metric_counter_t counter);
+
+void metrics_record_max(metric_gauge_t gauge, uint32_t value);
+
+void metrics_record_publish_latency(uint32_t latency_ms);
+
+/**
+ * Add metrics as members of the object open in writer, gauges are reset
+ */
+void metrics_write_health(json_writer_t *writer);
+
+#endif
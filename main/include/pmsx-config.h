@@ -12,8 +12,7 @@ pmsx003_config_t pms_conf = {
     .uart_port = UART_PORT,
     .indoor = false,
     .enabled = true,
-    .periodic = true,
-    .periodic_sec_interval = 300, // every five minutes
+    .periodic = false, // reads are timed by the acquisition scheduler
     .set_pin = SET_GPIO,
     .reset_pin = RESET_GPIO,
     .uart_tx_pin = TX_GPIO,
@@ -0,0 +1,41 @@
+#ifndef PROFILER_INCLUDE_PROFILER_H_
+#define PROFILER_INCLUDE_PROFILER_H_
+
+#include <stdint.h>
+
+/**
+ * Start point of a measured path
+ */
+typedef struct {
+    uint32_t cycles;
+    int64_t time;
+    uint32_t free_heap;
+} profiler_mark_t;
+
+#ifdef CONFIG_TELEMETRY_PROFILING
+
+void profiler_start(profiler_mark_t *mark);
+
+/**
+ * Log cycles, microseconds and heap consumed by path since mark as a JSON line
+ */
+void profiler_report(const char *path, const profiler_mark_t *mark);
+
+/**
+ * Log the time elapsed from boot to reach milestone as a JSON line
+ */
+void profiler_report_since_boot(const char *milestone);
+
+#define PROFILER_START(mark) profiler_mark_t mark; profiler_start(&mark)
+#define PROFILER_REPORT(path, mark) profiler_report(path, &mark)
+#define PROFILER_REPORT_SINCE_BOOT(milestone) profiler_report_since_boot(milestone)
+
+#else
+
+#define PROFILER_START(mark)
+#define PROFILER_REPORT(path, mark)
+#define PROFILER_REPORT_SINCE_BOOT(milestone)
+
+#endif
+
+#endif
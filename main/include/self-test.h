@@ -0,0 +1,43 @@
+#ifndef SELF_TEST_INCLUDE_SELF_TEST_H_
+#define SELF_TEST_INCLUDE_SELF_TEST_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_event.h"
+
+ESP_EVENT_DECLARE_BASE(SELF_TEST_EVENTS);
+
+enum {
+    // the running firmware has been marked valid
+    SELF_TEST_EVENT_PASSED
+};
+
+typedef enum {
+    SELF_TEST_PMS_FRAME = 1 << 0,
+    SELF_TEST_DHT_READ = 1 << 1,
+    SELF_TEST_MQTT_CONNECTED = 1 << 2
+} self_test_check_t;
+
+/**
+ * Start the self-test if the running firmware is pending verification, return false otherwise.
+ * The firmware is marked valid once every check passed with enough free heap,
+ * it's rolled back if that doesn't happen within CONFIG_FW_SELF_TEST_TIMEOUT from boot.
+ */
+bool self_test_start();
+
+/**
+ * Record a passed check, nothing happens if no self-test is running
+ */
+void self_test_pass(self_test_check_t check);
+
+/**
+ * Block until the self-test ends, return immediately if none was started
+ */
+void self_test_wait();
+
+/**
+ * Milliseconds from boot to the firmware being marked valid, -1 if that didn't happen during this boot
+ */
+int64_t self_test_get_time_to_valid_ms();
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef SENSOR_DRIVERS_INCLUDE_SENSOR_DRIVERS_H_
+#define SENSOR_DRIVERS_INCLUDE_SENSOR_DRIVERS_H_
+
+#include "acquisition-scheduler.h"
+
+// PMSx003 fan has to run 30 seconds before readings are stable
+#define SENSOR_DRIVERS_PMS_WARMUP_TIME 30000
+
+extern const sensor_driver_t dht_sensor_driver;
+
+extern const sensor_driver_t pms_sensor_driver;
+
+/**
+ * Latch the PMS SET line so that the sensor stays awake, or asleep, while the chip is in deep sleep
+ */
+void sensor_drivers_hold_pms_state(bool awake);
+
+void sensor_drivers_release_pms_state();
+
+#endif
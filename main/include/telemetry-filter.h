@@ -0,0 +1,40 @@
+#ifndef TELEMETRY_FILTER_INCLUDE_TELEMETRY_FILTER_H_
+#define TELEMETRY_FILTER_INCLUDE_TELEMETRY_FILTER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "app-models.h"
+
+/**
+ * Report by exception policy of a sample type. A sample is published when it
+ * moves more than deadband (absolute) or deadband_percent (relative to the last
+ * published value) away from the last published one, or when heartbeat seconds
+ * went by since then. A zero field is disabled, with both deadbands disabled
+ * any change is published. An all zero policy publishes every sample.
+ */
+typedef struct {
+    float deadband;
+    float deadband_percent;
+    uint32_t heartbeat;
+} telemetry_filter_policy_t;
+
+/**
+ * Load persisted policies, to be called before the sender task starts
+ */
+void telemetry_filter_init();
+
+/**
+ * Decide whether sample is published, accepted samples become the new
+ * reference. Called from the sender task only.
+ */
+bool telemetry_filter_accept(const telemetry_sample_t *sample);
+
+/**
+ * Update and persist policies from a JSON document like
+ * {"pollution":{"deadband":2,"deadbandPercent":10,"heartbeat":3600}},
+ * sample types not listed keep their policy. Configurations are applied by
+ * a single task, the MQTT one, and picked up by the sender task.
+ */
+bool telemetry_filter_configure(const char *json, int length);
+
+#endif
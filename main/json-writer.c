@@ -0,0 +1,212 @@
+#include "json-writer.h"
+
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUMBER_BUFFER_SIZE 26
+
+static void json_writer_put_char(json_writer_t *writer, char c) {
+
+    // keep one byte for the string terminator
+    if (writer->length + 1 >= writer->size) {
+        writer->overflow = true;
+        return;
+    }
+
+    writer->buffer[writer->length++] = c;
+}
+
+static void json_writer_put_chars(json_writer_t *writer, const char *chars, size_t length) {
+
+    if (writer->length + length >= writer->size) {
+        writer->overflow = true;
+        return;
+    }
+
+    memcpy(writer->buffer + writer->length, chars, length);
+    writer->length += length;
+}
+
+static void json_writer_put_escaped(json_writer_t *writer, const char *value) {
+
+    json_writer_put_char(writer, '\"');
+
+    for (const unsigned char *c = (const unsigned char *) value; *c != '\0'; c++) {
+        switch (*c) {
+            case '\"':
+                json_writer_put_chars(writer, "\\\"", 2);
+                break;
+            case '\\':
+                json_writer_put_chars(writer, "\\\\", 2);
+                break;
+            case '\b':
+                json_writer_put_chars(writer, "\\b", 2);
+                break;
+            case '\f':
+                json_writer_put_chars(writer, "\\f", 2);
+                break;
+            case '\n':
+                json_writer_put_chars(writer, "\\n", 2);
+                break;
+            case '\r':
+                json_writer_put_chars(writer, "\\r", 2);
+                break;
+            case '\t':
+                json_writer_put_chars(writer, "\\t", 2);
+                break;
+            default:
+                if (*c < 32) {
+                    char escaped[7];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", *c);
+                    json_writer_put_chars(writer, escaped, 6);
+                } else {
+                    json_writer_put_char(writer, *c);
+                }
+                break;
+        }
+    }
+
+    json_writer_put_char(writer, '\"');
+}
+
+/**
+ * Write the separator and the key preceding a value, if any
+ */
+static void json_writer_begin_value(json_writer_t *writer, const char *key) {
+
+    if (writer->depth > 0) {
+        uint16_t mask = 1 << (writer->depth - 1);
+        if (writer->has_items & mask) {
+            json_writer_put_char(writer, ',');
+        }
+        writer->has_items |= mask;
+    }
+
+    if (key != NULL) {
+        json_writer_put_escaped(writer, key);
+        json_writer_put_char(writer, ':');
+    }
+}
+
+static void json_writer_open(json_writer_t *writer, const char *key, char token) {
+
+    if (writer->depth >= JSON_WRITER_MAX_DEPTH) {
+        writer->overflow = true;
+        return;
+    }
+
+    json_writer_begin_value(writer, key);
+    json_writer_put_char(writer, token);
+
+    writer->depth++;
+    writer->has_items &= ~(1 << (writer->depth - 1));
+}
+
+static void json_writer_close(json_writer_t *writer, char token) {
+
+    if (writer->depth == 0) {
+        writer->overflow = true;
+        return;
+    }
+
+    json_writer_put_char(writer, token);
+    writer->depth--;
+}
+
+/**
+ * Same rules cJSON applies when printing numbers: integral values are
+ * printed as int, others with the shortest of 15 or 17 significant digits
+ * that reads back to the same double.
+ */
+static void json_writer_put_number(json_writer_t *writer, double value) {
+
+    char number[NUMBER_BUFFER_SIZE] = {'\0'};
+    int length = 0;
+
+    int integer_value = value >= INT_MAX ? INT_MAX : value <= (double) INT_MIN ? INT_MIN : (int) value;
+
+    if (isnan(value) || isinf(value)) {
+        length = snprintf(number, sizeof(number), "null");
+    } else if (value == (double) integer_value) {
+        length = snprintf(number, sizeof(number), "%d", integer_value);
+    } else {
+        length = snprintf(number, sizeof(number), "%1.15g", value);
+
+        double test = strtod(number, NULL);
+        double max_value = fabs(test) > fabs(value) ? fabs(test) : fabs(value);
+        if (fabs(test - value) > max_value * DBL_EPSILON) {
+            length = snprintf(number, sizeof(number), "%1.17g", value);
+        }
+    }
+
+    if (length < 0 || length >= NUMBER_BUFFER_SIZE) {
+        writer->overflow = true;
+        return;
+    }
+
+    json_writer_put_chars(writer, number, length);
+}
+
+void json_writer_init(json_writer_t *writer, char *buffer, size_t size) {
+
+    writer->buffer = buffer;
+    writer->size = size;
+    writer->length = 0;
+    writer->has_items = 0;
+    writer->depth = 0;
+    writer->overflow = buffer == NULL || size == 0;
+}
+
+void json_writer_begin_object(json_writer_t *writer, const char *key) {
+    json_writer_open(writer, key, '{');
+}
+
+void json_writer_end_object(json_writer_t *writer) {
+    json_writer_close(writer, '}');
+}
+
+void json_writer_begin_array(json_writer_t *writer, const char *key) {
+    json_writer_open(writer, key, '[');
+}
+
+void json_writer_end_array(json_writer_t *writer) {
+    json_writer_close(writer, ']');
+}
+
+void json_writer_add_string(json_writer_t *writer, const char *key, const char *value) {
+
+    json_writer_begin_value(writer, key);
+
+    if (value == NULL) {
+        json_writer_put_chars(writer, "null", 4);
+        return;
+    }
+
+    json_writer_put_escaped(writer, value);
+}
+
+void json_writer_add_number(json_writer_t *writer, const char *key, double value) {
+
+    json_writer_begin_value(writer, key);
+    json_writer_put_number(writer, value);
+}
+
+void json_writer_add_raw_member(json_writer_t *writer, const char *member) {
+
+    json_writer_begin_value(writer, NULL);
+    json_writer_put_chars(writer, member, strlen(member));
+}
+
+const char* json_writer_finish(json_writer_t *writer) {
+
+    if (writer->overflow || writer->depth != 0) {
+        return NULL;
+    }
+
+    writer->buffer[writer->length] = '\0';
+    return writer->buffer;
+}
@@ -9,9 +9,7 @@
 #include "wifi-manager.h"
 #include "mqtt-events.h"
 #include "mqtt-manager.h"
-#include "idf-pmsx003.h"
 #include "data-sender.h"
-#include "pmsx-config.h"
 #include "time-manager.h"
 #include "wifi-provisioning-events.h"
 #include "wifi-provisioning.h"
@@ -19,15 +17,27 @@
 #include "device-helper.h"
 #include "gpio-manager.h"
 #include "driver/gpio.h"
-#include "dht-manager.h"
+#include "acquisition-scheduler.h"
+#include "sensor-drivers.h"
 #include "ota-manager.h"
+#include "duty-cycle.h"
+#include "profiler.h"
+#include "aggregator.h"
+#include "self-test.h"
 
-static const char *TAG = "breathe-app";
+#ifdef CONFIG_DUTY_CYCLE_MODE
+#define DUTY_CYCLE_CONNECT_TIMEOUT 20000
+#define DUTY_CYCLE_FLUSH_TIMEOUT 15000
+#define DUTY_CYCLE_FW_CHECK_TIMEOUT 60000
+// as the long click of gpio-manager
+#define DUTY_CYCLE_RESET_HOLD_TIME 3000
+#endif
 
-static void pms_callback(pm_data_t *sensor_data) {
+// the first PMS frame of a self-test comes after the warm up of an immediate read
+_Static_assert(CONFIG_FW_SELF_TEST_TIMEOUT * 1000 > SENSOR_DRIVERS_PMS_WARMUP_TIME + ACQUISITION_SCHEDULER_MAX_LATENESS_MS,
+    "self-test timeout shorter than the PMS warm up");
 
-    data_sender_enqueue_pms_data(sensor_data);
-}
+static const char *TAG = "breathe-app";
 
 static void load_mqtt_certificates(mqtt_certificates_t *out) {
 
@@ -59,7 +69,11 @@ static void wifi_event_handler(void* handler_args, esp_event_base_t base, int32_
 static void mqtt_event_handler(void* handler_args, esp_event_base_t base, int32_t id, void* event_data) {
     
     if (id == MQTT_MANAGER_EVENT_CONNECTED) {
+        PROFILER_REPORT_SINCE_BOOT("mqtt_connected");
+        self_test_pass(SELF_TEST_MQTT_CONNECTED);
         data_sender_provision_device();
+        data_sender_subscribe_configuration();
+        data_sender_resume();
     } 
 }
 
@@ -71,20 +85,153 @@ static void gpio_event_callback(uint8_t gpio_num, pad_event_t event) {
     }
 }
 
+static pad_conf_t reset_pad_conf = {
+    .gpio_number = GPIO_NUM_0,
+    .direction = GPIO_INPUT,
+    .pull_mode = GPIO_PULL_UP,
+    .interrput_mode = GPIO_INTERRUPT_FALLING,
+    .callback = &gpio_event_callback
+};
+
+#ifdef CONFIG_DUTY_CYCLE_MODE
+
+static bool duty_cycle_upload() {
+
+    esp_event_handler_register(MQTT_MANAGER_EVENTS, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
+    esp_event_handler_register(WIFI_MANAGER_EVENTS, ESP_EVENT_ANY_ID, wifi_event_handler, NULL);
+
+    wifi_manager_init();
+    mqtt_manager_init(&load_mqtt_certificates);
+    data_sender_init();
+
+    ota_manager_init();
+
+    for (int waited = 0; !mqtt_manager_is_connected() && waited < DUTY_CYCLE_CONNECT_TIMEOUT; waited += 100) {
+        vTaskDelay(100 / portTICK_PERIOD_MS);
+    }
+
+    if (!mqtt_manager_is_connected()) {
+        ESP_LOGW(TAG, "broker not reachable, samples kept for the next upload");
+        return false;
+    }
+
+    uint16_t flushed = duty_cycle_flush_samples(&data_sender_enqueue_sample);
+
+    // samples not published in time are safe in the spool
+    bool is_flushed = data_sender_flush(DUTY_CYCLE_FLUSH_TIMEOUT);
+    ESP_LOGI(TAG, "%u samples uploaded, spool %s", flushed, is_flushed ? "empty" : "not empty");
+
+    // a firmware validated by this upload reports its time to valid before disconnecting
+    self_test_wait();
+    if (self_test_get_time_to_valid_ms() >= 0) {
+        data_sender_provision_device();
+    }
+
+    // the periodic check never comes in a wake this short, a downloaded update restarts the device
+    if (duty_cycle_is_fw_check_due() && !ota_manager_check_now(DUTY_CYCLE_FW_CHECK_TIMEOUT)) {
+        ESP_LOGW(TAG, "firmware check not completed, a partial download goes on at the next check");
+    }
+
+    mqtt_manager_disconnect();
+    return true;
+}
+
+/**
+ * The press woke the chip up before the gpio manager could see its edge,
+ * a press held long enough resets the device as a long click does
+ */
+static void duty_cycle_handle_pad_wakeup() {
+
+    int held = 0;
+    while (gpio_get_level(GPIO_NUM_0) == 0 && held < DUTY_CYCLE_RESET_HOLD_TIME) {
+        vTaskDelay(50 / portTICK_PERIOD_MS);
+        held += 50;
+    }
+
+    if (held >= DUTY_CYCLE_RESET_HOLD_TIME) {
+        gpio_event_callback(GPIO_NUM_0, GPIO_LONG_CLICK);
+    }
+
+    duty_cycle_resume_sleep();
+}
+
+static void duty_cycle_task(void *args) {
+
+    const sensor_driver_t *drivers[] = { &pms_sensor_driver, &dht_sensor_driver };
+
+    gpio_manager_init();
+    gpio_manager_configure_pad(&reset_pad_conf);
+    // GPIO0 has the pull up of the boot strap, a press pulls it low
+    duty_cycle_set_wakeup_pad(GPIO_NUM_0, 0);
+
+    duty_cycle_step_t step = duty_cycle_begin();
+
+    if (duty_cycle_is_pad_wakeup()) {
+        duty_cycle_handle_pad_wakeup();
+    }
+
+    // deep sleep resets through the bootloader, which rolls back a firmware still pending verification
+    bool is_self_testing = self_test_start();
+    if (is_self_testing) {
+        step = duty_cycle_stay_awake();
+    }
+
+    if (step == DUTY_CYCLE_WARM_UP) {
+        sensor_drivers_hold_pms_state(true);
+        duty_cycle_sleep();
+    }
+
+    // the SET line is still latched, it is driven high again before being released
+    for (int i = 0; i < sizeof(drivers) / sizeof(drivers[0]); i++) {
+        if (drivers[i]->init != NULL) {
+            drivers[i]->init();
+        }
+        if (drivers[i]->prepare != NULL) {
+            drivers[i]->prepare();
+        }
+    }
+    sensor_drivers_release_pms_state();
+
+    if (is_self_testing) {
+        vTaskDelay(SENSOR_DRIVERS_PMS_WARMUP_TIME / portTICK_PERIOD_MS);
+    }
+
+    for (int i = 0; i < sizeof(drivers) / sizeof(drivers[0]); i++) {
+        esp_err_t err = drivers[i]->read(&duty_cycle_store_sample);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "%s read failed: %d", drivers[i]->name, err);
+        }
+    }
+
+    sensor_drivers_hold_pms_state(false);
+
+    if (step == DUTY_CYCLE_UPLOAD) {
+        duty_cycle_set_upload_result(duty_cycle_upload());
+    }
+
+    self_test_wait();
+    duty_cycle_sleep();
+}
+
+#else
+
+static void self_test_event_handler(void* handler_args, esp_event_base_t base, int32_t id, void* event_data) {
+
+    // provisioning sent on connection didn't carry the time to valid yet
+    if (id == SELF_TEST_EVENT_PASSED && mqtt_manager_is_connected()) {
+        data_sender_provision_device();
+    }
+}
+
 static void main_task(void *args) {
 
+    esp_event_handler_register(SELF_TEST_EVENTS, ESP_EVENT_ANY_ID, self_test_event_handler, NULL);
+    bool is_self_testing = self_test_start();
+
     esp_event_handler_register(MQTT_MANAGER_EVENTS, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
     
     esp_event_handler_register(WIFI_MANAGER_EVENTS, ESP_EVENT_ANY_ID, wifi_event_handler, NULL);
     
-     pad_conf_t reset_pad_conf = {
-        .gpio_number = GPIO_NUM_0,
-        .direction = GPIO_INPUT,
-        .pull_mode = GPIO_PULL_UP,
-        .interrput_mode = GPIO_INTERRUPT_FALLING,
-        .callback = &gpio_event_callback
-    };
-
     gpio_manager_init();
     gpio_manager_configure_pad(&reset_pad_conf);
 
@@ -92,20 +239,29 @@ static void main_task(void *args) {
     mqtt_manager_init(&load_mqtt_certificates);
     data_sender_init();
 
-    pms_conf.callback = &pms_callback,
-    idf_pmsx5003_init(&pms_conf);
-
     ota_manager_init();
-    
-    //dht_manager_start_update_task();
 
-    while (true) {
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
+    acquisition_scheduler_register(&pms_sensor_driver);
+    acquisition_scheduler_register(&dht_sensor_driver);
+#ifdef CONFIG_TELEMETRY_AGGREGATION
+    aggregator_init(&data_sender_enqueue_sample);
+    sample_sink_f sink = &aggregator_add_sample;
+#else
+    sample_sink_f sink = &data_sender_enqueue_sample;
+#endif
+
+    // a new firmware has to read its sensors within the self-test timeout, not one interval after boot
+    if (is_self_testing) {
+        acquisition_scheduler_start_now(sink);
+    } else {
+        acquisition_scheduler_start(sink);
     }
 
     vTaskDelete(NULL);
 }
 
+#endif
+
 void app_main(void) {
 
     /* Print chip information */
@@ -129,7 +285,11 @@ void app_main(void) {
     storage_manager_init();
 
     if (device_helper_is_enrollment_completed()) {
+#ifdef CONFIG_DUTY_CYCLE_MODE
+        xTaskCreate(duty_cycle_task, "duty cycle task", 4096, NULL, 5, NULL);
+#else
         xTaskCreate(main_task, "main task", 4096, NULL, 5, NULL);
+#endif
     } else {
         esp_event_handler_register(WIFI_MANAGER_PROVISIONING_EVENTS, ESP_EVENT_ANY_ID, wifi_provisioning_event_handler, NULL);
         wifi_provisioning_start();
@@ -0,0 +1,106 @@
+#include "metrics.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "wifi-manager.h"
+
+// upper bounds in ms, the last bucket counts anything slower
+static const uint32_t LATENCY_BUCKETS[] = { 50, 100, 250, 500, 1000, 2500, 5000 };
+
+#define LATENCY_BUCKETS_COUNT (sizeof(LATENCY_BUCKETS) / sizeof(LATENCY_BUCKETS[0]) + 1)
+
+// indexed by metric_counter_t
+static const char *COUNTER_NAMES[METRIC_COUNTERS_COUNT] = {
+    "samplesDropped",
+    "samplesSpooled",
+    "samplesSuppressed",
+    "messagesSent",
+    "deliveriesLost",
+    "dhtChecksumErrors",
+    "dhtTimeoutErrors",
+    "dhtOtherErrors"
+};
+
+// indexed by metric_gauge_t
+static const char *GAUGE_NAMES[METRIC_GAUGES_COUNT] = {
+    "samplesQueueDepth"
+};
+
+// tasks whose stack high-water mark is reported, missing ones are skipped
+static const char *MONITORED_TASKS[] = {
+    "pms data sender task",
+    "acquisition_task",
+    "wifi reconnect task",
+    "gpio event task",
+    "ota-task"
+};
+
+#define MONITORED_TASKS_COUNT (sizeof(MONITORED_TASKS) / sizeof(MONITORED_TASKS[0]))
+
+static uint32_t counters[METRIC_COUNTERS_COUNT];
+
+static uint32_t gauges[METRIC_GAUGES_COUNT];
+
+static uint32_t latency_buckets[LATENCY_BUCKETS_COUNT];
+
+void metrics_increment(metric_counter_t counter) {
+
+    __atomic_fetch_add(&counters[counter], 1, __ATOMIC_RELAXED);
+}
+
+void metrics_record_max(metric_gauge_t gauge, uint32_t value) {
+
+    uint32_t current = __atomic_load_n(&gauges[gauge], __ATOMIC_RELAXED);
+    while (value > current &&
+        !__atomic_compare_exchange_n(&gauges[gauge], &current, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+void metrics_record_publish_latency(uint32_t latency_ms) {
+
+    int bucket = 0;
+    while (bucket < LATENCY_BUCKETS_COUNT - 1 && latency_ms > LATENCY_BUCKETS[bucket]) {
+        bucket++;
+    }
+
+    __atomic_fetch_add(&latency_buckets[bucket], 1, __ATOMIC_RELAXED);
+}
+
+static void metrics_write_stacks(json_writer_t *writer) {
+
+    json_writer_begin_object(writer, "stackHighWater");
+
+    for (int i = 0; i < MONITORED_TASKS_COUNT; i++) {
+        TaskHandle_t task = xTaskGetHandle(MONITORED_TASKS[i]);
+        if (task != NULL) {
+            json_writer_add_number(writer, MONITORED_TASKS[i], uxTaskGetStackHighWaterMark(task));
+        }
+    }
+
+    json_writer_end_object(writer);
+}
+
+void metrics_write_health(json_writer_t *writer) {
+
+    json_writer_add_number(writer, "uptime", esp_timer_get_time() / 1000000);
+    json_writer_add_number(writer, "freeHeap", esp_get_free_heap_size());
+    json_writer_add_number(writer, "minFreeHeap", esp_get_minimum_free_heap_size());
+    json_writer_add_number(writer, "wifiAttempts", wifi_manager_get_connection_attempts());
+
+    for (int i = 0; i < METRIC_COUNTERS_COUNT; i++) {
+        json_writer_add_number(writer, COUNTER_NAMES[i], __atomic_load_n(&counters[i], __ATOMIC_RELAXED));
+    }
+
+    for (int i = 0; i < METRIC_GAUGES_COUNT; i++) {
+        json_writer_add_number(writer, GAUGE_NAMES[i], __atomic_exchange_n(&gauges[i], 0, __ATOMIC_RELAXED));
+    }
+
+    json_writer_begin_array(writer, "publishLatency");
+    for (int i = 0; i < LATENCY_BUCKETS_COUNT; i++) {
+        json_writer_add_number(writer, NULL, __atomic_load_n(&latency_buckets[i], __ATOMIC_RELAXED));
+    }
+    json_writer_end_array(writer);
+
+    metrics_write_stacks(writer);
+}
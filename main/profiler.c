@@ -0,0 +1,36 @@
+#include "profiler.h"
+
+#ifdef CONFIG_TELEMETRY_PROFILING
+
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "xtensa/hal.h"
+
+static const char *TAG = "profiler";
+
+void profiler_start(profiler_mark_t *mark) {
+
+    mark->free_heap = esp_get_free_heap_size();
+    mark->time = esp_timer_get_time();
+    mark->cycles = xthal_get_ccount();
+}
+
+void profiler_report(const char *path, const profiler_mark_t *mark) {
+
+    // read first, logging below is not part of the measure
+    uint32_t cycles = xthal_get_ccount() - mark->cycles;
+    int64_t elapsed = esp_timer_get_time() - mark->time;
+    int32_t heap_used = (int32_t) (mark->free_heap - esp_get_free_heap_size());
+
+    ESP_LOGI(TAG, "{\"path\":\"%s\",\"cycles\":%u,\"us\":%lld,\"heap\":%d,\"minHeap\":%u}",
+        path, cycles, elapsed, heap_used, esp_get_minimum_free_heap_size());
+}
+
+void profiler_report_since_boot(const char *milestone) {
+
+    ESP_LOGI(TAG, "{\"path\":\"%s\",\"us\":%lld,\"minHeap\":%u}",
+        milestone, esp_timer_get_time(), esp_get_minimum_free_heap_size());
+}
+
+#endif
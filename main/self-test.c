@@ -0,0 +1,95 @@
+#include "self-test.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "ota-manager.h"
+
+#define SELF_TEST_CHECKS (SELF_TEST_PMS_FRAME | SELF_TEST_DHT_READ | SELF_TEST_MQTT_CONNECTED)
+
+#define SELF_TEST_DONE_BIT BIT7
+
+#define SELF_TEST_TIMEOUT_MS ((int64_t) CONFIG_FW_SELF_TEST_TIMEOUT * 1000)
+
+ESP_EVENT_DEFINE_BASE(SELF_TEST_EVENTS);
+
+static const char *TAG = "self-test";
+
+static EventGroupHandle_t self_test_event_group = NULL;
+
+// written before SELF_TEST_DONE_BIT is set
+static int64_t time_to_valid_ms = -1;
+
+static void self_test_task(void *args) {
+
+    // the timeout runs from boot, checks may have passed before the task started
+    int64_t remaining_ms = SELF_TEST_TIMEOUT_MS - esp_timer_get_time() / 1000;
+    TickType_t timeout = remaining_ms > 0 ? remaining_ms / portTICK_PERIOD_MS : 0;
+
+    EventBits_t bits = xEventGroupWaitBits(self_test_event_group, SELF_TEST_CHECKS, false, true, timeout);
+
+    uint32_t minimum_free_heap = esp_get_minimum_free_heap_size();
+    bool is_passed = (bits & SELF_TEST_CHECKS) == SELF_TEST_CHECKS && minimum_free_heap >= CONFIG_FW_SELF_TEST_MIN_HEAP;
+
+    if (!is_passed) {
+        ESP_LOGE(TAG, "self-test failed: checks 0x%x of 0x%x, minimum free heap %u bytes",
+            bits & SELF_TEST_CHECKS, SELF_TEST_CHECKS, minimum_free_heap);
+        ota_manager_rollback_image();
+    } else if (ota_manager_confirm_image()) {
+        time_to_valid_ms = esp_timer_get_time() / 1000;
+        ESP_LOGI(TAG, "self-test passed in %lld ms, minimum free heap %u bytes", time_to_valid_ms, minimum_free_heap);
+    }
+
+    xEventGroupSetBits(self_test_event_group, SELF_TEST_DONE_BIT);
+
+    if (time_to_valid_ms >= 0) {
+        esp_event_post(SELF_TEST_EVENTS, SELF_TEST_EVENT_PASSED, NULL, 0, portMAX_DELAY);
+    }
+
+    vTaskDelete(NULL);
+}
+
+bool self_test_start() {
+
+    if (!ota_manager_is_pending_verify()) {
+        return false;
+    }
+
+    self_test_event_group = xEventGroupCreate();
+    if (self_test_event_group == NULL) {
+        // the bootloader rolls the firmware back on the next reset
+        ESP_LOGE(TAG, "unable to start the self-test");
+        return false;
+    }
+
+    ESP_LOGI(TAG, "firmware %s pending verification, self-test started", ota_manager_get_fw_version());
+    xTaskCreate(self_test_task, "self-test task", 3072, NULL, 4, NULL);
+
+    return true;
+}
+
+void self_test_pass(self_test_check_t check) {
+
+    if (self_test_event_group != NULL) {
+        xEventGroupSetBits(self_test_event_group, check);
+    }
+}
+
+void self_test_wait() {
+
+    if (self_test_event_group != NULL) {
+        xEventGroupWaitBits(self_test_event_group, SELF_TEST_DONE_BIT, false, true, portMAX_DELAY);
+    }
+}
+
+int64_t self_test_get_time_to_valid_ms() {
+
+    if (self_test_event_group == NULL || (xEventGroupGetBits(self_test_event_group) & SELF_TEST_DONE_BIT) == 0) {
+        return -1;
+    }
+
+    return time_to_valid_ms;
+}
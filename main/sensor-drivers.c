@@ -0,0 +1,169 @@
+#include "sensor-drivers.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "idf-pmsx003.h"
+#include "pmsx-config.h"
+#include "dht-manager.h"
+#include "time-manager.h"
+#include "profiler.h"
+#include "metrics.h"
+#include "self-test.h"
+
+// a temperature read anticipated by a few seconds is still meaningful
+#define DHT_READ_JITTER 10000
+
+// PMSx003 streams a frame every second while awake
+#define PMS_FRAME_TIMEOUT 3000
+
+static const char *TAG = "sensor-drivers";
+
+static xQueueHandle pms_frame_queue = NULL;
+
+static void dht_driver_count_error(esp_err_t err) {
+
+    switch (err) {
+        case ESP_ERR_INVALID_CRC:
+            metrics_increment(METRIC_DHT_CHECKSUM_ERRORS);
+            break;
+        case ESP_ERR_TIMEOUT:
+            metrics_increment(METRIC_DHT_TIMEOUT_ERRORS);
+            break;
+        default:
+            metrics_increment(METRIC_DHT_OTHER_ERRORS);
+            break;
+    }
+}
+
+static esp_err_t dht_driver_read(sample_sink_f sink) {
+
+    dht_reading_t reading;
+
+    PROFILER_START(read_mark);
+    esp_err_t err = dht_manager_read(&reading);
+    PROFILER_REPORT("dht_read", read_mark);
+    if (err != ESP_OK) {
+        dht_driver_count_error(err);
+        return err;
+    }
+
+    self_test_pass(SELF_TEST_DHT_READ);
+
+    // both samples share the acquisition time of the frame
+    int64_t timestamp = reading.acquired_at / 1000;
+
+    telemetry_sample_t temperature_sample = {
+        .timestamp = timestamp,
+        .clock = SAMPLE_CLOCK_MONOTONIC,
+        .type = TEMPERATURE_SAMPLE,
+        .temperature = reading.temperature
+    };
+
+    telemetry_sample_t humidity_sample = {
+        .timestamp = timestamp,
+        .clock = SAMPLE_CLOCK_MONOTONIC,
+        .type = HUMIDITY_SAMPLE,
+        .humidity = reading.humidity
+    };
+
+    bool is_stored = sink(&temperature_sample);
+    is_stored &= sink(&humidity_sample);
+
+    return is_stored ? ESP_OK : ESP_FAIL;
+}
+
+static void pms_callback(pm_data_t *sensor_data) {
+    // keep the latest frame only
+    xQueueOverwrite(pms_frame_queue, sensor_data);
+}
+
+static void pms_set_awake(bool awake) {
+    gpio_set_level(SET_GPIO, awake ? 1 : 0);
+}
+
+static esp_err_t pms_driver_init() {
+
+    pms_frame_queue = xQueueCreate(1, sizeof(pm_data_t));
+    if (pms_frame_queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    pms_conf.callback = &pms_callback;
+    idf_pmsx5003_init(&pms_conf);
+
+    pms_set_awake(false);
+
+    return ESP_OK;
+}
+
+static esp_err_t pms_driver_prepare() {
+
+    xQueueReset(pms_frame_queue);
+    pms_set_awake(true);
+
+    return ESP_OK;
+}
+
+static esp_err_t pms_driver_read(sample_sink_f sink) {
+
+    pm_data_t frame;
+    bool has_frame = xQueueReceive(pms_frame_queue, &frame, PMS_FRAME_TIMEOUT / portTICK_PERIOD_MS) == pdTRUE;
+
+    pms_set_awake(false);
+
+    if (!has_frame) {
+        ESP_LOGW(TAG, "no frame received from PMS sensor");
+        return ESP_ERR_TIMEOUT;
+    }
+
+    self_test_pass(SELF_TEST_PMS_FRAME);
+
+    telemetry_sample_t sample = {
+        .timestamp = time_manager_get_monotonic_ms(),
+        .clock = SAMPLE_CLOCK_MONOTONIC,
+        .type = POLLUTION_SAMPLE,
+        .pollution = {
+            .pm1_0 = frame.pm1_0,
+            .pm2_5 = frame.pm2_5,
+            .pm10 = frame.pm10,
+            .particles_03um = frame.particles_03um,
+            .particles_05um = frame.particles_05um,
+            .particles_10um = frame.particles_10um,
+            .particles_25um = frame.particles_25um,
+            .particles_50um = frame.particles_50um,
+            .particles_100um = frame.particles_100um
+        }
+    };
+
+    return sink(&sample) ? ESP_OK : ESP_FAIL;
+}
+
+void sensor_drivers_hold_pms_state(bool awake) {
+
+    gpio_hold_dis(SET_GPIO);
+    pms_set_awake(awake);
+    gpio_hold_en(SET_GPIO);
+    gpio_deep_sleep_hold_en();
+}
+
+void sensor_drivers_release_pms_state() {
+    gpio_hold_dis(SET_GPIO);
+}
+
+const sensor_driver_t dht_sensor_driver = {
+    .name = "dht",
+    .interval_ms = CONFIG_DHT_READ_INTERVAL * 1000,
+    .jitter_ms = DHT_READ_JITTER,
+    .read = &dht_driver_read
+};
+
+const sensor_driver_t pms_sensor_driver = {
+    .name = "pms",
+    .interval_ms = CONFIG_PMS_READ_INTERVAL * 1000,
+    .warmup_ms = SENSOR_DRIVERS_PMS_WARMUP_TIME,
+    .init = &pms_driver_init,
+    .prepare = &pms_driver_prepare,
+    .read = &pms_driver_read
+};
@@ -0,0 +1,167 @@
+#include "telemetry-filter.h"
+
+#include <math.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "cJSON.h"
+#include "storage-manager.h"
+#include "metrics.h"
+
+#define CONFIGURATION_MAX_LENGTH 256
+
+static const char *TAG = "telemetry-filter";
+
+static char *POLICIES_KEY = "tlm_filter";
+
+// indexed by sample_type_t, summaries are never filtered
+static const char *SAMPLE_TYPE_KEYS[SAMPLE_TYPES_COUNT] = {
+    "pollution",
+    "temperature",
+    "humidity",
+    NULL
+};
+
+typedef struct {
+    bool is_valid;
+    int64_t published_at;
+    telemetry_sample_t sample;
+} filter_reference_t;
+
+// owned by the sender task
+static telemetry_filter_policy_t policies[SAMPLE_TYPES_COUNT];
+
+static filter_reference_t references[SAMPLE_TYPES_COUNT];
+
+// owned by the task applying configurations, handed over through the queue
+static telemetry_filter_policy_t configured_policies[SAMPLE_TYPES_COUNT];
+
+static QueueHandle_t policies_queue = NULL;
+
+void telemetry_filter_init() {
+
+    if (!storage_manager_get_prefs_blob_value(POLICIES_KEY, configured_policies, sizeof(configured_policies))) {
+        memset(configured_policies, 0, sizeof(configured_policies));
+    }
+
+    memcpy(policies, configured_policies, sizeof(policies));
+
+    policies_queue = xQueueCreate(1, sizeof(configured_policies));
+}
+
+static bool telemetry_filter_is_moved(const telemetry_filter_policy_t *policy, float reference, float value) {
+
+    float delta = fabsf(value - reference);
+
+    if (policy->deadband == 0 && policy->deadband_percent == 0) {
+        return delta > 0;
+    }
+
+    bool is_out_of_band = policy->deadband > 0 && delta > policy->deadband;
+    bool is_out_of_percent_band = policy->deadband_percent > 0 &&
+        delta > fabsf(reference) * policy->deadband_percent / 100;
+
+    return is_out_of_band || is_out_of_percent_band;
+}
+
+static bool telemetry_filter_is_changed(const telemetry_filter_policy_t *policy,
+        const telemetry_sample_t *reference, const telemetry_sample_t *sample) {
+
+    switch (sample->type) {
+        case POLLUTION_SAMPLE:
+            return telemetry_filter_is_moved(policy, reference->pollution.pm1_0, sample->pollution.pm1_0) ||
+                telemetry_filter_is_moved(policy, reference->pollution.pm2_5, sample->pollution.pm2_5) ||
+                telemetry_filter_is_moved(policy, reference->pollution.pm10, sample->pollution.pm10);
+        case TEMPERATURE_SAMPLE:
+            return telemetry_filter_is_moved(policy, reference->temperature, sample->temperature);
+        case HUMIDITY_SAMPLE:
+            return telemetry_filter_is_moved(policy, reference->humidity, sample->humidity);
+        default:
+            return true;
+    }
+}
+
+bool telemetry_filter_accept(const telemetry_sample_t *sample) {
+
+    if (policies_queue != NULL && xQueueReceive(policies_queue, policies, 0) == pdTRUE) {
+        ESP_LOGI(TAG, "policies updated");
+    }
+
+    if (sample->type >= SAMPLE_TYPES_COUNT) {
+        return true;
+    }
+
+    const telemetry_filter_policy_t *policy = &policies[sample->type];
+    filter_reference_t *reference = &references[sample->type];
+    int64_t now = esp_timer_get_time() / 1000000;
+
+    bool is_disabled = policy->deadband == 0 && policy->deadband_percent == 0 && policy->heartbeat == 0;
+    bool is_accepted = is_disabled || !reference->is_valid ||
+        (policy->heartbeat > 0 && now - reference->published_at >= policy->heartbeat) ||
+        telemetry_filter_is_changed(policy, &reference->sample, sample);
+
+    if (is_accepted) {
+        reference->is_valid = true;
+        reference->published_at = now;
+        reference->sample = *sample;
+    } else {
+        metrics_increment(METRIC_SAMPLES_SUPPRESSED);
+    }
+
+    return is_accepted;
+}
+
+static void telemetry_filter_read_number(const cJSON *object, const char *key, float *value) {
+
+    const cJSON *item = cJSON_GetObjectItemCaseSensitive(object, key);
+    if (cJSON_IsNumber(item) && item->valuedouble >= 0) {
+        *value = item->valuedouble;
+    }
+}
+
+bool telemetry_filter_configure(const char *json, int length) {
+
+    if (length >= CONFIGURATION_MAX_LENGTH) {
+        ESP_LOGE(TAG, "configuration too long");
+        return false;
+    }
+
+    char buffer[CONFIGURATION_MAX_LENGTH];
+    memcpy(buffer, json, length);
+    buffer[length] = '\0';
+
+    cJSON *root = cJSON_Parse(buffer);
+    if (!cJSON_IsObject(root)) {
+        ESP_LOGE(TAG, "invalid configuration");
+        cJSON_Delete(root);
+        return false;
+    }
+
+    for (int i = 0; i < SAMPLE_TYPES_COUNT; i++) {
+
+        const cJSON *item = SAMPLE_TYPE_KEYS[i] != NULL ? cJSON_GetObjectItemCaseSensitive(root, SAMPLE_TYPE_KEYS[i]) : NULL;
+        if (!cJSON_IsObject(item)) {
+            continue;
+        }
+
+        telemetry_filter_policy_t *policy = &configured_policies[i];
+        float heartbeat = policy->heartbeat;
+        telemetry_filter_read_number(item, "deadband", &policy->deadband);
+        telemetry_filter_read_number(item, "deadbandPercent", &policy->deadband_percent);
+        telemetry_filter_read_number(item, "heartbeat", &heartbeat);
+        policy->heartbeat = heartbeat;
+
+        ESP_LOGI(TAG, "%s: deadband %.2f, %.1f%%, heartbeat %u s", SAMPLE_TYPE_KEYS[i],
+            policy->deadband, policy->deadband_percent, policy->heartbeat);
+    }
+
+    cJSON_Delete(root);
+
+    if (!storage_manager_set_prefs_blob_value(POLICIES_KEY, configured_policies, sizeof(configured_policies))) {
+        ESP_LOGW(TAG, "unable to persist policies");
+    }
+
+    return policies_queue != NULL && xQueueOverwrite(policies_queue, configured_policies) == pdTRUE;
+}